@@ -1,17 +1,22 @@
 package bence.sipka.user.sapphire;
 
 import java.io.BufferedReader;
+import java.io.DataInputStream;
 import java.io.Externalizable;
 import java.io.IOException;
 import java.io.InputStreamReader;
 import java.io.ObjectInput;
 import java.io.ObjectOutput;
 import java.io.OutputStream;
+import java.nio.charset.StandardCharsets;
 import java.security.MessageDigest;
 import java.security.NoSuchAlgorithmException;
+import java.util.ArrayList;
 import java.util.Arrays;
 import java.util.HashMap;
 import java.util.HashSet;
+import java.util.LinkedHashMap;
+import java.util.List;
 import java.util.Map;
 import java.util.Map.Entry;
 import java.util.NavigableMap;
@@ -60,6 +65,17 @@ public class SapphireLevelConverterWorkerTaskFactory implements TaskFactory<Sapp
 	private static final int CATEGORY_NONE = 7;
 	public static final int SAPPHIRE_RELEASE_VERSION = 3;
 
+	/**
+	 * Asset name of the level catalog which contains the descriptors of all the converted levels.
+	 * <p>
+	 * Placed next to the levels directory, so it is not enumerated together with the level files.
+	 */
+	public static final String CATALOG_ASSET_NAME = "gameres/game_sapphire/levels.catalog";
+	private static final byte[] CATALOG_MAGIC = { 'R', 'H', 'L', 'C' };
+	private static final int CATALOG_VERSION = 2;
+	private static final int CATALOG_FLAG_NON_MODIFYABLE = 0x01;
+	private static final int CATALOG_FLAG_HAS_AUTHOR = 0x02;
+
 	private int maxDifficulty = 10;
 	private Set<FileCollectionStrategy> levelcollectionstrategies;
 	private Set<FileCollectionStrategy> musiccollectionstrategies;
@@ -114,16 +130,29 @@ public class SapphireLevelConverterWorkerTaskFactory implements TaskFactory<Sapp
 
 		NavigableMap<String, SakerPath> assets = new TreeMap<>();
 
+		NavigableMap<String, CatalogEntry> catalog = new TreeMap<>();
+
 		SakerPath workingdirpath = taskcontext.getTaskWorkingDirectoryPath();
 
 		for (Entry<SakerPath, SakerFile> entry : levelinputfiles.entrySet()) {
+			CatalogEntry catalogentry = new CatalogEntry();
 			SakerFile convertresult = convertFile(taskcontext, entry.getKey(), entry.getValue(), genDirectory,
-					workingdirpath, cc);
+					workingdirpath, cc, catalogentry);
 			if (convertresult != null) {
-				assets.put(workingdirpath.relativize(entry.getKey()).toString(), convertresult.getSakerPath());
+				String assetname = workingdirpath.relativize(entry.getKey()).toString();
+				assets.put(assetname, convertresult.getSakerPath());
+				catalog.put(assetname, catalogentry);
 			}
 		}
 
+		SakerPath catalogpath = SakerPath.valueOf(CATALOG_ASSET_NAME);
+		byte[] catalogbytes = writeCatalog(catalog);
+		verifyCatalog(catalogbytes, assets);
+		SakerFile catalogfile = new ByteArraySakerFile(catalogpath.getFileName(), catalogbytes);
+		taskcontext.getTaskUtilities().resolveDirectoryAtRelativePathCreate(genDirectory, catalogpath.getParent())
+				.add(catalogfile);
+		assets.put(CATALOG_ASSET_NAME, catalogfile.getSakerPath());
+
 		taskcontext.getTaskUtilities().reportOutputFileDependency(null, SakerPathFiles.toFileContentMap(genDirectory
 				.getFilesRecursiveByPath(genDirectory.getSakerPath(), DirectoryVisitPredicate.everything())));
 		genDirectory.synchronize();
@@ -134,11 +163,11 @@ public class SapphireLevelConverterWorkerTaskFactory implements TaskFactory<Sapp
 	}
 
 	private SakerFile convertFile(TaskContext taskcontext, SakerPath filepath, SakerFile file, SakerDirectory outdir,
-			SakerPath workingdirpath, ConverterContext cc) {
+			SakerPath workingdirpath, ConverterContext cc, CatalogEntry catalogentry) {
 		byte[] result;
 		try {
 			SakerPath relpath = workingdirpath.relativize(filepath);
-			result = translateFile(file, cc);
+			result = translateFile(file, cc, catalogentry);
 			SakerFile outputfile = new ByteArraySakerFile(file.getName(), result);
 
 			taskcontext.getTaskUtilities().resolveDirectoryAtRelativePathCreate(outdir, relpath.getParent())
@@ -149,7 +178,8 @@ public class SapphireLevelConverterWorkerTaskFactory implements TaskFactory<Sapp
 		return null;
 	}
 
-	private byte[] translateFile(SakerFile file, ConverterContext cc) throws DontIncludeLevelException {
+	private byte[] translateFile(SakerFile file, ConverterContext cc, CatalogEntry catalogentry)
+			throws DontIncludeLevelException {
 		Set<String> demonames = new HashSet<>();
 		boolean leaderboard = false;
 		String cmd = null;
@@ -211,8 +241,9 @@ public class SapphireLevelConverterWorkerTaskFactory implements TaskFactory<Sapp
 							String content = line.substring(12);
 
 							leaderboard = true;
+							catalogentry.leaderboards = leaderboardTypesToFlags(content);
 							headeros.write(SAPPHIRE_CMD_LEADERBOARDS);
-							IntegerType.INSTANCE.serialize(leaderboardTypesToFlags(content), headeros);
+							IntegerType.INSTANCE.serialize(catalogentry.leaderboards, headeros);
 							break;
 						}
 						case "i": {
@@ -269,6 +300,7 @@ public class SapphireLevelConverterWorkerTaskFactory implements TaskFactory<Sapp
 						}
 						case "a": { // author
 							byte[] author = line.substring(2).getBytes();
+							catalogentry.author = author;
 
 							headeros.write(cmd.charAt(0));
 							IntegerType.INSTANCE.serialize(author.length, headeros);
@@ -501,6 +533,14 @@ public class SapphireLevelConverterWorkerTaskFactory implements TaskFactory<Sapp
 			//non-modifyable flag
 			headeros.write(SAPPHIRE_CMD_NON_MODIFYABLE_FLAG);
 
+			catalogentry.title = titlebytes;
+			catalogentry.difficulty = difficulty;
+			catalogentry.category = category;
+			catalogentry.democount = democount;
+			catalogentry.playercount = playercount;
+			catalogentry.uuid = Arrays.copyOfRange(uuidbytes, uuidbytes.length - 16, uuidbytes.length);
+			catalogentry.flags = CATALOG_FLAG_NON_MODIFYABLE;
+
 			byte[] osbytes = new byte[headeros.size() + os.size()];
 			System.arraycopy(headeros.toByteArray(), 0, osbytes, 0, headeros.size());
 			System.arraycopy(os.toByteArray(), 0, osbytes, headeros.size(), os.size());
@@ -516,6 +556,146 @@ public class SapphireLevelConverterWorkerTaskFactory implements TaskFactory<Sapp
 		}
 	}
 
+	/**
+	 * Writes the level catalog.
+	 * <p>
+	 * The levels are grouped by their asset directory, and ordered by asset name in a group. This is the same order
+	 * as the assets are enumerated in the generated assets header, so the client can associate the entries with the
+	 * asset identifiers without storing them in the catalog. The asset name of each entry is stored so the association
+	 * is verified during the build by {@link #verifyCatalog(byte[], NavigableMap)}.
+	 * <p>
+	 * Format (big endian):
+	 *
+	 * <pre>
+	 * "RHLC" uint32:version
+	 * uint32:stringtablelength byte[stringtablelength]
+	 * uint32:groupcount
+	 * groups: uint32:nameoffset uint32:namelength uint32:entrycount entries
+	 * entry: uint32:assetnameoffset uint32:assetnamelength
+	 *        uint32:levelversion uint32:titleoffset uint32:titlelength uint32:authoroffset uint32:authorlength
+	 *        uint32:difficulty uint32:category uint32:democount uint32:playercount uint32:leaderboards
+	 *        byte[16]:uuid uint8:flags
+	 * </pre>
+	 */
+	private static byte[] writeCatalog(NavigableMap<String, CatalogEntry> catalog) throws IOException {
+		Map<String, List<Entry<String, CatalogEntry>>> groups = new LinkedHashMap<>();
+		for (Entry<String, CatalogEntry> entry : catalog.entrySet()) {
+			groups.computeIfAbsent(getAssetDirectory(entry.getKey()), x -> new ArrayList<>()).add(entry);
+		}
+		try (UnsyncByteArrayOutputStream stringsos = new UnsyncByteArrayOutputStream();
+				UnsyncByteArrayOutputStream groupsos = new UnsyncByteArrayOutputStream();
+				UnsyncByteArrayOutputStream os = new UnsyncByteArrayOutputStream()) {
+			Map<String, Integer> stringoffsets = new HashMap<>();
+			IntegerType.INSTANCE.serialize(groups.size(), groupsos);
+			for (Entry<String, List<Entry<String, CatalogEntry>>> group : groups.entrySet()) {
+				writeCatalogString(group.getKey().getBytes(), stringsos, stringoffsets, groupsos);
+				IntegerType.INSTANCE.serialize(group.getValue().size(), groupsos);
+				for (Entry<String, CatalogEntry> groupentry : group.getValue()) {
+					CatalogEntry entry = groupentry.getValue();
+					writeCatalogString(groupentry.getKey().getBytes(), stringsos, stringoffsets, groupsos);
+					IntegerType.INSTANCE.serialize(SAPPHIRE_RELEASE_VERSION, groupsos);
+					writeCatalogString(entry.title, stringsos, stringoffsets, groupsos);
+					int flags = entry.flags;
+					if (entry.author != null) {
+						flags |= CATALOG_FLAG_HAS_AUTHOR;
+						writeCatalogString(entry.author, stringsos, stringoffsets, groupsos);
+					} else {
+						IntegerType.INSTANCE.serialize(0, groupsos);
+						IntegerType.INSTANCE.serialize(0, groupsos);
+					}
+					IntegerType.INSTANCE.serialize(entry.difficulty, groupsos);
+					IntegerType.INSTANCE.serialize(entry.category, groupsos);
+					IntegerType.INSTANCE.serialize(entry.democount, groupsos);
+					IntegerType.INSTANCE.serialize(entry.playercount, groupsos);
+					IntegerType.INSTANCE.serialize(entry.leaderboards, groupsos);
+					groupsos.write(entry.uuid);
+					groupsos.write(flags);
+				}
+			}
+			os.write(CATALOG_MAGIC);
+			IntegerType.INSTANCE.serialize(CATALOG_VERSION, os);
+			IntegerType.INSTANCE.serialize(stringsos.size(), os);
+			stringsos.writeTo((OutputStream) os);
+			groupsos.writeTo((OutputStream) os);
+			return os.toByteArray();
+		}
+	}
+
+	/**
+	 * Verifies that the written catalog pairs each entry with the asset that the client enumerates at its position.
+	 * <p>
+	 * The client doesn't read the level files if their entries are present in the catalog. The assets compiler assigns
+	 * the asset identifiers in asset name order, and the generated enumerator of a directory iterates over its direct
+	 * children in identifier order. The build fails if the catalog doesn't follow the same order.
+	 */
+	private static void verifyCatalog(byte[] catalogbytes, NavigableMap<String, SakerPath> assets) throws IOException {
+		Map<String, List<String>> enumerated = new HashMap<>();
+		for (String assetname : assets.keySet()) {
+			if (CATALOG_ASSET_NAME.equals(assetname)) {
+				continue;
+			}
+			enumerated.computeIfAbsent(getAssetDirectory(assetname), x -> new ArrayList<>()).add(assetname);
+		}
+		DataInputStream in = new DataInputStream(new UnsyncByteArrayInputStream(catalogbytes));
+		byte[] magic = new byte[CATALOG_MAGIC.length];
+		in.readFully(magic);
+		if (!Arrays.equals(magic, CATALOG_MAGIC) || in.readInt() != CATALOG_VERSION) {
+			throw new RuntimeException("Invalid level catalog header.");
+		}
+		byte[] strings = new byte[in.readInt()];
+		in.readFully(strings);
+		int groupcount = in.readInt();
+		if (groupcount != enumerated.size()) {
+			throw new RuntimeException(
+					"Level catalog group count mismatch: " + groupcount + " - " + enumerated.size());
+		}
+		for (int i = 0; i < groupcount; i++) {
+			String groupname = readCatalogString(in, strings);
+			List<String> groupassets = enumerated.get(groupname);
+			int count = in.readInt();
+			if (groupassets == null || groupassets.size() != count) {
+				throw new RuntimeException("Level catalog group mismatch: " + groupname);
+			}
+			for (int j = 0; j < count; j++) {
+				String assetname = readCatalogString(in, strings);
+				if (!assetname.equals(groupassets.get(j))) {
+					throw new RuntimeException("Level catalog entry mismatch in " + groupname + " at index " + j
+							+ ": " + assetname + " - " + groupassets.get(j));
+				}
+				//the rest of the entry: levelversion, title, author, difficulty, category, democount, playercount,
+				//leaderboards, uuid, flags
+				in.readFully(new byte[10 * 4 + 16 + 1]);
+			}
+		}
+		if (in.read() >= 0) {
+			throw new RuntimeException("Trailing data in level catalog.");
+		}
+	}
+
+	private static String readCatalogString(DataInputStream in, byte[] strings) throws IOException {
+		int offset = in.readInt();
+		int length = in.readInt();
+		return new String(strings, offset, length);
+	}
+
+	private static String getAssetDirectory(String assetname) {
+		return assetname.substring(0, Math.max(assetname.lastIndexOf('/'), 0));
+	}
+
+	private static void writeCatalogString(byte[] bytes, UnsyncByteArrayOutputStream stringsos,
+			Map<String, Integer> stringoffsets, OutputStream os) throws IOException {
+		//the bytes are only used as a key for deduplication
+		String key = new String(bytes, StandardCharsets.ISO_8859_1);
+		Integer offset = stringoffsets.get(key);
+		if (offset == null) {
+			offset = stringsos.size();
+			stringoffsets.put(key, offset);
+			stringsos.write(bytes);
+		}
+		IntegerType.INSTANCE.serialize(offset, os);
+		IntegerType.INSTANCE.serialize(bytes.length, os);
+	}
+
 	private static void writeDemo(OutputStream os, int randomseed, String title, byte[] data) throws IOException {
 		os.write('R');
 		IntegerType.INSTANCE.serialize(randomseed, os);
@@ -590,6 +770,18 @@ public class SapphireLevelConverterWorkerTaskFactory implements TaskFactory<Sapp
 		return new String(chars);
 	}
 
+	private static class CatalogEntry {
+		byte[] title;
+		byte[] author;
+		int difficulty;
+		int category;
+		int democount;
+		int playercount;
+		int leaderboards;
+		byte[] uuid;
+		int flags;
+	}
+
 	private static class ConverterContext {
 		Map<String, String> uuidMap = new TreeMap<>();
 		int warnedLeaderboards = 40;
@@ -10,7 +10,12 @@ import java.io.ObjectOutput;
 import java.io.OutputStream;
 import java.io.PrintStream;
 import java.util.ArrayList;
+import java.util.Arrays;
 import java.util.Collection;
+import java.util.HashMap;
+import java.util.HashSet;
+import java.util.List;
+import java.util.Map;
 import java.util.Map.Entry;
 import java.util.NavigableMap;
 import java.util.NavigableSet;
@@ -43,6 +48,11 @@ public class SapphireTextureConverterWorkerTaskFactory
 
 	public static final int TILE_DIMENSION = 60;
 	public static final int TILE_PADDING = 2;
+	/**
+	 * The maximum number of tiles in a row of an atlas page. 32 tiles result in 2048x2048 pages, which is supported
+	 * by all of our target devices and is enough to fit every level sprite on a single page.
+	 */
+	public static final int MAX_ATLAS_DIMENSION = 32;
 
 	private Set<FileCollectionStrategy> inputCollectionStrategies;
 
@@ -91,16 +101,47 @@ public class SapphireTextureConverterWorkerTaskFactory
 			parseTexturesFile(entry.getValue(), animations, elements);
 		}
 
+		//identical tiles (e.g. still frames of animations) are only placed once on an atlas page
+		//only the tiles of the current page are shared, so the frames of an animation stay on the same page
+		Map<TilePixels, Element> pagetiles = new HashMap<>();
 		TextureSakerFile tex = null;
 		for (Animation anim : animations) {
+			List<TilePixels> animpixels = new ArrayList<>(anim.elements.size());
 			for (Element elem : anim.elements) {
+				animpixels.add(new TilePixels(elem));
+			}
+			Set<TilePixels> distinctpixels = new HashSet<>(animpixels);
+			int newtiles = 0;
+			for (TilePixels pixels : distinctpixels) {
+				if (!pagetiles.containsKey(pixels)) {
+					++newtiles;
+				}
+			}
+			if (tex != null && tex.getRemainingCapacity() < newtiles
+					&& distinctpixels.size() <= MAX_ATLAS_DIMENSION * MAX_ATLAS_DIMENSION) {
+				//start a new page so the frames of an animation don't need different texture bindings
+				tex = null;
+				pagetiles.clear();
+			}
+			for (int i = 0; i < anim.elements.size(); i++) {
+				Element elem = anim.elements.get(i);
+				elements.remove(elem);
+				TilePixels pixels = animpixels.get(i);
+				Element packed = pagetiles.get(pixels);
+				if (packed != null) {
+					elem.resultTexture = packed.resultTexture;
+					elem.resultPos = packed.resultPos;
+					continue;
+				}
 				if (tex == null || !tex.canAdd()) {
-					tex = createNewTexture(elements, textures);
+					//only happens in the middle of an animation if it has more distinct tiles than a page can hold
+					tex = createNewTexture(elements.size() + 1, textures);
 					textures.add(tex);
+					pagetiles.clear();
 				}
 				elem.resultTexture = tex;
 				tex.add(elem);
-				elements.remove(elem);
+				pagetiles.put(pixels, elem);
 			}
 		}
 		SakerPath taskworkingdirpath = taskcontext.getTaskWorkingDirectoryPath();
@@ -126,8 +167,11 @@ public class SapphireTextureConverterWorkerTaskFactory
 					for (Element elem : anim.elements) {
 						ps.print("<FrameAnimation.FrameAnimationElement");
 
-						String pathtopng = taskworkingdirpath.relativize(elem.resultTexture.getSakerPath()).toString();
-						ps.print(" texture=\"@res/" + pathtopng.substring(0, pathtopng.length() - 4) + "\"");
+						String pathtotexture = taskworkingdirpath.relativize(elem.resultTexture.getSakerPath())
+								.toString();
+						ps.print(" texture=\"@res/"
+								+ pathtotexture.substring(0, pathtotexture.length() - TextureSakerFile.EXTENSION.length())
+								+ "\"");
 						ps.print(" x=\"" + elem.resultPos.x + "\"");
 						ps.print(" y=\"" + elem.resultPos.y + "\"");
 
@@ -155,11 +199,10 @@ public class SapphireTextureConverterWorkerTaskFactory
 		return result;
 	}
 
-	private static TextureSakerFile createNewTexture(Collection<Element> elements,
-			Collection<TextureSakerFile> textures) {
-		int rem = elements.size();
+	private static TextureSakerFile createNewTexture(int rem, Collection<TextureSakerFile> textures) {
 		int dim = calcDim(rem);
-		TextureSakerFile result = new TextureSakerFile("_sapphire_anim_texture_" + textures.size() + ".png", dim);
+		TextureSakerFile result = new TextureSakerFile(
+				"_sapphire_anim_texture_" + textures.size() + TextureSakerFile.EXTENSION, dim);
 		return result;
 	}
 
@@ -176,10 +219,10 @@ public class SapphireTextureConverterWorkerTaskFactory
 			int w = img.getWidth() / TILE_DIMENSION;
 			int h = img.getHeight() / TILE_DIMENSION;
 			// TODO paddingban 0 alpha de szin az megegyezik szelevel
-			for (int i = 0; i < w; i++) {
-				for (int j = 0; j < h; j++) {
+			for (int j = 0; j < h; j++) {
+				for (int i = 0; i < w; i++) {
 					Element elem = new Element(img,
-							new Rectangle(i * TILE_DIMENSION, 0, TILE_DIMENSION, TILE_DIMENSION), anim);
+							new Rectangle(i * TILE_DIMENSION, j * TILE_DIMENSION, TILE_DIMENSION, TILE_DIMENSION), anim);
 					elements.add(elem);
 				}
 			}
@@ -187,13 +230,39 @@ public class SapphireTextureConverterWorkerTaskFactory
 	}
 
 	private static int calcDim(int rem) {
-		int dim = 16;
+		int dim = MAX_ATLAS_DIMENSION;
 		while (rem < dim * dim / 4) {
 			dim /= 2;
 		}
 		return dim;
 	}
 
+	private static final class TilePixels {
+		private final int[] pixels;
+		private final int hash;
+
+		public TilePixels(Element elem) {
+			this.pixels = elem.image.getRGB(elem.imagePos.x, elem.imagePos.y, TILE_DIMENSION, TILE_DIMENSION, null, 0,
+					TILE_DIMENSION);
+			this.hash = Arrays.hashCode(pixels);
+		}
+
+		@Override
+		public int hashCode() {
+			return hash;
+		}
+
+		@Override
+		public boolean equals(Object obj) {
+			if (this == obj)
+				return true;
+			if (!(obj instanceof TilePixels))
+				return false;
+			TilePixels other = (TilePixels) obj;
+			return hash == other.hash && Arrays.equals(pixels, other.pixels);
+		}
+	}
+
 	@Override
 	public void writeExternal(ObjectOutput out) throws IOException {
 		SerialUtils.writeExternalCollection(out, inputCollectionStrategies);
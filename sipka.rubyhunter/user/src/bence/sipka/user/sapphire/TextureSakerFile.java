@@ -17,10 +17,32 @@ package bence.sipka.user.sapphire;
 
 import java.awt.geom.Rectangle2D;
 import java.awt.image.BufferedImage;
+import java.io.DataOutputStream;
+import java.io.IOException;
+import java.io.OutputStream;
+import java.nio.charset.StandardCharsets;
 import java.util.ArrayList;
 import java.util.Collection;
 
+/**
+ * An atlas page, written as a texture container instead of a PNG, so the runtime doesn't need to decode it.
+ * The pixels are stored uncompressed, loading a page is a single copy into the upload buffer.
+ * <p>
+ * Format (big endian):
+ * 
+ * <pre>
+ * "RHTX", uint32 version
+ * uint32 color format (0: RGBA_8888), uint32 width, uint32 height
+ * uint32 flags (0), uint32 data length, RGBA rows
+ * </pre>
+ */
 public class TextureSakerFile extends ImageSakerFile {
+	public static final String EXTENSION = ".rhtex";
+
+	private static final byte[] CONTAINER_MAGIC = "RHTX".getBytes(StandardCharsets.US_ASCII);
+	private static final int CONTAINER_VERSION = 2;
+	private static final int CONTAINER_FORMAT_RGBA_8888 = 0;
+
 	private Collection<Element> elements = new ArrayList<>();
 	private int dim;
 
@@ -34,10 +56,43 @@ public class TextureSakerFile extends ImageSakerFile {
 		this.dim = dim;
 	}
 
+	@Override
+	public void writeToStreamImpl(OutputStream os) throws IOException {
+		BufferedImage img = getImage();
+		int w = img.getWidth();
+		int h = img.getHeight();
+		int[] argb = img.getRGB(0, 0, w, h, null, 0, w);
+
+		DataOutputStream dos = new DataOutputStream(os);
+		dos.write(CONTAINER_MAGIC);
+		dos.writeInt(CONTAINER_VERSION);
+		dos.writeInt(CONTAINER_FORMAT_RGBA_8888);
+		dos.writeInt(w);
+		dos.writeInt(h);
+		dos.writeInt(0);
+		dos.writeInt(w * h * 4);
+		byte[] row = new byte[w * 4];
+		for (int y = 0; y < h; y++) {
+			for (int x = 0; x < w; x++) {
+				int c = argb[y * w + x];
+				row[x * 4 + 0] = (byte) (c >>> 16);
+				row[x * 4 + 1] = (byte) (c >>> 8);
+				row[x * 4 + 2] = (byte) c;
+				row[x * 4 + 3] = (byte) (c >>> 24);
+			}
+			dos.write(row);
+		}
+		dos.flush();
+	}
+
 	public boolean canAdd() {
 		return elements.size() < dim * dim;
 	}
 
+	public int getRemainingCapacity() {
+		return dim * dim - elements.size();
+	}
+
 	public void add(Element elem) {
 		BufferedImage img = getImage();
 		int idx = elements.size();
@@ -7,6 +7,7 @@ import java.io.ObjectInput;
 import java.io.ObjectOutput;
 import java.io.OutputStream;
 import java.io.UncheckedIOException;
+import java.nio.charset.StandardCharsets;
 import java.util.ArrayList;
 import java.util.Collections;
 import java.util.HashMap;
@@ -27,6 +28,7 @@ import bence.sipka.compiler.source.TemplatedSource;
 import bence.sipka.compiler.source.TemplatedSourceSakerFile;
 import bence.sipka.compiler.types.TypeDeclaration;
 import bence.sipka.compiler.types.TypesTaskFactory;
+import bence.sipka.compiler.types.builtin.FloatType;
 import bence.sipka.compiler.types.builtin.IntegerType;
 import bence.sipka.compiler.types.builtin.ShortType;
 import bence.sipka.compiler.xml.declarations.AttributeDeclaration;
@@ -65,6 +67,15 @@ public class XmlCompilerWorkerTaskFactory
 
 	public static final int FLAG_DYN_TYPE_EMBEDDED = 0x80000000;
 
+	/**
+	 * Frame animations are compiled to a flat table instead of the general xml format, so the runtime can read them
+	 * without inflating each element.
+	 */
+	public static final String FRAME_ANIMATION_ELEMENT_NAME = "FrameAnimation";
+	public static final String FRAME_ANIMATION_CHILD_NAME = "FrameAnimation.FrameAnimationElement";
+	public static final byte[] FRAME_ANIMATION_TABLE_MAGIC = "RHFA".getBytes(StandardCharsets.US_ASCII);
+	public static final int FRAME_ANIMATION_TABLE_VERSION = 1;
+
 	public static final BundleResourceSupplier descriptor = BundleContentAccess
 			.getBundleResourceSupplier("xml_compiler");
 
@@ -125,7 +136,12 @@ public class XmlCompilerWorkerTaskFactory
 
 		for (Entry<Document, SakerFile> docentry : xmldocuments) {
 			String filename = docentry.getValue().getName();
-			ByteArrayRegion compiledbytes = compile(docentry.getKey(), xmlCompileHeaderData, filename);
+			ByteArrayRegion compiledbytes;
+			if (isFrameAnimationTable(docentry.getKey())) {
+				compiledbytes = compileFrameAnimationTable(docentry.getKey(), filename);
+			} else {
+				compiledbytes = compile(docentry.getKey(), xmlCompileHeaderData, filename);
+			}
 			ByteArraySakerFile nfile = new ByteArraySakerFile(filename, compiledbytes);
 			SakerFile prev = buildDirectory.add(nfile);
 			if (prev != null) {
@@ -190,6 +206,110 @@ public class XmlCompilerWorkerTaskFactory
 		}
 	}
 
+	private static boolean isFrameAnimationTable(Document doc) {
+		Node root = doc.getFirstChild();
+		if (root == null || !FRAME_ANIMATION_ELEMENT_NAME.equals(root.getLocalName())
+				|| countValidAttributes(root.getAttributes()) != 0) {
+			return false;
+		}
+		NodeList children = root.getChildNodes();
+		for (int i = 0; i < children.getLength(); i++) {
+			Node child = children.item(i);
+			if (child.getNodeType() != Node.ELEMENT_NODE)
+				continue;
+			if (!FRAME_ANIMATION_CHILD_NAME.equals(child.getLocalName())
+					|| countValidChildren(child.getChildNodes()) != 0) {
+				return false;
+			}
+			NamedNodeMap attrs = child.getAttributes();
+			for (int j = 0; j < attrs.getLength(); j++) {
+				Node attr = attrs.item(j);
+				if (ATTRIBUTE_TESTER.test(attr)) {
+					continue;
+				}
+				if (CONFIG_NAMESPACE_URI.equals(attr.getNamespaceURI())) {
+					//user identifiers are not supported in the table format
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	private static String getRequiredAttribute(Node n, String name, String filename) {
+		Node attr = n.getAttributes().getNamedItem(name);
+		if (attr == null) {
+			throw new RuntimeException(filename + " : Missing attribute: " + name + " on " + n.getNodeName());
+		}
+		return attr.getNodeValue();
+	}
+
+	/**
+	 * Format:
+	 * 
+	 * <pre>
+	 * "RHFA", uint32 version
+	 * uint32 texture count, ResId textures[texture count]
+	 * uint32 frame count, { uint32 texture index, float left, top, right, bottom }[frame count]
+	 * </pre>
+	 */
+	private ByteArrayRegion compileFrameAnimationTable(Document doc, String filename) {
+		Node root = doc.getFirstChild();
+		ElementDeclaration elementdecl = output.xmlelements
+				.get(FRAME_ANIMATION_CHILD_NAME.substring(FRAME_ANIMATION_CHILD_NAME.indexOf('.') + 1));
+		if (elementdecl == null)
+			throw new RuntimeException(filename + " : Failed to find declared element with name: "
+					+ FRAME_ANIMATION_CHILD_NAME);
+		AttributeDeclaration texturedecl = elementdecl.findAttribute("texture", output.xmlelements);
+		TypeDeclaration texturetype = texturedecl == null ? null : parseType(texturedecl.getType());
+		if (texturetype == null)
+			throw new RuntimeException(filename + " : Type not found for texture attribute of: "
+					+ FRAME_ANIMATION_CHILD_NAME);
+
+		List<String> textures = new ArrayList<>();
+		try (UnsyncByteArrayOutputStream os = new UnsyncByteArrayOutputStream();
+				UnsyncByteArrayOutputStream framesos = new UnsyncByteArrayOutputStream()) {
+			NodeList children = root.getChildNodes();
+			int framecount = 0;
+			for (int i = 0; i < children.getLength(); i++) {
+				Node child = children.item(i);
+				if (child.getNodeType() != Node.ELEMENT_NODE)
+					continue;
+				String texture = getRequiredAttribute(child, "texture", filename);
+				int textureindex = textures.indexOf(texture);
+				if (textureindex < 0) {
+					textureindex = textures.size();
+					textures.add(texture);
+				}
+				float x = Float.parseFloat(getRequiredAttribute(child, "x", filename));
+				float y = Float.parseFloat(getRequiredAttribute(child, "y", filename));
+				float w = Float.parseFloat(getRequiredAttribute(child, "w", filename));
+				float h = Float.parseFloat(getRequiredAttribute(child, "h", filename));
+
+				IntegerType.INSTANCE.serialize(textureindex, framesos);
+				FloatType.INSTANCE.serialize(x, framesos);
+				FloatType.INSTANCE.serialize(y, framesos);
+				FloatType.INSTANCE.serialize(x + w, framesos);
+				FloatType.INSTANCE.serialize(y + h, framesos);
+				++framecount;
+			}
+
+			os.write(FRAME_ANIMATION_TABLE_MAGIC);
+			IntegerType.INSTANCE.serialize(FRAME_ANIMATION_TABLE_VERSION, os);
+			IntegerType.INSTANCE.serialize(textures.size(), os);
+			for (String texture : textures) {
+				texturetype.serialize(texture, os);
+			}
+			IntegerType.INSTANCE.serialize(framecount, os);
+			framesos.writeTo((OutputStream) os);
+			return os.toByteArrayRegion();
+		} catch (IOException e) {
+			throw new UncheckedIOException(e);
+		} catch (NumberFormatException e) {
+			throw new RuntimeException(filename + " : Invalid frame animation element dimension.", e);
+		}
+	}
+
 	private void compile(Node n, OutputStream os, TranslateMetaData meta, XmlCompileHeaderData xmlCompileHeaderData,
 			String filename) throws IOException {
 		if (n.getNodeType() != Element.ELEMENT_NODE)
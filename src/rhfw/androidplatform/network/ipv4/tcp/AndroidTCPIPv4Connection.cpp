@@ -95,6 +95,15 @@ bool AndroidTCPIPv4Connection::connectImpl(const NetworkAddress& netaddress) {
 	return false;
 }
 
+void AndroidTCPIPv4Connection::shutdown() {
+	WARN(fd < 0);
+	if (fd < 0) {
+		return;
+	}
+	int res = ::shutdown(fd, SHUT_RDWR);
+	ASSERT(res == 0 || errno == 107 || errno == 57) << "syscall failed " << strerror(errno);
+}
+
 void AndroidTCPIPv4Connection::disconnect() {
 	WARN(fd < 0);
 	if (fd < 0) {
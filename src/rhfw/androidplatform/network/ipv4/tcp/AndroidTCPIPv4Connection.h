@@ -43,6 +43,7 @@ public:
 	AndroidTCPIPv4Connection();
 	~AndroidTCPIPv4Connection();
 
+	virtual void shutdown() override;
 	virtual void disconnect() override;
 };
 
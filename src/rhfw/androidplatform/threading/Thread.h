@@ -68,6 +68,13 @@ public:
 	static Id getCurrentId() {
 		return gettid();
 	}
+	/**
+	 * Returns the number of processors available to the application, at least 1.
+	 */
+	static unsigned int getProcessorCount() {
+		long res = sysconf(_SC_NPROCESSORS_ONLN);
+		return res < 1 ? 1 : (unsigned int) res;
+	}
 
 private:
 	friend class platform_bridge;
@@ -100,6 +100,15 @@ int AppleTCPIPv4Connection::writeImpl(const void* data, unsigned int count) {
 	return res;
 }
 
+void AppleTCPIPv4Connection::shutdown() {
+	WARN(fd < 0);
+	if (fd < 0) {
+		return;
+	}
+	int res = ::shutdown(fd, SHUT_RDWR);
+	ASSERT(res == 0 || errno == 107 || errno == 57) << "syscall failed " << strerror(errno);
+}
+
 void AppleTCPIPv4Connection::disconnect() {
 	WARN(fd < 0);
 	if (fd < 0) {
@@ -43,6 +43,7 @@ public:
 	AppleTCPIPv4Connection();
 	~AppleTCPIPv4Connection();
 
+	virtual void shutdown() override;
 	virtual void disconnect() override;
 };
 
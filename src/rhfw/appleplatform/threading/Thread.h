@@ -25,6 +25,7 @@
 
 #include <framework/threading/Thread.h>
 #include <pthread.h>
+#include <unistd.h>
 #include <gen/configuration.h>
 #include <gen/log.h>
 
@@ -44,6 +45,13 @@ public:
 	static Id getCurrentId() {
 		return pthread_self();
 	}
+	/**
+	 * Returns the number of processors available to the application, at least 1.
+	 */
+	static unsigned int getProcessorCount() {
+		long res = sysconf(_SC_NPROCESSORS_ONLN);
+		return res < 1 ? 1 : (unsigned int) res;
+	}
 private:
 
 	template<typename T>
@@ -77,6 +77,8 @@ bool DirectX11Renderer::load() {
 	blendDesc.AlphaToCoverageEnable = false;
 
 	ThrowIfFailed(dev->CreateBlendState(&blendDesc, &blendState));
+	rtbd.SrcBlend = D3D11_BLEND_ONE;
+	ThrowIfFailed(dev->CreateBlendState(&blendDesc, &premultipliedBlendState));
 	devcon->OMSetBlendState(blendState, nullptr, 0xffffffff);
 	D3D11_DEPTH_STENCIL_DESC dsDesc;
 	// Depth test parameters
@@ -122,6 +124,8 @@ void DirectX11Renderer::free() {
 	ASSERT(res == 0);
 	res = blendState->Release();
 	ASSERT(res == 0);
+	res = premultipliedBlendState->Release();
+	ASSERT(res == 0);
 	res = depthStencilStateWithDepthtest->Release();
 	ASSERT(res == 0);
 	res = depthStencilStateWithoutDepthtest->Release();
@@ -201,6 +205,9 @@ void DirectX11Renderer::setCullToFrontFaceImpl(bool isFront) {
 	} else {
 	}
 }
+void DirectX11Renderer::setPremultipliedAlphaBlendImpl(bool enabled) {
+	devcon->OMSetBlendState(enabled ? premultipliedBlendState : blendState, nullptr, 0xffffffff);
+}
 void DirectX11Renderer::setViewPortImpl(const render::ViewPort& vp) {
 	D3D11_VIEWPORT viewport = { 0 };
 
@@ -44,6 +44,7 @@ public:
 
 	ID3D11RasterizerState* rasterizerState = nullptr;
 	ID3D11BlendState* blendState = nullptr;
+	ID3D11BlendState* premultipliedBlendState = nullptr;
 	ID3D11DepthStencilState* depthStencilStateWithDepthtest = nullptr;
 	ID3D11DepthStencilState* depthStencilStateWithoutDepthtest = nullptr;
 
@@ -61,6 +62,7 @@ private:
 	virtual void setDepthTestImpl(bool enabled) override;
 	virtual void setFaceCullingImpl(bool enabled) override;
 	virtual void setCullToFrontFaceImpl(bool isFront) override;
+	virtual void setPremultipliedAlphaBlendImpl(bool enabled) override;
 	virtual void setViewPortImpl(const render::ViewPort& vp) override;
 
 	virtual render::Texture* createTextureImpl() override;
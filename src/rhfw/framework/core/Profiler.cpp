@@ -0,0 +1,175 @@
+/*
+ * Copyright (C) 2020 Bence Sipka
+ *
+ * This program is free software: you can redistribute it and/or modify 
+ * it under the terms of the GNU General Public License as published by 
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/*
+ * Profiler.cpp
+ *
+ *  Created on: 2026. okt. 19.
+ *      Author: sipka
+ */
+
+#include <framework/core/Profiler.h>
+#include <framework/io/stream/OutputStream.h>
+#include <framework/threading/Thread.h>
+
+#include <gen/log.h>
+
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+
+namespace rhfw {
+namespace core {
+
+std::atomic<bool> Profiler::enabled { false };
+std::atomic<Profiler::ThreadBuffer*> Profiler::threadBuffers[MAX_THREAD_COUNT] { };
+std::atomic<unsigned int> Profiler::threadBufferCount { 0 };
+
+Profiler::Frame Profiler::frames[FRAME_HISTORY_COUNT] { };
+unsigned int Profiler::frameCount = 0;
+long long Profiler::frameBegin = -1;
+
+Profiler::ThreadBuffer* Profiler::getThreadBuffer() {
+	//the buffers are never freed, as other threads may still read them
+	static thread_local ThreadBuffer* buffer = nullptr;
+	static thread_local bool registered = false;
+	if (!registered) {
+		registered = true;
+		unsigned int index = threadBufferCount.fetch_add(1, std::memory_order_relaxed);
+		if (index < MAX_THREAD_COUNT) {
+			buffer = new ThreadBuffer();
+			threadBuffers[index].store(buffer, std::memory_order_release);
+		} else {
+			LOGW()<< "Too many threads for profiling, events of this thread are not recorded";
+		}
+	}
+	return buffer;
+}
+
+void Profiler::setEnabled(bool enabled) {
+	if (!enabled) {
+		frameBegin = -1;
+	}
+	Profiler::enabled.store(enabled, std::memory_order_relaxed);
+}
+
+long long Profiler::getTimeMicros() {
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Profiler::record(const char* name, long long begin, long long end) {
+	ThreadBuffer* buf = getThreadBuffer();
+	if (buf == nullptr) {
+		return;
+	}
+	unsigned int head = buf->head.load(std::memory_order_relaxed);
+	Event& e = buf->events[head & (THREAD_EVENT_COUNT - 1)];
+	e.name = name;
+	e.begin = begin;
+	e.end = end;
+	buf->head.store(head + 1, std::memory_order_release);
+}
+
+void Profiler::beginFrame() {
+	ASSERT(Thread::isApplicationMainThread());
+	if (!isEnabled()) {
+		return;
+	}
+	frameBegin = getTimeMicros();
+}
+
+void Profiler::endFrame() {
+	ASSERT(Thread::isApplicationMainThread());
+	if (frameBegin < 0) {
+		return;
+	}
+	long long end = getTimeMicros();
+	Frame& f = frames[frameCount % FRAME_HISTORY_COUNT];
+	f.begin = frameBegin;
+	f.end = end;
+	++frameCount;
+	record("Frame", frameBegin, end);
+	frameBegin = -1;
+}
+
+static unsigned int writeJsonEscaped(char* buffer, unsigned int capacity, const char* str) {
+	unsigned int len = 0;
+	for (; *str != 0 && len + 2 < capacity; ++str) {
+		char c = *str;
+		if (c == '"' || c == '\\') {
+			buffer[len++] = '\\';
+		} else if ((unsigned char) c < 0x20) {
+			c = ' ';
+		}
+		buffer[len++] = c;
+	}
+	buffer[len] = 0;
+	return len;
+}
+
+bool Profiler::exportChromeTrace(OutputStream& out) {
+	static const char HEADER[] = "{\"traceEvents\":[";
+	static const char FOOTER[] = "\n]}\n";
+	//collect the events into larger chunks, to avoid a write call for each of them
+	char chunk[8 * 1024];
+	unsigned int chunklen = 0;
+	memcpy(chunk, HEADER, sizeof(HEADER) - 1);
+	chunklen += sizeof(HEADER) - 1;
+
+	char name[128];
+	bool first = true;
+	unsigned int count = threadBufferCount.load(std::memory_order_relaxed);
+	if (count > MAX_THREAD_COUNT) {
+		count = MAX_THREAD_COUNT;
+	}
+	for (unsigned int tid = 0; tid < count; ++tid) {
+		ThreadBuffer* buf = threadBuffers[tid].load(std::memory_order_acquire);
+		if (buf == nullptr) {
+			continue;
+		}
+		unsigned int head = buf->head.load(std::memory_order_acquire);
+		unsigned int i = head > THREAD_EVENT_COUNT ? head - THREAD_EVENT_COUNT : 0;
+		for (; i < head; ++i) {
+			const Event& e = buf->events[i & (THREAD_EVENT_COUNT - 1)];
+			writeJsonEscaped(name, sizeof(name), e.name);
+			if (sizeof(chunk) - chunklen < 256) {
+				if (!out.write(chunk, chunklen)) {
+					return false;
+				}
+				chunklen = 0;
+			}
+			int len = snprintf(chunk + chunklen, sizeof(chunk) - chunklen,
+					"%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%lld,\"dur\":%lld}", first ? "" : ",", name, tid,
+					e.begin, e.end - e.begin);
+			if (len <= 0 || (unsigned int) len >= sizeof(chunk) - chunklen) {
+				continue;
+			}
+			chunklen += len;
+			first = false;
+		}
+	}
+	if (sizeof(chunk) - chunklen < sizeof(FOOTER)) {
+		if (!out.write(chunk, chunklen)) {
+			return false;
+		}
+		chunklen = 0;
+	}
+	memcpy(chunk + chunklen, FOOTER, sizeof(FOOTER) - 1);
+	chunklen += sizeof(FOOTER) - 1;
+	return out.write(chunk, chunklen);
+}
+
+} // namespace core
+} // namespace rhfw
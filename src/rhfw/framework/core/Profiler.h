@@ -0,0 +1,158 @@
+/*
+ * Copyright (C) 2020 Bence Sipka
+ *
+ * This program is free software: you can redistribute it and/or modify 
+ * it under the terms of the GNU General Public License as published by 
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/*
+ * Profiler.h
+ *
+ *  Created on: 2026. okt. 19.
+ *      Author: sipka
+ */
+
+#ifndef FRAMEWORK_CORE_PROFILER_H_
+#define FRAMEWORK_CORE_PROFILER_H_
+
+#include <gen/configuration.h>
+
+#include <atomic>
+
+namespace rhfw {
+class OutputStream;
+namespace core {
+
+/**
+ * Records named time zones into per-thread ring buffers.
+ * Every thread only writes its own buffer, so recording takes no locks. Readers of other threads
+ * may see an event that is being overwritten, which is acceptable for profiling purposes.
+ * Zone names must be string literals (or otherwise outlive the profiler data).
+ */
+class Profiler {
+public:
+	static const unsigned int MAX_THREAD_COUNT = 16;
+	/**
+	 * Must be a power of two.
+	 */
+	static const unsigned int THREAD_EVENT_COUNT = 8192;
+	static const unsigned int FRAME_HISTORY_COUNT = 128;
+
+	class Event {
+	public:
+		const char* name;
+		long long begin;
+		long long end;
+	};
+	class Frame {
+	public:
+		long long begin;
+		long long end;
+
+		long long getDuration() const {
+			return end - begin;
+		}
+	};
+private:
+	static_assert((THREAD_EVENT_COUNT & (THREAD_EVENT_COUNT - 1)) == 0, "event count is not power of two");
+
+	class ThreadBuffer {
+	public:
+		Event events[THREAD_EVENT_COUNT];
+		std::atomic<unsigned int> head { 0 };
+	};
+
+	static std::atomic<bool> enabled;
+	static std::atomic<ThreadBuffer*> threadBuffers[MAX_THREAD_COUNT];
+	static std::atomic<unsigned int> threadBufferCount;
+
+	static Frame frames[FRAME_HISTORY_COUNT];
+	static unsigned int frameCount;
+	static long long frameBegin;
+
+	static ThreadBuffer* getThreadBuffer();
+public:
+	static bool isEnabled() {
+		return enabled.load(std::memory_order_relaxed);
+	}
+	static void setEnabled(bool enabled);
+
+	/**
+	 * Monotonic time in microseconds.
+	 */
+	static long long getTimeMicros();
+
+	static void record(const char* name, long long begin, long long end);
+
+	/**
+	 * Frame boundaries, called by the main thread.
+	 */
+	static void beginFrame();
+	static void endFrame();
+
+	static unsigned int getFrameCount() {
+		return frameCount < FRAME_HISTORY_COUNT ? frameCount : FRAME_HISTORY_COUNT;
+	}
+	/**
+	 * Index 0 is the latest completed frame.
+	 */
+	static const Frame& getFrame(unsigned int index) {
+		return frames[(frameCount - 1 - index) % FRAME_HISTORY_COUNT];
+	}
+
+	/**
+	 * Calls the handler with the events recorded by the calling thread, oldest first.
+	 */
+	template<typename Handler>
+	static void forEachThreadEvent(Handler&& handler) {
+		ThreadBuffer* buf = getThreadBuffer();
+		if (buf == nullptr) {
+			return;
+		}
+		unsigned int head = buf->head.load(std::memory_order_relaxed);
+		unsigned int i = head > THREAD_EVENT_COUNT ? head - THREAD_EVENT_COUNT : 0;
+		for (; i < head; ++i) {
+			handler(buf->events[i & (THREAD_EVENT_COUNT - 1)]);
+		}
+	}
+
+	/**
+	 * Writes the recorded events of all threads in Chrome trace event JSON format.
+	 * The output can be opened in chrome://tracing or any compatible viewer.
+	 */
+	static bool exportChromeTrace(OutputStream& out);
+};
+
+class ProfileZone {
+private:
+	const char* name;
+	long long begin;
+public:
+	explicit ProfileZone(const char* name)
+			: name(name), begin(Profiler::isEnabled() ? Profiler::getTimeMicros() : -1) {
+	}
+	ProfileZone(const ProfileZone&) = delete;
+	ProfileZone& operator=(const ProfileZone&) = delete;
+	~ProfileZone() {
+		if (begin >= 0) {
+			Profiler::record(name, begin, Profiler::getTimeMicros());
+		}
+	}
+};
+
+} // namespace core
+} // namespace rhfw
+
+#define PROFILE_ZONE_CONCAT_IMPL(a, b) a##b
+#define PROFILE_ZONE_CONCAT(a, b) PROFILE_ZONE_CONCAT_IMPL(a, b)
+#define PROFILE_ZONE(name) ::rhfw::core::ProfileZone PROFILE_ZONE_CONCAT(profile_zone_, __LINE__) { name }
+
+#endif /* FRAMEWORK_CORE_PROFILER_H_ */
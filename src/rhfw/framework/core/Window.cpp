@@ -21,6 +21,7 @@
  */
 
 #include <framework/core/Window.h>
+#include <framework/core/Profiler.h>
 #include <framework/io/touch/TouchEvent.h>
 #include <framework/render/Renderer.h>
 
@@ -181,6 +182,7 @@ void WindowBase::onTimeChanged(const time_millis& time, const time_millis& previ
 
 		lastForegroundUpdate = time;
 
+		PROFILE_ZONE("Window::foregroundTimeListeners");
 		for (auto&& listener : foregroundTimeListeners.foreach()) {
 			listener.onTimeChanged(currentForegroundTime, prevtime);
 		}
@@ -192,6 +194,7 @@ void WindowBase::draw() {
 		return;
 	}
 	//ASSERT(isReadyToDraw(), "Window is not ready to draw");
+	Profiler::beginFrame();
 	auto* renderer = surface.getRenderer();
 	renderer->pushRenderTarget(static_cast<Window*>(this));
 	renderer->setViewPort(render::ViewPort { size.pixelSize });
@@ -199,6 +202,7 @@ void WindowBase::draw() {
 		listener.onDraw();
 	}
 	renderer->popRenderTarget();
+	Profiler::endFrame();
 }
 
 void WindowBase::attachToRenderer(const Resource<render::Renderer>& renderer) {
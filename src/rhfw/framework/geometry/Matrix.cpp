@@ -27,6 +27,18 @@
 
 #include <gen/log.h>
 
+/**
+ * The hot matrix operations have SIMD implementations, selected at compile time by the target instruction set.
+ * The SIMD implementations perform the same operations in the same order as the scalar ones.
+ */
+#if defined(__SSE__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define MATRIX_SIMD_SSE 1
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define MATRIX_SIMD_NEON 1
+#include <arm_neon.h>
+#endif
+
 namespace rhfw {
 
 enum MatrixOrder {
@@ -320,6 +332,27 @@ template<> Matrix2D& Matrix2D::multScale(float x, float y) {
 		data[M_INDEX(r, 1)] * array[M_INDEX(1, c)] +\
 		data[M_INDEX(r, 2)] * array[M_INDEX(2, c)])
 template<> Matrix2D& Matrix2D::operator *=(const Matrix2D& m) {
+#if defined(MATRIX_SIMD_SSE)
+	//the columns are loaded with unaligned loads, the last one is shifted to avoid reading past the data
+	const __m128 a0 = _mm_loadu_ps(data + 0);
+	const __m128 a1 = _mm_loadu_ps(data + 3);
+	const __m128 l2 = _mm_loadu_ps(data + 5);
+	const __m128 a2 = _mm_shuffle_ps(l2, l2, _MM_SHUFFLE(0, 3, 2, 1));
+
+	__m128 r[3];
+	for (unsigned int c = 0; c < 3; ++c) {
+		const float* mc = m.data + c * 3;
+		r[c] = _mm_mul_ps(a0, _mm_set1_ps(mc[0]));
+		r[c] = _mm_add_ps(r[c], _mm_mul_ps(a1, _mm_set1_ps(mc[1])));
+		r[c] = _mm_add_ps(r[c], _mm_mul_ps(a2, _mm_set1_ps(mc[2])));
+	}
+	//the 4th lane of the first two stores is overwritten by the next store
+	_mm_storeu_ps(data + 0, r[0]);
+	_mm_storeu_ps(data + 3, r[1]);
+	const __m128 last = _mm_shuffle_ps(r[2], r[2], _MM_SHUFFLE(2, 1, 0, 0));
+	_mm_storeu_ps(data + 5, _mm_move_ss(last, _mm_shuffle_ps(r[1], r[1], _MM_SHUFFLE(2, 2, 2, 2))));
+	return *this;
+#else
 	//TODO eleg lenne csak 3 float-nyi buffer?
 	float buf[DIMENSION_VAL * DIMENSION_VAL];
 	buf[M_INDEX(0, 0)] = M_3D_MULT(0, 0, m.data);
@@ -347,12 +380,52 @@ template<> Matrix2D& Matrix2D::operator *=(const Matrix2D& m) {
 	data[M_INDEX(2, 2)] = buf[M_INDEX(2, 2)];
 
 	return *this;
+#endif /* defined(MATRIX_SIMD_SSE) */
 }
 #define M_4D_MULT(r, c, array) (data[M_INDEX(r, 0)] * array[M_INDEX(0, c)] +\
 		data[M_INDEX(r, 1)] * array[M_INDEX(1, c)] +\
 		data[M_INDEX(r, 2)] * array[M_INDEX(2, c)] +\
 		data[M_INDEX(r, 3)] * array[M_INDEX(3, c)])
 template<> Matrix3D& Matrix3D::operator *=(const Matrix3D& m) {
+#if defined(MATRIX_SIMD_SSE)
+	const __m128 a0 = _mm_loadu_ps(data + 0);
+	const __m128 a1 = _mm_loadu_ps(data + 4);
+	const __m128 a2 = _mm_loadu_ps(data + 8);
+	const __m128 a3 = _mm_loadu_ps(data + 12);
+
+	__m128 r[4];
+	for (unsigned int c = 0; c < 4; ++c) {
+		const float* mc = m.data + c * 4;
+		r[c] = _mm_mul_ps(a0, _mm_set1_ps(mc[0]));
+		r[c] = _mm_add_ps(r[c], _mm_mul_ps(a1, _mm_set1_ps(mc[1])));
+		r[c] = _mm_add_ps(r[c], _mm_mul_ps(a2, _mm_set1_ps(mc[2])));
+		r[c] = _mm_add_ps(r[c], _mm_mul_ps(a3, _mm_set1_ps(mc[3])));
+	}
+	_mm_storeu_ps(data + 0, r[0]);
+	_mm_storeu_ps(data + 4, r[1]);
+	_mm_storeu_ps(data + 8, r[2]);
+	_mm_storeu_ps(data + 12, r[3]);
+	return *this;
+#elif defined(MATRIX_SIMD_NEON)
+	const float32x4_t a0 = vld1q_f32(data + 0);
+	const float32x4_t a1 = vld1q_f32(data + 4);
+	const float32x4_t a2 = vld1q_f32(data + 8);
+	const float32x4_t a3 = vld1q_f32(data + 12);
+
+	float32x4_t r[4];
+	for (unsigned int c = 0; c < 4; ++c) {
+		const float* mc = m.data + c * 4;
+		r[c] = vmulq_n_f32(a0, mc[0]);
+		r[c] = vaddq_f32(r[c], vmulq_n_f32(a1, mc[1]));
+		r[c] = vaddq_f32(r[c], vmulq_n_f32(a2, mc[2]));
+		r[c] = vaddq_f32(r[c], vmulq_n_f32(a3, mc[3]));
+	}
+	vst1q_f32(data + 0, r[0]);
+	vst1q_f32(data + 4, r[1]);
+	vst1q_f32(data + 8, r[2]);
+	vst1q_f32(data + 12, r[3]);
+	return *this;
+#else
 	//TODO eleg lenne csak 4 float-nyi buffer?
 	float buf[DIMENSION_VAL * DIMENSION_VAL];
 	buf[M_INDEX(0, 0)] = M_4D_MULT(0, 0, m.data);
@@ -396,6 +469,7 @@ template<> Matrix3D& Matrix3D::operator *=(const Matrix3D& m) {
 	data[M_INDEX(3, 3)] = buf[M_INDEX(3, 3)];
 
 	return *this;
+#endif /* defined(MATRIX_SIMD_SSE) */
 }
 
 #define M_R_INDEX(row, column) (Indexer<(row), (column), MatIndexerType::DIMENSION_VAL, COLUMN_MAJOR>::index)
@@ -732,6 +806,19 @@ template<> Matrix3D& Matrix3D::multRotate(float rad, float x, float y, float z)
 	return *this *= Matrix3D().setRotate(rad, x, y, z);
 }
 template<> Matrix3D& Matrix3D::multTranslate(float x, float y, float z) {
+#if defined(MATRIX_SIMD_SSE)
+	const __m128 w = _mm_loadu_ps(data + 12);
+	_mm_storeu_ps(data + 0, _mm_add_ps(_mm_loadu_ps(data + 0), _mm_mul_ps(w, _mm_set1_ps(x))));
+	_mm_storeu_ps(data + 4, _mm_add_ps(_mm_loadu_ps(data + 4), _mm_mul_ps(w, _mm_set1_ps(y))));
+	_mm_storeu_ps(data + 8, _mm_add_ps(_mm_loadu_ps(data + 8), _mm_mul_ps(w, _mm_set1_ps(z))));
+	return *this;
+#elif defined(MATRIX_SIMD_NEON)
+	const float32x4_t w = vld1q_f32(data + 12);
+	vst1q_f32(data + 0, vaddq_f32(vld1q_f32(data + 0), vmulq_n_f32(w, x)));
+	vst1q_f32(data + 4, vaddq_f32(vld1q_f32(data + 4), vmulq_n_f32(w, y)));
+	vst1q_f32(data + 8, vaddq_f32(vld1q_f32(data + 8), vmulq_n_f32(w, z)));
+	return *this;
+#else
 	data[M_INDEX(0, 0)] += data[M_INDEX(0, 3)] * x;
 	data[M_INDEX(1, 0)] += data[M_INDEX(1, 3)] * x;
 	data[M_INDEX(2, 0)] += data[M_INDEX(2, 3)] * x;
@@ -747,8 +834,20 @@ template<> Matrix3D& Matrix3D::multTranslate(float x, float y, float z) {
 	data[M_INDEX(2, 2)] += data[M_INDEX(2, 3)] * z;
 	data[M_INDEX(3, 2)] += data[M_INDEX(3, 3)] * z;
 	return *this;
+#endif /* defined(MATRIX_SIMD_SSE) */
 }
 template<> Matrix3D& Matrix3D::multScale(float x, float y, float z) {
+#if defined(MATRIX_SIMD_SSE)
+	_mm_storeu_ps(data + 0, _mm_mul_ps(_mm_loadu_ps(data + 0), _mm_set1_ps(x)));
+	_mm_storeu_ps(data + 4, _mm_mul_ps(_mm_loadu_ps(data + 4), _mm_set1_ps(y)));
+	_mm_storeu_ps(data + 8, _mm_mul_ps(_mm_loadu_ps(data + 8), _mm_set1_ps(z)));
+	return *this;
+#elif defined(MATRIX_SIMD_NEON)
+	vst1q_f32(data + 0, vmulq_n_f32(vld1q_f32(data + 0), x));
+	vst1q_f32(data + 4, vmulq_n_f32(vld1q_f32(data + 4), y));
+	vst1q_f32(data + 8, vmulq_n_f32(vld1q_f32(data + 8), z));
+	return *this;
+#else
 	data[M_INDEX(0, 0)] *= x;
 	data[M_INDEX(1, 0)] *= x;
 	data[M_INDEX(2, 0)] *= x;
@@ -764,6 +863,7 @@ template<> Matrix3D& Matrix3D::multScale(float x, float y, float z) {
 	data[M_INDEX(2, 2)] *= z;
 	data[M_INDEX(3, 2)] *= z;
 	return *this;
+#endif /* defined(MATRIX_SIMD_SSE) */
 }
 template<> Matrix3D& Matrix3D::multProjection(const render::Renderer& renderer, float fovy, float aspect, float znear, float zfar) {
 	//TODO
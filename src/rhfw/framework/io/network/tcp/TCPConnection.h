@@ -47,6 +47,11 @@ public:
 
 	bool connect(const NetworkAddress& address);
 
+	/**
+	 * Shuts down both directions of the connection, so blocked reads and writes return.
+	 * The connection is not released, disconnect() still needs to be called.
+	 */
+	virtual void shutdown() = 0;
 	virtual void disconnect() = 0;
 };
 
@@ -21,6 +21,7 @@
  */
 
 #include <framework/render/Renderer.h>
+#include <framework/core/Profiler.h>
 #include <framework/render/RenderingContext.h>
 #include <framework/render/RenderTarget.h>
 #include <framework/render/ShaderPipelineStage.h>
@@ -67,6 +68,7 @@ Renderer& Renderer::operator=(Renderer&& o) {
 	depthTestEnabledState.setTargetValue(o.depthTestEnabledState.getTargetValue());
 	faceCullingEnabledState.setTargetValue(o.faceCullingEnabledState.getTargetValue());
 	cullFrontFaceState.setTargetValue(o.cullFrontFaceState.getTargetValue());
+	premultipliedAlphaBlendState.setTargetValue(o.premultipliedAlphaBlendState.getTargetValue());
 
 	viewPortState.setTargetValue(o.viewPortState.getTargetValue());
 
@@ -261,6 +263,7 @@ bool Renderer::load() {
 	depthTestEnabledState.postCommand();
 	faceCullingEnabledState.postCommand();
 	cullFrontFaceState.postCommand();
+	premultipliedAlphaBlendState.postCommand();
 
 	return true;
 }
@@ -292,6 +295,7 @@ bool Renderer::reload() {
 	depthTestEnabledState.postCommand();
 	faceCullingEnabledState.postCommand();
 	cullFrontFaceState.postCommand();
+	premultipliedAlphaBlendState.postCommand();
 
 	viewPortState.postCommand();
 
@@ -453,7 +457,10 @@ void Renderer::popRenderTarget() {
 	ASSERT(renderTargetStackCount > 0) << "No rendertargets to pop";
 	--renderTargetStackCount;
 	Resource<RenderTarget>& top = renderTargetStack[renderTargetStackCount].target;
-	top->finishDrawing();
+	{
+		PROFILE_ZONE("RenderTarget::finishDrawing");
+		top->finishDrawing();
+	}
 	top = nullptr;
 	renderTargetState.setValues(nullptr);
 	if (renderTargetStackCount != 0) {
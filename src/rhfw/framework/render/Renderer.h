@@ -199,6 +199,7 @@ private:
 	virtual void setDepthTestImpl(bool enabled) = 0;
 	virtual void setFaceCullingImpl(bool enabled) = 0;
 	virtual void setCullToFrontFaceImpl(bool isFront) = 0;
+	virtual void setPremultipliedAlphaBlendImpl(bool enabled) = 0;
 	virtual void setViewPortImpl(const ViewPort& vp) = 0;
 
 	void addStateChangeCommand(DrawStateCommand& command) {
@@ -222,6 +223,7 @@ protected:
 	DrawState<bool, &Renderer::setDepthTestImpl> depthTestEnabledState { this, false, false };
 	DrawState<bool, &Renderer::setFaceCullingImpl> faceCullingEnabledState { this, false, false };
 	DrawState<bool, &Renderer::setCullToFrontFaceImpl> cullFrontFaceState { this, false, false };
+	DrawState<bool, &Renderer::setPremultipliedAlphaBlendImpl> premultipliedAlphaBlendState { this, false, false };
 
 	DrawState<RenderTargetStackEntry*, &Renderer::activateRenderTarget> renderTargetState { this, nullptr, nullptr };
 
@@ -287,6 +289,17 @@ public:
 		return cullFrontFaceState.getTargetValue();
 	}
 
+	/**
+	 * Blends the drawn colors as premultiplied by their alpha, instead of multiplying them with the alpha when blending.
+	 * Used when drawing render targets, as the colors drawn into them are already multiplied.
+	 */
+	void setPremultipliedAlphaBlend(bool enabled) {
+		premultipliedAlphaBlendState.setTargetValue(enabled);
+	}
+	bool isPremultipliedAlphaBlend() const {
+		return premultipliedAlphaBlendState.getTargetValue();
+	}
+
 	virtual void setTopology(Topology topology) {
 		this->topology = topology;
 	}
@@ -60,6 +60,17 @@ public:
 	virtual ~TextureInputSource() = default;
 	virtual void apply(Texture* texture) = 0;
 
+	/**
+	 * Prepares the data for the next apply() call, may be called on a background thread.
+	 *
+	 * @return the size of the prepared data in bytes.
+	 */
+	virtual unsigned int prepare() {
+		return 0;
+	}
+	virtual void discardPrepared() {
+	}
+
 #if RENDERAPI_opengl30_AVAILABLE
 	virtual void apply(OpenGl30Texture* texture);
 #endif /* RENDERAPI_opengl30_AVAILABLE */
@@ -111,6 +122,15 @@ private:
 
 protected:
 	Size2UI size { 0, 0 };
+
+	virtual unsigned int prepare() override {
+		return input == nullptr ? 0 : input->prepare();
+	}
+	virtual void discardPrepared() override {
+		if (input != nullptr) {
+			input->discardPrepared();
+		}
+	}
 public:
 	Texture() = default;
 	Texture(Texture&& o)
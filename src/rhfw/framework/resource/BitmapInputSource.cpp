@@ -21,10 +21,21 @@
  */
 
 #include <framework/resource/BitmapInputSource.h>
+#include <framework/io/stream/InputStream.h>
+#include <framework/utils/MemoryInput.h>
 #include <framework/utils/utility.h>
 
 #include <libpng/png.h>
 #include <gen/log.h>
+#include <gen/serialize.h>
+
+#include <string.h>
+
+#define TEXTURE_CONTAINER_VERSION 2
+#define TEXTURE_CONTAINER_FORMAT_RGBA_8888 0
+#define TEXTURE_CONTAINER_FORMAT_A_8 1
+//larger than any texture size supported by the renderers
+#define TEXTURE_CONTAINER_MAX_DIMENSION 16384
 
 namespace rhfw {
 
@@ -33,6 +44,7 @@ BitmapInputSource::BitmapInputSource(InputSource* input)
 }
 
 BitmapInputSource::~BitmapInputSource() {
+	delete[] preparedData;
 	delete input;
 }
 
@@ -49,16 +61,75 @@ static png_uint_32 convertFormat(ColorFormat format) {
 	}
 }
 
-void BitmapInputSource::apply(render::Texture* texture) {
+unsigned char* BitmapInputSource::decode(unsigned int* width, unsigned int* height) {
 	auto read = input->getData();
+	const char* data = read;
+	if (read.getLength() >= 4 && memcmp(data, "RHTX", 4) == 0) {
+		return decodeContainer(data, read.getLength(), width, height);
+	}
+	return decodePng(data, read.getLength(), width, height);
+}
+
+unsigned char* BitmapInputSource::decodeContainer(const char* data, unsigned int length, unsigned int* width,
+		unsigned int* height) {
+	MemoryInput<const char> in { data + 4, length - 4 };
+	auto&& is = EndianInputStream<Endianness::Big>::wrap(in);
+
+	uint32 version;
+	uint32 containerformat;
+	uint32 w;
+	uint32 h;
+	uint32 flags;
+	uint32 datalen;
+	if (!is.deserialize<uint32>(version) || version != TEXTURE_CONTAINER_VERSION || !is.deserialize<uint32>(containerformat)
+			|| !is.deserialize<uint32>(w) || !is.deserialize<uint32>(h) || !is.deserialize<uint32>(flags)
+			|| !is.deserialize<uint32>(datalen) || datalen > in.getLength()) {
+		LOGWTF()<< "Invalid texture container header";
+		return nullptr;
+	}
+	unsigned int pixelsize;
+	switch (containerformat) {
+		case TEXTURE_CONTAINER_FORMAT_RGBA_8888:
+			pixelsize = 4;
+			WARN(format != ColorFormat::RGBA_8888) << "Texture container color format mismatch: " << format;
+			break;
+		case TEXTURE_CONTAINER_FORMAT_A_8:
+			pixelsize = 1;
+			WARN(format != ColorFormat::A_8) << "Texture container color format mismatch: " << format;
+			break;
+		default:
+			LOGWTF()<< "Unknown texture container format: " << containerformat;
+			return nullptr;
+	}
+	if (w == 0 || h == 0 || w > TEXTURE_CONTAINER_MAX_DIMENSION || h > TEXTURE_CONTAINER_MAX_DIMENSION) {
+		LOGWTF()<< "Invalid texture container dimensions: " << w << " - " << h;
+		return nullptr;
+	}
+	if (w > 0xFFFFFFFFu / h / pixelsize) {
+		LOGWTF()<< "Texture container is too large: " << w << " - " << h;
+		return nullptr;
+	}
+	const unsigned int byteslen = w * h * pixelsize;
+	if (flags != 0 || datalen != byteslen) {
+		LOGWTF()<< "Texture container size mismatch: " << datalen << " - " << byteslen << " flags: " << flags;
+		return nullptr;
+	}
+	unsigned char* buffer = new unsigned char[byteslen];
+	memcpy(buffer, in.getPointer(), byteslen);
+	*width = w;
+	*height = h;
+	return buffer;
+}
 
+unsigned char* BitmapInputSource::decodePng(const char* data, unsigned int length, unsigned int* width,
+		unsigned int* height) {
 	png_image image { 0 };
 	image.version = PNG_IMAGE_VERSION;
 
-	int pngsuccess = png_image_begin_read_from_memory(&image, read, read.getLength());
+	int pngsuccess = png_image_begin_read_from_memory(&image, data, length);
 	if (pngsuccess == 0) {
 		LOGWTF()<< "png error " << image.message << ", image.error: " << image.warning_or_error;
-		return;
+		return nullptr;
 	}
 	image.format = convertFormat(format);
 
@@ -70,10 +141,49 @@ void BitmapInputSource::apply(render::Texture* texture) {
 	if (pngsuccess == 0) {
 		LOGWTF()<< "png error " << image.message << ", image.error: " << image.warning_or_error;
 		delete[] buffer;
-		return;
+		return nullptr;
+	}
+	*width = image.width;
+	*height = image.height;
+	return buffer;
+}
+
+unsigned int BitmapInputSource::prepare() {
+	MutexLocker lock { mutex };
+	if (preparedData == nullptr) {
+		preparedData = decode(&preparedWidth, &preparedHeight);
+		if (preparedData == nullptr) {
+			return 0;
+		}
+	}
+	return preparedWidth * preparedHeight * (format == ColorFormat::A_8 ? 1 : 4);
+}
+
+void BitmapInputSource::discardPrepared() {
+	MutexLocker lock { mutex };
+	delete[] preparedData;
+	preparedData = nullptr;
+}
+
+void BitmapInputSource::apply(render::Texture* texture) {
+	unsigned char* buffer;
+	unsigned int width;
+	unsigned int height;
+	{
+		MutexLocker lock { mutex };
+		buffer = preparedData;
+		width = preparedWidth;
+		height = preparedHeight;
+		preparedData = nullptr;
+	}
+	if (buffer == nullptr) {
+		buffer = decode(&width, &height);
+		if (buffer == nullptr) {
+			return;
+		}
 	}
 
-	asInitializer(texture)->initWithData(image.width, image.height, format, buffer);
+	asInitializer(texture)->initWithData(width, height, format, buffer);
 
 	delete[] buffer;
 }
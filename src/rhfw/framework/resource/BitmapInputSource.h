@@ -24,6 +24,7 @@
 #define BITMAPINPUTSOURCE_H_
 
 #include <framework/render/Texture.h>
+#include <framework/threading/Mutex.h>
 
 namespace rhfw {
 
@@ -33,6 +34,17 @@ private:
 
 	ColorFormat format = ColorFormat::NONE;
 
+	/**
+	 * Guards the prepared data, as it may be decoded on a background thread.
+	 */
+	Mutex mutex { Mutex::auto_init { } };
+	unsigned char* preparedData = nullptr;
+	unsigned int preparedWidth = 0;
+	unsigned int preparedHeight = 0;
+
+	unsigned char* decode(unsigned int* width, unsigned int* height);
+	unsigned char* decodePng(const char* data, unsigned int length, unsigned int* width, unsigned int* height);
+	unsigned char* decodeContainer(const char* data, unsigned int length, unsigned int* width, unsigned int* height);
 protected:
 	virtual void apply(render::Texture* texture) override;
 public:
@@ -41,6 +53,9 @@ public:
 	BitmapInputSource& operator=(const BitmapInputSource&) = delete;
 	~BitmapInputSource();
 
+	virtual unsigned int prepare() override;
+	virtual void discardPrepared() override;
+
 	ColorFormat getColorFormat() const {
 		return format;
 	}
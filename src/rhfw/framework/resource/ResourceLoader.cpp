@@ -21,23 +21,144 @@
  */
 
 #include <framework/resource/ResourceLoader.h>
+#include <framework/threading/Thread.h>
 #include <gen/log.h>
 
 namespace rhfw {
 
 ResourceLoader::ResourceLoader() {
+	unsigned int processors = Thread::getProcessorCount();
+	workerCount = processors <= 1 ? 1 : processors - 1;
+	if (workerCount > MAX_WORKER_COUNT) {
+		workerCount = MAX_WORKER_COUNT;
+	}
 }
 
 ResourceLoader::~ResourceLoader() {
-	//ASSERT(toLoadList.isEmpty(), "ResourceLoader still has to load resources, call executeLoading");
+	{
+		MutexLocker lock { mutex };
+		exiting = true;
+	}
+	for (unsigned int i = 0; i < startedWorkers; ++i) {
+		workSemaphore.post();
+	}
+	for (unsigned int i = 0; i < startedWorkers; ++i) {
+		exitSemaphore.wait();
+	}
+	for (auto&& e : preparedList.objects()) {
+		e.target->discardPrepared();
+	}
+	for (auto&& e : loadedList.objects()) {
+		if (e.loaded) {
+			e.resource.free();
+		}
+	}
+}
+
+ResourceLoader::Entry* ResourceLoader::takeFirst(LinkedList<Entry>& list) {
+	if (list.isEmpty()) {
+		return nullptr;
+	}
+	Entry* result = list.first()->get();
+	result->removeLinkFromList();
+	return result;
+}
+
+void ResourceLoader::runWorker() {
+	while (true) {
+		workSemaphore.wait();
+		Entry* entry;
+		{
+			MutexLocker lock { mutex };
+			if (exiting) {
+				break;
+			}
+			entry = takeFirst(pendingList);
+			if (entry == nullptr) {
+				//taken by the owner thread
+				continue;
+			}
+		}
+		entry->cost = entry->target->prepare();
+		{
+			MutexLocker lock { mutex };
+			preparedList.addToEnd(*entry);
+		}
+		preparedSemaphore.post();
+	}
+	exitSemaphore.post();
+}
+
+void ResourceLoader::loadResource(Resource<ShareableResource> resource) {
+	ASSERT(resource != nullptr) << "Resource is nullptr";
+
+	Entry* entry = new Entry(util::move(resource));
+	{
+		MutexLocker lock { mutex };
+		pendingList.addToEnd(*entry);
+	}
+	++remaining;
+	if (startedWorkers < workerCount) {
+		++startedWorkers;
+		Thread t;
+		t.start([this]() {
+			this->runWorker();
+			return 0;
+		});
+	}
+	workSemaphore.post();
+}
+
+void ResourceLoader::finishEntry(Entry* entry) {
+	if (entry->resource.isLoaded()) {
+		//loaded by someone else in the meantime
+		entry->target->discardPrepared();
+	}
+	entry->loaded = entry->resource.load();
+	loadedList.addToEnd(*entry);
+	--remaining;
+}
+
+bool ResourceLoader::executeLoading(unsigned int budget) {
+	unsigned int spent = 0;
+	while (remaining > 0 && spent < budget) {
+		Entry* entry;
+		{
+			MutexLocker lock { mutex };
+			entry = takeFirst(preparedList);
+		}
+		if (entry == nullptr) {
+			break;
+		}
+		finishEntry(entry);
+		spent += entry->cost;
+	}
+	return remaining == 0;
 }
 
 void ResourceLoader::executeLoading() {
-	/*for (auto* n : toLoadList.nodes()) {
-	 //n cant be nullptr
-	 Resource* res = n->get();
-	 res->load();
-	 n->removeLinkFromList();
-	 }*/
+	while (remaining > 0) {
+		Entry* entry;
+		bool prepared;
+		{
+			MutexLocker lock { mutex };
+			entry = takeFirst(preparedList);
+			prepared = entry != nullptr;
+			if (!prepared) {
+				entry = takeFirst(pendingList);
+			}
+		}
+		if (entry == nullptr) {
+			//every remaining resource is being prepared by the workers
+			//the semaphore may have been posted for entries which were already loaded, the loop handles that
+			preparedSemaphore.wait();
+			continue;
+		}
+		if (!prepared) {
+			entry->cost = entry->target->prepare();
+		}
+		finishEntry(entry);
+	}
 }
+
 }
@@ -23,28 +23,100 @@
 #ifndef RESOURCELOADER_H_
 #define RESOURCELOADER_H_
 
-#include <gen/configuration.h>
+#include <framework/resource/Resource.h>
+#include <framework/resource/ShareableResource.h>
+#include <framework/threading/Mutex.h>
+#include <framework/threading/Semaphore.h>
 #include <framework/utils/LinkedList.h>
+#include <framework/utils/LinkedNode.h>
+
+#include <gen/configuration.h>
 
 namespace rhfw {
 
+/**
+ * Loads resources in two phases. The CPU side of the loading (see ShareableResource::prepare()) is executed on
+ * worker threads, and the rest of the loading (uploading to the GPU) is executed by executeLoading() on the thread
+ * that owns the resources, in limited portions.
+ * <p>
+ * The loaded resources are kept referenced until the loader is destroyed.
+ */
 class ResourceLoader {
+public:
+	/**
+	 * The decoding is fanned out to a worker per processor, leaving one for the owner thread.
+	 */
+	static const unsigned int MAX_WORKER_COUNT = 8;
+	/**
+	 * The amount of prepared data, which is loaded by a single executeLoading() call by default.
+	 */
+	static const unsigned int DEFAULT_BUDGET = 4 * 1024 * 1024;
 private:
-	//LinkedList<Resource> toLoadList;
+	class Entry: public LinkedNode<Entry> {
+	public:
+		Resource<ShareableResource> resource;
+		ShareableResource* target;
+		unsigned int cost = 0;
+		bool loaded = false;
+
+		explicit Entry(Resource<ShareableResource> resource)
+				: resource { util::move(resource) }, target { this->resource } {
+		}
+
+		virtual Entry* get() override {
+			return this;
+		}
+	};
+
+	Mutex mutex { Mutex::auto_init { } };
+	Semaphore workSemaphore { Semaphore::auto_init { } };
+	Semaphore preparedSemaphore { Semaphore::auto_init { } };
+	Semaphore exitSemaphore { Semaphore::auto_init { } };
+
+	unsigned int workerCount;
+	unsigned int startedWorkers = 0;
+	bool exiting = false;
+
+	/**
+	 * The resources waiting for preparing and loading. Guarded by the mutex.
+	 */
+	LinkedList<Entry> pendingList;
+	LinkedList<Entry> preparedList;
+
+	/**
+	 * Only accessed by the owner thread.
+	 */
+	LinkedList<Entry> loadedList;
+	unsigned int remaining = 0;
+
+	void runWorker();
+	Entry* takeFirst(LinkedList<Entry>& list);
+	void finishEntry(Entry* entry);
 public:
 	ResourceLoader();
+	ResourceLoader(const ResourceLoader&) = delete;
+	ResourceLoader& operator=(const ResourceLoader&) = delete;
 	~ResourceLoader();
 
-	/*template<typename SharedResourceType>
-	 void loadResource(SharedResource<SharedResourceType>* res) {
-	 if (res->isLoaded()) {
-	 res->load();
-	 } else {
-	 toLoadList.addToEnd(res);
-	 }
-	 }*/
+	/**
+	 * Starts loading the resource in the background.
+	 */
+	void loadResource(Resource<ShareableResource> resource);
 
+	/**
+	 * Loads the prepared resources until the given amount of data is processed. Never waits for the worker threads.
+	 *
+	 * @return true if all resources are loaded.
+	 */
+	bool executeLoading(unsigned int budget);
+	/**
+	 * Loads all resources, waits for the worker threads if necessary.
+	 */
 	void executeLoading();
+
+	bool isFinished() const {
+		return remaining == 0;
+	}
 };
 
 }
@@ -32,9 +32,24 @@ class ShareableResource {
 protected:
 	template<typename, typename >
 	friend class ResourceBase;
+	friend class ResourceLoader;
 
 	virtual bool load() = 0;
 	virtual void free() = 0;
+	/**
+	 * Performs the part of load() which can be executed on a background thread (file reading, decoding), and keeps
+	 * the result until load() is called. Called at most once before each load().
+	 *
+	 * @return an estimate of the amount of data which remains to be processed by load().
+	 */
+	virtual unsigned int prepare() {
+		return 0;
+	}
+	/**
+	 * Releases the results of prepare(), if load() is not going to be called.
+	 */
+	virtual void discardPrepared() {
+	}
 	virtual bool reload() {
 		LOGW()<<"Reload not implemented";
 		free();
@@ -67,10 +67,19 @@ bool Font::load() {
 	xml::XmlNode node;
 	node.param = this;
 	XmlParser::parseXmlAsset(ResourceManager::idToFile(resId), &node);
+	for (unsigned int i = 0; i < characterCount; ++i) {
+		const unsigned int id = (unsigned int) charmap[i].id;
+		if (id < DIRECT_LOOKUP_COUNT) {
+			directLookup[id] = charmap + i;
+		}
+	}
 	return texture.load();
 }
 void Font::free() {
 	texture.free();
+	for (unsigned int i = 0; i < DIRECT_LOOKUP_COUNT; ++i) {
+		directLookup[i] = nullptr;
+	}
 	delete[] charmap;
 }
 void Font::applyAttributes(const xml::XmlAttributes& attrs, unsigned int charcount) {
@@ -134,6 +143,9 @@ const CharDescription& Font::getCharacter(UnicodeCodePoint codepoint) const {
 }
 
 const CharDescription* Font::getCharacterOptional(UnicodeCodePoint codepoint) const {
+	if ((unsigned int) codepoint < DIRECT_LOOKUP_COUNT) {
+		return directLookup[(unsigned int) codepoint];
+	}
 	int begin = 0;
 	int end = characterCount;
 	while (begin < end) {
@@ -67,6 +67,12 @@ public:
 };
 
 class Font: public ShareableResource {
+public:
+	/**
+	 * The characters with code points below this are looked up from a table instead of a binary search.
+	 */
+	static const unsigned int DIRECT_LOOKUP_COUNT = 256;
+private:
 	friend void* rhfw::inflateElement<RXml::Elem::Font>(const xml::XmlNode& node, const xml::XmlAttributes& attrs);
 	friend void* rhfw::getChild<RXml::Elem::Font>(const xml::XmlNode& parent, const xml::XmlNode& child,
 			const xml::XmlAttributes& attributes);
@@ -83,6 +89,7 @@ protected:
 
 	unsigned int characterCount = 0;
 	CharDescription* charmap = nullptr;
+	const CharDescription* directLookup[DIRECT_LOOKUP_COUNT] { };
 
 	ResId resId;
 
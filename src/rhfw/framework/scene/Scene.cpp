@@ -83,6 +83,14 @@ void Scene::hide() {
 	WindowSizeListener::unsubscribe();
 	TouchEventListener::unsubscribe();
 }
+void Scene::executeResourceLoading() {
+	if (!resourceLoader.isFinished()) {
+		if (resourceLoader.executeLoading(ResourceLoader::DEFAULT_BUDGET)) {
+			onResourcesLoaded();
+		}
+	}
+}
+
 core::Window* rhfw::Scene::getWindow() {
 	return manager->getWindow();
 }
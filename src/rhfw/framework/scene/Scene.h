@@ -26,6 +26,8 @@
 #include <framework/utils/LifeCycleChain.h>
 #include <framework/layer/LayerGroup.h>
 #include <framework/core/Window.h>
+#include <framework/core/Profiler.h>
+#include <framework/resource/ResourceLoader.h>
 
 #include <gen/resources.h>
 #include <gen/configuration.h>
@@ -46,6 +48,9 @@ private:
 
 	SceneManager* manager = nullptr;
 
+	ResourceLoader resourceLoader;
+
+	void executeResourceLoading();
 public:
 
 	Scene();
@@ -68,6 +73,11 @@ public:
 	}
 
 	virtual void onDraw() override {
+		{
+			PROFILE_ZONE("Scene::resourceLoading");
+			executeResourceLoading();
+		}
+		PROFILE_ZONE("Scene::draw");
 		LayerGroup::draw();
 	}
 
@@ -82,6 +92,13 @@ public:
 	virtual void navigatingFrom(SceneTransition* transition) {
 	}
 
+	/**
+	 * The loader which is passed to loadResources(). The resources are loaded while the scene is drawn.
+	 */
+	ResourceLoader& getResourceLoader() {
+		return resourceLoader;
+	}
+
 	ResId getIdentifier() const {
 		return identifier;
 	}
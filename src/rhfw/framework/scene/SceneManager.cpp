@@ -102,6 +102,7 @@ void SceneManager::create(core::Window* window, Scene* startscene) {
 	topscene = startscene;
 	topscene->setSceneManager(this);
 	topscene->setScene(topscene);
+	topscene->loadResources(topscene->getResourceLoader());
 	topscene->show();
 }
 Scene* SceneManager::create(core::Window* window, ResId startscene) {
@@ -39,8 +39,7 @@ void SceneTransition::handleSceneChanges(SceneTransition* transition, Scene* new
 	newScene->setSceneManager(&transition->manager);
 	newScene->setScene(newScene);
 
-	ResourceLoader resLoader;
-	newScene->loadResources(resLoader);
+	newScene->loadResources(newScene->getResourceLoader());
 
 	if (transition->oldScene != nullptr) {
 		//handle old changes
@@ -61,6 +61,44 @@ private:
 			delete[] old;
 		}
 	}
+
+	//bottom-up merge sort, stable, O(n log n) instead of the previous O(n^2) selection sort
+	template<typename Less>
+	void mergeSort(Less&& less) {
+		if (mSize < 2) {
+			return;
+		}
+		T** src = data;
+		T** dst = new T*[capacity];
+		for (int width = 1; width < mSize; width *= 2) {
+			for (int start = 0; start < mSize; start += 2 * width) {
+				int mid = start + width < mSize ? start + width : mSize;
+				int end = start + 2 * width < mSize ? start + 2 * width : mSize;
+				int l = start;
+				int r = mid;
+				int out = start;
+				while (l < mid && r < end) {
+					if (less(src[r], src[l])) {
+						dst[out++] = src[r++];
+					} else {
+						dst[out++] = src[l++];
+					}
+				}
+				while (l < mid) {
+					dst[out++] = src[l++];
+				}
+				while (r < end) {
+					dst[out++] = src[r++];
+				}
+			}
+			T** tmp = src;
+			src = dst;
+			dst = tmp;
+		}
+		//src holds the sorted data, dst is the unused buffer
+		data = src;
+		delete[] dst;
+	}
 public:
 	ArrayList()
 			: capacity(32), mSize(0) {
@@ -289,27 +327,15 @@ public:
 	}
 
 	void sort() {
-		for (int i = 0; i < mSize - 1; ++i) {
-			for (int j = i + 1; j < mSize; ++j) {
-				if (*data[j] < *data[i]) {
-					auto* tmp = data[i];
-					data[i] = data[j];
-					data[j] = tmp;
-				}
-			}
-		}
+		mergeSort([](const T* l, const T* r) {
+			return *l < *r;
+		});
 	}
 	template<typename Comparator>
 	void sort(Comparator&& comp) {
-		for (int i = 0; i < mSize - 1; ++i) {
-			for (int j = i + 1; j < mSize; ++j) {
-				if (comp(*data[j], *data[i])) {
-					auto* tmp = data[i];
-					data[i] = data[j];
-					data[j] = tmp;
-				}
-			}
-		}
+		mergeSort([&](const T* l, const T* r) {
+			return comp(*l, *r);
+		});
 	}
 
 	T** begin() {
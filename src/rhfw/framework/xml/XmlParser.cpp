@@ -26,6 +26,7 @@
 #include <framework/io/files/AssetFileDescriptor.h>
 #include <framework/io/stream/InputStream.h>
 #include <framework/io/stream/BufferedInputStream.h>
+#include <framework/utils/MemoryInput.h>
 #include <framework/xml/XmlNode.h>
 #include <framework/xml/XmlAttributes.h>
 
@@ -103,6 +104,13 @@ void XmlParser::versionParser<1>(EndianInputStream<Endianness::Big>& stream, xml
 
 void XmlParser::parseXml(FileInput& file, xml::XmlNode* result) {
 	auto stream = EndianInputStream<Endianness::Big>::wrap(BufferedInputStream::wrap(file));
+	parseXml(stream, result);
+}
+void XmlParser::parseXml(const void* data, unsigned int length, xml::XmlNode* result) {
+	auto stream = EndianInputStream<Endianness::Big>::wrap(MemoryInput<const char> { static_cast<const char*>(data), length });
+	parseXml(stream, result);
+}
+void XmlParser::parseXml(EndianInputStream<Endianness::Big>& stream, xml::XmlNode* result) {
 	uint32 version = 0;
 	stream.deserialize<uint32>(version);
 	switch (version) {
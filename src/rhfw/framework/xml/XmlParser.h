@@ -45,6 +45,7 @@ class XmlParser {
 private:
 	template<int version>
 	void versionParser(EndianInputStream<Endianness::Big>& stream, xml::XmlNode* result, xml::XmlAttributes& attrbuf);
+	void parseXml(EndianInputStream<Endianness::Big>& stream, xml::XmlNode* result);
 public:
 
 	XmlParser() {
@@ -53,6 +54,10 @@ public:
 	}
 
 	void parseXml(FileInput& file, xml::XmlNode* result);
+	/**
+	 * Parses a compiled xml that was already read into memory.
+	 */
+	void parseXml(const void* data, unsigned int length, xml::XmlNode* result);
 
 	static xml::XmlNode parseXmlAsset(RAssetFile resourceId);
 	static void parseXmlAsset(RAssetFile resourceId, xml::XmlNode* result);
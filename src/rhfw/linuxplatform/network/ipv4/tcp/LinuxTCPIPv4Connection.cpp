@@ -96,6 +96,15 @@ bool LinuxTCPIPv4Connection::connectImpl(const NetworkAddress& netaddress) {
 	return false;
 }
 
+void LinuxTCPIPv4Connection::shutdown() {
+	WARN(fd < 0);
+	if (fd < 0) {
+		return;
+	}
+	int res = ::shutdown(fd, SHUT_RDWR);
+	ASSERT(res == 0 || errno == 107 || errno == 57) << "syscall failed " << strerror(errno);
+}
+
 void LinuxTCPIPv4Connection::disconnect() {
 	WARN(fd < 0);
 	if (fd < 0) {
@@ -43,6 +43,7 @@ public:
 	LinuxTCPIPv4Connection();
 	~LinuxTCPIPv4Connection();
 
+	virtual void shutdown() override;
 	virtual void disconnect() override;
 };
 
@@ -51,6 +51,13 @@ public:
 	static Id getCurrentId() {
 		return syscall(SYS_gettid);
 	}
+	/**
+	 * Returns the number of processors available to the application, at least 1.
+	 */
+	static unsigned int getProcessorCount() {
+		long res = sysconf(_SC_NPROCESSORS_ONLN);
+		return res < 1 ? 1 : (unsigned int) res;
+	}
 	/**
 	 * Returns the remaining time, because the sleep was interrupted
 	 */
@@ -256,6 +256,15 @@ void OpenGlEs20Renderer::setCullToFrontFaceImpl(bool isFront) {
 		CHECK_GL_ERROR_REND(this);
 	}
 }
+void OpenGlEs20Renderer::setPremultipliedAlphaBlendImpl(bool enabled) {
+	if (enabled) {
+		glBlendFuncSeparate(GL_ONE, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE);
+		CHECK_GL_ERROR_REND(this);
+	} else {
+		glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE);
+		CHECK_GL_ERROR_REND(this);
+	}
+}
 void OpenGlEs20Renderer::setViewPortImpl(const render::ViewPort& vp) {
 	glViewport(vp.pos.x(), vp.pos.y(), vp.size.width(), vp.size.height());
 	CHECK_GL_ERROR_REND(this);
@@ -120,6 +120,7 @@ private:
 	virtual void setDepthTestImpl(bool enabled) override;
 	virtual void setFaceCullingImpl(bool enabled) override;
 	virtual void setCullToFrontFaceImpl(bool isFront) override;
+	virtual void setPremultipliedAlphaBlendImpl(bool enabled) override;
 	virtual void setViewPortImpl(const render::ViewPort& vp) override;
 
 	virtual render::Texture* createTextureImpl() override;
@@ -85,6 +85,15 @@ bool WinSockTCPIPv4Connection::connectImpl(const NetworkAddress& netaddress) {
 	return false;
 }
 
+void WinSockTCPIPv4Connection::shutdown() {
+	WARN(socket == INVALID_SOCKET);
+	if (socket == INVALID_SOCKET) {
+		return;
+	}
+	int res = ::shutdown(socket, SD_BOTH);
+	ASSERT(res == 0 || WSAGetLastError() == WSAENOTCONN || WSAGetLastError() == WSAECONNRESET) << "WSA call failed " << WSAGetLastError();
+}
+
 void WinSockTCPIPv4Connection::disconnect() {
 	WARN(socket == INVALID_SOCKET);
 	if (socket == INVALID_SOCKET) {
@@ -47,6 +47,7 @@ public:
 	WinSockTCPIPv4Connection();
 	~WinSockTCPIPv4Connection();
 
+	virtual void shutdown() override;
 	virtual void disconnect() override;
 };
 
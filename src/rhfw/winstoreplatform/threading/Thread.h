@@ -41,6 +41,14 @@ public:
 	static Id getCurrentId() {
 		return GetCurrentThreadId();
 	}
+	/**
+	 * Returns the number of processors available to the application, at least 1.
+	 */
+	static unsigned int getProcessorCount() {
+		SYSTEM_INFO info;
+		GetNativeSystemInfo(&info);
+		return info.dwNumberOfProcessors < 1 ? 1 : (unsigned int) info.dwNumberOfProcessors;
+	}
 	void sleep(unsigned int millis) {
 		Sleep((DWORD) millis);
 	}
@@ -24,6 +24,7 @@
 #include <framework/threading/Semaphore.h>
 
 #include <sapphireserver/client/ClientConnection.h>
+#include <sapphireserver/client/PresenceService.h>
 
 #include <sapphire/sapphireconstants.h>
 #include <sapphireserver/servermain.h>
@@ -49,6 +50,7 @@ ClientConnection::ClientConnection(TCPConnection* connection)
 	MainRandomer->read(connectionIdentifier.getData(), SapphireUUID::UUID_LENGTH);
 }
 ClientConnection::~ClientConnection() {
+	requestWorker.stop();
 	writerWorker.stop();
 
 	delete cipherOutputStream;
@@ -283,7 +285,20 @@ void ClientConnection::clientReadFunction<3>() {
 					level.getInfo().author.getUserName() = state.userName;
 				}
 				LOGI() << "Received level with UUID: " << level.getInfo().uuid.asString();
+				if (!AdmitExpensiveRequest()) {
+					//verifying the demo is expensive, refuse if too many are in progress
+					postConnectionUserLogEvent(connectionIdentifier, clientUUID,
+							FixedString { "UploadLevel\tREFUSED_BUSY\t" } + level.getInfo().uuid.asString());
+					SapphireUUID leveluuid = level.getInfo().uuid;
+					write([=](EndianOutputStream<Endianness::Big>& ostream) {
+						ostream.serialize<SapphireComm>(SapphireComm::UploadLevel);
+						ostream.serialize<SapphireCommError>(SapphireCommError::ServerError);
+						ostream.serialize<SapphireUUID>(leveluuid);
+					});
+					break;
+				}
 				auto storeerror = DataStorage->saveLevel(level, this->clientUUID);
+				FinishExpensiveRequest();
 				switch (storeerror) {
 					case SapphireStorageError::SUCCESS: {
 						postConnectionUserLogEvent(connectionIdentifier, clientUUID,
@@ -365,7 +380,7 @@ void ClientConnection::clientReadFunction<3>() {
 				auto storeerror = DataStorage->queryLevels(details, 64, start, &outcount, clientUUID);
 				switch (storeerror) {
 					case SapphireStorageError::SUCCESS: {
-						write([=](EndianOutputStream<Endianness::Big>& ostream) {
+						writeSerialized([&](EndianOutputStream<Endianness::Big>& ostream) {
 							ostream.serialize<SapphireComm>(SapphireComm::GetLevels);
 							ostream.serialize<SapphireCommError>(SapphireCommError::NoError);
 							ostream.serialize<uint32>(start);
@@ -395,7 +410,7 @@ void ClientConnection::clientReadFunction<3>() {
 				}
 				if (!registeredLevelChangedListener) {
 					levelChangedListener = SapphireDataStorage::LevelChangedListener::make_listener(
-							[=](unsigned int index, LevelChangeInfo info) {
+							[=](unsigned int index, const SapphireUUID& leveluuid, LevelChangeInfo info) {
 								switch (info) {
 									case LevelChangeInfo::REMOVED: {
 										write([=](EndianOutputStream<Endianness::Big>& ostream) {
@@ -498,10 +513,10 @@ void ClientConnection::clientReadFunction<3>() {
 						} else {
 							postConnectionUserLogEvent(connectionIdentifier, clientUUID,
 									FixedString { "DownloadLevel\tSUCCESS\t" } + outlevel.getInfo().uuid.asString());
-							write([=](EndianOutputStream<Endianness::Big>& ostream) {
+							writeSerialized([&](EndianOutputStream<Endianness::Big>& ostream) {
 								ostream.serialize<SapphireComm>(SapphireComm::DownloadLevel);
 								ostream.serialize<SapphireCommError>(SapphireCommError::NoError);
-								outlevel.saveLevel(ostream, true);
+								outlevel.saveLevel(ostream, true, clientAppVersion >= 8);
 							});
 						}
 						break;
@@ -591,9 +606,12 @@ void ClientConnection::clientReadFunction<3>() {
 					return;
 				}
 				unsigned int inoutstart = start;
-				unsigned int outcount;
-				LocalArray<SapphireDiscussionMessage, 64> messages;
-				auto storeerror = DataStorage->queryMessages(messages, count > 64 ? 64 : count, &inoutstart, &outcount);
+				unsigned int outcount = 0;
+				DiscussionMessageHistory::Snapshot messages;
+				auto storeerror = DataStorage->queryMessages(&messages);
+				if (storeerror == SapphireStorageError::SUCCESS && !messages.query(count > 64 ? 64 : count, &inoutstart, &outcount)) {
+					storeerror = SapphireStorageError::OUT_OF_BOUNDS;
+				}
 				LOGI() << "Query messages: " << start << " (" << count << ") result: " << inoutstart << " (" << outcount << ")";
 				switch (storeerror) {
 					case SapphireStorageError::OUT_OF_BOUNDS: {
@@ -608,7 +626,7 @@ void ClientConnection::clientReadFunction<3>() {
 						break;
 					}
 					case SapphireStorageError::SUCCESS: {
-						write([=](EndianOutputStream<Endianness::Big>& ostream) {
+						writeSerialized([&](EndianOutputStream<Endianness::Big>& ostream) {
 							ostream.serialize<SapphireComm>(SapphireComm::QueryMessages);
 							ostream.serialize<SapphireCommError>(SapphireCommError::NoError);
 							ostream.serialize<uint32>(start);
@@ -616,7 +634,7 @@ void ClientConnection::clientReadFunction<3>() {
 							ostream.serialize<uint32>(inoutstart);
 							ostream.serialize<uint32>(outcount);
 							for (unsigned int i = 0; i < outcount; ++i) {
-								ostream.serialize<SapphireDiscussionMessage>(messages[i]);
+								ostream.serialize<SapphireDiscussionMessage>(messages.get(inoutstart + i).message);
 							}
 						});
 						break;
@@ -755,11 +773,7 @@ void ClientConnection::clientReadFunction<3>() {
 					if (need) {
 						messagesChangedListener = SapphireDataStorage::MessagesChangedListener::make_listener(
 								[=](unsigned int startindex, unsigned int count) {
-									write([=](EndianOutputStream<Endianness::Big>& ostream) {
-												ostream.serialize<SapphireComm>(SapphireComm::DiscussionMessagesChanged);
-												ostream.serialize<uint32>(startindex);
-												ostream.serialize<uint32>(count);
-											});
+									writeMessagesChanged(startindex, count);
 								});
 						DataStorage->addMessagesChangedListener(messagesChangedListener);
 						MainWorkerThread.post(
@@ -876,6 +890,11 @@ void ClientConnection::readThreadFunction(TCPConnection* conn) {
 		});
 		sem.wait();
 		switch (version) {
+			case 11:
+			case 10:
+			case 9:
+			case 8:
+			case 7:
 			case 6:
 			case 5: {
 				clientReadFunction<5>();
@@ -920,6 +939,7 @@ void ClientConnection::readThreadFunction(TCPConnection* conn) {
 
 void ClientConnection::start() {
 	writerWorker.start();
+	requestWorker.start();
 
 	LOGI() << "Start client connection " << connection->getAddress();
 
@@ -960,6 +980,10 @@ void ClientConnection::writeError(SapphireComm cmd, SapphireCommError error) {
 }
 
 void ClientConnection::stop() {
+	//the writer thread may be blocked sending to a stalled client, the send returns after the shutdown
+	connection->shutdown();
+	//don't wait for the pending requests, the read thread waits for the one in progress before exiting
+	requestWorker.signalStopDiscardJobs();
 	writerWorker.stop();
 	connection->disconnect();
 
@@ -990,20 +1014,118 @@ void ClientConnection::postUpgradeStream() {
 	});
 }
 
+static void serializeUserStateChanged(EndianOutputStream<Endianness::Big>& ostream, const ClientConnectionState& conn, bool online) {
+	ostream.serialize<SapphireComm>(SapphireComm::UserStateChanged);
+	ostream.serialize<bool>(online);
+	ostream.serialize<SapphireUUID>(conn.connectionId);
+	if(online) {
+		ostream.serialize<SapphireDifficulty>(conn.userDifficultyColor);
+		ostream.serialize<FixedString>(conn.userName);
+	}
+}
+static unsigned int userStateChangedSize(const ClientConnectionState& conn) {
+	return SAPPHIRE_SERVER_WRITE_SIZE_ESTIMATE + conn.userName.length();
+}
+static void serializeMessagesChanged(EndianOutputStream<Endianness::Big>& ostream, uint32 startindex, uint32 count) {
+	ostream.serialize<SapphireComm>(SapphireComm::DiscussionMessagesChanged);
+	ostream.serialize<uint32>(startindex);
+	ostream.serialize<uint32>(count);
+}
+
 void ClientConnection::writeUserStateChanged(const ClientConnectionState& conn, bool online) {
 	if (!conn.connectionId) {
 		return;
 	}
+	MutexLocker lock { pendingNotificationsMutex };
+	if (notificationFlushPosted || isWriteQueueCongested()) {
+		//keep only the latest state of a user
+		for (auto&& pending : pendingUserStates) {
+			if (pending->state.connectionId == conn.connectionId) {
+				unsigned int prevsize = userStateChangedSize(pending->state);
+				if (!reserveWriteQueue(userStateChangedSize(conn))) {
+					return;
+				}
+				queuedWriteBytes -= prevsize;
+				pendingUserStatesSize += userStateChangedSize(conn) - prevsize;
+				pending->state = conn;
+				pending->online = online;
+				postNotificationFlush();
+				return;
+			}
+		}
+		if (!reserveWriteQueue(userStateChangedSize(conn))) {
+			return;
+		}
+		pendingUserStatesSize += userStateChangedSize(conn);
+		pendingUserStates.add(new PendingUserState(conn, online));
+		postNotificationFlush();
+		return;
+	}
+	write([=](EndianOutputStream<Endianness::Big>& ostream) {
+		serializeUserStateChanged(ostream, conn, online);
+	}, userStateChangedSize(conn));
+}
+void ClientConnection::writeMessagesChanged(unsigned int startindex, unsigned int count) {
+	MutexLocker lock { pendingNotificationsMutex };
+	if (notificationFlushPosted || isWriteQueueCongested()) {
+		pendingMessagesChanged = true;
+		pendingMessagesStartIndex = startindex;
+		pendingMessagesCount = count;
+		postNotificationFlush();
+		return;
+	}
 	write([=](EndianOutputStream<Endianness::Big>& ostream) {
-		ostream.serialize<SapphireComm>(SapphireComm::UserStateChanged);
-		ostream.serialize<bool>(online);
-		ostream.serialize<SapphireUUID>(conn.connectionId);
-		if(online) {
-			ostream.serialize<SapphireDifficulty>(conn.userDifficultyColor);
-			ostream.serialize<FixedString>(conn.userName);
+		serializeMessagesChanged(ostream, startindex, count);
+	});
+}
+void ClientConnection::postNotificationFlush() {
+	if (notificationFlushPosted) {
+		return;
+	}
+	notificationFlushPosted = true;
+	write([=](EndianOutputStream<Endianness::Big>& ostream) {
+		bool messageschanged;
+		uint32 messagesstart;
+		uint32 messagescount;
+		ArrayList<PendingUserState> userstates;
+		{
+			MutexLocker lock { pendingNotificationsMutex };
+			notificationFlushPosted = false;
+			messageschanged = pendingMessagesChanged;
+			messagesstart = pendingMessagesStartIndex;
+			messagescount = pendingMessagesCount;
+			pendingMessagesChanged = false;
+			userstates = util::move(pendingUserStates);
+			//the user states were reserved when they were collected
+			queuedWriteBytes -= pendingUserStatesSize;
+			pendingUserStatesSize = 0;
+		}
+		if (messageschanged) {
+			serializeMessagesChanged(ostream, messagesstart, messagescount);
+		}
+		for (auto&& us : userstates) {
+			serializeUserStateChanged(ostream, us->state, us->online);
 		}
 	});
 }
+bool ClientConnection::reserveWriteQueue(unsigned int size) {
+	if (writeQueueOverflow) {
+		return false;
+	}
+	unsigned int queued = queuedWriteBytes.fetch_add(size) + size;
+	if (queued <= SAPPHIRE_SERVER_WRITE_QUEUE_LIMIT) {
+		return true;
+	}
+	queuedWriteBytes -= size;
+	if (!writeQueueOverflow.exchange(true)) {
+		LOGW() << "Write queue overflow, disconnecting client: " << queued;
+		postConnectionUserLogEvent(connectionIdentifier, clientUUID, "Abort connection\tWrite queue overflow");
+		MainWorkerThread.post([=] {
+			stop();
+		});
+	}
+	return false;
+}
 
 void ClientConnection::setMaintenanceMode(bool mode) {
 	if (mode && this->clientUUID) {
@@ -1026,6 +1148,246 @@ void ClientConnection::sendPingRequest(uint32 id) {
 		});
 	}
 }
+void ClientConnection::registerLevelChangedListener() {
+	if (registeredLevelChangedListener) {
+		return;
+	}
+	levelChangedListener = SapphireDataStorage::LevelChangedListener::make_listener(
+			[=](unsigned int index, const SapphireUUID& leveluuid, LevelChangeInfo info) {
+				notifyLevelChanged(index, leveluuid, info);
+			});
+	auto storeerror = DataStorage->addLevelChangedListener(levelChangedListener);
+	if (storeerror == SapphireStorageError::SUCCESS) {
+		registeredLevelChangedListener = true;
+	} else {
+		levelChangedListener = nullptr;
+	}
+}
+
+void ClientConnection::sendLevelCatalogChanges(SapphireDataStorage::LevelCatalogCursor cursor) {
+	bool reset;
+	ArrayList<SapphireUUID> removed;
+	ArrayList<SapphireLevelDetails> changed;
+	unsigned int totalcount;
+	//locked, so the response is ordered consistently with the removal notifications
+	MutexLocker lock { pendingLevelChangesMutex };
+	auto storeerror = DataStorage->queryLevelChanges(clientUUID, &cursor, &reset, &removed, &changed, &totalcount);
+	if (storeerror != SapphireStorageError::SUCCESS) {
+		write([=](EndianOutputStream<Endianness::Big>& ostream) {
+			ostream.serialize<SapphireComm>(SapphireComm::SyncLevels);
+			ostream.serialize<SapphireCommError>(SapphireCommError::ServerError);
+		});
+		return;
+	}
+	writeSerialized([&](EndianOutputStream<Endianness::Big>& ostream) {
+		ostream.serialize<SapphireComm>(SapphireComm::SyncLevels);
+		ostream.serialize<SapphireCommError>(SapphireCommError::NoError);
+		ostream.serialize<SapphireUUID>(cursor.epoch);
+		ostream.serialize<uint32>(cursor.sequence);
+		ostream.serialize<bool>(reset);
+		ostream.serialize<uint32>(removed.size());
+		for (int i = 0; i < removed.size(); ++i) {
+			ostream.serialize<SapphireUUID>(removed[i]);
+		}
+		ostream.serialize<uint32>(changed.size());
+		for (int i = 0; i < changed.size(); ++i) {
+			ostream.serialize<SapphireLevelDetails>(changed[i]);
+		}
+		ostream.serialize<uint32>(totalcount);
+	});
+}
+
+static int comparePendingLevelUUIDPtrs(const SapphireUUID* l, const SapphireUUID* r) {
+	return l->compare(*r);
+}
+static int comparePendingLevelUUID(const SapphireUUID* l, const SapphireUUID& r) {
+	return l->compare(r);
+}
+
+class ChangedLevelDetails {
+public:
+	unsigned int index;
+	SapphireLevelDetails details;
+
+	static int compareIndex(const ChangedLevelDetails* l, const ChangedLevelDetails* r) {
+		return l->index < r->index ? -1 : (l->index > r->index ? 1 : 0);
+	}
+};
+
+void ClientConnection::notifyLevelChanged(unsigned int index, const SapphireUUID& leveluuid, LevelChangeInfo info) {
+	if (clientAppVersion < 7) {
+		//older clients are notified per change, and query the details themselves
+		switch (info) {
+			case LevelChangeInfo::REMOVED: {
+				write([=](EndianOutputStream<Endianness::Big>& ostream) {
+					ostream.serialize<SapphireComm>(SapphireComm::LevelRemoved);
+					ostream.serialize<uint32>(index);
+				});
+				break;
+			}
+			case LevelChangeInfo::ADDED:
+			case LevelChangeInfo::RATING_CHANGED: {
+				write([=](EndianOutputStream<Endianness::Big>& ostream) {
+					ostream.serialize<SapphireComm>(SapphireComm::LevelDetailsChanged);
+					ostream.serialize<uint32>(index);
+				});
+				break;
+			}
+			default: {
+				break;
+			}
+		}
+		return;
+	}
+	MutexLocker lock { pendingLevelChangesMutex };
+	switch (info) {
+		case LevelChangeInfo::REMOVED: {
+			int pendingindex = pendingLevelChanges.getIndexForSorted(leveluuid, comparePendingLevelUUID);
+			if (pendingindex >= 0) {
+				delete pendingLevelChanges.remove(pendingindex);
+			}
+			write([=](EndianOutputStream<Endianness::Big>& ostream) {
+				ostream.serialize<SapphireComm>(SapphireComm::LevelRemoved);
+				ostream.serialize<uint32>(index);
+			});
+			break;
+		}
+		case LevelChangeInfo::ADDED:
+		case LevelChangeInfo::RATING_CHANGED: {
+			if (pendingLevelChanges.getIndexForSorted(leveluuid, comparePendingLevelUUID) < 0) {
+				pendingLevelChanges.setSorted(new SapphireUUID(leveluuid), comparePendingLevelUUIDPtrs);
+			}
+			break;
+		}
+		default: {
+			break;
+		}
+	}
+}
+
+void ClientConnection::sendPendingLevelChanges() {
+	MutexLocker lock { pendingLevelChangesMutex };
+	if (pendingLevelChanges.isEmpty()) {
+		return;
+	}
+	//the index is resolved now, and may be ahead of the client if a removal notification is still in flight
+	//the client identifies the level by the uuid in the details, the index is only a hint
+	ArrayList<ChangedLevelDetails> changed;
+	for (auto&& uuid : pendingLevelChanges) {
+		ChangedLevelDetails* c = new ChangedLevelDetails();
+		auto storeerror = DataStorage->queryLevel(*uuid, &c->details, &c->index, clientUUID);
+		if (storeerror != SapphireStorageError::SUCCESS) {
+			//removed in the meantime
+			delete c;
+			continue;
+		}
+		//in index order, so the added levels are appended in the same order as on the server
+		int pos = changed.getIndexForSorted(c, ChangedLevelDetails::compareIndex);
+		changed.add(pos < 0 ? -(pos + 1) : pos, c);
+	}
+	pendingLevelChanges.clear();
+	if (changed.isEmpty()) {
+		return;
+	}
+	writeSerialized([&](EndianOutputStream<Endianness::Big>& ostream) {
+		ostream.serialize<SapphireComm>(SapphireComm::LevelDetailsBatch);
+		ostream.serialize<uint32>(changed.size());
+		for (int i = 0; i < changed.size(); ++i) {
+			ostream.serialize<uint32>(changed[i].index);
+			ostream.serialize<SapphireLevelDetails>(changed[i].details);
+		}
+	});
+}
+
+void ClientConnection::writePresenceMessage(const PresenceMessage& message) {
+	PresenceMessage msg = message;
+	write([=](EndianOutputStream<Endianness::Big>& ostream) {
+		ostream.write(msg.getData(), msg.getSize());
+	}, msg.getSize());
+}
+
+void ClientConnection::postMessageBuffer(MessageBuffer* buffer) {
+	uint32 size = buffer->size;
+	if (!reserveWriteQueue(size)) {
+		delete buffer;
+		return;
+	}
+	bool posted = writerWorker.post([=] {
+		queuedWriteBytes -= size;
+		if (!terminated && !writeQueueOverflow) {
+			outputStream->write(buffer->data, size);
+		}
+		delete buffer;
+	});
+	if (!posted) {
+		queuedWriteBytes -= size;
+		delete buffer;
+	}
+}
+
+static int compareDownloadLevelUUID(const SapphireUUID* l, const SapphireUUID& r) {
+	return l->compare(r);
+}
+bool ClientConnection::beginLevelDownload(const SapphireUUID& uuid) {
+	MutexLocker l { levelDownloadsMutex };
+	int index = levelDownloads.getIndexForSorted(uuid, compareDownloadLevelUUID);
+	if (index >= 0) {
+		return false;
+	}
+	levelDownloads.add(-(index + 1), new SapphireUUID(uuid));
+	return true;
+}
+void ClientConnection::finishLevelDownload(const SapphireUUID& uuid) {
+	MutexLocker l { levelDownloadsMutex };
+	int index = levelDownloads.getIndexForSorted(uuid, compareDownloadLevelUUID);
+	if (index >= 0) {
+		delete levelDownloads.remove(index);
+	}
+}
+
+void ClientConnection::writeLevelChunked(const SapphireUUID& uuid, const Level& level) {
+	MessageBuffer* data = new MessageBuffer();
+	{
+		auto&& os = OutputStream::wrap(*data);
+		level.saveLevel(os, true, true);
+	}
+	postLevelChunk(uuid, data, 0);
+}
+void ClientConnection::postLevelChunk(const SapphireUUID& uuid, MessageBuffer* data, uint32 offset) {
+	uint32 chunksize = data->size - offset > SAPPHIRE_DOWNLOAD_CHUNK_SIZE ? SAPPHIRE_DOWNLOAD_CHUNK_SIZE : data->size - offset;
+	if (!reserveWriteQueue(chunksize)) {
+		finishLevelDownload(uuid);
+		delete data;
+		return;
+	}
+	bool posted = writerWorker.post([=] {
+		queuedWriteBytes -= chunksize;
+		if (terminated || writeQueueOverflow) {
+			finishLevelDownload(uuid);
+			delete data;
+			return;
+		}
+		auto&& ostream = *outputStream;
+		ostream.serialize<SapphireComm>(SapphireComm::DownloadLevelChunk);
+		ostream.serialize<SapphireUUID>(uuid);
+		ostream.serialize<uint32>(data->size);
+		ostream.serialize<uint32>(offset);
+		ostream.serialize<uint32>(chunksize);
+		ostream.write(data->data + offset, chunksize);
+		if (offset + chunksize < data->size) {
+			postLevelChunk(uuid, data, offset + chunksize);
+		} else {
+			finishLevelDownload(uuid);
+			delete data;
+		}
+	});
+	if (!posted) {
+		queuedWriteBytes -= chunksize;
+		finishLevelDownload(uuid);
+		delete data;
+	}
+}
+
 void ClientConnection::sendPingRequestOrDisconnect() {
 	write([=](EndianOutputStream<Endianness::Big>& ostream) {
 		if (pingOrDisconnectCounter == 0) {
@@ -33,6 +33,9 @@
 #include <framework/threading/Mutex.h>
 #include <framework/utils/ArrayList.h>
 
+#include <atomic>
+#include <string.h>
+
 #include <sapphire/community/SapphireUser.h>
 #include <sapphire/server/WorkerThread.h>
 #include <sapphireserver/storage/SapphireDataStorage.h>
@@ -46,6 +49,8 @@
 namespace userapp {
 using namespace rhfw;
 
+class PresenceMessage;
+
 class ClientConnectionState {
 public:
 	FixedString userName;
@@ -64,6 +69,77 @@ class ClientConnection: public LinkedNode<ClientConnection> {
 	Mutex destroyMutex { Mutex::auto_init { } };
 
 	WorkerThread writerWorker;
+	/**
+	 * Handles the requests which depend only on their arguments, and may take long, like level and demo downloads.
+	 * The read thread can continue handling other requests meanwhile, and their responses can precede these.
+	 */
+	WorkerThread requestWorker;
+
+	/**
+	 * Estimated size of the messages posted to the writer thread, but not written yet.
+	 * The client is disconnected if it exceeds SAPPHIRE_SERVER_WRITE_QUEUE_LIMIT, as it doesn't keep up with the messages.
+	 */
+	std::atomic<unsigned int> queuedWriteBytes { 0 };
+	std::atomic<bool> writeQueueOverflow { false };
+
+	/**
+	 * Message serialized before it is posted to the writer thread, so its exact size is reserved in the write queue.
+	 */
+	class MessageBuffer {
+	public:
+		char* data = nullptr;
+		uint32 size = 0;
+		uint32 capacity = 0;
+
+		~MessageBuffer() {
+			delete[] data;
+		}
+
+		bool write(const void* buffer, unsigned int count) {
+			if (size + count > capacity) {
+				uint32 ncapacity = capacity < 4096 ? 4096 : capacity * 2;
+				if (ncapacity < size + count) {
+					ncapacity = size + count;
+				}
+				char* ndata = new char[ncapacity];
+				memcpy(ndata, data, size);
+				delete[] data;
+				data = ndata;
+				capacity = ncapacity;
+			}
+			memcpy(data + size, buffer, count);
+			size += count;
+			return true;
+		}
+	};
+	/**
+	 * Takes ownership of the buffer.
+	 */
+	void postMessageBuffer(MessageBuffer* buffer);
+
+	class PendingUserState {
+	public:
+		ClientConnectionState state;
+		bool online;
+
+		PendingUserState(const ClientConnectionState& state, bool online)
+				: state(state), online(online) {
+		}
+	};
+	/**
+	 * Notifications which are superseded by later ones of the same kind.
+	 * If the write queue is congested, they are collected here and written by a single flush job.
+	 */
+	Mutex pendingNotificationsMutex { Mutex::auto_init { } };
+	bool notificationFlushPosted = false;
+	bool pendingMessagesChanged = false;
+	uint32 pendingMessagesStartIndex = 0;
+	uint32 pendingMessagesCount = 0;
+	ArrayList<PendingUserState> pendingUserStates;
+	/**
+	 * Size of the pending user states, reserved in the write queue until the flush job writes them.
+	 */
+	unsigned int pendingUserStatesSize = 0;
 
 	RC4Cipher writeCipher;
 
@@ -73,6 +149,11 @@ class ClientConnection: public LinkedNode<ClientConnection> {
 
 	bool registeredLevelChangedListener = false;
 	SapphireDataStorage::LevelChangedListener::Listener levelChangedListener;
+	/**
+	 * Sorted uuids of the levels that changed since the last LevelDetailsBatch was sent.
+	 */
+	ArrayList<SapphireUUID> pendingLevelChanges;
+	Mutex pendingLevelChangesMutex { Mutex::auto_init { } };
 	SapphireDataStorage::MessagesChangedListener::Listener messagesChangedListener;
 	SapphireDataStorage::HardwareAssociationListener::Listener hardwareAssociationListener;
 	ArrayList<HardwareListener> hardwareProgressChangedListeners;
@@ -80,6 +161,10 @@ class ClientConnection: public LinkedNode<ClientConnection> {
 
 	HardwareListener* getHardwareListener(const SapphireUUID& hardware);
 	bool requiresCommunityNotifications = false;
+	/**
+	 * The online users are sent by the PresenceService. Only used on the MainWorkerThread.
+	 */
+	bool presenceSubscribed = false;
 
 	/**
 	 * The UUID the user provides at the start of connection
@@ -123,6 +208,20 @@ class ClientConnection: public LinkedNode<ClientConnection> {
 
 	void writeError(SapphireComm cmd, SapphireCommError error);
 
+	/**
+	 * Accounts the estimated size of a message to be posted to the writer thread.
+	 * Returns false and disconnects the client if the write queue limit is exceeded.
+	 */
+	bool reserveWriteQueue(unsigned int size);
+	bool isWriteQueueCongested() const {
+		return queuedWriteBytes.load() > SAPPHIRE_SERVER_WRITE_QUEUE_COALESCE_LIMIT;
+	}
+	/**
+	 * Posts the job writing the pending notifications if not yet posted. pendingNotificationsMutex must be locked.
+	 */
+	void postNotificationFlush();
+	void writeMessagesChanged(unsigned int startindex, unsigned int count);
+
 	template<typename Writer>
 	void writeTerminate(Writer&& writer) {
 		write([=] (EndianOutputStream<Endianness::Big>& ostream) {
@@ -148,6 +247,28 @@ class ClientConnection: public LinkedNode<ClientConnection> {
 
 	void installHardwareProgressListener(const SapphireDataStorage::AssociatedHardware* h);
 	void removeHardwareProgressListener(const SapphireDataStorage::AssociatedHardware* h);
+
+	void registerLevelChangedListener();
+	void notifyLevelChanged(unsigned int index, const SapphireUUID& leveluuid, LevelChangeInfo info);
+	void sendLevelCatalogChanges(SapphireDataStorage::LevelCatalogCursor cursor);
+	/**
+	 * Sends the level in DownloadLevelChunk messages. The next chunk is only posted after the previous one is written,
+	 * so responses posted meanwhile are not blocked until the whole level is sent.
+	 */
+	void writeLevelChunked(const SapphireUUID& uuid, const Level& level);
+	void postLevelChunk(const SapphireUUID& uuid, MessageBuffer* data, uint32 offset);
+
+	Mutex levelDownloadsMutex { Mutex::auto_init { } };
+	/**
+	 * Levels with a DownloadLevel request in progress. Repeated requests of the same level are ignored meanwhile,
+	 * so the chunks of the same level are never interleaved.
+	 */
+	ArrayList<SapphireUUID> levelDownloads;
+	/**
+	 * Returns false if the level is already being downloaded.
+	 */
+	bool beginLevelDownload(const SapphireUUID& uuid);
+	void finishLevelDownload(const SapphireUUID& uuid);
 public:
 	ClientConnection(TCPConnection* connection);
 	~ClientConnection();
@@ -156,13 +277,33 @@ public:
 	void stop();
 
 	template<typename Writer>
-	void write(Writer&& writer) {
-		writerWorker.post([=] () mutable {
-			if (terminated) {
+	void write(Writer&& writer, unsigned int estimatedsize = SAPPHIRE_SERVER_WRITE_SIZE_ESTIMATE) {
+		if (!reserveWriteQueue(estimatedsize)) {
+			return;
+		}
+		bool posted = writerWorker.post([=] () mutable {
+			queuedWriteBytes -= estimatedsize;
+			if (terminated || writeQueueOverflow) {
 				return;
 			}
 			util::forward<Writer>(writer)(*outputStream);
 		});
+		if (!posted) {
+			queuedWriteBytes -= estimatedsize;
+		}
+	}
+	/**
+	 * Writes a message with a variable size payload. The writer is called immediately to serialize the message
+	 * into a buffer, which is posted to the writer thread with its exact size reserved in the write queue.
+	 */
+	template<typename Writer>
+	void writeSerialized(Writer&& writer) {
+		MessageBuffer* buffer = new MessageBuffer();
+		{
+			auto&& ostream = EndianOutputStream<Endianness::Big>::wrap(*buffer);
+			writer(ostream);
+		}
+		postMessageBuffer(buffer);
 	}
 	template<typename Writer>
 	void writeNoTerminateCheck(Writer&& writer) {
@@ -201,6 +342,17 @@ public:
 
 	void sendPingRequest(uint32 id);
 	void sendPingRequestOrDisconnect();
+
+	/**
+	 * Sends the details of the levels changed since the last call in a single message.
+	 * Called periodically for all connections.
+	 */
+	void sendPendingLevelChanges();
+
+	bool isPresenceSubscribed() const {
+		return presenceSubscribed;
+	}
+	void writePresenceMessage(const PresenceMessage& message);
 };
 
 } // namespace userapp
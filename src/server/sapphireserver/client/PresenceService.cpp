@@ -0,0 +1,166 @@
+/*
+ * Copyright (C) 2020 Bence Sipka
+ *
+ * This program is free software: you can redistribute it and/or modify 
+ * it under the terms of the GNU General Public License as published by 
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/*
+ * PresenceService.cpp
+ *
+ *  Created on: 2026. okt. 19.
+ *      Author: sipka
+ */
+
+#include <framework/io/stream/OutputStream.h>
+
+#include <sapphireserver/client/PresenceService.h>
+#include <sapphireserver/client/ClientConnection.h>
+#include <sapphire/sapphireconstants.h>
+
+#include <gen/log.h>
+#include <gen/serialize.h>
+
+#include <string.h>
+
+namespace userapp {
+
+PresenceService* OnlinePresence = nullptr;
+
+bool PresenceMessage::write(const void* buffer, unsigned int count) {
+	ASSERT(data->references == 1) << "Message is already shared";
+	if (data->size + count > data->capacity) {
+		uint32 ncapacity = data->capacity < 256 ? 256 : data->capacity * 2;
+		if (ncapacity < data->size + count) {
+			ncapacity = data->size + count;
+		}
+		char* nbytes = new char[ncapacity];
+		memcpy(nbytes, data->bytes, data->size);
+		delete[] data->bytes;
+		data->bytes = nbytes;
+		data->capacity = ncapacity;
+	}
+	memcpy(data->bytes + data->size, buffer, count);
+	data->size += count;
+	return true;
+}
+
+PresenceService::PresenceService() {
+	userStateListener = UserStateListener::make_listener([=](const ClientConnectionState& state, UserState userstate) {
+		if (state.userName.length() == 0) {
+			return;
+		}
+		switch (userstate) {
+			case UserState::AUTHORIZED: {
+				setOnline(state);
+				break;
+			}
+			case UserState::DISCONNECTED: {
+				setOffline(state);
+				break;
+			}
+			default: {
+				break;
+			}
+		}
+	});
+	UserStateEvents += userStateListener;
+}
+PresenceService::~PresenceService() {
+}
+
+void PresenceService::setOnline(const ClientConnectionState& state) {
+	if (!state.connectionId) {
+		return;
+	}
+	snapshotValid = false;
+	int index = users.getIndexForSorted(state.connectionId, Entry::compareUUID);
+	if (index >= 0) {
+		users[index].userName = state.userName;
+		users[index].difficultyColor = state.userDifficultyColor;
+	} else {
+		users.add(-(index + 1), new Entry(state.connectionId, state.userName, state.userDifficultyColor));
+	}
+	int pendingindex = pendingOnline.getIndexForSorted(state.connectionId, Entry::compareUUID);
+	if (pendingindex >= 0) {
+		pendingOnline[pendingindex].userName = state.userName;
+		pendingOnline[pendingindex].difficultyColor = state.userDifficultyColor;
+	} else {
+		pendingOnline.add(-(pendingindex + 1), new Entry(state.connectionId, state.userName, state.userDifficultyColor));
+	}
+}
+void PresenceService::setOffline(const ClientConnectionState& state) {
+	int index = users.getIndexForSorted(state.connectionId, Entry::compareUUID);
+	if (index < 0) {
+		return;
+	}
+	snapshotValid = false;
+	delete users.remove(index);
+	int pendingindex = pendingOnline.getIndexForSorted(state.connectionId, Entry::compareUUID);
+	if (pendingindex >= 0) {
+		delete pendingOnline.remove(pendingindex);
+	}
+	//sent even if it came online in the same batch, as a snapshot may have included it
+	pendingOffline.add(new SapphireUUID(state.connectionId));
+}
+
+void PresenceService::sendSnapshot(ClientConnection& connection) {
+	if (!snapshotValid) {
+		snapshotMessage = PresenceMessage { };
+		auto&& ostream = EndianOutputStream<Endianness::Big>::wrap(snapshotMessage);
+		ostream.serialize<SapphireComm>(SapphireComm::OnlineUsersSnapshot);
+		ostream.serialize<uint32>(version);
+		ostream.serialize<uint32>(users.size());
+		for (auto&& u : users) {
+			ostream.serialize<SapphireUUID>(u->connectionId);
+			ostream.serialize<SapphireDifficulty>(u->difficultyColor);
+			ostream.serialize<FixedString>(u->userName);
+		}
+		snapshotValid = true;
+	}
+	connection.writePresenceMessage(snapshotMessage);
+}
+
+void PresenceService::sendChanges() {
+	if (pendingOnline.isEmpty() && pendingOffline.isEmpty()) {
+		return;
+	}
+	++version;
+	//the snapshot contains the version
+	snapshotValid = false;
+
+	PresenceMessage message;
+	{
+		auto&& ostream = EndianOutputStream<Endianness::Big>::wrap(message);
+		ostream.serialize<SapphireComm>(SapphireComm::OnlineUsersChanged);
+		ostream.serialize<uint32>(version);
+		ostream.serialize<uint32>(pendingOffline.size());
+		for (auto&& id : pendingOffline) {
+			ostream.serialize<SapphireUUID>(*id);
+		}
+		ostream.serialize<uint32>(pendingOnline.size());
+		for (auto&& u : pendingOnline) {
+			ostream.serialize<SapphireUUID>(u->connectionId);
+			ostream.serialize<SapphireDifficulty>(u->difficultyColor);
+			ostream.serialize<FixedString>(u->userName);
+		}
+	}
+	pendingOffline.clear();
+	pendingOnline.clear();
+
+	for (auto&& c : ClientConnections.objects()) {
+		if (c.isPresenceSubscribed()) {
+			c.writePresenceMessage(message);
+		}
+	}
+}
+
+}  // namespace userapp
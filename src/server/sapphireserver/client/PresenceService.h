@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) 2020 Bence Sipka
+ *
+ * This program is free software: you can redistribute it and/or modify 
+ * it under the terms of the GNU General Public License as published by 
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/*
+ * PresenceService.h
+ *
+ *  Created on: 2026. okt. 19.
+ *      Author: sipka
+ */
+
+#ifndef TEST_SAPPHIRE_SERVER_CLIENT_PRESENCESERVICE_H_
+#define TEST_SAPPHIRE_SERVER_CLIENT_PRESENCESERVICE_H_
+
+#include <framework/utils/ArrayList.h>
+#include <framework/utils/FixedString.h>
+
+#include <sapphire/level/SapphireUUID.h>
+#include <sapphireserver/servermain.h>
+
+#include <gen/types.h>
+#include <gen/fwd/types.h>
+
+#include <atomic>
+
+namespace userapp {
+using namespace rhfw;
+
+/**
+ * Encoded message, shared by the connections it is sent to. Only written before it is shared.
+ */
+class PresenceMessage {
+	class Data {
+	public:
+		std::atomic<unsigned int> references { 1 };
+		char* bytes = nullptr;
+		uint32 size = 0;
+		uint32 capacity = 0;
+
+		~Data() {
+			delete[] bytes;
+		}
+	};
+	Data* data;
+
+	void release() {
+		if (data != nullptr && data->references.fetch_sub(1) == 1) {
+			delete data;
+		}
+	}
+public:
+	PresenceMessage()
+			: data(new Data()) {
+	}
+	PresenceMessage(const PresenceMessage& o)
+			: data(o.data) {
+		data->references.fetch_add(1);
+	}
+	PresenceMessage& operator=(const PresenceMessage& o) {
+		o.data->references.fetch_add(1);
+		release();
+		data = o.data;
+		return *this;
+	}
+	~PresenceMessage() {
+		release();
+	}
+
+	bool write(const void* buffer, unsigned int count);
+
+	const char* getData() const {
+		return data->bytes;
+	}
+	uint32 getSize() const {
+		return data->size;
+	}
+};
+
+/**
+ * Versioned table of the online users, for the connections subscribed to community notifications.
+ * A new subscriber receives the whole table in an OnlineUsersSnapshot, then the changes in OnlineUsersChanged batches,
+ * sent at most every SAPPHIRE_PRESENCE_BATCH_MILLIS. The messages are encoded once for all connections.
+ * Applying a change is idempotent on the client, so changes already included in a snapshot can be sent again.
+ *
+ * Only used on the MainWorkerThread.
+ */
+class PresenceService {
+	class Entry {
+	public:
+		static int compare(const Entry* l, const Entry* r) {
+			return l->connectionId.compare(r->connectionId);
+		}
+		static int compareUUID(const Entry* l, const SapphireUUID& uuid) {
+			return l->connectionId.compare(uuid);
+		}
+
+		SapphireUUID connectionId;
+		FixedString userName;
+		SapphireDifficulty difficultyColor;
+
+		Entry(const SapphireUUID& connectionid, const FixedString& username, SapphireDifficulty difficultycolor)
+				: connectionId(connectionid), userName(username), difficultyColor(difficultycolor) {
+		}
+	};
+
+	uint32 version = 0;
+	/**
+	 * Sorted by connection id.
+	 */
+	ArrayList<Entry> users;
+
+	/**
+	 * Changes since the last batch. Online is sorted by connection id.
+	 */
+	ArrayList<Entry> pendingOnline;
+	ArrayList<SapphireUUID> pendingOffline;
+
+	PresenceMessage snapshotMessage;
+	bool snapshotValid = false;
+
+	UserStateListener::Listener userStateListener;
+
+	void setOnline(const ClientConnectionState& state);
+	void setOffline(const ClientConnectionState& state);
+public:
+	PresenceService();
+	~PresenceService();
+
+	void sendSnapshot(ClientConnection& connection);
+	/**
+	 * Sends the pending changes to the subscribed connections.
+	 */
+	void sendChanges();
+};
+
+extern PresenceService* OnlinePresence;
+
+}  // namespace userapp
+
+#endif /* TEST_SAPPHIRE_SERVER_CLIENT_PRESENCESERVICE_H_ */
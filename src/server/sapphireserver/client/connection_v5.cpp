@@ -24,11 +24,13 @@
 #include <framework/threading/Semaphore.h>
 
 #include <sapphireserver/client/ClientConnection.h>
+#include <sapphireserver/client/PresenceService.h>
 
 #include <sapphire/sapphireconstants.h>
 #include <sapphireserver/servermain.h>
 #include <sapphireserver/storage/SapphireDataStorage.h>
 #include <sapphire/level/Level.h>
+#include <sapphire/level/DemoMoveEncoding.h>
 #include <sapphire/server/SapphireLevelDetails.h>
 #include <sapphire/community/SapphireDiscussionMessage.h>
 #include <sapphire/common/RegistrationToken.h>
@@ -372,7 +374,20 @@ void ClientConnection::clientReadFunction<CONNECTION_VERSION>() {
 				}
 				level.getInfo().nonModifyAbleFlag = true;
 				LOGI()<< "Received level with UUID: " << level.getInfo().uuid.asString();
+				if (!AdmitExpensiveRequest()) {
+					//verifying the demo is expensive, refuse if too many are in progress
+					postConnectionUserLogEvent(connectionIdentifier, clientUUID,
+							FixedString { "UploadLevel\tREFUSED_BUSY\t" } + level.getInfo().uuid.asString());
+					SapphireUUID leveluuid = level.getInfo().uuid;
+					write([=](EndianOutputStream<Endianness::Big>& ostream) {
+						ostream.serialize<SapphireComm>(SapphireComm::UploadLevel);
+						ostream.serialize<SapphireCommError>(SapphireCommError::ServerError);
+						ostream.serialize<SapphireUUID>(leveluuid);
+					});
+					break;
+				}
 				auto storeerror = DataStorage->saveLevel(level, this->clientUUID);
+				FinishExpensiveRequest();
 				switch (storeerror) {
 					case SapphireStorageError::SUCCESS: {
 						postConnectionUserLogEvent(connectionIdentifier, clientUUID,
@@ -454,7 +469,7 @@ void ClientConnection::clientReadFunction<CONNECTION_VERSION>() {
 				auto storeerror = DataStorage->queryLevels(details, 64, start, &outcount, clientUUID);
 				switch (storeerror) {
 					case SapphireStorageError::SUCCESS: {
-						write([=](EndianOutputStream<Endianness::Big>& ostream) {
+						writeSerialized([&](EndianOutputStream<Endianness::Big>& ostream) {
 							ostream.serialize<SapphireComm>(SapphireComm::GetLevels);
 							ostream.serialize<SapphireCommError>(SapphireCommError::NoError);
 							ostream.serialize<uint32>(start);
@@ -482,37 +497,27 @@ void ClientConnection::clientReadFunction<CONNECTION_VERSION>() {
 						break;
 					}
 				}
-				if (!registeredLevelChangedListener) {
-					levelChangedListener = SapphireDataStorage::LevelChangedListener::make_listener(
-							[=](unsigned int index, LevelChangeInfo info) {
-								switch (info) {
-									case LevelChangeInfo::REMOVED: {
-										write([=](EndianOutputStream<Endianness::Big>& ostream) {
-													ostream.serialize<SapphireComm>(SapphireComm::LevelRemoved);
-													ostream.serialize<uint32>(index);
-												});
-										break;
-									}
-									case LevelChangeInfo::ADDED:
-									case LevelChangeInfo::RATING_CHANGED: {
-										write([=](EndianOutputStream<Endianness::Big>& ostream) {
-													ostream.serialize<SapphireComm>(SapphireComm::LevelDetailsChanged);
-													ostream.serialize<uint32>(index);
-												});
-										break;
-									}
-									default: {
-										break;
-									}
-								}
-							});
-					auto storeerror = DataStorage->addLevelChangedListener(levelChangedListener);
-					if (storeerror == SapphireStorageError::SUCCESS) {
-						registeredLevelChangedListener = true;
-					} else {
-						levelChangedListener = nullptr;
-					}
+				registerLevelChangedListener();
+				break;
+			}
+			case SapphireComm::SyncLevels: {
+				CHECK_CLIENT_ID();
+				if (clientAppVersion < 11) {
+					//not part of the protocol for older clients
+					postConnectionUserLogEvent(connectionIdentifier, clientUUID, "Abort connection\tUnknown Command");
+					LOGI() << "Unknown cmd: " << cmd;
+					goto exit_loop;
 				}
+
+				SapphireDataStorage::LevelCatalogCursor cursor;
+				if (!stream->deserialize<SapphireUUID>(cursor.epoch) || !stream->deserialize<uint32>(cursor.sequence)) {
+					LOGI()<< "Failed to read level catalog cursor";
+					postConnectionUserLogEvent(connectionIdentifier, clientUUID, "Abort connection\tRead failure\tSyncLevels");
+					goto exit_loop;
+				}
+				//register first, so no changes are missed after the query
+				registerLevelChangedListener();
+				sendLevelCatalogChanges(cursor);
 				break;
 			}
 			case SapphireComm::QuerySingleLevel: {
@@ -565,59 +570,75 @@ void ClientConnection::clientReadFunction<CONNECTION_VERSION>() {
 					postConnectionUserLogEvent(connectionIdentifier, clientUUID, "Abort connection\tRead failure\tDownloadLevel");
 					goto exit_loop;
 				}
-				bool builtinlevel;
-				Level outlevel;
-				auto storeerror = DataStorage->getLevel(uuid, &outlevel, &builtinlevel);
-				switch (storeerror) {
-					case SapphireStorageError::SUCCESS: {
-						if (builtinlevel) {
+				if (!beginLevelDownload(uuid)) {
+					//the response of the request in progress answers this one too
+					LOGI()<< "Level download already in progress: " << uuid.asString();
+					break;
+				}
+				requestWorker.post([=] {
+					bool chunked = false;
+					bool builtinlevel;
+					Level outlevel;
+					auto storeerror = DataStorage->getLevel(uuid, &outlevel, &builtinlevel);
+					switch (storeerror) {
+						case SapphireStorageError::SUCCESS: {
+							if (builtinlevel) {
+								write([=](EndianOutputStream<Endianness::Big>& ostream) {
+									ostream.serialize<SapphireComm>(SapphireComm::DownloadLevel);
+									ostream.serialize<SapphireCommError>(SapphireCommError::NotFound);
+									ostream.serialize<SapphireUUID>(uuid);
+								});
+							} else if (clientAppVersion < outlevel.getLevelVersion()) {
+								postConnectionUserLogEvent(connectionIdentifier, clientUUID,
+										FixedString { "DownloadLevel\tNEWVERSION\t" } + outlevel.getInfo().uuid.asString());
+								write([=](EndianOutputStream<Endianness::Big>& ostream) {
+									ostream.serialize<SapphireComm>(SapphireComm::DownloadLevel);
+									ostream.serialize<SapphireCommError>(SapphireCommError::NewerVersion);
+									ostream.serialize<SapphireUUID>(uuid);
+								});
+							} else {
+								postConnectionUserLogEvent(connectionIdentifier, clientUUID,
+										FixedString { "DownloadLevel\tSUCCESS\t" } + outlevel.getInfo().uuid.asString());
+								if (clientAppVersion >= 9) {
+									chunked = true;
+									writeLevelChunked(uuid, outlevel);
+								} else {
+									writeSerialized([&](EndianOutputStream<Endianness::Big>& ostream) {
+										ostream.serialize<SapphireComm>(SapphireComm::DownloadLevel);
+										ostream.serialize<SapphireCommError>(SapphireCommError::NoError);
+										outlevel.saveLevel(ostream, true, clientAppVersion >= 8);
+									});
+								}
+							}
+							break;
+						}
+						case SapphireStorageError::LEVEL_NOT_FOUND: {
+							postConnectionUserLogEvent(connectionIdentifier, clientUUID,
+									FixedString { "DownloadLevel\tLevelNotFound\t" } + uuid.asString());
 							write([=](EndianOutputStream<Endianness::Big>& ostream) {
 								ostream.serialize<SapphireComm>(SapphireComm::DownloadLevel);
 								ostream.serialize<SapphireCommError>(SapphireCommError::NotFound);
 								ostream.serialize<SapphireUUID>(uuid);
 							});
-						} else if (clientAppVersion < outlevel.getLevelVersion()) {
+							break;
+						}
+						default: {
 							postConnectionUserLogEvent(connectionIdentifier, clientUUID,
-									FixedString { "DownloadLevel\tNEWVERSION\t" } + outlevel.getInfo().uuid.asString());
+									FixedString { "DownloadLevel\tServerError\t" } + uuid.asString());
+							LOGI()<< "Storage error: " << (int) storeerror;
 							write([=](EndianOutputStream<Endianness::Big>& ostream) {
 								ostream.serialize<SapphireComm>(SapphireComm::DownloadLevel);
-								ostream.serialize<SapphireCommError>(SapphireCommError::NewerVersion);
+								ostream.serialize<SapphireCommError>(SapphireCommError::ServerError);
 								ostream.serialize<SapphireUUID>(uuid);
 							});
-						} else {
-							postConnectionUserLogEvent(connectionIdentifier, clientUUID,
-									FixedString { "DownloadLevel\tSUCCESS\t" } + outlevel.getInfo().uuid.asString());
-							write([=](EndianOutputStream<Endianness::Big>& ostream) {
-								ostream.serialize<SapphireComm>(SapphireComm::DownloadLevel);
-								ostream.serialize<SapphireCommError>(SapphireCommError::NoError);
-								outlevel.saveLevel(ostream, true);
-							});
+							break;
 						}
-						break;
 					}
-					case SapphireStorageError::LEVEL_NOT_FOUND: {
-						postConnectionUserLogEvent(connectionIdentifier, clientUUID,
-								FixedString { "DownloadLevel\tLevelNotFound\t" } + uuid.asString());
-						write([=](EndianOutputStream<Endianness::Big>& ostream) {
-							ostream.serialize<SapphireComm>(SapphireComm::DownloadLevel);
-							ostream.serialize<SapphireCommError>(SapphireCommError::NotFound);
-							ostream.serialize<SapphireUUID>(uuid);
-						});
-						break;
+					if (!chunked) {
+						//the response is a single message, a repeated request can't interleave with it
+						finishLevelDownload(uuid);
 					}
-					default: {
-						postConnectionUserLogEvent(connectionIdentifier, clientUUID,
-								FixedString { "DownloadLevel\tServerError\t" } + uuid.asString());
-						LOGI()<< "Storage error: " << (int) storeerror;
-						write([=](EndianOutputStream<Endianness::Big>& ostream) {
-							ostream.serialize<SapphireComm>(SapphireComm::DownloadLevel);
-							ostream.serialize<SapphireCommError>(SapphireCommError::ServerError);
-							ostream.serialize<SapphireUUID>(uuid);
-						});
-						break;
-					}
-				}
-
+				});
 				break;
 			}
 			case SapphireComm::RateLevel: {
@@ -690,9 +711,12 @@ void ClientConnection::clientReadFunction<CONNECTION_VERSION>() {
 					goto exit_loop;
 				}
 				unsigned int inoutstart = start;
-				unsigned int outcount;
-				LocalArray<SapphireDiscussionMessage, 64> messages;
-				auto storeerror = DataStorage->queryMessages(messages, count > 64 ? 64 : count, &inoutstart, &outcount);
+				unsigned int outcount = 0;
+				DiscussionMessageHistory::Snapshot messages;
+				auto storeerror = DataStorage->queryMessages(&messages);
+				if (storeerror == SapphireStorageError::SUCCESS && !messages.query(count > 64 ? 64 : count, &inoutstart, &outcount)) {
+					storeerror = SapphireStorageError::OUT_OF_BOUNDS;
+				}
 				LOGI()<< "Query messages: " << start << " (" << count << ") result: " << inoutstart << " (" << outcount << ")";
 				switch (storeerror) {
 					case SapphireStorageError::OUT_OF_BOUNDS: {
@@ -707,7 +731,7 @@ void ClientConnection::clientReadFunction<CONNECTION_VERSION>() {
 						break;
 					}
 					case SapphireStorageError::SUCCESS: {
-						write([=](EndianOutputStream<Endianness::Big>& ostream) {
+						writeSerialized([&](EndianOutputStream<Endianness::Big>& ostream) {
 							ostream.serialize<SapphireComm>(SapphireComm::QueryMessages);
 							ostream.serialize<SapphireCommError>(SapphireCommError::NoError);
 							ostream.serialize<uint32>(start);
@@ -715,7 +739,7 @@ void ClientConnection::clientReadFunction<CONNECTION_VERSION>() {
 							ostream.serialize<uint32>(inoutstart);
 							ostream.serialize<uint32>(outcount);
 							for (unsigned int i = 0; i < outcount; ++i) {
-								ostream.serialize<SapphireDiscussionMessage>(messages[i]);
+								ostream.serialize<SapphireDiscussionMessage>(messages.get(inoutstart + i).message);
 							}
 						});
 						break;
@@ -854,15 +878,16 @@ void ClientConnection::clientReadFunction<CONNECTION_VERSION>() {
 					if (need) {
 						messagesChangedListener = SapphireDataStorage::MessagesChangedListener::make_listener(
 								[=](unsigned int startindex, unsigned int count) {
-									write([=](EndianOutputStream<Endianness::Big>& ostream) {
-												ostream.serialize<SapphireComm>(SapphireComm::DiscussionMessagesChanged);
-												ostream.serialize<uint32>(startindex);
-												ostream.serialize<uint32>(count);
-											});
+									writeMessagesChanged(startindex, count);
 								});
 						DataStorage->addMessagesChangedListener(messagesChangedListener);
 						MainWorkerThread.post(
 								[=] {
+									if (clientAppVersion >= 10) {
+										presenceSubscribed = true;
+										OnlinePresence->sendSnapshot(*this);
+										return;
+									}
 									userStateListener = UserStateListener::make_listener([=](const ClientConnectionState& conn, UserState state) {
 												if(conn.userName.length() > 0 && (state == UserState::AUTHORIZED || state == UserState::DISCONNECTED)) {
 													writeUserStateChanged(conn, state == UserState::AUTHORIZED);
@@ -883,6 +908,7 @@ void ClientConnection::clientReadFunction<CONNECTION_VERSION>() {
 							messagesChangedListener = nullptr;
 						}
 						MainWorkerThread.post([=] {
+							presenceSubscribed = false;
 							userStateListener = nullptr;
 						});
 					}
@@ -899,7 +925,7 @@ void ClientConnection::clientReadFunction<CONNECTION_VERSION>() {
 				uint32 randomseed;
 				if (!stream->deserialize<SapphireLevelCommProgress>(progress) || !stream->deserialize<uint64>(progressid)
 						|| !stream->deserialize<SapphireUUID>(leveluuid)
-						|| !stream->deserialize<SafeFixedString<SAPPHIRE_DEMO_MAX_LEN>>(steps)
+						|| !stream->deserialize<SafeDemoMoves>(steps)
 						|| !stream->deserialize<uint32>(randomseed)) {
 					LOGI()<< "Failed to read";
 					postConnectionUserLogEvent(connectionIdentifier, clientUUID, "Abort connection\tRead failure\tLevelProgress");
@@ -1169,37 +1195,58 @@ void ClientConnection::clientReadFunction<CONNECTION_VERSION>() {
 					postConnectionUserLogEvent(connectionIdentifier, clientUUID, "Abort connection\tRead failure\tGetPlayerDemo");
 					goto exit_loop;
 				}
-				FixedString steps;
-				uint32 randomseed;
-				auto error = DataStorage->getPlayerDemo(leveluuid, demoid, &steps, &randomseed);
-				switch (error) {
-					case SapphireStorageError::SUCCESS: {
-						write([=](EndianOutputStream<Endianness::Big>& ostream) {
-							ostream.serialize<SapphireComm>(cmd);
-							ostream.serialize<SapphireUUID>(leveluuid);
-							ostream.serialize<PlayerDemoId>(demoid);
-							ostream.serialize<SapphireCommError>(SapphireCommError::NoError);
-							ostream.serialize<uint32>(randomseed);
-							ostream.serialize<FixedString>(steps);
-						});
-						break;
-					}
-					case SapphireStorageError::DEMO_NOT_FOUND: {
-						write([=](EndianOutputStream<Endianness::Big>& ostream) {
-							ostream.serialize<SapphireComm>(cmd);
-							ostream.serialize<SapphireUUID>(leveluuid);
-							ostream.serialize<SapphireCommError>(SapphireCommError::NotFound);
-						});
-						break;
-					}
-					default: {
-						write([=](EndianOutputStream<Endianness::Big>& ostream) {
-							ostream.serialize<SapphireComm>(cmd);
-							ostream.serialize<SapphireUUID>(leveluuid);
-							ostream.serialize<SapphireCommError>(SapphireCommError::ServerError);
-						});
-						break;
+				if (!AdmitExpensiveRequest()) {
+					write([=](EndianOutputStream<Endianness::Big>& ostream) {
+						ostream.serialize<SapphireComm>(cmd);
+						ostream.serialize<SapphireUUID>(leveluuid);
+						ostream.serialize<PlayerDemoId>(demoid);
+						ostream.serialize<SapphireCommError>(SapphireCommError::ServerError);
+					});
+					break;
+				}
+				bool posted = requestWorker.post([=] {
+					FixedString steps;
+					uint32 randomseed;
+					auto error = DataStorage->getPlayerDemo(leveluuid, demoid, &steps, &randomseed);
+					FinishExpensiveRequest();
+					switch (error) {
+						case SapphireStorageError::SUCCESS: {
+							write([=](EndianOutputStream<Endianness::Big>& ostream) {
+								ostream.serialize<SapphireComm>(cmd);
+								ostream.serialize<SapphireUUID>(leveluuid);
+								ostream.serialize<PlayerDemoId>(demoid);
+								ostream.serialize<SapphireCommError>(SapphireCommError::NoError);
+								ostream.serialize<uint32>(randomseed);
+								if (clientAppVersion >= 8) {
+									ostream.serialize<CompactDemoMoves>(steps);
+								} else {
+									ostream.serialize<FixedString>(steps);
+								}
+							}, SAPPHIRE_SERVER_WRITE_SIZE_ESTIMATE + steps.length());
+							break;
+						}
+						case SapphireStorageError::DEMO_NOT_FOUND: {
+							write([=](EndianOutputStream<Endianness::Big>& ostream) {
+								ostream.serialize<SapphireComm>(cmd);
+								ostream.serialize<SapphireUUID>(leveluuid);
+								ostream.serialize<PlayerDemoId>(demoid);
+								ostream.serialize<SapphireCommError>(SapphireCommError::NotFound);
+							});
+							break;
+						}
+						default: {
+							write([=](EndianOutputStream<Endianness::Big>& ostream) {
+								ostream.serialize<SapphireComm>(cmd);
+								ostream.serialize<SapphireUUID>(leveluuid);
+								ostream.serialize<PlayerDemoId>(demoid);
+								ostream.serialize<SapphireCommError>(SapphireCommError::ServerError);
+							});
+							break;
+						}
 					}
+				});
+				if (!posted) {
+					FinishExpensiveRequest();
 				}
 				break;
 			}
@@ -1304,6 +1351,7 @@ void ClientConnection::clientReadFunction<CONNECTION_VERSION>() {
 
 	exit_loop:
 
+	requestWorker.stop();
 	writerWorker.stop();
 	for (auto&& l : hardwareProgressChangedListeners) {
 		if (l->listener != nullptr) {
@@ -37,6 +37,7 @@
 #include <sapphire/sapphireconstants.h>
 #include <sapphireserver/storage/local/LocalSapphireDataStorage.h>
 #include <sapphireserver/client/ClientConnection.h>
+#include <sapphireserver/client/PresenceService.h>
 #include <sapphire/level/SapphireUUID.h>
 
 #include <sapphireserver/servermain.h>
@@ -73,6 +74,8 @@ static bool MaintenanceMode = false;
 static bool MaintenanceQueued = false;
 static Mutex MaintenanceMutex { Mutex::auto_init { } };
 static unsigned int SuggestedUpgradeVersion = 2;
+static unsigned int ExpensiveRequestCount = 0;
+static Mutex ExpensiveRequestMutex { Mutex::auto_init { } };
 
 bool IsMaintenanceMode() {
 	MutexLocker locker { MaintenanceMutex };
@@ -90,6 +93,19 @@ unsigned int GetSuggestedUpgradeVersion() {
 	MutexLocker locker { MaintenanceMutex };
 	return SuggestedUpgradeVersion;
 }
+bool AdmitExpensiveRequest() {
+	MutexLocker locker { ExpensiveRequestMutex };
+	if (ExpensiveRequestCount >= SAPPHIRE_SERVER_EXPENSIVE_REQUEST_LIMIT) {
+		return false;
+	}
+	++ExpensiveRequestCount;
+	return true;
+}
+void FinishExpensiveRequest() {
+	MutexLocker locker { ExpensiveRequestMutex };
+	ASSERT(ExpensiveRequestCount > 0);
+	--ExpensiveRequestCount;
+}
 static void SetSuggestedUpgradeVersion(unsigned int version) {
 	{
 		MutexLocker locker { MaintenanceMutex };
@@ -706,6 +722,57 @@ static void startPingerThread() {
 	});
 }
 
+static void startLevelChangesThread() {
+	Thread t;
+	t.start([] {
+		LOGI() << "Start level changes thread";
+		Semaphore sem {Semaphore::auto_init {}};
+		while(true) {
+			Thread::sleep(SAPPHIRE_LEVEL_CHANGES_BATCH_MILLIS);
+			bool exitthread = false;
+			MainWorkerThread.post([&] () {
+						exitthread = AcceptorSocket == nullptr;
+						if(!exitthread) {
+							for (auto&& c : ClientConnections.objects()) {
+								c.sendPendingLevelChanges();
+							}
+						}
+						sem.post();
+					});
+			sem.wait();
+			if(exitthread) {
+				break;
+			}
+		}
+		LOGI() << "Exit level changes thread";
+		return 0;
+	});
+}
+static void startPresenceThread() {
+	Thread t;
+	t.start([] {
+		LOGI() << "Start presence thread";
+		Semaphore sem {Semaphore::auto_init {}};
+		while(true) {
+			Thread::sleep(SAPPHIRE_PRESENCE_BATCH_MILLIS);
+			bool exitthread = false;
+			MainWorkerThread.post([&] () {
+						exitthread = AcceptorSocket == nullptr;
+						if(!exitthread) {
+							OnlinePresence->sendChanges();
+						}
+						sem.post();
+					});
+			sem.wait();
+			if(exitthread) {
+				break;
+			}
+		}
+		LOGI() << "Exit presence thread";
+		return 0;
+	});
+}
+
 #if defined(RHFW_PLATFORM_WIN32)
 static BOOL WINAPI CtrlHandler(DWORD fdwCtrlType) {
 	postServerLogEvent("Signal handler shutdown");
@@ -749,6 +816,8 @@ static void installSignalHandlers() {
 	signal(SIGINT, signal_handler_INT);
 	signal(SIGTERM, signal_handler_TERM);
 	signal(SIGHUP, signal_handler_HUP);
+	//writing to a connection that was shut down or reset by the client returns an error instead
+	signal(SIGPIPE, SIG_IGN);
 }
 #else
 static_assert(false, "Unknown platform");
@@ -778,6 +847,9 @@ int main(int argc, char* argv[]) {
 		MainRandomContext.load();
 		MainRandomer = MainRandomContext->createRandomer();
 		DataStorage = new LocalSapphireDataStorage();
+		MainWorkerThread.post([] {
+			OnlinePresence = new PresenceService();
+		});
 
 		postServerLogEvent("Storage ready");
 
@@ -794,6 +866,8 @@ int main(int argc, char* argv[]) {
 
 		startControlThread();
 		startPingerThread();
+		startLevelChangesThread();
+		startPresenceThread();
 
 		postServerLogEvent("Threads started");
 
@@ -843,6 +917,7 @@ int main(int argc, char* argv[]) {
 		MainWorkerThread.stop();
 
 		LOGV() << "Worker thread stopped";
+		delete OnlinePresence;
 		delete MainRandomer;
 		MainRandomContext.free();
 		MainRandomContext = nullptr;
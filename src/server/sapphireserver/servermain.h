@@ -57,6 +57,14 @@ bool IsMaintenanceConnectionDisabled();
 void MaintenanceOpportunity();
 unsigned int GetSuggestedUpgradeVersion();
 
+/**
+ * Admission control for the expensive requests over all connections.
+ * Returns false if SAPPHIRE_SERVER_EXPENSIVE_REQUEST_LIMIT requests are already in progress, and the request should be refused.
+ * Every admitted request must be finished with FinishExpensiveRequest().
+ */
+bool AdmitExpensiveRequest();
+void FinishExpensiveRequest();
+
 extern SapphireDataStorage* DataStorage;
 extern LinkedList<ClientConnection, false> ClientConnections;
 
@@ -0,0 +1,161 @@
+/*
+ * Copyright (C) 2020 Bence Sipka
+ *
+ * This program is free software: you can redistribute it and/or modify 
+ * it under the terms of the GNU General Public License as published by 
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/*
+ * DiscussionMessageHistory.cpp
+ *
+ *  Created on: 2026. okt. 19.
+ *      Author: sipka
+ */
+
+#include <sapphireserver/storage/DiscussionMessageHistory.h>
+
+#include <gen/log.h>
+
+namespace userapp {
+
+DiscussionMessageHistory::Segment::~Segment() {
+	for (unsigned int i = 0; i < count; ++i) {
+		delete records[i];
+	}
+}
+DiscussionMessageHistory::SnapshotData::~SnapshotData() {
+	for (unsigned int i = 0; i < segmentCount; ++i) {
+		release(segments[i]);
+	}
+	delete[] segments;
+}
+
+bool DiscussionMessageHistory::Snapshot::query(unsigned int maxcount, unsigned int* inoutstart, unsigned int* outcount) const {
+	unsigned int startindex = getStartIndex();
+	unsigned int count = getCount();
+	if (maxcount == 0 || *inoutstart >= startindex + count) {
+		*inoutstart = startindex;
+		*outcount = count;
+		return false;
+	}
+	if (*inoutstart < startindex) {
+		unsigned int diff = startindex - *inoutstart;
+		if (diff >= maxcount) {
+			*inoutstart = startindex;
+			*outcount = count;
+			return false;
+		}
+		*inoutstart += diff;
+		maxcount -= diff;
+	}
+	unsigned int available = startindex + count - *inoutstart;
+	*outcount = available < maxcount ? available : maxcount;
+	return true;
+}
+
+DiscussionMessageHistory::DiscussionMessageHistory(unsigned int capacity)
+		: capacity(capacity), maxSegments(capacity / SEGMENT_SIZE + 2), current(new SnapshotData(maxSegments)) {
+	ASSERT(capacity > 0);
+}
+DiscussionMessageHistory::~DiscussionMessageHistory() {
+	release(current);
+}
+
+DiscussionMessageHistory::Snapshot DiscussionMessageHistory::snapshot() {
+	MutexLocker lock { currentMutex };
+	current->references.fetch_add(1);
+	return Snapshot { current };
+}
+
+DiscussionMessageHistory::SnapshotData* DiscussionMessageHistory::copyCurrent() {
+	//only the writer modifies current, no need to lock currentMutex
+	SnapshotData* result = new SnapshotData(maxSegments);
+	result->segmentCount = current->segmentCount;
+	result->firstOffset = current->firstOffset;
+	result->count = current->count;
+	result->startIndex = current->startIndex;
+	for (unsigned int i = 0; i < current->segmentCount; ++i) {
+		Segment* seg = current->segments[i];
+		seg->references.fetch_add(1);
+		result->segments[i] = seg;
+	}
+	return result;
+}
+void DiscussionMessageHistory::publish(SnapshotData* data) {
+	SnapshotData* prev;
+	{
+		MutexLocker lock { currentMutex };
+		prev = current;
+		current = data;
+	}
+	release(prev);
+}
+
+void DiscussionMessageHistory::append(DiscussionMessageRecord* record, unsigned int* outstartindex, unsigned int* outcount) {
+	MutexLocker lock { writeMutex };
+	SnapshotData* next = copyCurrent();
+	Segment* tail = next->segmentCount == 0 ? nullptr : next->segments[next->segmentCount - 1];
+	if (tail == nullptr || tail->count == SEGMENT_SIZE) {
+		tail = new Segment();
+		next->segments[next->segmentCount++] = tail;
+	}
+	//the slot is past the count of every published snapshot
+	tail->records[tail->count++] = record;
+	++next->count;
+	if (next->count > capacity) {
+		--next->count;
+		++next->startIndex;
+		if (++next->firstOffset == SEGMENT_SIZE) {
+			release(next->segments[0]);
+			for (unsigned int i = 1; i < next->segmentCount; ++i) {
+				next->segments[i - 1] = next->segments[i];
+			}
+			--next->segmentCount;
+			next->firstOffset = 0;
+		}
+	}
+	*outstartindex = next->startIndex;
+	*outcount = next->count;
+	publish(next);
+}
+
+void DiscussionMessageHistory::updateUser(const SapphireUUID& useruuid, const FixedString& name, SapphireDifficulty difficultycolor) {
+	MutexLocker lock { writeMutex };
+	Snapshot prev { current };
+	current->references.fetch_add(1);
+
+	bool found = false;
+	for (unsigned int i = 0; i < prev.getCount() && !found; ++i) {
+		found = prev.get(prev.getStartIndex() + i).userUUID == useruuid;
+	}
+	if (!found) {
+		return;
+	}
+	SnapshotData* next = new SnapshotData(maxSegments);
+	next->startIndex = prev.getStartIndex();
+	next->count = prev.getCount();
+	for (unsigned int i = 0; i < prev.getCount(); ++i) {
+		auto&& rec = prev.get(prev.getStartIndex() + i);
+		DiscussionMessageRecord* copy = new DiscussionMessageRecord(rec);
+		if (copy->userUUID == useruuid) {
+			copy->message.userName = name;
+			copy->message.difficultyColor = difficultycolor;
+		}
+		if (i % SEGMENT_SIZE == 0) {
+			next->segments[next->segmentCount++] = new Segment();
+		}
+		Segment* tail = next->segments[next->segmentCount - 1];
+		tail->records[tail->count++] = copy;
+	}
+	publish(next);
+}
+
+}  // namespace userapp
@@ -0,0 +1,198 @@
+/*
+ * Copyright (C) 2020 Bence Sipka
+ *
+ * This program is free software: you can redistribute it and/or modify 
+ * it under the terms of the GNU General Public License as published by 
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/*
+ * DiscussionMessageHistory.h
+ *
+ *  Created on: 2026. okt. 19.
+ *      Author: sipka
+ */
+
+#ifndef SAPPHIRESERVER_STORAGE_DISCUSSIONMESSAGEHISTORY_H_
+#define SAPPHIRESERVER_STORAGE_DISCUSSIONMESSAGEHISTORY_H_
+
+#include <framework/threading/Mutex.h>
+#include <framework/utils/FixedString.h>
+
+#include <sapphire/community/SapphireDiscussionMessage.h>
+#include <sapphire/level/SapphireUUID.h>
+
+#include <gen/fwd/types.h>
+
+#include <atomic>
+
+namespace userapp {
+using namespace rhfw;
+
+/**
+ * Immutable discussion message, with the author information already resolved.
+ */
+class DiscussionMessageRecord {
+public:
+	SapphireUUID userUUID;
+	SapphireDiscussionMessage message;
+
+	DiscussionMessageRecord(const SapphireUUID& useruuid, const SapphireDiscussionMessage& message)
+			: userUUID(useruuid), message(message) {
+	}
+};
+
+/**
+ * Fixed capacity ring of the latest discussion messages.
+ *
+ * The records are stored in reference counted segments, which are only appended to. Appending a message publishes
+ * a new snapshot sharing the segments with the previous ones, so readers can keep and read a snapshot without locking.
+ * The lock in snapshot() is only held while the reference to the current snapshot is taken.
+ */
+class DiscussionMessageHistory {
+public:
+	static const unsigned int SEGMENT_SIZE = 256;
+private:
+	class Segment {
+	public:
+		std::atomic<unsigned int> references { 1 };
+		DiscussionMessageRecord* records[SEGMENT_SIZE];
+		/**
+		 * Only modified by the writer, the snapshots see the records up to their own count.
+		 */
+		unsigned int count = 0;
+
+		~Segment();
+	};
+	class SnapshotData {
+	public:
+		std::atomic<unsigned int> references { 1 };
+		Segment** segments;
+		unsigned int segmentCount = 0;
+		/**
+		 * Position of the oldest message in the first segment.
+		 */
+		unsigned int firstOffset = 0;
+		unsigned int count = 0;
+		unsigned int startIndex = 0;
+
+		SnapshotData(unsigned int maxsegments)
+				: segments(new Segment*[maxsegments]) {
+		}
+		~SnapshotData();
+	};
+
+	static void release(Segment* segment) {
+		if (segment->references.fetch_sub(1) == 1) {
+			delete segment;
+		}
+	}
+	static void release(SnapshotData* data) {
+		if (data != nullptr && data->references.fetch_sub(1) == 1) {
+			delete data;
+		}
+	}
+public:
+	class Snapshot {
+		friend class DiscussionMessageHistory;
+
+		SnapshotData* data = nullptr;
+
+		explicit Snapshot(SnapshotData* data)
+				: data(data) {
+		}
+	public:
+		Snapshot() {
+		}
+		Snapshot(const Snapshot& o)
+				: data(o.data) {
+			if (data != nullptr) {
+				data->references.fetch_add(1);
+			}
+		}
+		Snapshot(Snapshot&& o)
+				: data(o.data) {
+			o.data = nullptr;
+		}
+		Snapshot& operator=(const Snapshot& o) {
+			if (o.data != nullptr) {
+				o.data->references.fetch_add(1);
+			}
+			release(data);
+			data = o.data;
+			return *this;
+		}
+		Snapshot& operator=(Snapshot&& o) {
+			SnapshotData* prev = data;
+			data = o.data;
+			o.data = nullptr;
+			release(prev);
+			return *this;
+		}
+		~Snapshot() {
+			release(data);
+		}
+
+		unsigned int getStartIndex() const {
+			return data == nullptr ? 0 : data->startIndex;
+		}
+		unsigned int getCount() const {
+			return data == nullptr ? 0 : data->count;
+		}
+		/**
+		 * The index is absolute, from getStartIndex() to getStartIndex() + getCount().
+		 */
+		const DiscussionMessageRecord& get(unsigned int index) const {
+			unsigned int pos = data->firstOffset + (index - data->startIndex);
+			return *data->segments[pos / SEGMENT_SIZE]->records[pos % SEGMENT_SIZE];
+		}
+
+		/**
+		 * Determines the range of at most maxcount messages starting from inoutstart.
+		 * If the range is out of bounds, the start index and count of the whole snapshot is returned, with false.
+		 */
+		bool query(unsigned int maxcount, unsigned int* inoutstart, unsigned int* outcount) const;
+	};
+private:
+	const unsigned int capacity;
+	const unsigned int maxSegments;
+
+	Mutex currentMutex { Mutex::auto_init { } };
+	SnapshotData* current;
+	/**
+	 * Serializes the writers.
+	 */
+	Mutex writeMutex { Mutex::auto_init { } };
+
+	SnapshotData* copyCurrent();
+	void publish(SnapshotData* data);
+public:
+	DiscussionMessageHistory(unsigned int capacity);
+	DiscussionMessageHistory(const DiscussionMessageHistory&) = delete;
+	DiscussionMessageHistory& operator=(const DiscussionMessageHistory&) = delete;
+	~DiscussionMessageHistory();
+
+	Snapshot snapshot();
+
+	/**
+	 * Appends the record and takes ownership of it. The oldest message is dropped if the capacity is exceeded.
+	 * The start index and count after appending is stored in the out arguments.
+	 */
+	void append(DiscussionMessageRecord* record, unsigned int* outstartindex, unsigned int* outcount);
+	/**
+	 * Replaces the author information in the messages of the user.
+	 * It copies all the records, but it is only needed when a user changes name or colour.
+	 */
+	void updateUser(const SapphireUUID& useruuid, const FixedString& name, SapphireDifficulty difficultycolor);
+};
+
+}  // namespace userapp
+
+#endif /* SAPPHIRESERVER_STORAGE_DISCUSSIONMESSAGEHISTORY_H_ */
@@ -26,6 +26,8 @@
 #include <framework/utils/BasicListener.h>
 #include <framework/utils/ArrayList.h>
 #include <sapphire/common/commontypes.h>
+#include <sapphire/level/SapphireUUID.h>
+#include <sapphireserver/storage/DiscussionMessageHistory.h>
 #include <gen/fwd/types.h>
 
 namespace userapp {
@@ -115,9 +117,23 @@ public:
 		PlayerDemoId demoId;
 	};
 	/**
-	 * Param: Index of the level changed
+	 * Position in the sequence of level catalog changes.
 	 */
-	using LevelChangedListener = SimpleListener<void(unsigned int, LevelChangeInfo)>;
+	class LevelCatalogCursor {
+	public:
+		/**
+		 * Identifies the change sequence. Cursors with different epochs cannot be compared.
+		 */
+		SapphireUUID epoch;
+		uint32 sequence = 0;
+	};
+	/**
+	 * Params:
+	 * unsigned int: index of the level changed, at the time of the change
+	 * SapphireUUID: uuid of the level changed
+	 * LevelChangeInfo: the kind of change
+	 */
+	using LevelChangedListener = SimpleListener<void(unsigned int, const SapphireUUID&, LevelChangeInfo)>;
 	/**
 	 * Params:
 	 * unsigned int: start index of messages queriable
@@ -147,8 +163,22 @@ public:
 
 	virtual SapphireStorageError queryLevels(SapphireLevelDetails* details, unsigned int maxcount, unsigned int start,
 			unsigned int *outcount, const SapphireUUID& user) = 0;
-	virtual SapphireStorageError queryMessages(SapphireDiscussionMessage* messages, unsigned int maxcount, unsigned int* inoutstart,
-			unsigned int* outcount) = 0;
+	/**
+	 * Queries the details and the current index of a single level.
+	 */
+	virtual SapphireStorageError queryLevel(const SapphireUUID& leveluuid, SapphireLevelDetails* outdetails, unsigned int* outindex,
+			const SapphireUUID& user) = 0;
+	/**
+	 * Queries the levels changed since the given cursor, and updates the cursor to the current state.
+	 * The changed levels are in catalog order, the added levels are always at the end of the catalog.
+	 * If the changes cannot be determined since the cursor, all levels are returned, and outreset is set to true.
+	 */
+	virtual SapphireStorageError queryLevelChanges(const SapphireUUID& user, LevelCatalogCursor* inoutcursor, bool* outreset,
+			ArrayList<SapphireUUID>* outremoved, ArrayList<SapphireLevelDetails>* outchanged, unsigned int* outtotalcount) = 0;
+	/**
+	 * Takes a snapshot of the latest discussion messages. The snapshot can be read without locking while it is held.
+	 */
+	virtual SapphireStorageError queryMessages(DiscussionMessageHistory::Snapshot* outsnapshot) = 0;
 	virtual SapphireStorageError queryAssociatedHardwares(const SapphireUUID& hardwareuuid, ArrayList<AssociatedHardware>& outids) = 0;
 	virtual SapphireStorageError queryLevelProgress(ProgressSynchId* progressid, const SapphireUUID& hardware, SapphireUUID* outlevel,
 			SapphireLevelProgress* outprogress) = 0;
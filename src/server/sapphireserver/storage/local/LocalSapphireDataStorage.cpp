@@ -22,6 +22,7 @@
 
 #include <sapphireserver/storage/local/LocalSapphireDataStorage.h>
 #include <sapphire/level/SapphireLevelDescriptor.h>
+#include <sapphire/level/DemoMoveEncoding.h>
 #include <sapphire/server/SapphireLevelDetails.h>
 #include <sapphire/community/SapphireDiscussionMessage.h>
 #include <sapphire/common/FantasyNames.h>
@@ -139,12 +140,16 @@ void LocalSapphireDataStorage::StorageSapphireLevelDescriptor::initDate(FileDesc
 	}
 }
 
-LocalSapphireDataStorage::LocalSapphireDataStorage() {
+LocalSapphireDataStorage::LocalSapphireDataStorage()
+		: messageHistory(MAX_MESSAGE_CACHE_SIZE) {
 	usersDirectory.create();
 	levelsDirectory.create();
 	messagesDirectory.create();
 	hardwareDirectory.create();
 	demosDirectory.create();
+	databaseDirectory.create();
+
+	getRandomer()->read(levelCatalogEpoch.getData(), SapphireUUID::UUID_LENGTH);
 
 	unsigned int count = 0;
 
@@ -171,47 +176,23 @@ LocalSapphireDataStorage::LocalSapphireDataStorage() {
 	}
 	postLogEvent(FixedString { "Total community levels: " } + FixedString::toString(count));
 
-	postLogEvent("Loading users...");
-	auto&& userspath = usersDirectory.getPath();
-	for (auto&& dir : usersDirectory.enumerate()) {
-		if(!dir.isDirectory()){
-			continue;
-		}
-		StorageSapphireUser* user = new StorageSapphireUser();
-		StorageDirectoryDescriptor userdir { userspath + dir };
-		if (!loadUser(userdir, user)) {
-			postLogEvent("Failed to load user.");
-			delete user;
-		} else {
-			users.setSorted(user, StorageSapphireUser::compare);
-		}
-		if ((++count % 1000) == 0) {
-			postLogEvent(FixedString { "Loaded users: " } + FixedString::toString(count));
-		}
-	}
-	postLogEvent(FixedString { "Total loaded users: " } + FixedString::toString(count));
-
-	postLogEvent("Loading hardwares...");
-	count = 0;
-	auto&& hardwarepath = hardwareDirectory.getPath();
-	for (auto&& dir : hardwareDirectory.enumerate()) {
-		if (!dir.isDirectory()) {
-			continue;
-		}
-		StorageUserHardware* hardware = new StorageUserHardware();
-		if (!SapphireUUID::fromString(&hardware->hardwareUUID, ((FilePath) dir).getURI())) {
-			delete hardware;
-			continue;
+	{
+		LevelLoadLookup levellookup { descriptors };
+		if (!loadDatabase(levellookup)) {
+			//don't start with a partial state, the table or the journals would be overwritten by it
+			postLogEvent("Failed to load database, refusing to start.");
+			THROW() << "Failed to load database";
 		}
-		hardware->loadProgress(hardwarepath + dir);
-
-		hardwares.setSorted(hardware, StorageUserHardware::compare);
-
-		if ((++count % 1000) == 0) {
-			postLogEvent(FixedString { "Loaded hardwares: " } + FixedString::toString(count));
+		postLogEvent(FixedString { "Total loaded users: " } + FixedString::toString(users.size()));
+		postLogEvent(FixedString { "Total loaded hardwares: " } + FixedString::toString(hardwares.size()));
+		finishLevelCatalogLoading();
+		if (databaseTableOutdated || journalRecordCount > 0) {
+			postLogEvent("Writing database table...");
+			if (!writeDatabase()) {
+				postLogEvent("Failed to write database table.");
+			}
 		}
 	}
-	postLogEvent(FixedString { "Total loaded hardwares: " } + FixedString::toString(count));
 
 	postLogEvent("Loading builtin level demos to statistics and leaderboards...");
 	count = 0;
@@ -317,14 +298,29 @@ LocalSapphireDataStorage::LocalSapphireDataStorage() {
 		messagesFileIndex = 0;
 		currentMessagesFileMessageCount = 0;
 	}
+	for (auto&& msg : loadedMessages) {
+		SapphireDiscussionMessage dm;
+		dm.userName = msg->user->name;
+		dm.difficultyColor = msg->user->difficultyColor;
+		dm.message = util::move(msg->message);
+		unsigned int startindex;
+		unsigned int count;
+		messageHistory.append(new DiscussionMessageRecord(msg->user->uuid, dm), &startindex, &count);
+	}
+	loadedMessages.clear();
 	postLogEvent(FixedString { "Current messages file index: " } + FixedString::toString(messagesFileIndex) + " count: " + FixedString::toString(currentMessagesFileMessageCount));
 
 	postLogEvent("Loading done.");
 
 	messageWriterThread.start();
+	databaseWriterThread.start();
 }
 LocalSapphireDataStorage::~LocalSapphireDataStorage() {
 	messageWriterThread.stop();
+	databaseWriterThread.stop();
+	if (journalRecordCount > 0) {
+		writeDatabase();
+	}
 	delete uuidRandomer;
 }
 void LocalSapphireDataStorage::initLevelData(const Level& level) {
@@ -355,7 +351,7 @@ void LocalSapphireDataStorage::initLevelData(const Level& level) {
 		for (;;++democount) {
 			pos = istream.getPosition();
 			if (!istream.deserialize<SapphireUUID>(userid)
-					|| !istream.deserialize<uint32>(randomseed) || !istream.deserialize<FixedString>(steps)) {
+					|| !istream.deserialize<uint32>(randomseed) || !istream.deserialize<SafeDemoMoves>(steps)) {
 				//end of stream probably
 				if (size != pos) {
 					postLogEvent(FixedString { "Failed to deserialize demo data: " } + uuid.asString() + " at demo index: " + FixedString::toString(democount) + " file pos: " + FixedString::toString(pos) + " file size: " + FixedString::toString(size));
@@ -483,7 +479,7 @@ unsigned int LocalSapphireDataStorage::readMessagesFile1(unsigned int index, boo
 		}
 
 		auto* msg = new StorageDiscussionMessage { founduser, util::move(message) };
-		messages.add(msg);
+		loadedMessages.add(msg);
 		++result;
 
 		if (founduser->name == nullptr || founduser->difficultyColor < diffcolor) {
@@ -522,7 +518,7 @@ unsigned int LocalSapphireDataStorage::readMessagesFile2(unsigned int index, boo
 		}
 
 		auto* msg = new StorageDiscussionMessage { founduser, util::move(message) };
-		messages.add(msg);
+		loadedMessages.add(msg);
 		++result;
 	}
 	return result;
@@ -545,24 +541,72 @@ SapphireStorageError LocalSapphireDataStorage::queryLevels(SapphireLevelDetails*
 
 	MutexLocker ul = usersLockPool.locker(user);
 	for (unsigned int i = start; i < descriptors.size() && *outcount < maxcount; ++i, ++(*outcount)) {
-		auto& det = *details++;
-		auto& d = descriptors[i];
+		fillLevelDetailsLocked(*details++, descriptors[i], storeuser);
+	}
+	return SapphireStorageError::SUCCESS;
+}
+SapphireStorageError LocalSapphireDataStorage::queryLevel(const SapphireUUID& leveluuid, SapphireLevelDetails* outdetails,
+		unsigned int* outindex, const SapphireUUID& user) {
+	auto* storeuser = findUser(user);
+	if (storeuser == nullptr) {
+		return SapphireStorageError::INVALID_USER_UUID;
+	}
+	MutexLocker l { levelsMutex };
+	int index = findLevelIndexLocked(leveluuid);
+	if (index < 0) {
+		return SapphireStorageError::LEVEL_NOT_FOUND;
+	}
+	MutexLocker ul = usersLockPool.locker(user);
+	fillLevelDetailsLocked(*outdetails, descriptors[index], storeuser);
+	*outindex = index;
+	return SapphireStorageError::SUCCESS;
+}
+SapphireStorageError LocalSapphireDataStorage::queryLevelChanges(const SapphireUUID& user, LevelCatalogCursor* inoutcursor, bool* outreset,
+		ArrayList<SapphireUUID>* outremoved, ArrayList<SapphireLevelDetails>* outchanged, unsigned int* outtotalcount) {
+	auto* storeuser = findUser(user);
+	if (storeuser == nullptr) {
+		return SapphireStorageError::INVALID_USER_UUID;
+	}
+	MutexLocker l { levelsMutex };
+	uint32 since = inoutcursor->sequence;
+	bool reset = inoutcursor->epoch != levelCatalogEpoch || since > levelCatalogSequence || since < removedLevelsMinSequence;
+	if (!reset) {
+		for (auto* r : removedLevels) {
+			if (r->catalogSequence > since) {
+				outremoved->add(new SapphireUUID(r->levelUUID));
+			}
+		}
+	}
 
-		det = d;
+	MutexLocker ul = usersLockPool.locker(user);
+	for (auto* d : descriptors) {
+		if (reset || d->catalogSequence > since) {
+			auto* det = new SapphireLevelDetails();
+			fillLevelDetailsLocked(*det, *d, storeuser);
+			outchanged->add(det);
+		}
+	}
+	*outreset = reset;
+	*outtotalcount = descriptors.size();
+	inoutcursor->epoch = levelCatalogEpoch;
+	inoutcursor->sequence = levelCatalogSequence;
+	return SapphireStorageError::SUCCESS;
+}
+void LocalSapphireDataStorage::fillLevelDetailsLocked(SapphireLevelDetails& det, const StorageSapphireLevelDescriptor& d,
+		StorageSapphireUser* user) {
+	det = d;
 
-		det.dateYear = d.dateYear;
-		det.dateMonth = d.dateMonth;
-		det.dateDay = d.dateDay;
+	det.dateYear = d.dateYear;
+	det.dateMonth = d.dateMonth;
+	det.dateDay = d.dateDay;
 
-		det.ratingSum = d.ratingSum;
-		det.ratingCount = d.ratingCount;
+	det.ratingSum = d.ratingSum;
+	det.ratingCount = d.ratingCount;
 
-		auto* rating = storeuser->findRating(d.uuid);
-		if (rating != nullptr) {
-			det.userRating = rating->rating;
-		}
+	auto* rating = user->findRating(d.uuid);
+	if (rating != nullptr) {
+		det.userRating = rating->rating;
 	}
-	return SapphireStorageError::SUCCESS;
 }
 SapphireStorageError LocalSapphireDataStorage::appendMessage(const SapphireUUID& userid, const char* message) {
 	if (message == nullptr) {
@@ -577,14 +621,16 @@ SapphireStorageError LocalSapphireDataStorage::appendMessage(const SapphireUUID&
 	if (msgstr.length() > SAPPHIRE_DISCUSSION_MESSAGE_MAX_LEN) {
 		return SapphireStorageError::OUT_OF_BOUNDS;
 	}
-	auto* msg = new StorageDiscussionMessage { user, message };
+	unsigned int startindex;
+	unsigned int count;
 	{
-		MutexLocker lock { messagesMutex };
-		messages.add(msg);
-		if (messages.size() > MAX_MESSAGE_CACHE_SIZE) {
-			delete messages.remove(0);
-			++messagesStartIndex;
-		}
+		//resolve the author under the user lock, so a concurrent rename updates this message as well
+		MutexLocker ml = usersLockPool.locker(user->uuid);
+		SapphireDiscussionMessage dm;
+		dm.userName = user->name;
+		dm.difficultyColor = user->difficultyColor;
+		dm.message = msgstr;
+		messageHistory.append(new DiscussionMessageRecord(user->uuid, dm), &startindex, &count);
 	}
 	messageWriterThread.post([=] {
 		LOGTRACE() << "Serialize message: " << msgstr << " current msg file message count: " << currentMessagesFileMessageCount;
@@ -605,43 +651,12 @@ SapphireStorageError LocalSapphireDataStorage::appendMessage(const SapphireUUID&
 		ostream.serialize<FixedString>(msgstr);
 
 	});
-	broadcastListenerEvents(messagesChangedEvents, messagesChangedListenersMutex, messagesStartIndex, messages.size());
+	broadcastListenerEvents(messagesChangedEvents, messagesChangedListenersMutex, startindex, count);
 
 	return SapphireStorageError::SUCCESS;
 }
-SapphireStorageError LocalSapphireDataStorage::queryMessages(SapphireDiscussionMessage* messages, unsigned int maxcount,
-		unsigned int* start, unsigned int* outcount) {
-	MutexLocker lock { messagesMutex };
-
-	if (maxcount == 0 || *start >= messagesStartIndex + this->messages.size()) {
-		*start = messagesStartIndex;
-		*outcount = this->messages.size();
-		return SapphireStorageError::OUT_OF_BOUNDS;
-	}
-
-	*outcount = 0;
-	if (*start < messagesStartIndex) {
-		unsigned int diff = messagesStartIndex - *start;
-		if (diff >= maxcount) {
-			*start = messagesStartIndex;
-			*outcount = this->messages.size();
-			return SapphireStorageError::OUT_OF_BOUNDS;
-		}
-		*start += diff;
-		maxcount -= diff;
-	}
-	if (maxcount == 0) {
-		return SapphireStorageError::SUCCESS;
-	}
-	for (unsigned int i = *start; i < this->messages.size() && *outcount < maxcount; ++i, ++(*outcount)) {
-		auto& msg = this->messages[i];
-		auto& target = *messages++;
-
-		target.message = msg.message;
-		MutexLocker ml = usersLockPool.locker(msg.user->uuid);
-		target.userName = msg.user->name;
-		target.difficultyColor = msg.user->difficultyColor;
-	}
+SapphireStorageError LocalSapphireDataStorage::queryMessages(DiscussionMessageHistory::Snapshot* outsnapshot) {
+	*outsnapshot = messageHistory.snapshot();
 	return SapphireStorageError::SUCCESS;
 }
 void LocalSapphireDataStorage::queryAssociatedHardwaresLocked(StorageUserHardware& hardware, ArrayList<AssociatedHardware>& outids) {
@@ -704,13 +719,13 @@ SapphireStorageError LocalSapphireDataStorage::createHardwareAssociation(const S
 		addHardwareAssociationLocked(*ahh, *toadd, othergroup);
 	}
 	addHardwareAssociationLocked(*h, *toadd, othergroup);
-	toadd->saveAssociatedHardwares(hardwareDirectory.getPath() + (const char*) toadd->hardwareUUID.asString());
+	journalHardwareAssociations(*toadd);
 	for (auto&& gh : othergroup) {
 		auto* found = findHardwareLocked(gh->hardwareUUID);
 		ASSERT(found != nullptr) << gh->hardwareUUID.asString();
 		MutexLocker fml = hardwaresLockPool.locker(found->hardwareUUID);
 
-		found->saveAssociatedHardwares(hardwareDirectory.getPath() + (const char*) found->hardwareUUID.asString());
+		journalHardwareAssociations(*found);
 	}
 	return SapphireStorageError::SUCCESS;
 }
@@ -743,7 +758,7 @@ SapphireStorageError LocalSapphireDataStorage::addHardwareAssociationLocked(Stor
 
 		broadcastListenerEventsNoMutex(hardwareAssociationEvents, *a1, *a2, true);
 	}
-	hardware1.saveAssociatedHardwares(hardwareDirectory.getPath() + (const char*) hardware1.hardwareUUID.asString());
+	journalHardwareAssociations(hardware1);
 	return SapphireStorageError::SUCCESS;
 }
 
@@ -809,20 +824,22 @@ SapphireStorageError LocalSapphireDataStorage::saveLevel(const Level& levelarg,
 			desc = new StorageSapphireLevelDescriptor(level);
 			desc->setFileDescriptor(new StorageFileDescriptor(levelsDirectory.getPath() + (const char*) desc->uuid.asString()));
 			desc->serverSideAvailable = true;
+			desc->catalogSequence = ++levelCatalogSequence;
 			index = descriptors.size();
 			descriptors.add(desc);
+			journalLevelCatalog(DatabaseJournalRecord::LEVEL_ADDED, desc->uuid, desc->catalogSequence);
 		}
 
-		level.saveLevel(desc->getFileDescriptor());
+		level.saveLevel(desc->getFileDescriptor(), false, true);
 		desc->initDate(desc->getFileDescriptor());
 	}
 	{
 		MutexLocker ul = usersLockPool.locker(user->uuid);
 		user->uploadedLevels.setSorted(new SapphireUUID(desc->uuid), compareUUIDPtrs);
-		user->saveUploadedLevels(usersDirectory.getPath() + (const char*) user->uuid.asString());
+		journalUserUploadedLevel(user->uuid, desc->uuid);
 	}
 
-	broadcastListenerEvents(levelChangedEvents, levelChangedListenersMutex, index, LevelChangeInfo::ADDED);
+	broadcastListenerEvents(levelChangedEvents, levelChangedListenersMutex, index, level.getInfo().uuid, LevelChangeInfo::ADDED);
 	return demoremoved ? SapphireStorageError::LEVEL_SAVE_SUCCESS_DEMO_REMOVED : SapphireStorageError::SUCCESS;
 }
 //1:
@@ -831,20 +848,7 @@ SapphireStorageError LocalSapphireDataStorage::saveLevel(const Level& levelarg,
 //2:
 //	name
 //	color
-#define STORAGE_USER_FORMAT 2
-void LocalSapphireDataStorage::saveUser(StorageDirectoryDescriptor& dir, const StorageSapphireUser& user) {
-	LOGI()<< "Save user: " << user.getUUID().asString();
-	StorageFileDescriptor fd {dir.getPath() + USER_DATA_FILENAME};
-	auto stream = EndianOutputStream<Endianness::Big>::wrap(fd.openOutputStream());
-
-	stream.serialize<uint32>(STORAGE_USER_FORMAT);
-	stream.serialize<SapphireUUID>(user.getUUID());
-	stream.serialize<RegistrationToken>(user.getRegistrationToken());
-	stream.serialize<FixedString>(user.name);
-	stream.serialize<SapphireDifficulty>(user.difficultyColor);
-}
-
-bool LocalSapphireDataStorage::loadUser(StorageDirectoryDescriptor& dir, StorageSapphireUser* user) {
+bool LocalSapphireDataStorage::loadUser(StorageDirectoryDescriptor& dir, StorageSapphireUser* user, const LevelLoadLookup& levellookup) {
 	{
 		StorageFileDescriptor fd { dir.getPath() + USER_DATA_FILENAME };
 		auto stream = EndianInputStream<Endianness::Big>::wrap(BufferedInputStream::wrap(fd.openInputStream()));
@@ -891,20 +895,23 @@ bool LocalSapphireDataStorage::loadUser(StorageDirectoryDescriptor& dir, Storage
 			if (!stream.deserialize<SapphireUUID>(leveluuid) || !stream.deserialize<uint8>(rating)) {
 				break;
 			}
-			auto* level = findLevel(leveluuid);
-			if (level != nullptr) {
-				unsigned int oldrating = user->setRating(leveluuid, rating);
-				level->ratingSum += rating - oldrating;
-				if (oldrating == 0) {
-					++(level->ratingCount);
-				}
-			}
+			applyLoadedRating(user, levellookup.find(leveluuid), rating);
 		}
 	}
 	user->loadUploadedLevels(dir.getPath());
 
 	return true;
 }
+void LocalSapphireDataStorage::applyLoadedRating(StorageSapphireUser* user, StorageSapphireLevelDescriptor* level, unsigned int rating) {
+	if (level == nullptr) {
+		return;
+	}
+	unsigned int oldrating = user->setRating(level->uuid, rating);
+	level->ratingSum += rating - oldrating;
+	if (oldrating == 0) {
+		++(level->ratingCount);
+	}
+}
 
 SapphireStorageError LocalSapphireDataStorage::removeLevel(const SapphireUUID& leveluuid) {
 	//TODO
@@ -924,12 +931,14 @@ SapphireStorageError LocalSapphireDataStorage::removeLevel(const SapphireUUID& l
 			return SapphireStorageError::LEVEL_NOT_FOUND;
 		}
 		descriptors.remove(index);
+		addRemovedLevelLocked(leveluuid, ++levelCatalogSequence);
+		journalLevelCatalog(DatabaseJournalRecord::LEVEL_REMOVED, leveluuid, levelCatalogSequence);
 	}
 	//TODO don't remove the file but move it to some other location
 	desc->getFileDescriptor().remove();
 	delete desc;
 
-	broadcastListenerEvents(levelChangedEvents, levelChangedListenersMutex, (unsigned int) index, LevelChangeInfo::REMOVED);
+	broadcastListenerEvents(levelChangedEvents, levelChangedListenersMutex, (unsigned int) index, leveluuid, LevelChangeInfo::REMOVED);
 	return SapphireStorageError::SUCCESS;
 }
 
@@ -976,7 +985,8 @@ LocalSapphireDataStorage::StorageUserHardware* LocalSapphireDataStorage::getHard
 	hardwares.setSorted(h, StorageUserHardware::compare);
 	StorageDirectoryDescriptor dir { hardwareDirectory.getPath() + (const char*) uuid.asString() };
 	dir.create();
-	h->loadProgress(dir.getPath());
+	h->loadProgress(dir.getPath(), levelOrdinals);
+	journalHardwareCreated(uuid);
 	return h;
 }
 
@@ -988,6 +998,14 @@ Randomer* LocalSapphireDataStorage::getRandomer() {
 	return uuidRandomer;
 }
 
+void LocalSapphireDataStorage::addRemovedLevelLocked(const SapphireUUID& leveluuid, uint32 sequence) {
+	if (removedLevels.size() >= MAX_REMOVED_LEVELS_TRACKED) {
+		removedLevelsMinSequence = removedLevels[0].catalogSequence;
+		delete removedLevels.remove(0);
+	}
+	removedLevels.add(new StorageRemovedLevel(leveluuid, sequence));
+}
+
 LocalSapphireDataStorage::StorageSapphireLevelDescriptor* LocalSapphireDataStorage::findLevel(const SapphireUUID& uuid) {
 	MutexLocker l { levelsMutex };
 	return findLevelLocked(uuid);
@@ -1042,15 +1060,14 @@ SapphireStorageError LocalSapphireDataStorage::rateLevel(const SapphireUUID& use
 		if (oldrating == 0) {
 			++(level->ratingCount);
 		}
+		level->catalogSequence = ++levelCatalogSequence;
+		journalLevelCatalog(DatabaseJournalRecord::LEVEL_CHANGED, leveluuid, level->catalogSequence);
 	}
 
-	StorageFileDescriptor fd { usersDirectory.getPath() + (const char*) userid.asString() + USER_RATINGS_FILENAME };
+	journalUserRating(userid, leveluuid, rating);
 
-	auto ostream = EndianOutputStream<Endianness::Host>::wrap(fd.openAppendStream());
-	ostream.serialize<SapphireUUID>(leveluuid);
-	ostream.serialize<uint8>(rating);
-
-	broadcastListenerEvents(levelChangedEvents, levelChangedListenersMutex, (unsigned int) levelindex, LevelChangeInfo::RATING_CHANGED);
+	broadcastListenerEvents(levelChangedEvents, levelChangedListenersMutex, (unsigned int) levelindex, leveluuid,
+			LevelChangeInfo::RATING_CHANGED);
 
 	return SapphireStorageError::SUCCESS;
 }
@@ -1138,10 +1155,8 @@ SapphireStorageError LocalSapphireDataStorage::registerUser(const SapphireUUID&
 	//it will be overridden if the user chooses a different one
 	u->name = generateFantasyName(u->uuid);
 
-	StorageDirectoryDescriptor userdir { usersDirectory.getPath() + (const char*) u->getUUID().asString() };
-	userdir.create();
-	saveUser(userdir, *u);
 	users.setSorted(u, StorageSapphireUser::compare);
+	journalUserRegistered(*u);
 
 	return SapphireStorageError::SUCCESS;
 }
@@ -1161,9 +1176,8 @@ SapphireStorageError LocalSapphireDataStorage::updateUserInfoLocked(StorageSapph
 	}
 	user->name = name;
 	user->difficultyColor = diffcolor;
-	StorageDirectoryDescriptor userdir { usersDirectory.getPath() + (const char*) user->getUUID().asString() };
-	userdir.create();
-	saveUser(userdir, *user);
+	messageHistory.updateUser(user->uuid, name, diffcolor);
+	journalUserInfo(*user);
 	return SapphireStorageError::SUCCESS;
 }
 
@@ -1180,24 +1194,25 @@ SapphireStorageError LocalSapphireDataStorage::setLevelProgress(ProgressSynchId*
 	}
 	LOGTRACE()<< "Set level progress: " << *progressid << " uuid: " << level.asString();
 	h->progressId++;
-	//always append to the progress file
+	//always append to the progress file, it is the history that the associated hardwares query by progress id
 	StorageFileDescriptor fd { hardwareDirectory.getPath() + (const char*) hardware.asString() + FILENAME_HARDWARE_PROGRESS };
 	{
 		auto&& ostream = EndianOutputStream<Endianness::Big>::wrap(fd.openAppendStream());
 		ostream.serialize<SapphireUUID>(level);
 		ostream.serialize<uint32>((uint32) progress);
 	}
+	journalHardwareProgress(hardware, level, progress, *progressid);
 	broadcastListenerEventsNoMutex(h->hardwareProgressChangedEvents, *progressid, level, progress);
-	if (h->isFinishedLevel(level)) {
+	uint32 ordinal = levelOrdinals.getOrdinal(level);
+	if (h->finishedLevels.contains(ordinal)) {
 		return SapphireStorageError::PROGRESS_UNCHANGED;
 	}
 	if (progress == SapphireLevelProgress::LEVEL_SEEN) {
-		if (h->isSeenLevel(level)) {
+		if (!h->seenLevels.add(ordinal)) {
 			return SapphireStorageError::PROGRESS_UNCHANGED;
 		}
-		h->seenLevels.setSorted(new SapphireUUID(level), compareUUIDPtrs);
 	} else {
-		h->finishedLevels.setSorted(new SapphireUUID(level), compareUUIDPtrs);
+		h->finishedLevels.add(ordinal);
 	}
 
 	return SapphireStorageError::SUCCESS;
@@ -1243,13 +1258,13 @@ SapphireStorageError LocalSapphireDataStorage::increaseAssociatedHardwareProgres
 		return SapphireStorageError::INVALID_PROGRESSID;
 	}
 	associated->synchronizedProgressCount = *progressid + 1;
-	h->saveAssociatedHardwares(hardwareDirectory.getPath() + (const char*) hardware.asString());
+	journalHardwareAssociations(*h);
 	return SapphireStorageError::SUCCESS;
 }
 
-void LocalSapphireDataStorage::StorageUserHardware::loadProgress(const FilePath& directory) {
+void LocalSapphireDataStorage::StorageUserHardware::loadProgress(const FilePath& directory, StorageLevelOrdinalTable& ordinals) {
 	StorageFileDescriptor progfd { directory + FILENAME_HARDWARE_PROGRESS };
-	loadProgress(progfd);
+	loadProgress(progfd, ordinals);
 
 	StorageFileDescriptor associated { directory + FILENAME_ASSOCIATED_HARDWARES };
 	auto&& ais = EndianInputStream<Endianness::Big>::wrap(associated.openInputStream());
@@ -1263,15 +1278,7 @@ void LocalSapphireDataStorage::StorageUserHardware::loadProgress(const FilePath&
 	}
 
 }
-void LocalSapphireDataStorage::StorageUserHardware::saveAssociatedHardwares(const FilePath& directory) {
-	StorageFileDescriptor associated { directory + FILENAME_ASSOCIATED_HARDWARES };
-	auto&& os = EndianOutputStream<Endianness::Big>::wrap(associated.openOutputStream());
-	for (auto&& h : associatedHardwares) {
-		os.serialize<SapphireUUID>(h->hardwareUUID);
-		os.serialize<ProgressSynchId>(h->synchronizedProgressCount);
-	}
-}
-void LocalSapphireDataStorage::StorageUserHardware::loadProgress(FileDescriptor& fd) {
+void LocalSapphireDataStorage::StorageUserHardware::loadProgress(FileDescriptor& fd, StorageLevelOrdinalTable& ordinals) {
 	auto&& istream = EndianInputStream<Endianness::Big>::wrap(fd.openInputStream());
 	SapphireUUID uuid;
 	SapphireLevelProgress progress;
@@ -1284,11 +1291,7 @@ void LocalSapphireDataStorage::StorageUserHardware::loadProgress(FileDescriptor&
 			}
 			break;
 		}
-		if (progress == SapphireLevelProgress::LEVEL_FINISHED) {
-			finishedLevels.setSorted(new SapphireUUID(uuid), compareUUIDPtrs);
-		} else {
-			seenLevels.setSorted(new SapphireUUID(uuid), compareUUIDPtrs);
-		}
+		addLevelProgress(ordinals.getOrdinal(uuid), progress);
 		++progressId;
 	}
 }
@@ -1302,14 +1305,6 @@ void LocalSapphireDataStorage::StorageSapphireUser::loadUploadedLevels(const Fil
 	}
 }
 
-void LocalSapphireDataStorage::StorageSapphireUser::saveUploadedLevels(const FilePath& directory) {
-	StorageFileDescriptor fd { directory + FILENAME_USER_UPLOADED_LEVELS };
-	auto&& ostream = EndianOutputStream<Endianness::Big>::wrap(fd.openOutputStream());
-
-	for (auto&& l : uploadedLevels) {
-		ostream.serialize<SapphireUUID>(*l);
-	}
-}
 
 SapphireStorageError LocalSapphireDataStorage::getLevelStatistics(const SapphireUUID& leveluuid, LevelStatistics* outstats,
 		unsigned int* outplaycount) {
@@ -1399,7 +1394,7 @@ SapphireStorageError LocalSapphireDataStorage::appendLevelStatistics(const Sapph
 		auto&& demoostream = EndianOutputStream<Endianness::Big>::wrap(demofd.openAppendStream());
 		demoostream.serialize<SapphireUUID>(userid);
 		demoostream.serialize<uint32>(randomseed);
-		demoostream.serialize<FixedString>(steps);
+		demoostream.serialize<CompactDemoMoves>(steps);
 	}
 	applyLeaderboardData(user, foundstats, stats, demoid, level.getTurn());
 
@@ -1433,13 +1428,13 @@ SapphireStorageError LocalSapphireDataStorage::getPlayerDemo(const SapphireUUID&
 	while (currentdemoid <= demoid) {
 		if (currentdemoid == demoid) {
 			if (!istream.deserialize<SapphireUUID>(userid) || !istream.deserialize<uint32>(*outrandomseed)
-					|| !istream.deserialize<SafeFixedString<SAPPHIRE_DEMO_MAX_LEN>>(*outsteps)) {
+					|| !istream.deserialize<SafeDemoMoves>(*outsteps)) {
 				return SapphireStorageError::STORAGE_UNAVAILABLE;
 			}
 			return SapphireStorageError::SUCCESS;
 		} else {
 			if (!istream.deserialize<SapphireUUID>(userid) || !istream.deserialize<uint32>(randomseed)
-					|| !istream.deserialize<IgnoreFixedString>(nullptr)) {
+					|| !istream.deserialize<IgnoreDemoMoves>(nullptr)) {
 				return SapphireStorageError::DEMO_NOT_FOUND;
 			}
 		}
@@ -25,6 +25,7 @@
 
 #include <framework/io/files/StorageDirectoryDescriptor.h>
 #include <framework/io/files/StorageFileDescriptor.h>
+#include <framework/io/files/FileOutput.h>
 #include <framework/utils/ArrayList.h>
 #include <framework/utils/LinkedList.h>
 #include <framework/utils/ContainerLinkedNode.h>
@@ -34,6 +35,7 @@
 
 #include <sapphire/level/SapphireLevelDescriptor.h>
 #include <sapphireserver/storage/SapphireDataStorage.h>
+#include <sapphireserver/storage/local/StorageLevelOrdinals.h>
 #include <sapphire/level/Level.h>
 #include <sapphire/community/SapphireUser.h>
 #include <sapphire/level/SapphireUUID.h>
@@ -49,6 +51,7 @@ class LocalSapphireDataStorage: public SapphireDataStorage {
 	StorageDirectoryDescriptor messagesDirectory { StorageDirectoryDescriptor::Root() + "messages" };
 	StorageDirectoryDescriptor hardwareDirectory { StorageDirectoryDescriptor::Root() + "hardware" };
 	StorageDirectoryDescriptor demosDirectory { StorageDirectoryDescriptor::Root() + "demos" };
+	StorageDirectoryDescriptor databaseDirectory { StorageDirectoryDescriptor::Root() + "database" };
 	unsigned int messagesFileIndex = 0;
 	unsigned int currentMessagesFileMessageCount = 0;
 
@@ -106,6 +109,8 @@ class LocalSapphireDataStorage: public SapphireDataStorage {
 		}
 	};
 
+	static const uint32 LEVEL_CATALOG_ORDER_UNKNOWN = 0xFFFFFFFF;
+
 	class StorageSapphireLevelDescriptor: public SapphireLevelDescriptor {
 	public:
 		using SapphireLevelDescriptor::SapphireLevelDescriptor;
@@ -117,8 +122,26 @@ class LocalSapphireDataStorage: public SapphireDataStorage {
 		uint32 ratingSum = 0;
 		uint32 ratingCount = 0;
 
+		/**
+		 * The catalog sequence number of the last change of this level.
+		 */
+		uint32 catalogSequence = 0;
+		/**
+		 * Position of the level in the persisted catalog, only used while loading.
+		 */
+		uint32 catalogOrder = LEVEL_CATALOG_ORDER_UNKNOWN;
+
 		void initDate(FileDescriptor& fd);
 	};
+	class StorageRemovedLevel {
+	public:
+		SapphireUUID levelUUID;
+		uint32 catalogSequence;
+
+		StorageRemovedLevel(const SapphireUUID& leveluuid, uint32 sequence)
+				: levelUUID(leveluuid), catalogSequence(sequence) {
+		}
+	};
 
 	class StorageLevelRating {
 	public:
@@ -187,8 +210,68 @@ class LocalSapphireDataStorage: public SapphireDataStorage {
 		}
 
 		void loadUploadedLevels(const FilePath& directory);
-		void saveUploadedLevels(const FilePath& directory);
+
+		template<typename OutStream>
+		bool serializeRatings(OutStream& os) const {
+			if (!os.template serialize<uint32>(levelRatings.size())) {
+				return false;
+			}
+			for (auto&& r : levelRatings) {
+				if (!os.template serialize<SapphireUUID>(r->levelUUID) || !os.template serialize<uint8>(r->rating)) {
+					return false;
+				}
+			}
+			return true;
+		}
+	};
+
+	/**
+	 * Temporary UUID lookup for the community levels while the users are loaded.
+	 * findLevel is a linear search, which is too slow when applying the ratings of all users.
+	 */
+	class LevelLoadLookup {
+		class Link {
+		public:
+			static int compare(const Link* l, const Link* r) {
+				return l->uuid.compare(r->uuid);
+			}
+			static int compareUUID(const Link* l, const SapphireUUID& uuid) {
+				return l->uuid.compare(uuid);
+			}
+			SapphireUUID uuid;
+			StorageSapphireLevelDescriptor* level;
+		};
+		ArrayList<Link> links;
+	public:
+		LevelLoadLookup(ArrayList<StorageSapphireLevelDescriptor>& descriptors);
+
+		StorageSapphireLevelDescriptor* find(const SapphireUUID& uuid) const {
+			int idx = links.getIndexForSorted(uuid, Link::compareUUID);
+			if (idx < 0) {
+				return nullptr;
+			}
+			return links.get(idx)->level;
+		}
+	};
+
+	/**
+	 * Record types of the database journal.
+	 * Every record is idempotent, so replaying them over a table which already contains them is safe.
+	 */
+	enum class DatabaseJournalRecord
+		: uint8 {
+			USER_REGISTERED = 1,
+		USER_INFO = 2,
+		USER_RATING = 3,
+		USER_UPLOADED_LEVEL = 4,
+		HARDWARE_CREATED = 5,
+		HARDWARE_PROGRESS = 6,
+		HARDWARE_ASSOCIATIONS = 7,
+		LEVEL_ADDED = 8,
+		LEVEL_CHANGED = 9,
+		LEVEL_REMOVED = 10,
 	};
+	class LevelCatalogSnapshot;
 
 	class StorageDiscussionMessage {
 	public:
@@ -196,7 +279,7 @@ class LocalSapphireDataStorage: public SapphireDataStorage {
 		FixedString message;
 	};
 	class StorageUserHardware {
-		void loadProgress(FileDescriptor& fd);
+		void loadProgress(FileDescriptor& fd, StorageLevelOrdinalTable& ordinals);
 	public:
 		static int compare(const StorageUserHardware* l, const StorageUserHardware* r) {
 			return l->hardwareUUID.compare(r->hardwareUUID);
@@ -206,21 +289,22 @@ class LocalSapphireDataStorage: public SapphireDataStorage {
 		}
 
 		SapphireUUID hardwareUUID;
-		ArrayList<SapphireUUID> seenLevels;
-		ArrayList<SapphireUUID> finishedLevels;
+		//ordinals from levelOrdinals
+		StorageLevelOrdinalSet seenLevels;
+		StorageLevelOrdinalSet finishedLevels;
 		ProgressSynchId progressId = 0;
 		HardwareProgressChangedListener::Events hardwareProgressChangedEvents;
 		//lock on hardwareMutex to access hardwares
 		ArrayList<AssociatedHardware> associatedHardwares;
 
-		bool isSeenLevel(const SapphireUUID& uuid) {
-			return seenLevels.getIndexForSorted(uuid, compareUUIDLPtrs) >= 0;
-		}
-		bool isFinishedLevel(const SapphireUUID& uuid) {
-			return finishedLevels.getIndexForSorted(uuid, compareUUIDLPtrs) >= 0;
+		void addLevelProgress(uint32 levelordinal, SapphireLevelProgress progress) {
+			if (progress == SapphireLevelProgress::LEVEL_FINISHED) {
+				finishedLevels.add(levelordinal);
+			} else {
+				seenLevels.add(levelordinal);
+			}
 		}
-		void loadProgress(const FilePath& directory);
-		void saveAssociatedHardwares(const FilePath& directory);
+		void loadProgress(const FilePath& directory, StorageLevelOrdinalTable& ordinals);
 
 		bool hasAssociatedHardware(const SapphireUUID& hardwareuuid) {
 			return getAssociatedHardware(hardwareuuid) != nullptr;
@@ -381,27 +465,94 @@ class LocalSapphireDataStorage: public SapphireDataStorage {
 		}
 	};
 
+	static const unsigned int MAX_REMOVED_LEVELS_TRACKED = 1024;
+
 	Mutex levelsMutex { Mutex::auto_init { } };
 	ArrayList<StorageSapphireLevelDescriptor> descriptors;
+	/**
+	 * The catalog cursor, the order of the levels and the tracked removals are persisted in the database table.
+	 * The epoch is only regenerated if they could not be loaded.
+	 */
+	SapphireUUID levelCatalogEpoch;
+	uint32 levelCatalogSequence = 0;
+	ArrayList<StorageRemovedLevel> removedLevels;
+	/**
+	 * Removals up to this sequence number are no longer tracked.
+	 */
+	uint32 removedLevelsMinSequence = 0;
+	/**
+	 * The next catalog position of the levels added by the replayed journal records, only used while loading.
+	 */
+	uint32 levelCatalogLoadOrder = 0;
+
+	void addRemovedLevelLocked(const SapphireUUID& leveluuid, uint32 sequence);
+	void finishLevelCatalogLoading();
 
 	Mutex usersMutex { Mutex::auto_init { } };
 	ArrayList<StorageSapphireUser> users;
 	LockPool<> usersLockPool;
 
-	Mutex messagesMutex { Mutex::auto_init { } };
-	ArrayList<StorageDiscussionMessage> messages;
-	unsigned int messagesStartIndex = 0;
+	/**
+	 * The messages read from the files while loading, moved to messageHistory after.
+	 */
+	ArrayList<StorageDiscussionMessage> loadedMessages;
+	DiscussionMessageHistory messageHistory;
 
 	Mutex hardwareMutex { Mutex::auto_init { } };
 	ArrayList<StorageUserHardware> hardwares;
 	LockPool<> hardwaresLockPool;
+	StorageLevelOrdinalTable levelOrdinals;
 
 	Mutex statisticsMutex { Mutex::auto_init { } };
 	ArrayList<StorageLevelStatistics> statistics;
 	LockPool<> statisticsLevelLockPool;
 
-	static void saveUser(StorageDirectoryDescriptor& dir, const StorageSapphireUser& user);
-	bool loadUser(StorageDirectoryDescriptor& dir, StorageSapphireUser* user);
+	bool loadUser(StorageDirectoryDescriptor& dir, StorageSapphireUser* user, const LevelLoadLookup& levellookup);
+	static void applyLoadedRating(StorageSapphireUser* user, StorageSapphireLevelDescriptor* level, unsigned int rating);
+
+	Mutex journalMutex { Mutex::auto_init { } };
+	/**
+	 * The open journal, nullptr until the first record is appended after a compaction.
+	 */
+	FileOutput* journalOutput = nullptr;
+	bool journalFlushPosted = false;
+	unsigned int journalRecordCount = 0;
+	/**
+	 * Set while loading if the table doesn't contain the loaded state, so it is written at startup.
+	 */
+	bool databaseTableOutdated = false;
+	/**
+	 * Set after the journals are replayed to the loaded state. The table is not written before that,
+	 * as it wouldn't contain the records of the journals, which are removed after the table is written.
+	 */
+	bool databaseJournalsApplied = false;
+	bool databaseCompactionPosted = false;
+	/**
+	 * Writes the database table in the background when the journal grows too large.
+	 */
+	WorkerThread databaseWriterThread;
+
+	bool loadDatabase(const LevelLoadLookup& levellookup);
+	bool loadDatabaseTable(const LevelLoadLookup& levellookup, ArrayList<SapphireUUID>& outmissinglevels);
+	void replayDatabaseJournal(const LevelLoadLookup& levellookup, const char* filename);
+	void importLegacyDatabase(const LevelLoadLookup& levellookup);
+	bool writeDatabase();
+	bool writeDatabaseTable();
+	bool writeDatabaseTable(const LevelCatalogSnapshot& catalog, StorageSapphireUser** userlist, unsigned int usercount,
+			StorageUserHardware** hardwarelist, unsigned int hardwarecount);
+	bool openJournalLocked();
+	void closeJournalLocked();
+	void journalRecordAppendedLocked();
+
+	void journalUserRegistered(const StorageSapphireUser& user);
+	void journalUserInfo(const StorageSapphireUser& user);
+	void journalUserRating(const SapphireUUID& useruuid, const SapphireUUID& leveluuid, unsigned int rating);
+	void journalUserUploadedLevel(const SapphireUUID& useruuid, const SapphireUUID& leveluuid);
+	void journalHardwareCreated(const SapphireUUID& hardwareuuid);
+	void journalHardwareProgress(const SapphireUUID& hardwareuuid, const SapphireUUID& leveluuid, SapphireLevelProgress progress,
+			ProgressSynchId progressid);
+	void journalHardwareAssociations(const StorageUserHardware& hardware);
+	void journalLevelCatalog(DatabaseJournalRecord type, const SapphireUUID& leveluuid, uint32 sequence);
 
 	unsigned int readMessagesFile(unsigned int index, bool* validfile, int formatnumber);
 	unsigned int readMessagesFile1(unsigned int index, bool* validfile);
@@ -431,6 +582,7 @@ class LocalSapphireDataStorage: public SapphireDataStorage {
 	StorageUserHardware* getHardwareCreateLocked(const SapphireUUID& uuid);
 	int findLevelIndex(const SapphireUUID& uuid);
 	int findLevelIndexLocked(const SapphireUUID& uuid);
+	void fillLevelDetailsLocked(SapphireLevelDetails& details, const StorageSapphireLevelDescriptor& desc, StorageSapphireUser* user);
 
 	StorageLevelStatistics* findStatistics(const SapphireUUID& leveluuid);
 	StorageLevelStatistics* findStatisticsLocked(const SapphireUUID& leveluuid);
@@ -472,8 +624,11 @@ public:
 
 	virtual SapphireStorageError queryLevels(SapphireLevelDetails* details, unsigned int maxcount, unsigned int start,
 			unsigned int *outcount, const SapphireUUID& user) override;
-	virtual SapphireStorageError queryMessages(SapphireDiscussionMessage* messages, unsigned int maxcount, unsigned int* inoutstart,
-			unsigned int* outcount) override;
+	virtual SapphireStorageError queryLevel(const SapphireUUID& leveluuid, SapphireLevelDetails* outdetails, unsigned int* outindex,
+			const SapphireUUID& user) override;
+	virtual SapphireStorageError queryLevelChanges(const SapphireUUID& user, LevelCatalogCursor* inoutcursor, bool* outreset,
+			ArrayList<SapphireUUID>* outremoved, ArrayList<SapphireLevelDetails>* outchanged, unsigned int* outtotalcount) override;
+	virtual SapphireStorageError queryMessages(DiscussionMessageHistory::Snapshot* outsnapshot) override;
 	virtual SapphireStorageError queryAssociatedHardwares(const SapphireUUID& hardwareuuid, ArrayList<AssociatedHardware>& outids) override;
 	virtual SapphireStorageError queryLevelProgress(ProgressSynchId* progressid, const SapphireUUID& hardware, SapphireUUID* outlevel,
 			SapphireLevelProgress* outprogress) override;
@@ -0,0 +1,956 @@
+/*
+ * Copyright (C) 2020 Bence Sipka
+ *
+ * This program is free software: you can redistribute it and/or modify 
+ * it under the terms of the GNU General Public License as published by 
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/*
+ * LocalSapphireDataStorageDatabase.cpp
+ *
+ *  Created on: 2026. okt. 19.
+ *      Author: sipka
+ */
+
+#include <sapphireserver/storage/local/LocalSapphireDataStorage.h>
+#include <sapphireserver/storage/local/StorageMappedFile.h>
+#include <sapphire/common/FantasyNames.h>
+
+#include <framework/io/stream/OutputStream.h>
+#include <framework/io/stream/InputStream.h>
+#include <framework/io/files/FileOutput.h>
+
+#include <sapphire/sapphireconstants.h>
+
+#include <gen/log.h>
+#include <sapphireserver/servermain.h>
+
+#include <string.h>
+
+//The users and hardwares are stored in a single table file, and the modifications since the table was written are appended to a journal.
+//The per-user and per-hardware directories of older versions are only imported if the table doesn't exist, they are not written anymore.
+//The table is written by replacing the file, so it only doesn't exist if it was never written. The journals are based on the
+//imported state in that case, and they are replayed after the import.
+//If the table exists but can't be loaded, the server doesn't start, so the table and the journals are not overwritten.
+//The per-hardware progress files are still appended, as they are the progress history queried by progress id.
+//
+//Table format (big endian):
+//	header:
+//		"RHDB" uint32 version
+//	level catalog (since version 2):
+//		UUID epoch, uint32 sequence, uint32 removed levels min sequence
+//		uint32 count * (removed level UUID, uint32 sequence)
+//		uint32 count * (level UUID, uint32 sequence), in catalog order
+//	records:
+//		user records, hardware records
+//	indexes, sorted by UUID:
+//		usercount * (UUID, uint64 record offset)
+//		hardwarecount * (UUID, uint64 record offset)
+//	trailer (fixed size, at the end of the file):
+//		uint64 user index offset, uint32 usercount, uint64 hardware index offset, uint32 hardwarecount, uint32 version, "RHDB"
+//
+//User record:
+//	UUID, RegistrationToken, FixedString name, SapphireDifficulty color
+//	uint32 count * (level UUID, uint8 rating)
+//	uint32 count * (uploaded level UUID)
+//Hardware record:
+//	UUID, uint64 progress id
+//	uint32 count * (seen level UUID)
+//	uint32 count * (finished level UUID)
+//	uint32 count * (associated hardware UUID, uint64 synchronized progress count)
+//
+//The catalog order is persisted, as the clients address the levels by their index, and the order of the level files
+//in the directory is not defined. Levels that are not in the catalog are added to its end at startup.
+//
+//The journal is compacted into the table in the background after DATABASE_JOURNAL_COMPACT_RECORD_COUNT records.
+//The journal is first moved aside, so new records are appended to a fresh journal while the table is written.
+//The table may contain the effects of some records in the fresh journal, this is fine as replaying the records is idempotent.
+//If the compaction fails, the moved journal is replayed after the table, followed by the fresh journal.
+//
+//The journal is kept open and the records are written to its buffer under the journal mutex.
+//The buffer is flushed to the file by a job on the database writer thread, which is posted when the first record is appended
+//after a flush, so the records appended meanwhile are written together. It is also flushed when it gets full.
+//The journal is only synced to the disk when it is closed before a compaction and at shutdown. A record that was not flushed
+//when the process died is lost, the storage is consistent with the journal at startup either way.
+#define DATABASE_TABLE_FILENAME "storage.table"
+#define DATABASE_TABLE_TEMP_FILENAME "storage.table.tmp"
+#define DATABASE_JOURNAL_FILENAME "storage.journal"
+#define DATABASE_COMPACTING_JOURNAL_FILENAME "storage.journal.compacting"
+#define DATABASE_JOURNAL_COMPACT_RECORD_COUNT (64 * 1024)
+#define DATABASE_JOURNAL_BUFFER_SIZE (16 * 1024)
+#define DATABASE_TABLE_VERSION 2
+#define DATABASE_TABLE_HEADER_SIZE 8
+#define DATABASE_TABLE_TRAILER_SIZE 32
+#define DATABASE_TABLE_INDEX_ENTRY_SIZE (16 + 8)
+#define DATABASE_TABLE_WRITE_BUFFER_SIZE (64 * 1024)
+
+namespace userapp {
+using namespace rhfw;
+
+static const char DATABASE_MAGIC[4] { 'R', 'H', 'D', 'B' };
+
+namespace {
+
+class DatabaseTableOutput {
+private:
+	FileOutput& out;
+	uint64 position = 0;
+public:
+	DatabaseTableOutput(FileOutput& out)
+			: out(out) {
+	}
+	bool write(const void* data, unsigned int count) {
+		position += count;
+		return out.write(data, count);
+	}
+	uint64 getPosition() const {
+		return position;
+	}
+};
+
+/**
+ * Adds the item to the end of the list if it keeps the ordering, else inserts it to the sorted position.
+ * The table is written in sorted order, so the tail insertion is the common case.
+ */
+template<typename T, typename Comparator>
+void appendSorted(ArrayList<T>& list, T* item, Comparator&& comp) {
+	if (list.isEmpty() || comp(&list.last(), item) < 0) {
+		list.add(item);
+	} else {
+		list.setSorted(item, util::forward<Comparator>(comp));
+	}
+}
+
+template<typename InStream, typename Comparator>
+bool deserializeUUIDList(InStream& is, ArrayList<SapphireUUID>& out, Comparator&& comp) {
+	uint32 count;
+	if (!is.template deserialize<uint32>(count)) {
+		return false;
+	}
+	for (uint32 i = 0; i < count; ++i) {
+		SapphireUUID uuid;
+		if (!is.template deserialize<SapphireUUID>(uuid)) {
+			return false;
+		}
+		appendSorted(out, new SapphireUUID(uuid), comp);
+	}
+	return true;
+}
+template<typename InStream>
+bool deserializeLevelSet(InStream& is, StorageLevelOrdinalSet& out, StorageLevelOrdinalTable& ordinals) {
+	uint32 count;
+	if (!is.template deserialize<uint32>(count)) {
+		return false;
+	}
+	for (uint32 i = 0; i < count; ++i) {
+		SapphireUUID uuid;
+		if (!is.template deserialize<SapphireUUID>(uuid)) {
+			return false;
+		}
+		out.add(ordinals.getOrdinal(uuid));
+	}
+	return true;
+}
+template<typename OutStream>
+bool serializeLevelSet(OutStream& os, const StorageLevelOrdinalSet& set, StorageLevelOrdinalTable& ordinals) {
+	if (!os.template serialize<uint32>(set.size())) {
+		return false;
+	}
+	bool success = true;
+	set.forEach([&](uint32 ordinal) {
+		success = success && os.template serialize<SapphireUUID>(ordinals.getUUID(ordinal));
+	});
+	return success;
+}
+template<typename OutStream>
+bool serializeUUIDList(OutStream& os, const ArrayList<SapphireUUID>& list) {
+	if (!os.template serialize<uint32>(list.size())) {
+		return false;
+	}
+	for (unsigned int i = 0; i < list.size(); ++i) {
+		if (!os.template serialize<SapphireUUID>(list[i])) {
+			return false;
+		}
+	}
+	return true;
+}
+
+} // namespace
+
+class LocalSapphireDataStorage::LevelCatalogSnapshot {
+public:
+	class Entry {
+	public:
+		SapphireUUID uuid;
+		uint32 sequence;
+
+		Entry(const SapphireUUID& uuid, uint32 sequence)
+				: uuid(uuid), sequence(sequence) {
+		}
+	};
+	SapphireUUID epoch;
+	uint32 sequence = 0;
+	uint32 removedMinSequence = 0;
+	ArrayList<Entry> removed;
+	/**
+	 * The levels in catalog order.
+	 */
+	ArrayList<Entry> levels;
+};
+
+LocalSapphireDataStorage::LevelLoadLookup::LevelLoadLookup(ArrayList<StorageSapphireLevelDescriptor>& descriptors) {
+	for (auto* d : descriptors) {
+		links.add(new Link { d->uuid, d });
+	}
+	links.sort([](const Link& l, const Link& r) {
+		return l.uuid < r.uuid;
+	});
+}
+
+bool LocalSapphireDataStorage::loadDatabase(const LevelLoadLookup& levellookup) {
+	StorageFileDescriptor tablefd { databaseDirectory.getPath() + DATABASE_TABLE_FILENAME };
+	ArrayList<SapphireUUID> missinglevels;
+	if (tablefd.exists()) {
+		postLogEvent("Loading database table...");
+		if (!loadDatabaseTable(levellookup, missinglevels)) {
+			postLogEvent("Failed to load database table.");
+			return false;
+		}
+	} else {
+		postLogEvent("Database table not found, importing users and hardwares from directories...");
+		importLegacyDatabase(levellookup);
+		//write the table right away, so the next startup doesn't need to import again
+		databaseTableOutdated = true;
+	}
+	replayDatabaseJournal(levellookup, DATABASE_COMPACTING_JOURNAL_FILENAME);
+	replayDatabaseJournal(levellookup, DATABASE_JOURNAL_FILENAME);
+	databaseJournalsApplied = true;
+	for (auto* uuid : missinglevels) {
+		if (levellookup.find(*uuid) != nullptr) {
+			continue;
+		}
+		bool found = false;
+		for (auto* r : removedLevels) {
+			if (r->levelUUID == *uuid) {
+				found = true;
+				break;
+			}
+		}
+		if (!found) {
+			//the level file was removed while the server was not running
+			addRemovedLevelLocked(*uuid, ++levelCatalogSequence);
+			//write the table, so the removal is persisted
+			databaseTableOutdated = true;
+		}
+	}
+	return true;
+}
+
+void LocalSapphireDataStorage::finishLevelCatalogLoading() {
+	//the sort is stable, the levels which are not in the catalog keep their directory order at the end
+	descriptors.sort([](const StorageSapphireLevelDescriptor& l, const StorageSapphireLevelDescriptor& r) {
+		return l.catalogOrder < r.catalogOrder;
+	});
+	for (auto* d : descriptors) {
+		if (d->catalogOrder == LEVEL_CATALOG_ORDER_UNKNOWN) {
+			d->catalogSequence = ++levelCatalogSequence;
+			//write the table, so the level is persisted in the catalog
+			databaseTableOutdated = true;
+		}
+	}
+}
+
+bool LocalSapphireDataStorage::loadDatabaseTable(const LevelLoadLookup& levellookup, ArrayList<SapphireUUID>& outmissinglevels) {
+	StorageFileDescriptor tablefd { databaseDirectory.getPath() + DATABASE_TABLE_FILENAME };
+	StorageMappedFile table { tablefd };
+	if (!table.isValid() || table.getLength() < DATABASE_TABLE_HEADER_SIZE + DATABASE_TABLE_TRAILER_SIZE) {
+		return false;
+	}
+	uint32 version;
+	{
+		auto&& is = EndianInputStream<Endianness::Big>::wrap(table.inputAt(0));
+		char magic[sizeof(DATABASE_MAGIC)];
+		if (is.read(magic, sizeof(magic)) != sizeof(magic) || memcmp(magic, DATABASE_MAGIC, sizeof(magic)) != 0
+				|| !is.deserialize<uint32>(version)) {
+			return false;
+		}
+		if (version != 1 && version != DATABASE_TABLE_VERSION) {
+			postLogEvent(FixedString { "Unknown database table version: " } + FixedString::toString(version));
+			return false;
+		}
+		if (version >= 2) {
+			uint32 removedcount;
+			if (!is.deserialize<SapphireUUID>(levelCatalogEpoch) || !is.deserialize<uint32>(levelCatalogSequence)
+					|| !is.deserialize<uint32>(removedLevelsMinSequence) || !is.deserialize<uint32>(removedcount)) {
+				return false;
+			}
+			for (uint32 i = 0; i < removedcount; ++i) {
+				SapphireUUID leveluuid;
+				uint32 sequence;
+				if (!is.deserialize<SapphireUUID>(leveluuid) || !is.deserialize<uint32>(sequence)) {
+					return false;
+				}
+				removedLevels.add(new StorageRemovedLevel(leveluuid, sequence));
+			}
+			uint32 levelcount;
+			if (!is.deserialize<uint32>(levelcount)) {
+				return false;
+			}
+			for (uint32 i = 0; i < levelcount; ++i) {
+				SapphireUUID leveluuid;
+				uint32 sequence;
+				if (!is.deserialize<SapphireUUID>(leveluuid) || !is.deserialize<uint32>(sequence)) {
+					return false;
+				}
+				auto* desc = levellookup.find(leveluuid);
+				if (desc == nullptr) {
+					outmissinglevels.add(new SapphireUUID(leveluuid));
+					continue;
+				}
+				desc->catalogOrder = levelCatalogLoadOrder++;
+				desc->catalogSequence = sequence;
+			}
+		}
+	}
+
+	uint64 userindexoffset;
+	uint32 usercount;
+	uint64 hardwareindexoffset;
+	uint32 hardwarecount;
+	{
+		auto&& is = EndianInputStream<Endianness::Big>::wrap(table.inputAt(table.getLength() - DATABASE_TABLE_TRAILER_SIZE));
+		uint32 trailerversion;
+		char magic[sizeof(DATABASE_MAGIC)];
+		if (!is.deserialize<uint64>(userindexoffset) || !is.deserialize<uint32>(usercount)
+				|| !is.deserialize<uint64>(hardwareindexoffset) || !is.deserialize<uint32>(hardwarecount)
+				|| !is.deserialize<uint32>(trailerversion) || is.read(magic, sizeof(magic)) != sizeof(magic)
+				|| memcmp(magic, DATABASE_MAGIC, sizeof(magic)) != 0 || trailerversion != version) {
+			//the file was probably not fully written
+			return false;
+		}
+		const uint64 indexesend = table.getLength() - DATABASE_TABLE_TRAILER_SIZE;
+		if (userindexoffset + (uint64) usercount * DATABASE_TABLE_INDEX_ENTRY_SIZE > indexesend
+				|| hardwareindexoffset + (uint64) hardwarecount * DATABASE_TABLE_INDEX_ENTRY_SIZE > indexesend) {
+			return false;
+		}
+	}
+
+	auto&& userindex = EndianInputStream<Endianness::Big>::wrap(table.inputAt(userindexoffset));
+	for (uint32 i = 0; i < usercount; ++i) {
+		SapphireUUID indexuuid;
+		uint64 offset;
+		if (!userindex.deserialize<SapphireUUID>(indexuuid) || !userindex.deserialize<uint64>(offset) || offset >= userindexoffset) {
+			return false;
+		}
+		auto&& is = EndianInputStream<Endianness::Big>::wrap(table.inputAt(offset));
+		StorageSapphireUser* user = new StorageSapphireUser();
+		if (!is.deserialize<SapphireUUID>(user->uuid) || user->uuid != indexuuid
+				|| !is.deserialize<RegistrationToken>(user->registrationToken)
+				|| !is.deserialize<SafeFixedString<SAPPHIRE_USERNAME_MAX_LEN>>(user->name)
+				|| !is.deserialize<SapphireDifficulty>(user->difficultyColor)) {
+			delete user;
+			return false;
+		}
+		uint32 ratingcount;
+		if (!is.deserialize<uint32>(ratingcount)) {
+			delete user;
+			return false;
+		}
+		for (uint32 r = 0; r < ratingcount; ++r) {
+			SapphireUUID leveluuid;
+			uint8 rating;
+			if (!is.deserialize<SapphireUUID>(leveluuid) || !is.deserialize<uint8>(rating)) {
+				delete user;
+				return false;
+			}
+			applyLoadedRating(user, levellookup.find(leveluuid), rating);
+		}
+		if (!deserializeUUIDList(is, user->uploadedLevels, compareUUIDPtrs)) {
+			delete user;
+			return false;
+		}
+		if (user->name.length() == 0) {
+			//same as in loadUser
+			user->name = generateFantasyName(user->uuid);
+		}
+		appendSorted(users, user, StorageSapphireUser::compare);
+	}
+
+	auto&& hardwareindex = EndianInputStream<Endianness::Big>::wrap(table.inputAt(hardwareindexoffset));
+	for (uint32 i = 0; i < hardwarecount; ++i) {
+		SapphireUUID indexuuid;
+		uint64 offset;
+		if (!hardwareindex.deserialize<SapphireUUID>(indexuuid) || !hardwareindex.deserialize<uint64>(offset)
+				|| offset >= userindexoffset) {
+			return false;
+		}
+		auto&& is = EndianInputStream<Endianness::Big>::wrap(table.inputAt(offset));
+		StorageUserHardware* hardware = new StorageUserHardware();
+		uint32 associatedcount;
+		if (!is.deserialize<SapphireUUID>(hardware->hardwareUUID) || hardware->hardwareUUID != indexuuid
+				|| !is.deserialize<ProgressSynchId>(hardware->progressId)
+				|| !deserializeLevelSet(is, hardware->seenLevels, levelOrdinals)
+				|| !deserializeLevelSet(is, hardware->finishedLevels, levelOrdinals)
+				|| !is.deserialize<uint32>(associatedcount)) {
+			delete hardware;
+			return false;
+		}
+		for (uint32 a = 0; a < associatedcount; ++a) {
+			SapphireUUID associateduuid;
+			ProgressSynchId synch;
+			if (!is.deserialize<SapphireUUID>(associateduuid) || !is.deserialize<ProgressSynchId>(synch)) {
+				delete hardware;
+				return false;
+			}
+			appendSorted(hardware->associatedHardwares, new AssociatedHardware(associateduuid, synch), AssociatedHardware::compare);
+		}
+		appendSorted(hardwares, hardware, StorageUserHardware::compare);
+	}
+	return true;
+}
+
+void LocalSapphireDataStorage::replayDatabaseJournal(const LevelLoadLookup& levellookup, const char* filename) {
+	StorageFileDescriptor journalfd { databaseDirectory.getPath() + filename };
+	StorageMappedFile journal { journalfd };
+	if (!journal.isValid()) {
+		return;
+	}
+	postLogEvent(FixedString { "Replaying database journal, size: " } + FixedString::toString(journal.getLength()));
+	auto&& is = EndianInputStream<Endianness::Big>::wrap(journal.inputAt(0));
+	unsigned int count = 0;
+	while (true) {
+		uint8 type;
+		if (!is.deserialize<uint8>(type)) {
+			break;
+		}
+		bool success = false;
+		switch ((DatabaseJournalRecord) type) {
+			case DatabaseJournalRecord::USER_REGISTERED: {
+				SapphireUUID uuid;
+				RegistrationToken token;
+				FixedString name;
+				SapphireDifficulty color;
+				success = is.deserialize<SapphireUUID>(uuid) && is.deserialize<RegistrationToken>(token)
+						&& is.deserialize<SafeFixedString<SAPPHIRE_USERNAME_MAX_LEN>>(name) && is.deserialize<SapphireDifficulty>(color);
+				if (success && findUserLocked(uuid) == nullptr) {
+					StorageSapphireUser* u = new StorageSapphireUser(uuid);
+					u->registrationToken = token;
+					u->name = name.length() == 0 ? generateFantasyName(uuid) : util::move(name);
+					u->difficultyColor = color;
+					users.setSorted(u, StorageSapphireUser::compare);
+				}
+				break;
+			}
+			case DatabaseJournalRecord::USER_INFO: {
+				SapphireUUID uuid;
+				FixedString name;
+				SapphireDifficulty color;
+				success = is.deserialize<SapphireUUID>(uuid) && is.deserialize<SafeFixedString<SAPPHIRE_USERNAME_MAX_LEN>>(name)
+						&& is.deserialize<SapphireDifficulty>(color);
+				if (success) {
+					auto* u = findUserLocked(uuid);
+					if (u != nullptr) {
+						u->name = util::move(name);
+						u->difficultyColor = color;
+					}
+				}
+				break;
+			}
+			case DatabaseJournalRecord::USER_RATING: {
+				SapphireUUID uuid;
+				SapphireUUID leveluuid;
+				uint8 rating;
+				success = is.deserialize<SapphireUUID>(uuid) && is.deserialize<SapphireUUID>(leveluuid) && is.deserialize<uint8>(rating);
+				if (success) {
+					auto* u = findUserLocked(uuid);
+					if (u != nullptr) {
+						applyLoadedRating(u, levellookup.find(leveluuid), rating);
+					}
+				}
+				break;
+			}
+			case DatabaseJournalRecord::USER_UPLOADED_LEVEL: {
+				SapphireUUID uuid;
+				SapphireUUID leveluuid;
+				success = is.deserialize<SapphireUUID>(uuid) && is.deserialize<SapphireUUID>(leveluuid);
+				if (success) {
+					auto* u = findUserLocked(uuid);
+					if (u != nullptr) {
+						u->uploadedLevels.setSorted(new SapphireUUID(leveluuid), compareUUIDPtrs);
+					}
+				}
+				break;
+			}
+			case DatabaseJournalRecord::HARDWARE_CREATED: {
+				SapphireUUID uuid;
+				success = is.deserialize<SapphireUUID>(uuid);
+				if (success && findHardwareLocked(uuid) == nullptr) {
+					StorageUserHardware* h = new StorageUserHardware();
+					h->hardwareUUID = uuid;
+					hardwares.setSorted(h, StorageUserHardware::compare);
+				}
+				break;
+			}
+			case DatabaseJournalRecord::HARDWARE_PROGRESS: {
+				SapphireUUID uuid;
+				SapphireUUID leveluuid;
+				SapphireLevelProgress progress;
+				ProgressSynchId progressid;
+				success = is.deserialize<SapphireUUID>(uuid) && is.deserialize<SapphireUUID>(leveluuid)
+						&& is.deserialize<uint32>(reinterpret_cast<uint32&>(progress)) && is.deserialize<ProgressSynchId>(progressid);
+				if (success) {
+					auto* h = findHardwareLocked(uuid);
+					if (h == nullptr) {
+						h = new StorageUserHardware();
+						h->hardwareUUID = uuid;
+						hardwares.setSorted(h, StorageUserHardware::compare);
+					}
+					if (h->progressId <= progressid) {
+						h->progressId = progressid + 1;
+					}
+					//same as StorageUserHardware::loadProgress
+					h->addLevelProgress(levelOrdinals.getOrdinal(leveluuid), progress);
+				}
+				break;
+			}
+			case DatabaseJournalRecord::HARDWARE_ASSOCIATIONS: {
+				SapphireUUID uuid;
+				uint32 associatedcount;
+				success = is.deserialize<SapphireUUID>(uuid) && is.deserialize<uint32>(associatedcount);
+				ArrayList<AssociatedHardware> associated;
+				for (uint32 i = 0; success && i < associatedcount; ++i) {
+					SapphireUUID associateduuid;
+					ProgressSynchId synch;
+					success = is.deserialize<SapphireUUID>(associateduuid) && is.deserialize<ProgressSynchId>(synch);
+					if (success) {
+						associated.setSorted(new AssociatedHardware(associateduuid, synch), AssociatedHardware::compare);
+					}
+				}
+				if (success) {
+					auto* h = findHardwareLocked(uuid);
+					if (h != nullptr) {
+						h->associatedHardwares = util::move(associated);
+					}
+				}
+				break;
+			}
+			case DatabaseJournalRecord::LEVEL_ADDED:
+			case DatabaseJournalRecord::LEVEL_CHANGED:
+			case DatabaseJournalRecord::LEVEL_REMOVED: {
+				SapphireUUID leveluuid;
+				uint32 sequence;
+				success = is.deserialize<SapphireUUID>(leveluuid) && is.deserialize<uint32>(sequence);
+				if (!success) {
+					break;
+				}
+				if (levelCatalogSequence < sequence) {
+					levelCatalogSequence = sequence;
+				}
+				if ((DatabaseJournalRecord) type == DatabaseJournalRecord::LEVEL_REMOVED) {
+					bool found = false;
+					for (auto* r : removedLevels) {
+						if (r->levelUUID == leveluuid && r->catalogSequence == sequence) {
+							found = true;
+							break;
+						}
+					}
+					if (!found) {
+						addRemovedLevelLocked(leveluuid, sequence);
+					}
+					break;
+				}
+				auto* desc = levellookup.find(leveluuid);
+				if (desc == nullptr) {
+					break;
+				}
+				if ((DatabaseJournalRecord) type == DatabaseJournalRecord::LEVEL_ADDED && desc->catalogOrder == LEVEL_CATALOG_ORDER_UNKNOWN) {
+					//the compacting journal may contain levels that are already in the table
+					desc->catalogOrder = levelCatalogLoadOrder++;
+				}
+				if (desc->catalogSequence < sequence) {
+					desc->catalogSequence = sequence;
+				}
+				break;
+			}
+			default: {
+				postLogEvent(FixedString { "Unknown database journal record: " } + FixedString::toString((unsigned int) type));
+				break;
+			}
+		}
+		if (!success) {
+			//probably a partially written record at the end
+			postLogEvent(FixedString { "Failed to read database journal record at index: " } + FixedString::toString(count));
+			break;
+		}
+		++count;
+	}
+	postLogEvent(FixedString { "Replayed database journal records: " } + FixedString::toString(count));
+	if (count == 0 && journal.getLength() > 0) {
+		//compact anyway, so new records are not appended after an unreadable record
+		count = 1;
+	}
+	journalRecordCount += count;
+}
+
+void LocalSapphireDataStorage::importLegacyDatabase(const LevelLoadLookup& levellookup) {
+	unsigned int count = 0;
+	postLogEvent("Loading users...");
+	auto&& userspath = usersDirectory.getPath();
+	for (auto&& dir : usersDirectory.enumerate()) {
+		if (!dir.isDirectory()) {
+			continue;
+		}
+		StorageSapphireUser* user = new StorageSapphireUser();
+		StorageDirectoryDescriptor userdir { userspath + dir };
+		if (!loadUser(userdir, user, levellookup)) {
+			postLogEvent("Failed to load user.");
+			delete user;
+		} else {
+			users.add(user);
+		}
+		if ((++count % 1000) == 0) {
+			postLogEvent(FixedString { "Loaded users: " } + FixedString::toString(count));
+		}
+	}
+	//sort once instead of inserting every user to its sorted position
+	users.sort([](const StorageSapphireUser& l, const StorageSapphireUser& r) {
+		return l.uuid < r.uuid;
+	});
+
+	postLogEvent("Loading hardwares...");
+	count = 0;
+	auto&& hardwarepath = hardwareDirectory.getPath();
+	for (auto&& dir : hardwareDirectory.enumerate()) {
+		if (!dir.isDirectory()) {
+			continue;
+		}
+		StorageUserHardware* hardware = new StorageUserHardware();
+		if (!SapphireUUID::fromString(&hardware->hardwareUUID, ((FilePath) dir).getURI())) {
+			delete hardware;
+			continue;
+		}
+		hardware->loadProgress(hardwarepath + dir, levelOrdinals);
+
+		hardwares.add(hardware);
+
+		if ((++count % 1000) == 0) {
+			postLogEvent(FixedString { "Loaded hardwares: " } + FixedString::toString(count));
+		}
+	}
+	hardwares.sort([](const StorageUserHardware& l, const StorageUserHardware& r) {
+		return l.hardwareUUID < r.hardwareUUID;
+	});
+}
+
+bool LocalSapphireDataStorage::writeDatabase() {
+	if (!databaseJournalsApplied) {
+		postLogEvent("Database journals are not loaded, not writing the table.");
+		return false;
+	}
+	StorageFileDescriptor compactingfd { databaseDirectory.getPath() + DATABASE_COMPACTING_JOURNAL_FILENAME };
+	{
+		MutexLocker jl { journalMutex };
+		//new records are appended to a fresh journal
+		closeJournalLocked();
+		//if a previous compaction failed, keep its journal, and include the current one in the next compaction
+		if (!compactingfd.exists()) {
+			StorageFileDescriptor journalfd { databaseDirectory.getPath() + DATABASE_JOURNAL_FILENAME };
+			if (!journalfd.exists() || journalfd.move(compactingfd)) {
+				journalRecordCount = 0;
+			}
+		}
+	}
+	if (!writeDatabaseTable()) {
+		//keep the moved journal, it is replayed after the previous table
+		return false;
+	}
+	//the table contains every record of the moved journal now, as they were applied to the state before it was moved
+	compactingfd.remove();
+	return true;
+}
+
+bool LocalSapphireDataStorage::openJournalLocked() {
+	if (journalOutput != nullptr) {
+		return true;
+	}
+	StorageFileDescriptor fd { databaseDirectory.getPath() + DATABASE_JOURNAL_FILENAME };
+	journalOutput = fd.createOutput();
+	journalOutput->setBufferSize(DATABASE_JOURNAL_BUFFER_SIZE);
+	journalOutput->setAppend(true);
+	if (!journalOutput->open()) {
+		postLogEvent("Failed to open database journal.");
+		delete journalOutput;
+		journalOutput = nullptr;
+		return false;
+	}
+	return true;
+}
+void LocalSapphireDataStorage::closeJournalLocked() {
+	if (journalOutput == nullptr) {
+		return;
+	}
+	journalOutput->flushBuffer();
+	journalOutput->flushDisk();
+	if (journalOutput->isError()) {
+		postLogEvent("Failed to write database journal.");
+	}
+	delete journalOutput;
+	journalOutput = nullptr;
+}
+
+void LocalSapphireDataStorage::journalRecordAppendedLocked() {
+	++journalRecordCount;
+	if (!journalFlushPosted) {
+		journalFlushPosted = databaseWriterThread.post([=] {
+			MutexLocker jl { journalMutex };
+			journalFlushPosted = false;
+			if (journalOutput != nullptr) {
+				journalOutput->flushBuffer();
+			}
+		});
+	}
+	if (journalRecordCount >= DATABASE_JOURNAL_COMPACT_RECORD_COUNT && !databaseCompactionPosted) {
+		databaseCompactionPosted = databaseWriterThread.post([=] {
+			postLogEvent("Compacting database journal...");
+			if (!writeDatabase()) {
+				postLogEvent("Failed to compact database journal.");
+			}
+			MutexLocker jl { journalMutex };
+			databaseCompactionPosted = false;
+		});
+	}
+}
+
+bool LocalSapphireDataStorage::writeDatabaseTable() {
+	//the entries are only added, never removed, so the pointers stay valid after the lists are unlocked
+	//the entries are then locked one by one, the storage stays usable while the table is written
+	unsigned int usercount;
+	StorageSapphireUser** userlist;
+	{
+		MutexLocker ul { usersMutex };
+		usercount = users.size();
+		userlist = new StorageSapphireUser*[usercount];
+		for (unsigned int i = 0; i < usercount; ++i) {
+			userlist[i] = users.get(i);
+		}
+	}
+	unsigned int hardwarecount;
+	StorageUserHardware** hardwarelist;
+	{
+		MutexLocker hl { hardwareMutex };
+		hardwarecount = hardwares.size();
+		hardwarelist = new StorageUserHardware*[hardwarecount];
+		for (unsigned int i = 0; i < hardwarecount; ++i) {
+			hardwarelist[i] = hardwares.get(i);
+		}
+	}
+
+	LevelCatalogSnapshot catalog;
+	{
+		MutexLocker l { levelsMutex };
+		catalog.epoch = levelCatalogEpoch;
+		catalog.sequence = levelCatalogSequence;
+		catalog.removedMinSequence = removedLevelsMinSequence;
+		for (auto* r : removedLevels) {
+			catalog.removed.add(new LevelCatalogSnapshot::Entry(r->levelUUID, r->catalogSequence));
+		}
+		for (auto* d : descriptors) {
+			catalog.levels.add(new LevelCatalogSnapshot::Entry(d->uuid, d->catalogSequence));
+		}
+	}
+
+	bool result = writeDatabaseTable(catalog, userlist, usercount, hardwarelist, hardwarecount);
+	delete[] userlist;
+	delete[] hardwarelist;
+	return result;
+}
+bool LocalSapphireDataStorage::writeDatabaseTable(const LevelCatalogSnapshot& catalog, StorageSapphireUser** userlist,
+		unsigned int usercount, StorageUserHardware** hardwarelist, unsigned int hardwarecount) {
+	StorageFileDescriptor tempfd { databaseDirectory.getPath() + DATABASE_TABLE_TEMP_FILENAME };
+	//output streams don't truncate the file
+	tempfd.remove();
+	{
+		auto* file = tempfd.createOutput();
+		file->setBufferSize(DATABASE_TABLE_WRITE_BUFFER_SIZE);
+		if (!file->open()) {
+			delete file;
+			return false;
+		}
+		DatabaseTableOutput tableout { *file };
+		auto&& os = EndianOutputStream<Endianness::Big>::wrap(tableout);
+		bool success = os.write(DATABASE_MAGIC, sizeof(DATABASE_MAGIC)) && os.serialize<uint32>(DATABASE_TABLE_VERSION);
+
+		success = success && os.serialize<SapphireUUID>(catalog.epoch) && os.serialize<uint32>(catalog.sequence)
+				&& os.serialize<uint32>(catalog.removedMinSequence) && os.serialize<uint32>(catalog.removed.size());
+		for (unsigned int i = 0; success && i < catalog.removed.size(); ++i) {
+			success = os.serialize<SapphireUUID>(catalog.removed[i].uuid) && os.serialize<uint32>(catalog.removed[i].sequence);
+		}
+		success = success && os.serialize<uint32>(catalog.levels.size());
+		for (unsigned int i = 0; success && i < catalog.levels.size(); ++i) {
+			success = os.serialize<SapphireUUID>(catalog.levels[i].uuid) && os.serialize<uint32>(catalog.levels[i].sequence);
+		}
+
+		uint64* useroffsets = new uint64[usercount];
+		for (unsigned int i = 0; success && i < usercount; ++i) {
+			auto&& u = *userlist[i];
+			MutexLocker ml = usersLockPool.locker(u.uuid);
+			useroffsets[i] = tableout.getPosition();
+			success = os.serialize<SapphireUUID>(u.uuid) && os.serialize<RegistrationToken>(u.registrationToken)
+					&& os.serialize<FixedString>(u.name) && os.serialize<SapphireDifficulty>(u.difficultyColor) && u.serializeRatings(os)
+					&& serializeUUIDList(os, u.uploadedLevels);
+		}
+		uint64* hardwareoffsets = new uint64[hardwarecount];
+		for (unsigned int i = 0; success && i < hardwarecount; ++i) {
+			auto&& h = *hardwarelist[i];
+			MutexLocker ml = hardwaresLockPool.locker(h.hardwareUUID);
+			hardwareoffsets[i] = tableout.getPosition();
+			success = os.serialize<SapphireUUID>(h.hardwareUUID) && os.serialize<ProgressSynchId>(h.progressId)
+					&& serializeLevelSet(os, h.seenLevels, levelOrdinals) && serializeLevelSet(os, h.finishedLevels, levelOrdinals)
+					&& os.serialize<uint32>(h.associatedHardwares.size());
+			for (auto* ah : h.associatedHardwares) {
+				success = success && os.serialize<SapphireUUID>(ah->hardwareUUID)
+						&& os.serialize<ProgressSynchId>(ah->synchronizedProgressCount);
+			}
+		}
+
+		const uint64 userindexoffset = tableout.getPosition();
+		for (unsigned int i = 0; success && i < usercount; ++i) {
+			success = os.serialize<SapphireUUID>(userlist[i]->uuid) && os.serialize<uint64>(useroffsets[i]);
+		}
+		const uint64 hardwareindexoffset = tableout.getPosition();
+		for (unsigned int i = 0; success && i < hardwarecount; ++i) {
+			success = os.serialize<SapphireUUID>(hardwarelist[i]->hardwareUUID) && os.serialize<uint64>(hardwareoffsets[i]);
+		}
+		delete[] useroffsets;
+		delete[] hardwareoffsets;
+
+		success = success && os.serialize<uint64>(userindexoffset) && os.serialize<uint32>(usercount)
+				&& os.serialize<uint64>(hardwareindexoffset) && os.serialize<uint32>(hardwarecount)
+				&& os.serialize<uint32>(DATABASE_TABLE_VERSION) && os.write(DATABASE_MAGIC, sizeof(DATABASE_MAGIC));
+
+		file->flushBuffer();
+		success = success && !file->isError();
+		if (success) {
+			file->flushDisk();
+			success = !file->isError();
+		}
+		delete file;
+		if (!success) {
+			postLogEvent("Failed to write database table file.");
+			tempfd.remove();
+			return false;
+		}
+	}
+	StorageFileDescriptor tablefd { databaseDirectory.getPath() + DATABASE_TABLE_FILENAME };
+	return tempfd.move(tablefd);
+}
+
+void LocalSapphireDataStorage::journalUserRegistered(const StorageSapphireUser& user) {
+	MutexLocker l { journalMutex };
+	if (!openJournalLocked()) {
+		return;
+	}
+	auto&& os = EndianOutputStream<Endianness::Big>::wrap(*journalOutput);
+	os.serialize<uint8>((uint8) DatabaseJournalRecord::USER_REGISTERED);
+	os.serialize<SapphireUUID>(user.uuid);
+	os.serialize<RegistrationToken>(user.registrationToken);
+	os.serialize<FixedString>(user.name);
+	os.serialize<SapphireDifficulty>(user.difficultyColor);
+	journalRecordAppendedLocked();
+}
+void LocalSapphireDataStorage::journalUserInfo(const StorageSapphireUser& user) {
+	MutexLocker l { journalMutex };
+	if (!openJournalLocked()) {
+		return;
+	}
+	auto&& os = EndianOutputStream<Endianness::Big>::wrap(*journalOutput);
+	os.serialize<uint8>((uint8) DatabaseJournalRecord::USER_INFO);
+	os.serialize<SapphireUUID>(user.uuid);
+	os.serialize<FixedString>(user.name);
+	os.serialize<SapphireDifficulty>(user.difficultyColor);
+	journalRecordAppendedLocked();
+}
+void LocalSapphireDataStorage::journalUserRating(const SapphireUUID& useruuid, const SapphireUUID& leveluuid, unsigned int rating) {
+	MutexLocker l { journalMutex };
+	if (!openJournalLocked()) {
+		return;
+	}
+	auto&& os = EndianOutputStream<Endianness::Big>::wrap(*journalOutput);
+	os.serialize<uint8>((uint8) DatabaseJournalRecord::USER_RATING);
+	os.serialize<SapphireUUID>(useruuid);
+	os.serialize<SapphireUUID>(leveluuid);
+	os.serialize<uint8>(rating);
+	journalRecordAppendedLocked();
+}
+void LocalSapphireDataStorage::journalUserUploadedLevel(const SapphireUUID& useruuid, const SapphireUUID& leveluuid) {
+	MutexLocker l { journalMutex };
+	if (!openJournalLocked()) {
+		return;
+	}
+	auto&& os = EndianOutputStream<Endianness::Big>::wrap(*journalOutput);
+	os.serialize<uint8>((uint8) DatabaseJournalRecord::USER_UPLOADED_LEVEL);
+	os.serialize<SapphireUUID>(useruuid);
+	os.serialize<SapphireUUID>(leveluuid);
+	journalRecordAppendedLocked();
+}
+void LocalSapphireDataStorage::journalHardwareCreated(const SapphireUUID& hardwareuuid) {
+	MutexLocker l { journalMutex };
+	if (!openJournalLocked()) {
+		return;
+	}
+	auto&& os = EndianOutputStream<Endianness::Big>::wrap(*journalOutput);
+	os.serialize<uint8>((uint8) DatabaseJournalRecord::HARDWARE_CREATED);
+	os.serialize<SapphireUUID>(hardwareuuid);
+	journalRecordAppendedLocked();
+}
+void LocalSapphireDataStorage::journalHardwareProgress(const SapphireUUID& hardwareuuid, const SapphireUUID& leveluuid,
+		SapphireLevelProgress progress, ProgressSynchId progressid) {
+	MutexLocker l { journalMutex };
+	if (!openJournalLocked()) {
+		return;
+	}
+	auto&& os = EndianOutputStream<Endianness::Big>::wrap(*journalOutput);
+	os.serialize<uint8>((uint8) DatabaseJournalRecord::HARDWARE_PROGRESS);
+	os.serialize<SapphireUUID>(hardwareuuid);
+	os.serialize<SapphireUUID>(leveluuid);
+	os.serialize<uint32>((uint32) progress);
+	os.serialize<ProgressSynchId>(progressid);
+	journalRecordAppendedLocked();
+}
+void LocalSapphireDataStorage::journalHardwareAssociations(const StorageUserHardware& hardware) {
+	MutexLocker l { journalMutex };
+	if (!openJournalLocked()) {
+		return;
+	}
+	auto&& os = EndianOutputStream<Endianness::Big>::wrap(*journalOutput);
+	os.serialize<uint8>((uint8) DatabaseJournalRecord::HARDWARE_ASSOCIATIONS);
+	os.serialize<SapphireUUID>(hardware.hardwareUUID);
+	os.serialize<uint32>(hardware.associatedHardwares.size());
+	for (unsigned int i = 0; i < hardware.associatedHardwares.size(); ++i) {
+		auto&& ah = hardware.associatedHardwares[i];
+		os.serialize<SapphireUUID>(ah.hardwareUUID);
+		os.serialize<ProgressSynchId>(ah.synchronizedProgressCount);
+	}
+	journalRecordAppendedLocked();
+}
+void LocalSapphireDataStorage::journalLevelCatalog(DatabaseJournalRecord type, const SapphireUUID& leveluuid, uint32 sequence) {
+	MutexLocker l { journalMutex };
+	if (!openJournalLocked()) {
+		return;
+	}
+	auto&& os = EndianOutputStream<Endianness::Big>::wrap(*journalOutput);
+	os.serialize<uint8>((uint8) type);
+	os.serialize<SapphireUUID>(leveluuid);
+	os.serialize<uint32>(sequence);
+	journalRecordAppendedLocked();
+}
+
+} // namespace userapp
@@ -0,0 +1,217 @@
+/*
+ * Copyright (C) 2020 Bence Sipka
+ *
+ * This program is free software: you can redistribute it and/or modify 
+ * it under the terms of the GNU General Public License as published by 
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/*
+ * StorageLevelOrdinals.cpp
+ *
+ *  Created on: 2026. okt. 19.
+ *      Author: sipka
+ */
+
+#include <sapphireserver/storage/local/StorageLevelOrdinals.h>
+
+#include <gen/log.h>
+
+#include <string.h>
+
+namespace userapp {
+
+#define ORDINAL_TABLE_INITIAL_CAPACITY 256
+
+static unsigned int hashLevelUUID(const SapphireUUID& uuid) {
+	//the UUIDs are random, any of their bytes are usable as a hash
+	const unsigned char* data = uuid.getData();
+	return ((unsigned int) data[0] << 24) | ((unsigned int) data[1] << 16) | ((unsigned int) data[2] << 8) | data[3];
+}
+
+StorageLevelOrdinalTable::HashTable::HashTable(unsigned int capacity, HashTable* previous)
+		: capacity(capacity), slots(new std::atomic<Entry*>[capacity]), previous(previous) {
+	for (unsigned int i = 0; i < capacity; ++i) {
+		slots[i].store(nullptr, std::memory_order_relaxed);
+	}
+}
+StorageLevelOrdinalTable::HashTable::~HashTable() {
+	delete[] slots;
+	delete previous;
+}
+
+StorageLevelOrdinalTable::Entry* StorageLevelOrdinalTable::HashTable::find(const SapphireUUID& uuid) const {
+	unsigned int mask = capacity - 1;
+	for (unsigned int i = hashLevelUUID(uuid) & mask;; i = (i + 1) & mask) {
+		Entry* e = slots[i].load(std::memory_order_acquire);
+		if (e == nullptr) {
+			return nullptr;
+		}
+		if (e->uuid == uuid) {
+			return e;
+		}
+	}
+}
+void StorageLevelOrdinalTable::HashTable::insert(Entry* entry) {
+	unsigned int mask = capacity - 1;
+	unsigned int i = hashLevelUUID(entry->uuid) & mask;
+	while (slots[i].load(std::memory_order_relaxed) != nullptr) {
+		i = (i + 1) & mask;
+	}
+	slots[i].store(entry, std::memory_order_release);
+}
+
+StorageLevelOrdinalTable::~StorageLevelOrdinalTable() {
+	delete table.load(std::memory_order_relaxed);
+}
+
+uint32 StorageLevelOrdinalTable::getOrdinal(const SapphireUUID& uuid) {
+	HashTable* t = table.load(std::memory_order_acquire);
+	if (t != nullptr) {
+		Entry* e = t->find(uuid);
+		if (e != nullptr) {
+			return e->ordinal;
+		}
+	}
+	MutexLocker l { mutex };
+	t = table.load(std::memory_order_relaxed);
+	if (t != nullptr) {
+		//may have been inserted since, or into a grown table
+		Entry* e = t->find(uuid);
+		if (e != nullptr) {
+			return e->ordinal;
+		}
+	}
+	uint32 ordinal = entries.size();
+	Entry* entry = new Entry(uuid, ordinal);
+	entries.add(entry);
+	if (t == nullptr || entries.size() * 2 > t->capacity) {
+		//keep the load factor at most 1/2, so the probe sequences stay short
+		HashTable* nt = new HashTable(t == nullptr ? ORDINAL_TABLE_INITIAL_CAPACITY : t->capacity * 2, t);
+		for (auto* e : entries) {
+			nt->insert(e);
+		}
+		table.store(nt, std::memory_order_release);
+	} else {
+		t->insert(entry);
+	}
+	return ordinal;
+}
+SapphireUUID StorageLevelOrdinalTable::getUUID(uint32 ordinal) {
+	MutexLocker l { mutex };
+	ASSERT(ordinal < entries.size()) << ordinal;
+	return entries[ordinal].uuid;
+}
+
+StorageLevelOrdinalSet& StorageLevelOrdinalSet::operator=(StorageLevelOrdinalSet&& o) {
+	ASSERT(this != &o);
+	delete[] values;
+	delete[] bits;
+	this->values = o.values;
+	this->bits = o.bits;
+	this->count = o.count;
+	this->capacity = o.capacity;
+	o.values = nullptr;
+	o.bits = nullptr;
+	o.count = 0;
+	o.capacity = 0;
+	return *this;
+}
+
+bool StorageLevelOrdinalSet::contains(uint32 ordinal) const {
+	if (bits != nullptr) {
+		unsigned int word = ordinal / 64;
+		return word < capacity && ((bits[word] >> (ordinal % 64)) & 1) != 0;
+	}
+	unsigned int low = 0;
+	unsigned int high = count;
+	while (low < high) {
+		unsigned int mid = low + (high - low) / 2;
+		if (values[mid] < ordinal) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+	return low < count && values[low] == ordinal;
+}
+
+bool StorageLevelOrdinalSet::add(uint32 ordinal) {
+	if (bits != nullptr) {
+		unsigned int word = ordinal / 64;
+		if (word >= capacity) {
+			growBitmap(word + 1);
+		}
+		uint64 mask = (uint64) 1 << (ordinal % 64);
+		if ((bits[word] & mask) != 0) {
+			return false;
+		}
+		bits[word] |= mask;
+		++count;
+		return true;
+	}
+	unsigned int low = 0;
+	unsigned int high = count;
+	while (low < high) {
+		unsigned int mid = low + (high - low) / 2;
+		if (values[mid] < ordinal) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+	if (low < count && values[low] == ordinal) {
+		return false;
+	}
+	uint32 maxordinal = count > 0 && values[count - 1] > ordinal ? values[count - 1] : ordinal;
+	unsigned int wordcount = maxordinal / 64 + 1;
+	if ((count + 1) * sizeof(uint32) > wordcount * sizeof(uint64)) {
+		convertToBitmap(wordcount);
+		return add(ordinal);
+	}
+	if (count == capacity) {
+		unsigned int ncapacity = capacity == 0 ? 4 : capacity * 2;
+		uint32* nvalues = new uint32[ncapacity];
+		memcpy(nvalues, values, count * sizeof(uint32));
+		delete[] values;
+		values = nvalues;
+		capacity = ncapacity;
+	}
+	memmove(values + low + 1, values + low, (count - low) * sizeof(uint32));
+	values[low] = ordinal;
+	++count;
+	return true;
+}
+
+void StorageLevelOrdinalSet::convertToBitmap(unsigned int wordcount) {
+	bits = new uint64[wordcount];
+	memset(bits, 0, wordcount * sizeof(uint64));
+	for (unsigned int i = 0; i < count; ++i) {
+		bits[values[i] / 64] |= (uint64) 1 << (values[i] % 64);
+	}
+	delete[] values;
+	values = nullptr;
+	capacity = wordcount;
+}
+
+void StorageLevelOrdinalSet::growBitmap(unsigned int wordcount) {
+	unsigned int ncapacity = capacity + capacity / 2;
+	if (ncapacity < wordcount) {
+		ncapacity = wordcount;
+	}
+	uint64* nbits = new uint64[ncapacity];
+	memcpy(nbits, bits, capacity * sizeof(uint64));
+	memset(nbits + capacity, 0, (ncapacity - capacity) * sizeof(uint64));
+	delete[] bits;
+	bits = nbits;
+	capacity = ncapacity;
+}
+
+}  // namespace userapp
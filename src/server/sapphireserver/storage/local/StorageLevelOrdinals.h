@@ -0,0 +1,159 @@
+/*
+ * Copyright (C) 2020 Bence Sipka
+ *
+ * This program is free software: you can redistribute it and/or modify 
+ * it under the terms of the GNU General Public License as published by 
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/*
+ * StorageLevelOrdinals.h
+ *
+ *  Created on: 2026. okt. 19.
+ *      Author: sipka
+ */
+
+#ifndef SAPPHIRESERVER_STORAGE_LOCAL_STORAGELEVELORDINALS_H_
+#define SAPPHIRESERVER_STORAGE_LOCAL_STORAGELEVELORDINALS_H_
+
+#include <framework/utils/ArrayList.h>
+#include <framework/threading/Mutex.h>
+
+#include <sapphire/level/SapphireUUID.h>
+
+#include <gen/fwd/types.h>
+
+#include <atomic>
+
+namespace userapp {
+using namespace rhfw;
+
+/**
+ * Assigns dense ordinals to level UUIDs, so sets of levels can be stored as bitmaps.
+ * Ordinals are assigned on first use and never released. They are not persisted, the sets are written as UUIDs.
+ * Looking up an already assigned ordinal doesn't lock, the mutex is only used when inserting.
+ */
+class StorageLevelOrdinalTable {
+private:
+	class Entry {
+	public:
+		SapphireUUID uuid;
+		uint32 ordinal;
+
+		Entry(const SapphireUUID& uuid, uint32 ordinal)
+				: uuid(uuid), ordinal(ordinal) {
+		}
+	};
+	/**
+	 * Open addressing hash table, the slots are only set once.
+	 * Grown tables are kept until destruction, as concurrent lookups may still use them.
+	 */
+	class HashTable {
+	public:
+		unsigned int capacity;
+		std::atomic<Entry*>* slots;
+		HashTable* previous;
+
+		HashTable(unsigned int capacity, HashTable* previous);
+		~HashTable();
+
+		Entry* find(const SapphireUUID& uuid) const;
+		void insert(Entry* entry);
+	};
+	Mutex mutex { Mutex::auto_init { } };
+	std::atomic<HashTable*> table { nullptr };
+	/**
+	 * Indexed by ordinal, modified only when locked.
+	 */
+	ArrayList<Entry> entries;
+public:
+	StorageLevelOrdinalTable() {
+	}
+	StorageLevelOrdinalTable(const StorageLevelOrdinalTable&) = delete;
+	StorageLevelOrdinalTable& operator=(const StorageLevelOrdinalTable&) = delete;
+	~StorageLevelOrdinalTable();
+
+	uint32 getOrdinal(const SapphireUUID& uuid);
+	SapphireUUID getUUID(uint32 ordinal);
+};
+
+/**
+ * Set of level ordinals.
+ * Sparse sets are stored as a sorted array, which is converted to a bitmap when that becomes the smaller representation,
+ * similar to the containers of roaring bitmaps. Elements are never removed.
+ */
+class StorageLevelOrdinalSet {
+private:
+	/**
+	 * Sorted ordinals if the set is not a bitmap.
+	 */
+	uint32* values = nullptr;
+	uint64* bits = nullptr;
+	unsigned int count = 0;
+	/**
+	 * Element count of values, or word count of bits.
+	 */
+	unsigned int capacity = 0;
+
+	void convertToBitmap(unsigned int wordcount);
+	void growBitmap(unsigned int wordcount);
+public:
+	StorageLevelOrdinalSet() {
+	}
+	StorageLevelOrdinalSet(const StorageLevelOrdinalSet&) = delete;
+	StorageLevelOrdinalSet& operator=(const StorageLevelOrdinalSet&) = delete;
+	StorageLevelOrdinalSet(StorageLevelOrdinalSet&& o)
+			: values(o.values), bits(o.bits), count(o.count), capacity(o.capacity) {
+		o.values = nullptr;
+		o.bits = nullptr;
+		o.count = 0;
+		o.capacity = 0;
+	}
+	StorageLevelOrdinalSet& operator=(StorageLevelOrdinalSet&& o);
+	~StorageLevelOrdinalSet() {
+		delete[] values;
+		delete[] bits;
+	}
+
+	bool contains(uint32 ordinal) const;
+	/**
+	 * Returns true if the ordinal was not present in the set.
+	 */
+	bool add(uint32 ordinal);
+
+	unsigned int size() const {
+		return count;
+	}
+	bool isBitmap() const {
+		return bits != nullptr;
+	}
+
+	/**
+	 * Calls the handler with every ordinal in ascending order.
+	 */
+	template<typename Handler>
+	void forEach(Handler&& handler) const {
+		if (bits != nullptr) {
+			for (unsigned int i = 0; i < capacity; ++i) {
+				for (uint64 word = bits[i]; word != 0; word &= word - 1) {
+					handler((uint32) (i * 64 + __builtin_ctzll(word)));
+				}
+			}
+		} else {
+			for (unsigned int i = 0; i < count; ++i) {
+				handler(values[i]);
+			}
+		}
+	}
+};
+
+}  // namespace userapp
+
+#endif /* SAPPHIRESERVER_STORAGE_LOCAL_STORAGELEVELORDINALS_H_ */
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2020 Bence Sipka
+ *
+ * This program is free software: you can redistribute it and/or modify 
+ * it under the terms of the GNU General Public License as published by 
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/*
+ * StorageMappedFile.cpp
+ *
+ *  Created on: 2026. okt. 19.
+ *      Author: sipka
+ */
+
+#include <sapphireserver/storage/local/StorageMappedFile.h>
+
+#include <gen/log.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace userapp {
+
+StorageMappedFile::StorageMappedFile(StorageFileDescriptor& fd) {
+	int filedesc = ::open(fd.getPath().getURI(), O_RDONLY);
+	if (filedesc < 0) {
+		return;
+	}
+	struct stat st;
+	if (::fstat(filedesc, &st) != 0 || st.st_size <= 0 || (unsigned long long) st.st_size > 0xFFFFFFFFull) {
+		::close(filedesc);
+		return;
+	}
+	void* addr = ::mmap(nullptr, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, filedesc, 0);
+	::close(filedesc);
+	if (addr != MAP_FAILED) {
+		//we read the file from start to end
+		::madvise(addr, (size_t) st.st_size, MADV_SEQUENTIAL);
+		data = static_cast<const char*>(addr);
+		length = (unsigned int) st.st_size;
+		mapped = true;
+		return;
+	}
+	LOGW()<< "Failed to map file: " << fd.getPath().getURI() << " errno: " << strerror(errno);
+	unsigned int len;
+	const char* read = fd.readFully(&len);
+	if (read != nullptr) {
+		data = read;
+		length = len;
+	}
+}
+
+StorageMappedFile& StorageMappedFile::operator=(StorageMappedFile&& o) {
+	ASSERT(this != &o) << "self move assignment";
+	release();
+	this->data = o.data;
+	this->length = o.length;
+	this->mapped = o.mapped;
+	o.data = nullptr;
+	o.length = 0;
+	o.mapped = false;
+	return *this;
+}
+
+void StorageMappedFile::release() {
+	if (data == nullptr) {
+		return;
+	}
+	if (mapped) {
+		int res = ::munmap(const_cast<char*>(data), length);
+		ASSERT(res == 0) << "munmap failed: " << strerror(errno);
+	} else {
+		delete[] data;
+	}
+	data = nullptr;
+	length = 0;
+	mapped = false;
+}
+
+}  // namespace userapp
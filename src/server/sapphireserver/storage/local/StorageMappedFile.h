@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2020 Bence Sipka
+ *
+ * This program is free software: you can redistribute it and/or modify 
+ * it under the terms of the GNU General Public License as published by 
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/*
+ * StorageMappedFile.h
+ *
+ *  Created on: 2026. okt. 19.
+ *      Author: sipka
+ */
+
+#ifndef SAPPHIRESERVER_STORAGE_LOCAL_STORAGEMAPPEDFILE_H_
+#define SAPPHIRESERVER_STORAGE_LOCAL_STORAGEMAPPEDFILE_H_
+
+#include <framework/io/files/StorageFileDescriptor.h>
+#include <framework/utils/MemoryInput.h>
+
+#include <gen/fwd/types.h>
+
+namespace userapp {
+using namespace rhfw;
+
+/**
+ * Read-only memory mapping of a storage file.
+ * The server only runs on linux, so this uses mmap directly. If mapping fails, the file is read fully instead.
+ */
+class StorageMappedFile {
+private:
+	const char* data = nullptr;
+	unsigned int length = 0;
+	bool mapped = false;
+
+	void release();
+public:
+	StorageMappedFile() {
+	}
+	StorageMappedFile(StorageFileDescriptor& fd);
+	StorageMappedFile(const StorageMappedFile&) = delete;
+	StorageMappedFile& operator=(const StorageMappedFile&) = delete;
+	StorageMappedFile(StorageMappedFile&& o)
+			: data(o.data), length(o.length), mapped(o.mapped) {
+		o.data = nullptr;
+		o.length = 0;
+		o.mapped = false;
+	}
+	StorageMappedFile& operator=(StorageMappedFile&& o);
+	~StorageMappedFile() {
+		release();
+	}
+
+	const char* getData() const {
+		return data;
+	}
+	unsigned int getLength() const {
+		return length;
+	}
+	bool isValid() const {
+		return data != nullptr;
+	}
+
+	/**
+	 * Creates an input for the bytes starting at the given offset till the end of the file.
+	 */
+	MemoryInput<const char> inputAt(uint64 offset) const {
+		if (offset >= length) {
+			return MemoryInput<const char> { data + length, 0 };
+		}
+		return MemoryInput<const char> { data + offset, (unsigned int) (length - offset) };
+	}
+};
+
+}  // namespace userapp
+
+#endif /* SAPPHIRESERVER_STORAGE_LOCAL_STORAGEMAPPEDFILE_H_ */
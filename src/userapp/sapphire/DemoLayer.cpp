@@ -20,6 +20,7 @@
  *      Author: sipka
  */
 
+#include <framework/core/Profiler.h>
 #include <framework/geometry/Matrix.h>
 #include <framework/geometry/Vector.h>
 #include <framework/io/key/KeyEvent.h>
@@ -268,7 +269,10 @@ unsigned int DemoLayer::advanceTurns(long long ms, long long turnms, unsigned in
 	while (turnPercent >= 1.0f && result < maxturns) {
 		++result;
 		turnPercent -= 1.0f;
-		goToNextTurn();
+		{
+			PROFILE_ZONE("DemoLayer::goToNextTurn");
+			goToNextTurn();
+		}
 
 		sounder.playSoundsForTurn();
 		int overturn = getOverTurns();
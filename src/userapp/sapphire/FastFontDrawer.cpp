@@ -22,8 +22,80 @@
 
 #include <sapphire/FastFontDrawer.h>
 
+#include <string.h>
+
 namespace userapp {
 
+static unsigned int hashGlyphRun(const char* begin, const char* end, float size, Gravity gravity) {
+	//FNV-1a
+	unsigned int hash = 2166136261u;
+	for (const char* it = begin; it != end; ++it) {
+		hash = (hash ^ (unsigned char) *it) * 16777619u;
+	}
+	uint32 sizebits;
+	memcpy(&sizebits, &size, sizeof(sizebits));
+	hash = (hash ^ sizebits) * 16777619u;
+	hash = (hash ^ (unsigned int) gravity) * 16777619u;
+	return hash;
+}
+
+const FastFontDrawerPool::GlyphRun* FastFontDrawerPool::getGlyphRun(const char* begin, const char* end, float size, Gravity gravity) {
+	const unsigned int length = end - begin;
+	if (length > GLYPH_RUN_MAX_LENGTH) {
+		return nullptr;
+	}
+	Font* f = font;
+	if (glyphRuns == nullptr) {
+		glyphRuns = new GlyphRun[GLYPH_RUN_CACHE_SETS * GLYPH_RUN_CACHE_WAYS];
+		glyphRunFont = f;
+	} else if (glyphRunFont != f) {
+		for (unsigned int i = 0; i < GLYPH_RUN_CACHE_SETS * GLYPH_RUN_CACHE_WAYS; ++i) {
+			glyphRuns[i].valid = false;
+		}
+		glyphRunFont = f;
+	}
+	const unsigned int hash = hashGlyphRun(begin, end, size, gravity);
+	GlyphRun* set = glyphRuns + (hash % GLYPH_RUN_CACHE_SETS) * GLYPH_RUN_CACHE_WAYS;
+	GlyphRun* victim = set;
+	++glyphRunClock;
+	for (unsigned int i = 0; i < GLYPH_RUN_CACHE_WAYS; ++i) {
+		GlyphRun& run = set[i];
+		if (!run.valid) {
+			victim = &run;
+			continue;
+		}
+		if (run.hash == hash && run.length == length && run.size == size && run.gravity == gravity
+				&& memcmp(run.text, begin, length) == 0) {
+			run.lastUsed = glyphRunClock;
+			return &run;
+		}
+		//unsigned difference, so the clock may wrap around
+		if (victim->valid && glyphRunClock - run.lastUsed > glyphRunClock - victim->lastUsed) {
+			victim = &run;
+		}
+	}
+	GlyphRun& run = *victim;
+	if (run.vertexCapacity < length * 4) {
+		delete[] run.vertices;
+		run.vertexCapacity = length * 4;
+		run.vertices = new GlyphVertex[run.vertexCapacity];
+	}
+	run.lastUsed = glyphRunClock;
+	run.hash = hash;
+	run.length = length;
+	run.size = size;
+	run.gravity = gravity;
+	memcpy(run.text, begin, length);
+	run.measuredWidth = f->measureText(begin, end, size);
+	f->fillBufferDataWithCharacters(begin, end, run.vertices, size, Vector2F { 0.0f, 0.0f }, gravity, run.measuredWidth,
+			[](GlyphVertex& v, const Vector2F& pos, const Vector2F& tex) {
+				v.position = pos;
+				v.texcoord = tex;
+			});
+	run.valid = true;
+	return &run;
+}
+
 void FastFontDrawerPool::prepare(Resource<Font> font, const Matrix2D& mvp) {
 	this->font = font;
 	textu->update( { &font->getTexture() });
@@ -50,6 +122,25 @@ void FastFontDrawerPool::commit() {
 	}
 }
 
+float FastFontDrawer::add(const char* begin, const char* end, const Color& color, const Vector2F& pos, float size, Gravity gravity) {
+	auto* run = pool.getGlyphRun(begin, end, size, gravity);
+	if (run == nullptr) {
+		const float pxwidth = pool.font->measureText(begin, end, size);
+		return add(begin, end, color, pos, size, gravity, pxwidth);
+	}
+	ensureCapacity(run->length);
+	auto* out = (SimpleFontShader::VertexInput*) &initer[index];
+	const unsigned int vertexcount = run->length * 4;
+	for (unsigned int i = 0; i < vertexcount; ++i) {
+		const GlyphVertex& v = run->vertices[i];
+		out[i].a_position = Vector4F { v.position.x() + pos.x(), v.position.y() + pos.y(), 0.0f, 1.0f };
+		out[i].a_texcoord = v.texcoord;
+		out[i].a_color = color;
+	}
+	index += vertexcount;
+	return run->measuredWidth;
+}
+
 void FastFontDrawer::commit() {
 	if (index == 0) {
 		return;
@@ -33,12 +33,64 @@
 #include <appmain.h>
 #include <QuadIndexBuffer.h>
 
+#include <string.h>
+
 namespace userapp {
 using namespace rhfw;
 
 class FastFontDrawer;
 class FastFontDrawerPool {
 	friend class FastFontDrawer;
+public:
+	/**
+	 * The laid out texts are cached in a set associative cache, the least recently used run of a set is replaced.
+	 * A scrolled level list draws a few hundred texts, which fit in the cache. The vertices of a run are allocated for the
+	 * length of its text, so the cache takes at most 2 MB if every run is GLYPH_RUN_MAX_LENGTH long, usually much less.
+	 */
+	static const unsigned int GLYPH_RUN_CACHE_SETS = 128;
+	static const unsigned int GLYPH_RUN_CACHE_WAYS = 4;
+	/**
+	 * Longer texts are not cached.
+	 */
+	static const unsigned int GLYPH_RUN_MAX_LENGTH = 64;
+private:
+	class GlyphVertex {
+	public:
+		Vector2F position;
+		Vector2F texcoord;
+	};
+	/**
+	 * A text laid out relative to the drawing position.
+	 */
+	class GlyphRun {
+	public:
+		unsigned int hash = 0;
+		unsigned int length = 0;
+		float size = 0.0f;
+		Gravity gravity = Gravity::LEFT;
+		float measuredWidth = 0.0f;
+		bool valid = false;
+		/**
+		 * The value of the pool clock when the run was last used.
+		 */
+		unsigned int lastUsed = 0;
+		char text[GLYPH_RUN_MAX_LENGTH];
+		unsigned int vertexCapacity = 0;
+		GlyphVertex* vertices = nullptr;
+
+		GlyphRun() = default;
+		GlyphRun(const GlyphRun&) = delete;
+		GlyphRun& operator=(const GlyphRun&) = delete;
+		~GlyphRun() {
+			delete[] vertices;
+		}
+	};
+
+	GlyphRun* glyphRuns = nullptr;
+	Font* glyphRunFont = nullptr;
+	unsigned int glyphRunClock = 0;
+
+	const GlyphRun* getGlyphRun(const char* begin, const char* end, float size, Gravity gravity);
 public:
 	AutoResource<Font> font;
 
@@ -49,6 +101,11 @@ public:
 
 	FastFontDrawerPool() {
 	}
+	FastFontDrawerPool(const FastFontDrawerPool&) = delete;
+	FastFontDrawerPool& operator=(const FastFontDrawerPool&) = delete;
+	~FastFontDrawerPool() {
+		delete[] glyphRuns;
+	}
 	void prepare(Resource<Font> font, const Matrix2D& mvp);
 	void commit();
 
@@ -96,14 +153,17 @@ public:
 
 	void commit();
 
-	float add(const char* begin, const char* end, const Color& color, const Vector2F& pos, float size, Gravity gravity, float measuredlen) {
-		unsigned int length = end - begin;
+	void ensureCapacity(unsigned int length) {
 		ASSERT(length * 4 < charCount);
 		if (length * 4 + index > charCount * 4) {
 			unsigned int oldcc = charCount;
 			commit();
 			prepare(oldcc);
 		}
+	}
+
+	float add(const char* begin, const char* end, const Color& color, const Vector2F& pos, float size, Gravity gravity, float measuredlen) {
+		ensureCapacity(end - begin);
 		pool.font->fillBufferDataWithCharacters(begin, end, (SimpleFontShader::VertexInput*) &initer[index], size, pos, gravity,
 				measuredlen, [&](SimpleFontShader::VertexInput& i, const Vector2F& pos, const Vector2F& tex) {
 					i.a_position = Vector4F {pos.xy(), 0.0f, 1.0f};
@@ -114,15 +174,10 @@ public:
 		return measuredlen;
 	}
 
-	float add(const char* begin, const char* end, const Color& color, const Vector2F& pos, float size, Gravity gravity) {
-		const float pxwidth = pool.font->measureText(begin, end, size);
-		return add(begin, end, color, pos, size, gravity, pxwidth);
-	}
+	float add(const char* begin, const char* end, const Color& color, const Vector2F& pos, float size, Gravity gravity);
 
 	float add(const char* text, const Color& color, const Vector2F& pos, float size, Gravity gravity) {
-		unsigned int len = 0;
-		const float pxwidth = pool.font->measureText(text, size, &len);
-		return add(text, text + len, color, pos, size, gravity, pxwidth);
+		return add(text, text + strlen(text), color, pos, size, gravity);
 	}
 
 	Resource<Font> getFont() {
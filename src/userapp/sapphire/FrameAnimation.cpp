@@ -20,15 +20,26 @@
  *      Author: sipka
  */
 
+#include <framework/io/files/AssetFileDescriptor.h>
+#include <framework/io/stream/InputStream.h>
 #include <framework/resource/ResourceManager.h>
+#include <framework/utils/MemoryInput.h>
 #include <framework/xml/XmlAttributes.h>
 #include <framework/xml/XmlNode.h>
 #include <framework/xml/XmlParser.h>
 #include <gen/assets.h>
 #include <gen/log.h>
 #include <gen/resources.h>
+#include <gen/serialize.h>
 #include <gen/xmldecl.h>
 #include <sapphire/FrameAnimation.h>
+#include <appmain.h>
+
+#include <string.h>
+
+#define FRAME_ANIMATION_TABLE_VERSION 1
+//texture index, left, top, right, bottom
+#define FRAME_ANIMATION_TABLE_ENTRY_SIZE (5 * 4)
 
 using namespace userapp;
 LINK_XML(FrameAnimationElement, FrameAnimation::Element)
@@ -45,10 +56,9 @@ template<>
 void* getChild<RXml::Elem::FrameAnimation>(const xml::XmlNode& parent, const xml::XmlNode& child, const xml::XmlAttributes& attributes) {
 	userapp::FrameAnimation* thiz = parent;
 	ASSERT(child.dynamicType == RXml::Elem::FrameAnimationElement);
-	auto&& elemres = thiz->elements[child.index];
-	auto* elem = new FrameAnimation::Element(attributes);
-	elemres = Resource<FrameAnimation::Element> { new ResourceBlock(elem) };
-	return elem;
+	auto& elem = thiz->elements[child.index];
+	elem.applyAttributes(attributes);
+	return &elem;
 }
 template<>
 bool addChild<RXml::Elem::FrameAnimation>(const xml::XmlNode& parent, const xml::XmlNode& child) {
@@ -80,12 +90,84 @@ FrameAnimation::FrameAnimation(ResId resid)
 FrameAnimation::~FrameAnimation() {
 }
 
+bool FrameAnimation::loadTable(const char* data, unsigned int length) {
+	MemoryInput<const char> in { data, length };
+	auto&& is = EndianInputStream<Endianness::Big>::wrap(in);
+
+	char magic[4];
+	uint32 version;
+	uint32 texturecount;
+	if (is.read(magic, 4) != 4 || memcmp(magic, "RHFA", sizeof(magic)) != 0 || !is.deserialize<uint32>(version)
+			|| version != FRAME_ANIMATION_TABLE_VERSION || !is.deserialize<uint32>(texturecount)
+			|| texturecount > in.getLength() / sizeof(uint32)) {
+		LOGW()<< "Invalid frame animation table header: " << resid;
+		return false;
+	}
+	Resource<render::Texture>* textures = new Resource<render::Texture> [texturecount];
+	for (unsigned int i = 0; i < texturecount; ++i) {
+		ResId textureres;
+		if (!is.deserialize<ResId>(textureres)) {
+			LOGW()<< "Frame animation table is truncated: " << resid;
+			delete[] textures;
+			return false;
+		}
+		textures[i] = getTexture(textureres);
+	}
+	uint32 framecount;
+	//the length of the memory input is the remaining byte count
+	if (!is.deserialize<uint32>(framecount) || framecount == 0 || framecount > in.getLength() / FRAME_ANIMATION_TABLE_ENTRY_SIZE) {
+		LOGW()<< "Frame animation table is truncated: " << resid;
+		delete[] textures;
+		return false;
+	}
+	elements = new Element[framecount];
+	childCount = framecount;
+	for (unsigned int i = 0; i < framecount; ++i) {
+		uint32 textureindex;
+		Element& elem = elements[i];
+		if (!is.deserialize<uint32>(textureindex) || !is.deserialize<float>(elem.pos.left) || !is.deserialize<float>(elem.pos.top)
+				|| !is.deserialize<float>(elem.pos.right) || !is.deserialize<float>(elem.pos.bottom)) {
+			LOGW()<< "Frame animation table is truncated: " << resid;
+			delete[] textures;
+			return false;
+		}
+		if (textureindex >= texturecount) {
+			LOGW()<< "Invalid texture index in frame animation table: " << resid;
+			delete[] textures;
+			return false;
+		}
+		elem.texture = textures[textureindex];
+	}
+	delete[] textures;
+	return true;
+}
+
 bool FrameAnimation::load() {
-	//TODO error handling on xml
-	xml::XmlNode node;
-	node.param = this;
-	XmlParser::parseXmlAsset(ResourceManager::idToFile(resid), &node);
-	//TODO element error check
+	//frame animations are usually compiled to a table, fall back to xml parsing for the others
+	AssetFileDescriptor fd { ResourceManager::idToFile(resid) };
+	unsigned int length;
+	char* data = fd.readFully(&length);
+	if (data == nullptr) {
+		return false;
+	}
+	bool success;
+	if (length >= 4 && memcmp(data, "RHFA", 4) == 0) {
+		success = loadTable(data, length);
+	} else {
+		//TODO error handling on xml
+		xml::XmlNode node;
+		node.param = this;
+		XmlParser parser;
+		parser.parseXml(data, length, &node);
+		success = true;
+	}
+	delete[] data;
+	if (!success) {
+		delete[] elements;
+		elements = nullptr;
+		childCount = 0;
+		return false;
+	}
 	for (unsigned int i = 0; i < childCount; ++i) {
 		elements[i].load();
 	}
@@ -97,10 +179,12 @@ void FrameAnimation::free() {
 		elements[i].free();
 	}
 	delete[] elements;
+	elements = nullptr;
+	childCount = 0;
 }
 
 void FrameAnimation::applyAttributes(unsigned int childcount, const xml::XmlAttributes& attrs) {
-	elements = new Resource<Element> [childcount];
+	elements = new Element[childcount];
 	this->childCount = childcount;
 }
 
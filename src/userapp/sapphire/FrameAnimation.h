@@ -85,7 +85,9 @@ public:
 private:
 	ResId resid;
 	unsigned int childCount = 0;
-	Resource<Element>* elements = nullptr;
+	Element* elements = nullptr;
+
+	bool loadTable(const char* data, unsigned int length);
 protected:
 
 	virtual bool load() override;
@@ -0,0 +1,208 @@
+/*
+ * Copyright (C) 2020 Bence Sipka
+ *
+ * This program is free software: you can redistribute it and/or modify 
+ * it under the terms of the GNU General Public License as published by 
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/*
+ * LevelPrefetcher.cpp
+ *
+ *  Created on: 2026. okt. 19.
+ *      Author: sipka
+ */
+
+#include <framework/threading/Thread.h>
+
+#include <sapphire/LevelPrefetcher.h>
+#include <sapphire/level/SapphireLevelDescriptor.h>
+
+namespace userapp {
+
+LevelPrefetcher::~LevelPrefetcher() {
+	bool wasstarted;
+	{
+		MutexLocker lock { mutex };
+		exiting = true;
+		pendingCount = 0;
+		wasstarted = started;
+	}
+	if (wasstarted) {
+		workSemaphore.post();
+		exitSemaphore.wait();
+	}
+}
+
+LevelPrefetcher::Entry* LevelPrefetcher::findEntry(const SapphireLevelDescriptor* desc) {
+	for (auto&& e : entries) {
+		if (e.descriptor == desc) {
+			return &e;
+		}
+	}
+	return nullptr;
+}
+
+void LevelPrefetcher::storeEntry(const SapphireLevelDescriptor* desc, Level&& level, bool success) {
+	Entry* target = entries;
+	for (auto&& e : entries) {
+		if (e.descriptor == nullptr) {
+			target = &e;
+			break;
+		}
+		if (e.lastUse < target->lastUse) {
+			target = &e;
+		}
+	}
+	target->descriptor = desc;
+	target->level = util::move(level);
+	target->success = success;
+	target->lastUse = ++useCounter;
+}
+
+void LevelPrefetcher::run() {
+	while (true) {
+		workSemaphore.wait();
+		const SapphireLevelDescriptor* desc;
+		{
+			MutexLocker lock { mutex };
+			if (exiting) {
+				break;
+			}
+			if (pendingCount == 0) {
+				continue;
+			}
+			desc = pending[0];
+			--pendingCount;
+			for (unsigned int i = 0; i < pendingCount; ++i) {
+				pending[i] = pending[i + 1];
+			}
+			if (findEntry(desc) != nullptr) {
+				continue;
+			}
+			working = desc;
+			workingInvalidated = false;
+		}
+		Level level;
+		bool success = level.loadLevel(desc->getFileDescriptor());
+		{
+			MutexLocker lock { mutex };
+			if (!workingInvalidated) {
+				storeEntry(desc, util::move(level), success);
+			}
+			working = nullptr;
+			//only the waiters of this level are woken up
+			for (; workingWaiters > 0; --workingWaiters) {
+				workingDoneSemaphore.post();
+			}
+		}
+	}
+	exitSemaphore.post();
+}
+
+void LevelPrefetcher::prefetch(const SapphireLevelDescriptor* const * descriptors, unsigned int count) {
+	MutexLocker lock { mutex };
+	if (exiting) {
+		return;
+	}
+	pendingCount = 0;
+	for (unsigned int i = 0; i < count && pendingCount < CACHE_SIZE; ++i) {
+		auto* desc = descriptors[i];
+		if (desc == nullptr || desc == working) {
+			continue;
+		}
+		if (Entry* e = findEntry(desc)) {
+			//keep it from being evicted by the newly requested ones
+			e->lastUse = ++useCounter;
+			continue;
+		}
+		pending[pendingCount++] = desc;
+	}
+	if (pendingCount == 0) {
+		return;
+	}
+	if (!started) {
+		started = true;
+		Thread t;
+		t.start([this]() {
+			this->run();
+			return 0;
+		});
+	}
+	for (unsigned int i = 0; i < pendingCount; ++i) {
+		workSemaphore.post();
+	}
+}
+
+bool LevelPrefetcher::loadLevel(const SapphireLevelDescriptor* desc, Level& out) {
+	bool wait;
+	{
+		MutexLocker lock { mutex };
+		if (Entry* e = findEntry(desc)) {
+			e->lastUse = ++useCounter;
+			if (!e->success) {
+				return false;
+			}
+			out = e->level;
+			return true;
+		}
+		wait = working == desc;
+		if (wait) {
+			++workingWaiters;
+		}
+	}
+	if (wait) {
+		//currently being parsed, wait for it instead of parsing it twice
+		workingDoneSemaphore.wait();
+
+		MutexLocker lock { mutex };
+		if (Entry* e = findEntry(desc)) {
+			e->lastUse = ++useCounter;
+			if (!e->success) {
+				return false;
+			}
+			out = e->level;
+			return true;
+		}
+	}
+	return out.loadLevel(desc->getFileDescriptor());
+}
+
+void LevelPrefetcher::invalidate(const SapphireLevelDescriptor* desc) {
+	bool wait;
+	{
+		MutexLocker lock { mutex };
+		unsigned int count = 0;
+		for (unsigned int i = 0; i < pendingCount; ++i) {
+			if (pending[i] != desc) {
+				pending[count++] = pending[i];
+			}
+		}
+		pendingCount = count;
+		if (Entry* e = findEntry(desc)) {
+			e->descriptor = nullptr;
+			e->level = Level { };
+			e->success = false;
+			e->lastUse = 0;
+		}
+		wait = working == desc;
+		if (wait) {
+			workingInvalidated = true;
+			++workingWaiters;
+		}
+	}
+	if (wait) {
+		//the descriptor may be deleted after we return
+		workingDoneSemaphore.wait();
+	}
+}
+
+}  // namespace userapp
+
@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2020 Bence Sipka
+ *
+ * This program is free software: you can redistribute it and/or modify 
+ * it under the terms of the GNU General Public License as published by 
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/*
+ * LevelPrefetcher.h
+ *
+ *  Created on: 2026. okt. 19.
+ *      Author: sipka
+ */
+
+#ifndef TEST_SAPPHIRE_LEVELPREFETCHER_H_
+#define TEST_SAPPHIRE_LEVELPREFETCHER_H_
+
+#include <framework/threading/Mutex.h>
+#include <framework/threading/Semaphore.h>
+
+#include <sapphire/level/Level.h>
+
+namespace userapp {
+using namespace rhfw;
+class SapphireLevelDescriptor;
+
+/**
+ * Parses levels on a background thread ahead of time, so the UI can display them without disk access.
+ * <p>
+ * The prefetched levels are stored in a small cache, keyed by their descriptors. The descriptors must be invalidated
+ * before they are modified or deleted.
+ */
+class LevelPrefetcher {
+public:
+	static const unsigned int CACHE_SIZE = 8;
+private:
+	class Entry {
+	public:
+		const SapphireLevelDescriptor* descriptor = nullptr;
+		Level level;
+		bool success = false;
+		unsigned int lastUse = 0;
+	};
+
+	Mutex mutex { Mutex::auto_init { } };
+	Semaphore workSemaphore { Semaphore::auto_init { } };
+	/**
+	 * Posted once for each waiter when the worker thread finishes parsing the working level.
+	 */
+	Semaphore workingDoneSemaphore { Semaphore::auto_init { } };
+	Semaphore exitSemaphore { Semaphore::auto_init { } };
+
+	bool started = false;
+	bool exiting = false;
+
+	const SapphireLevelDescriptor* pending[CACHE_SIZE];
+	unsigned int pendingCount = 0;
+
+	const SapphireLevelDescriptor* working = nullptr;
+	bool workingInvalidated = false;
+	/**
+	 * The number of threads waiting for the working level to be parsed.
+	 */
+	unsigned int workingWaiters = 0;
+
+	Entry entries[CACHE_SIZE];
+	unsigned int useCounter = 0;
+
+	Entry* findEntry(const SapphireLevelDescriptor* desc);
+	void storeEntry(const SapphireLevelDescriptor* desc, Level&& level, bool success);
+
+	void run();
+public:
+	LevelPrefetcher() {
+	}
+	LevelPrefetcher(const LevelPrefetcher&) = delete;
+	LevelPrefetcher& operator=(const LevelPrefetcher&) = delete;
+	~LevelPrefetcher();
+
+	/**
+	 * Requests the given levels to be parsed in the background, in the given order.
+	 * Replaces the previously requested but not yet started ones.
+	 */
+	void prefetch(const SapphireLevelDescriptor* const * descriptors, unsigned int count);
+	void prefetch(const SapphireLevelDescriptor* descriptor) {
+		prefetch(&descriptor, 1);
+	}
+
+	/**
+	 * Loads the level for the descriptor into the argument. Uses the prefetched level if available, else parses the
+	 * level file on the calling thread.
+	 */
+	bool loadLevel(const SapphireLevelDescriptor* desc, Level& out);
+
+	/**
+	 * Removes any prefetched data for the descriptor. Waits for the background parsing if it is in progress.
+	 */
+	void invalidate(const SapphireLevelDescriptor* desc);
+};
+
+}  // namespace userapp
+
+#endif /* TEST_SAPPHIRE_LEVELPREFETCHER_H_ */
@@ -1093,6 +1093,37 @@ void LevelSelectorLayer::setSelectedLevel(const SelectedItem& selected) {
 			ss->getBackgroundLayer()->setPreviewMode(false);
 		}
 	}
+	prefetchAroundSelection();
+}
+
+void LevelSelectorLayer::prefetchAroundSelection() {
+	if (selected == nullptr) {
+		return;
+	}
+	int index = selected.partition->getIndex(selected.descriptor);
+	if (index < 0) {
+		return;
+	}
+	//the selected level first, then the ones reachable with a single move
+	unsigned int count = selected.partition->getCount();
+	const SapphireLevelDescriptor* descs[5];
+	unsigned int desccount = 0;
+	descs[desccount++] = selected.descriptor;
+	if ((unsigned int) index + 1 < count) {
+		descs[desccount++] = selected.partition->get(index + 1);
+	}
+	if (index > 0) {
+		descs[desccount++] = selected.partition->get(index - 1);
+	}
+	if (gridRowCount > 1) {
+		if ((unsigned int) index + gridRowCount < count) {
+			descs[desccount++] = selected.partition->get(index + gridRowCount);
+		}
+		if ((unsigned int) index >= gridRowCount) {
+			descs[desccount++] = selected.partition->get(index - gridRowCount);
+		}
+	}
+	static_cast<SapphireScene*>(getScene())->getLevelPrefetcher().prefetch(descs, desccount);
 }
 
 unsigned int LevelSelectorLayer::getPartitionColumnCount(LevelPartition* p, unsigned int rowcount) {
@@ -1185,8 +1216,9 @@ void LevelSelectorLayer::onLevelSelected(const SapphireLevelDescriptor* desc) {
 	if (DifficultySelectorLayer::showLockedLevelDialog(this, desc->difficulty)) {
 		return;
 	}
+	auto* ss = static_cast<SapphireScene*>(getScene());
 	Level level;
-	if (!level.loadLevel(desc->getFileDescriptor())) {
+	if (!ss->getLevelPrefetcher().loadLevel(desc, level)) {
 		showLevelLoadFailedDialog();
 	} else {
 		auto* layer = new LevelDetailsLayer(this, desc, util::move(level));
@@ -1198,8 +1230,9 @@ void LevelSelectorLayer::onLevelSelected(const SelectedItem& selection) {
 	onLevelSelected(selection.descriptor);
 }
 void LevelSelectorLayer::onLevelStartSelected(const SapphireLevelDescriptor* desc) {
+	auto* ss = static_cast<SapphireScene*>(getScene());
 	Level level;
-	if (!level.loadLevel(desc->getFileDescriptor())) {
+	if (!ss->getLevelPrefetcher().loadLevel(desc, level)) {
 		showLevelLoadFailedDialog();
 		return;
 	}
@@ -1216,7 +1249,7 @@ void LevelSelectorLayer::onLevelStartSuspendedSelected(const SapphireLevelDescri
 	}
 	auto* ss = static_cast<SapphireScene*>(getScene());
 	Level level;
-	if (!level.loadLevel(desc->getFileDescriptor()) || !ss->loadSuspendedLevel(desc, level)) {
+	if (!ss->getLevelPrefetcher().loadLevel(desc, level) || !ss->loadSuspendedLevel(desc, level)) {
 		showLevelLoadFailedDialog();
 		return;
 	}
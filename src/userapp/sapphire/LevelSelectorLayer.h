@@ -160,6 +160,7 @@ private:
 	void scrollTouch();
 
 	void setSelectedLevel(const SelectedItem& selected);
+	void prefetchAroundSelection();
 
 	unsigned int getPartitionColumnCount(LevelPartition* partition, unsigned int rowcount);
 	unsigned int countColumns(unsigned int rowcount);
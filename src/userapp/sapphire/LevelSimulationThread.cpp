@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2020 Bence Sipka
+ *
+ * This program is free software: you can redistribute it and/or modify 
+ * it under the terms of the GNU General Public License as published by 
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/*
+ * LevelSimulationThread.cpp
+ *
+ *  Created on: 2026. okt. 19.
+ *      Author: sipka
+ */
+
+#include <framework/core/Profiler.h>
+#include <framework/threading/Thread.h>
+
+#include <sapphire/LevelSimulationThread.h>
+
+namespace userapp {
+
+LevelSimulationThread::~LevelSimulationThread() {
+	reset();
+	if (started) {
+		exiting = true;
+		stepSemaphore.post();
+		exitSemaphore.wait();
+	}
+}
+
+void LevelSimulationThread::run() {
+	while (true) {
+		stepSemaphore.wait();
+		if (exiting) {
+			break;
+		}
+		if (stepReload) {
+			back = *front;
+		}
+		back.copySimulationState(*front);
+		{
+			PROFILE_ZONE("Level::applyTurn");
+			back.applyTurn();
+		}
+
+		unsigned int step = stepNumber;
+		//post before publishing, so the owner never blocks on the semaphore after seeing the completed step
+		doneSemaphore.post();
+		completedStep.store(step, std::memory_order_release);
+	}
+	exitSemaphore.post();
+}
+
+void LevelSimulationThread::startTurn() {
+	ASSERT(!isTurnStarted());
+
+	if (!started) {
+		started = true;
+		Thread t;
+		t.start([this]() {
+			this->run();
+			return 0;
+		});
+	}
+	stepReload = backReloaded;
+	backReloaded = false;
+	stepNumber = ++requestedStep;
+	stepSemaphore.post();
+}
+
+bool LevelSimulationThread::finishTurn() {
+	if (!isTurnStarted() || completedStep.load(std::memory_order_acquire) != requestedStep) {
+		return false;
+	}
+	doneSemaphore.wait();
+	front->swapSimulationState(back);
+	consumedStep = requestedStep;
+	return true;
+}
+
+void LevelSimulationThread::reset() {
+	if (isTurnStarted()) {
+		doneSemaphore.wait();
+		consumedStep = requestedStep;
+	}
+	backReloaded = true;
+}
+
+}  // namespace userapp
+
@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2020 Bence Sipka
+ *
+ * This program is free software: you can redistribute it and/or modify 
+ * it under the terms of the GNU General Public License as published by 
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/*
+ * LevelSimulationThread.h
+ *
+ *  Created on: 2026. okt. 19.
+ *      Author: sipka
+ */
+
+#ifndef TEST_SAPPHIRE_LEVELSIMULATIONTHREAD_H_
+#define TEST_SAPPHIRE_LEVELSIMULATIONTHREAD_H_
+
+#include <framework/threading/Semaphore.h>
+
+#include <sapphire/level/Level.h>
+#include <sapphire/sapphireconstants.h>
+
+#include <atomic>
+
+namespace userapp {
+using namespace rhfw;
+
+/**
+ * Computes the turns of a level on a separate thread, so a slow turn does not hold up the frame being drawn.
+ * <p>
+ * The next turn is computed into a back buffer, while the front level can still be drawn. When the turn is done, the
+ * buffers are swapped on the calling thread without waiting or locking. The front level must not be modified while a
+ * turn is in progress, use reset() before doing so.
+ */
+class LevelSimulationThread {
+private:
+	Level* front;
+	Level back;
+	/**
+	 * If the back buffer needs to be fully copied from the front, as the level was reloaded.
+	 */
+	bool backReloaded = true;
+	/**
+	 * Parameters of the currently computed turn, written before the simulation thread is notified.
+	 */
+	bool stepReload = false;
+	unsigned int stepNumber = 0;
+
+	Semaphore stepSemaphore { Semaphore::auto_init { } };
+	Semaphore doneSemaphore { Semaphore::auto_init { } };
+	Semaphore exitSemaphore { Semaphore::auto_init { } };
+
+	bool started = false;
+	bool exiting = false;
+
+	/**
+	 * The number of the last requested and the last consumed turns, only accessed by the owner thread.
+	 */
+	unsigned int requestedStep = 0;
+	unsigned int consumedStep = 0;
+	/**
+	 * The number of the last turn which was computed by the simulation thread.
+	 */
+	std::atomic<unsigned int> completedStep { 0 };
+
+	void run();
+public:
+	explicit LevelSimulationThread(Level* front)
+			: front { front } {
+	}
+	LevelSimulationThread(const LevelSimulationThread&) = delete;
+	LevelSimulationThread& operator=(const LevelSimulationThread&) = delete;
+	~LevelSimulationThread();
+
+	static bool isWorthSimulating(const Level& level) {
+		return level.getWidth() * level.getHeight() >= SAPPHIRE_THREADED_SIMULATION_MIN_CELLS;
+	}
+
+	/**
+	 * Starts computing the next turn of the front level. The controls for the turn should be already applied.
+	 */
+	void startTurn();
+	/**
+	 * Returns true if a turn was started, and its result is not yet applied to the front level.
+	 */
+	bool isTurnStarted() const {
+		return requestedStep != consumedStep;
+	}
+	/**
+	 * Applies the result of the started turn to the front level, if it is already computed. Never waits for the
+	 * simulation thread.
+	 *
+	 * @return true if the front level was advanced by a turn.
+	 */
+	bool finishTurn();
+
+	/**
+	 * Waits for the started turn and discards it. Must be called before the front level is modified or reloaded.
+	 */
+	void reset();
+};
+
+}  // namespace userapp
+
+#endif /* TEST_SAPPHIRE_LEVELSIMULATIONTHREAD_H_ */
@@ -21,6 +21,7 @@
  */
 
 #include <framework/core/timing.h>
+#include <framework/core/Profiler.h>
 #include <framework/geometry/Matrix.h>
 #include <framework/geometry/Vector.h>
 #include <framework/io/key/KeyEvent.h>
@@ -103,6 +104,7 @@ void PlayerLayer::setLevel(const SapphireLevelDescriptor* desc) {
 
 	this->suspendedLevel = false;
 	this->descriptor = desc;
+	simulation.reset();
 	this->level.loadLevel(desc->getFileDescriptor());
 	this->level.setRandomSeed((unsigned int) core::MonotonicTime::getCurrent());
 	this->statisticsBase = level.getStatistics();
@@ -231,7 +233,8 @@ void PlayerLayer::drawImpl(float displayPercent) {
 			Rectangle { controller.getPaddings().left + menuRect.width(), controller.getPaddings().top + menuRect.height(),
 					controller.getPaddings().right + menuRect.width(), controller.getPaddings().bottom + menuRect.height() });
 
-	drawer.draw(turnPercent, displayPercent);
+	//the turn percent may exceed 1 while the next turn is being computed
+	drawer.draw(turnPercent < 1.0f ? turnPercent : 1.0f, displayPercent);
 	hudDrawer.draw(level, displayPercent, &controller);
 
 	renderer->setDepthTest(false);
@@ -289,6 +292,7 @@ void PlayerLayer::restartLevel() {
 	if (descriptor != nullptr && !isTestingLevel()) {
 		ss->notifyLevelPlayed(descriptor, level);
 	}
+	simulation.reset();
 	if (isTestingLevel()) {
 		level = editorLayer->getLevel();
 		level.resetState();
@@ -319,6 +323,7 @@ void PlayerLayer::restartSuspendedLevel() {
 
 	uncommittedStats += (level.getStatistics() - statisticsBase);
 
+	simulation.reset();
 	this->level.loadLevel(descriptor->getFileDescriptor());
 	this->turnPercent = 0.0f;
 	controller.clearInput();
@@ -332,6 +337,8 @@ void PlayerLayer::restartSuspendedLevel() {
 
 void PlayerLayer::onLosingInput() {
 	SapphireUILayer::onLosingInput();
+	//the paused dialogs may modify the level
+	simulation.reset();
 	controller.clearInput();
 	steamOverlayCallback.Unregister();
 
@@ -472,14 +479,29 @@ void PlayerLayer::onTimeChanged(const core::time_millis& time, const core::time_
 
 void PlayerLayer::advanceMilliseconds(long long ms) {
 	turnPercent += (float) ms / SPEED_VALUES[speedIndex];
+	bool threaded = LevelSimulationThread::isWorthSimulating(level);
 	while (turnPercent >= 1.0f) {
-		++playedTurns;
-		turnPercent -= 1.0f;
 		bool over = level.isOver();
 
-		controller.applyControls();
+		if (threaded) {
+			if (!simulation.isTurnStarted()) {
+				controller.applyControls();
+				simulation.startTurn();
+			}
+			PROFILE_ZONE("LevelSimulationThread::finishTurn");
+			if (!simulation.finishTurn()) {
+				//keep drawing the current turn until the next one is computed
+				break;
+			}
+		} else {
+			controller.applyControls();
+
+			PROFILE_ZONE("Level::applyTurn");
+			level.applyTurn();
+		}
+		++playedTurns;
+		turnPercent -= 1.0f;
 
-		level.applyTurn();
 		sounder.playSoundsForTurn();
 
 		uncommittedStats += (level.getStatistics() - statisticsBase);
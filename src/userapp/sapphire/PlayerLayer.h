@@ -37,6 +37,7 @@
 #include <sapphire/levelrender/LevelDrawer.h>
 #include <sapphire/levelrender/HudDrawer.h>
 #include <sapphire/LevelController.h>
+#include <sapphire/LevelSimulationThread.h>
 #include <sapphire/level/LevelStatistics.h>
 
 #include <sapphire/steam_opt.h>
@@ -59,6 +60,10 @@ private:
 	Rectangle menuRect;
 
 	Level level;
+	/**
+	 * Used to compute the turns of large levels, declared after the level to be destroyed before it.
+	 */
+	LevelSimulationThread simulation { &level };
 	LevelStatistics finishStatistics;
 	LevelDrawer drawer { &level };
 	HudDrawer hudDrawer;
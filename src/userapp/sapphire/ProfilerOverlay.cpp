@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2020 Bence Sipka
+ *
+ * This program is free software: you can redistribute it and/or modify 
+ * it under the terms of the GNU General Public License as published by 
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/*
+ * ProfilerOverlay.cpp
+ *
+ *  Created on: 2026. okt. 19.
+ *      Author: sipka
+ */
+
+#include <framework/core/Profiler.h>
+#include <framework/geometry/Matrix.h>
+#include <framework/geometry/Rectangle.h>
+#include <sapphire/ProfilerOverlay.h>
+
+#include <stdio.h>
+#include <string.h>
+
+namespace userapp {
+
+//a frame of this length fills the graph
+static const long long GRAPH_FULL_MICROS = 1000000 / 30;
+static const long long TARGET_FRAME_MICROS = 1000000 / 60;
+
+void ProfilerOverlay::setVisible(bool visible) {
+	this->visible = visible;
+	if (visible) {
+		core::Profiler::setEnabled(true);
+	}
+}
+
+unsigned int ProfilerOverlay::collectZones(ZoneSummary* zones) {
+	if (core::Profiler::getFrameCount() == 0) {
+		return 0;
+	}
+	const core::Profiler::Frame& frame = core::Profiler::getFrame(0);
+	unsigned int count = 0;
+	core::Profiler::forEachThreadEvent([&](const core::Profiler::Event& e) {
+		if (e.begin < frame.begin || e.end > frame.end) {
+			return;
+		}
+		for (unsigned int i = 0; i < count; ++i) {
+			//the same literal may have different addresses in different translation units
+			if (zones[i].name == e.name || strcmp(zones[i].name, e.name) == 0) {
+				zones[i].duration += e.end - e.begin;
+				++zones[i].count;
+				return;
+			}
+		}
+		if (count < MAX_ZONE_COUNT) {
+			zones[count].name = e.name;
+			zones[count].duration = e.end - e.begin;
+			zones[count].count = 1;
+			++count;
+		}
+	});
+	return count;
+}
+
+void ProfilerOverlay::draw(const core::WindowSize& size) {
+	if (!visible) {
+		return;
+	}
+	Matrix2D mvp;
+	mvp.setScreenDimension(size.pixelSize);
+
+	const float textsize = size.toPixelsY(0.35f);
+	const float leading = font->getLeading(textsize);
+	const float padding = size.toPixelsX(0.15f);
+	const float graphheight = size.toPixelsY(2.0f);
+	const float graphwidth = min(size.pixelSize.width() - 2 * padding, size.toPixelsX(8.0f));
+	const float barwidth = graphwidth / DISPLAYED_FRAME_COUNT;
+
+	ZoneSummary zones[MAX_ZONE_COUNT];
+	const unsigned int zonecount = collectZones(zones);
+
+	const float height = graphheight + (textsize + leading) * (zonecount + 1) + 3 * padding;
+	drawRectangleColor(mvp, Color { 0, 0, 0, 0.6f }, Rectangle { 0, 0, graphwidth + 2 * padding, height });
+
+	const unsigned int framecount = min(core::Profiler::getFrameCount(), (unsigned int) DISPLAYED_FRAME_COUNT);
+	long long total = 0;
+	long long worst = 0;
+	const float graphbottom = padding + graphheight;
+	for (unsigned int i = 0; i < framecount; ++i) {
+		const long long duration = core::Profiler::getFrame(i).getDuration();
+		total += duration;
+		if (duration > worst) {
+			worst = duration;
+		}
+		const float barheight = graphheight * min((float) duration / GRAPH_FULL_MICROS, 1.0f);
+		const float right = padding + graphwidth - barwidth * i;
+		Color color = duration <= TARGET_FRAME_MICROS ? Color { 0.2f, 0.9f, 0.2f, 1.0f } :
+						(duration <= GRAPH_FULL_MICROS ? Color { 0.9f, 0.9f, 0.2f, 1.0f } : Color { 0.9f, 0.2f, 0.2f, 1.0f });
+		drawRectangleColor(mvp, color, Rectangle { right - barwidth, graphbottom - barheight, right, graphbottom });
+	}
+	const float targety = graphbottom - graphheight * ((float) TARGET_FRAME_MICROS / GRAPH_FULL_MICROS);
+	drawRectangleColor(mvp, Color { 1, 1, 1, 0.5f }, Rectangle { padding, targety, padding + graphwidth, targety + 1.0f });
+
+	fontDrawerPool.prepare(font, mvp);
+	fontDrawer.prepare(64 * (MAX_ZONE_COUNT + 1));
+
+	char line[64];
+	float ypos = graphbottom + padding;
+	snprintf(line, sizeof(line), "frame %.2f ms avg %.2f ms max %.2f ms",
+			framecount == 0 ? 0.0 : core::Profiler::getFrame(0).getDuration() / 1000.0, framecount == 0 ? 0.0 : total / 1000.0 / framecount,
+			worst / 1000.0);
+	fontDrawer.add(line, Color { 1, 1, 1, 1 }, Vector2F { padding, ypos }, textsize, Gravity::LEFT | Gravity::TOP);
+	ypos += textsize + leading;
+	for (unsigned int i = 0; i < zonecount; ++i) {
+		snprintf(line, sizeof(line), "%7.2f ms %3ux %s", zones[i].duration / 1000.0, zones[i].count, zones[i].name);
+		fontDrawer.add(line, Color { 0.8f, 0.8f, 0.8f, 1 }, Vector2F { padding, ypos }, textsize, Gravity::LEFT | Gravity::TOP);
+		ypos += textsize + leading;
+	}
+
+	fontDrawerPool.commit();
+}
+
+}  // namespace userapp
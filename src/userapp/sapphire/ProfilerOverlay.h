@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2020 Bence Sipka
+ *
+ * This program is free software: you can redistribute it and/or modify 
+ * it under the terms of the GNU General Public License as published by 
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/*
+ * ProfilerOverlay.h
+ *
+ *  Created on: 2026. okt. 19.
+ *      Author: sipka
+ */
+
+#ifndef TEST_SAPPHIRE_PROFILEROVERLAY_H_
+#define TEST_SAPPHIRE_PROFILEROVERLAY_H_
+
+#include <framework/core/Window.h>
+#include <framework/resource/font/Font.h>
+#include <framework/resource/Resource.h>
+#include <gen/resources.h>
+#include <appmain.h>
+#include <sapphire/FastFontDrawer.h>
+
+namespace userapp {
+using namespace rhfw;
+
+/**
+ * Displays the durations of the last frames and the zones of the latest frame recorded by the Profiler.
+ */
+class ProfilerOverlay {
+public:
+	static const unsigned int DISPLAYED_FRAME_COUNT = 90;
+	static const unsigned int MAX_ZONE_COUNT = 12;
+private:
+	class ZoneSummary {
+	public:
+		const char* name;
+		long long duration;
+		unsigned int count;
+	};
+
+	AutoResource<Font> font = getFont(ResIds::build::sipka_rh_font_convert::gameres::Consolas_ttf);
+	FastFontDrawerPool fontDrawerPool;
+	FastFontDrawer fontDrawer { fontDrawerPool };
+
+	bool visible = false;
+
+	unsigned int collectZones(ZoneSummary* zones);
+public:
+	bool isVisible() const {
+		return visible;
+	}
+	void setVisible(bool visible);
+
+	void draw(const core::WindowSize& size);
+};
+
+}  // namespace userapp
+
+#endif /* TEST_SAPPHIRE_PROFILEROVERLAY_H_ */
@@ -176,7 +176,7 @@ void SapphireBackgroundLayer::onSettingsChanged(const SapphireSettings& settings
 }
 
 void SapphireBackgroundLayer::applyDisplayLevel(const SapphireLevelDescriptor* descriptor) {
-	this->level.loadLevel(descriptor->getFileDescriptor());
+	static_cast<SapphireScene*>(getScene())->getLevelPrefetcher().loadLevel(descriptor, this->level);
 	if (!previewMode) {
 		demo.play(level.getDemo(random.next(descriptor->demoCount)), level);
 		demo.next(level);
@@ -28,6 +28,7 @@
 #include <framework/io/files/StorageFileDescriptor.h>
 #include <framework/scene/SceneManager.h>
 #include <framework/core/Window.h>
+#include <framework/core/Profiler.h>
 #include <framework/io/stream/OutputStream.h>
 #include <framework/io/stream/BufferedInputStream.h>
 #include <framework/io/byteorder.h>
@@ -39,6 +40,7 @@
 
 #include <sapphire/SapphireScene.h>
 #include <sapphire/level/Level.h>
+#include <sapphire/level/DemoMoveEncoding.h>
 #include <sapphire/AsynchronTask.h>
 #include <sapphire/server/SapphireLevelDetails.h>
 #include <sapphire/sapphireconstants.h>
@@ -292,84 +294,93 @@ void SapphireScene::checkLevelDemos() {
 	LOGTRACE() << "Level checking done.";
 }
 
-void SapphireScene::performAsyncLoading(unsigned int version) {
-	FixedString* elliotpack = new FixedString("Elliot's classics");
-	levelPacks.add(elliotpack);
-	for (auto&& asset : RAssets::gameres::game_sapphire::levels::enumerate()) {
-		if (threadCancel) {
-			return;
+template<typename AssetEnumerable>
+bool SapphireScene::loadBuiltinLevels(const SapphireLevelCatalog& catalog, const char* groupname, AssetEnumerable&& assets,
+		bool communitylevel, const char* levelpack, bool singleplayeronly) {
+	auto* group = catalog.getGroup(groupname);
+	if (group != nullptr) {
+		//the entries are associated with the assets by their order, only use the group if it is consistent
+		unsigned int count = 0;
+		for (auto&& asset : assets) {
+			++count;
 		}
-		AssetFileDescriptor fd { asset };
-		auto* desc = SapphireLevelDescriptor::make(fd);
-		ASSERT(desc != nullptr) << "Failed to load level " << asset;
-		if (desc != nullptr) {
-			desc->setFileDescriptor(new AssetFileDescriptor(util::move(fd)));
-			levels[desc->playerCount - 1][(unsigned int) desc->difficulty].add(desc);
+		if (count != group->getCount()) {
+			LOGW()<< "Level catalog mismatch for " << groupname << ": " << group->getCount() << " - " << count;
+			group = nullptr;
 		}
 	}
-	for (auto&& asset : RAssets::gameres::game_sapphire::levels::custom::enumerate()) {
+	unsigned int index = 0;
+	for (auto&& asset : assets) {
 		if (threadCancel) {
-			return;
+			return false;
 		}
-		AssetFileDescriptor fd { asset };
-		auto* desc = SapphireLevelDescriptor::make(fd);
-		ASSERT(desc != nullptr) << "Failed to load level " << asset;
-		if (desc != nullptr) {
-			desc->setFileDescriptor(new AssetFileDescriptor(util::move(fd)));
-			desc->communityLevel = true;
-			levels[desc->playerCount - 1][(unsigned int) desc->difficulty].add(desc);
+		SapphireLevelDescriptor* desc = nullptr;
+		if (group != nullptr) {
+			desc = new SapphireLevelDescriptor();
+			if (!catalog.makeDescriptor(*group, index, desc)) {
+				delete desc;
+				desc = nullptr;
+			}
+			++index;
 		}
-	}
-	for (auto&& asset : RAssets::gameres::game_sapphire::levels::elliotclassic::enumerate()) {
-		if (threadCancel) {
-			return;
+		if (desc == nullptr) {
+			AssetFileDescriptor fd { asset };
+			desc = SapphireLevelDescriptor::make(fd);
 		}
-		AssetFileDescriptor fd { asset };
-		auto* desc = SapphireLevelDescriptor::make(fd);
 		ASSERT(desc != nullptr) << "Failed to load level " << asset;
 		if (desc != nullptr) {
-#if !defined(SAPPHIRE_DUAL_PLAYER_AVAILABLE)
-			if(desc->playerCount != 1) {
+			if (singleplayeronly && desc->playerCount != 1) {
 				delete desc;
 				continue;
 			}
-#endif /* !defined(SAPPHIRE_DUAL_PLAYER_AVAILABLE) */
-			desc->levelPack = *elliotpack;
-			desc->setFileDescriptor(new AssetFileDescriptor(util::move(fd)));
-			desc->communityLevel = true;
+			desc->setFileDescriptor(new AssetFileDescriptor(asset));
+			desc->communityLevel = communitylevel;
+			desc->levelPack = levelpack;
 			levels[desc->playerCount - 1][(unsigned int) desc->difficulty].add(desc);
 		}
 	}
+	return true;
+}
+
+void SapphireScene::performAsyncLoading(unsigned int version) {
+	FixedString* elliotpack = new FixedString("Elliot's classics");
+	levelPacks.add(elliotpack);
+
+	//the catalog contains the descriptors of the builtin levels, so we don't need to open every level file
+	SapphireLevelCatalog catalog;
 	{
-#ifdef SAPPHIRE_DUAL_PLAYER_AVAILABLE
-		for (auto&& asset : RAssets::gameres::game_sapphire::levels::twoplayer::enumerate()) {
-			if (threadCancel) {
-				return;
-			}
-			AssetFileDescriptor fd { asset };
-			auto* desc = SapphireLevelDescriptor::make(fd);
-			ASSERT(desc != nullptr) << "Failed to load level " << asset;
-			if (desc != nullptr) {
-				desc->setFileDescriptor(new AssetFileDescriptor(util::move(fd)));
-				levels[desc->playerCount - 1][(unsigned int) desc->difficulty].add(desc);
-			}
-		}
-		for (auto&& asset : RAssets::gameres::game_sapphire::levels::twoplayer::custom::enumerate()) {
-			if (threadCancel) {
-				return;
-			}
-			AssetFileDescriptor fd { asset };
-			auto* desc = SapphireLevelDescriptor::make(fd);
-			ASSERT(desc != nullptr) << "Failed to load level " << asset;
-			if (desc != nullptr) {
-				desc->setFileDescriptor(new AssetFileDescriptor(util::move(fd)));
-				desc->communityLevel = true;
-				levels[desc->playerCount - 1][(unsigned int) desc->difficulty].add(desc);
-			}
-		}
-#endif /* defined(SAPPHIRE_DUAL_PLAYER_AVAILABLE) */
+		AssetFileDescriptor catalogfd { RAssets::gameres::game_sapphire::levels_catalog };
+		WARN(!catalog.load(catalogfd)) << "Failed to load level catalog, parsing level files";
 	}
 
+	if (!loadBuiltinLevels(catalog, "gameres/game_sapphire/levels", RAssets::gameres::game_sapphire::levels::enumerate(),
+			false)) {
+		return;
+	}
+	if (!loadBuiltinLevels(catalog, "gameres/game_sapphire/levels/custom",
+			RAssets::gameres::game_sapphire::levels::custom::enumerate(), true)) {
+		return;
+	}
+#if defined(SAPPHIRE_DUAL_PLAYER_AVAILABLE)
+	if (!loadBuiltinLevels(catalog, "gameres/game_sapphire/levels/elliotclassic",
+			RAssets::gameres::game_sapphire::levels::elliotclassic::enumerate(), true, *elliotpack)) {
+		return;
+	}
+	if (!loadBuiltinLevels(catalog, "gameres/game_sapphire/levels/twoplayer",
+			RAssets::gameres::game_sapphire::levels::twoplayer::enumerate(), false)) {
+		return;
+	}
+	if (!loadBuiltinLevels(catalog, "gameres/game_sapphire/levels/twoplayer/custom",
+			RAssets::gameres::game_sapphire::levels::twoplayer::custom::enumerate(), true)) {
+		return;
+	}
+#else
+	if (!loadBuiltinLevels(catalog, "gameres/game_sapphire/levels/elliotclassic",
+			RAssets::gameres::game_sapphire::levels::elliotclassic::enumerate(), true, *elliotpack, true)) {
+		return;
+	}
+#endif /* defined(SAPPHIRE_DUAL_PLAYER_AVAILABLE) */
+
 	auto&& dowloadspath = downloadsDirectory.getPath();
 	for (auto&& file : downloadsDirectory.enumerate()) {
 		if (threadCancel) {
@@ -592,6 +603,7 @@ void SapphireScene::performLoadingFinish(unsigned int version) {
 							case SapphireCommError::LevelAlreadyExists:
 							case SapphireCommError::LevelDemoRemoved:
 							case SapphireCommError::NoError: {
+								levelPrefetcher.invalidate(desc);
 								Level level;
 								if(level.loadLevel(desc->getFileDescriptor())) {
 									level.getInfo().nonModifyAbleFlag = true;
@@ -758,6 +770,7 @@ SapphireScene::~SapphireScene() {
 	core::WindowAccesStateListener::unsubscribe();
 
 	delete uuidRandomer;
+	delete profilerOverlay;
 
 	delete levelLoaderTask;
 	for (unsigned int i = 0; i < availableMusicNames.size(); ++i) {
@@ -1604,8 +1617,14 @@ unsigned int SapphireScene::loadSettings() {
 					upgradeVersion<5>();
 					break;
 				}
-				case 6: {
+				case 6:
+				case 7:
+				case 8:
+				case 9:
+				case 10:
+				case 11: {
 					//increase decrease keys
+					//the settings format is unchanged since version 6
 					SapphireKeyMap keyboardkeys;
 					SapphireKeyMap gamepadkeys;
 					auto instream = EndianInputStream<Endianness::Big>::wrap(
@@ -2011,6 +2030,7 @@ const SapphireLevelDescriptor* SapphireScene::updateLevel(Level& level, const Sa
 		level.getInfo().uuid = d->uuid;
 		level.getInfo().author = getCurrentUserName();
 	} else {
+		levelPrefetcher.invalidate(desc);
 		d = const_cast<SapphireLevelDescriptor*>(desc);
 		sort = desc->title != level.getInfo().title;
 		if (desc->difficulty != level.getInfo().difficulty || nplayercount != d->playerCount) {
@@ -2037,6 +2057,7 @@ const SapphireLevelDescriptor* SapphireScene::updateLevel(Level& level, const Sa
 
 void SapphireScene::removeLevel(const SapphireLevelDescriptor* desc) {
 	ASSERT(desc->locallyStoredLevel);
+	levelPrefetcher.invalidate(desc);
 	levels[desc->playerCount - 1][(unsigned int) desc->difficulty].removeOne(const_cast<SapphireLevelDescriptor*>(desc));
 	delete desc;
 }
@@ -2079,6 +2100,14 @@ void SapphireScene::dispatchPostLoadVersionUpgrade(unsigned int version) {
 			upgradeVersionPostLoad<5>();
 			break;
 		}
+		case 6:
+		case 7:
+		case 8:
+		case 9:
+		case 10: {
+			//only the network protocol changed since version 6
+			break;
+		}
 		default: {
 			THROW() << "invalid version to upgrade from: " << version;
 			break;
@@ -2276,7 +2305,7 @@ const SapphireLevelDescriptor* SapphireScene::getDescriptorForDownloadedLevel(co
 		callLevelStateChangedAchievements(desc);
 	}
 
-	level.saveLevel(desc->getFileDescriptor(), true);
+	level.saveLevel(desc->getFileDescriptor(), true, true);
 
 	levels[desc->playerCount - 1][(unsigned int) desc->difficulty].add(desc);
 	sortLevels(levels[desc->playerCount - 1][(unsigned int) desc->difficulty]);
@@ -2287,6 +2316,7 @@ void SapphireScene::levelQueriedOnServer(const SapphireLevelDescriptor* descript
 	SapphireLevelDescriptor* desc = const_cast<SapphireLevelDescriptor*>(descriptor);
 	if (!desc->serverSideAvailable) {
 		desc->serverSideAvailable = true;
+		levelPrefetcher.invalidate(desc);
 
 		StorageFileDescriptor* nfd = new StorageFileDescriptor(downloadsDirectory.getPath() + (const char*) desc->uuid.asString());
 		if (static_cast<StorageFileDescriptor&>(desc->getFileDescriptor()).move(*nfd)) {
@@ -2456,7 +2486,7 @@ void SapphireScene::upgradeVersionCollectProgress() {
 							ostream.serialize<SapphireLevelCommProgress>(SapphireLevelCommProgress::Finished);
 							ostream.serialize<SapphireUUID>(desc->uuid);
 							ostream.serialize<uint32>(d->randomseed);
-							ostream.serialize<FixedString>(d->moves);
+							ostream.serialize<CompactDemoMoves>(d->moves);
 
 							Level level;
 							level.loadLevel(desc->getFileDescriptor());
@@ -2499,7 +2529,7 @@ void SapphireScene::writeLevelProgress(const SapphireLevelDescriptor* desc, uint
 	ostream.serialize<SapphireLevelCommProgress>(progress);
 	ostream.serialize<SapphireUUID>(desc->uuid);
 	ostream.serialize<uint32>(randomseed);
-	ostream.serialize<FixedString>(steps);
+	ostream.serialize<CompactDemoMoves>(steps);
 }
 void SapphireScene::writeTimeLevelProgress(const SapphireUUID& level, uint32 timeplayed) {
 	auto&& ostream = EndianOutputStream<Endianness::Big>::wrap(progressFile.openAppendStream());
@@ -2549,9 +2579,9 @@ bool SapphireScene::getLevelProgress(ProgressSynchId id, SapphireUUID* outlevelu
 			case SapphireLevelCommProgress::Finished: {
 				if (i == id) {
 					return istream.deserialize<uint32>(*outrandomseed)
-							&& istream.deserialize<SafeFixedString<SAPPHIRE_DEMO_MAX_LEN>>(*outsteps);
+							&& istream.deserialize<SafeDemoMoves>(*outsteps);
 				} else {
-					if (!istream.deserialize<uint32>(randomseed) || !istream.deserialize<IgnoreFixedString>(nullptr)) {
+					if (!istream.deserialize<uint32>(randomseed) || !istream.deserialize<IgnoreDemoMoves>(nullptr)) {
 						return false;
 					}
 				}
@@ -2615,7 +2645,7 @@ bool SapphireScene::getLatestLevelFinishSteps(const SapphireLevelDescriptor* des
 		THROW() << outprogress << " - " << descriptor->title << " - " << outleveluuid.asString() << " != " << descriptor->uuid.asString();
 		return false;
 	}
-	if (!istream.deserialize<uint32>(*outrandomseed) || !istream.deserialize<SafeFixedString<SAPPHIRE_DEMO_MAX_LEN>>(*outsteps)) {
+	if (!istream.deserialize<uint32>(*outrandomseed) || !istream.deserialize<SafeDemoMoves>(*outsteps)) {
 		THROW();
 		return false;
 	}
@@ -3164,6 +3194,60 @@ LeaderboardsDialog* SapphireScene::showLeaderboardsDialogForLevel(SapphireUILaye
 
 void SapphireScene::onDraw() {
 	Scene::onDraw();
+	if (profilerOverlay != nullptr) {
+		profilerOverlay->draw(getUiSize());
+	}
+}
+
+void SapphireScene::toggleProfilerOverlay() {
+	if (profilerOverlay == nullptr) {
+		profilerOverlay = new ProfilerOverlay();
+	}
+	profilerOverlay->setVisible(!profilerOverlay->isVisible());
+}
+
+void SapphireScene::exportProfilerTrace() {
+	if (!core::Profiler::isEnabled()) {
+		core::Profiler::setEnabled(true);
+		LOGI() << "Profiler enabled, export again to get the trace";
+		return;
+	}
+	StorageFileDescriptor tracefile { dataDirectory.getPath() + "profile_trace.json" };
+	auto&& out = tracefile.openOutputStream();
+	if (core::Profiler::exportChromeTrace(out)) {
+		LOGI() << "Profiler trace exported to data directory";
+	} else {
+		LOGW() << "Failed to export profiler trace";
+	}
+}
+
+void SapphireScene::loadResources(ResourceLoader& loader) {
+	Scene::loadResources(loader);
+	//decode the icons while the splash screen is shown
+	//the splash texture itself is needed right away, so it is not queued here
+	loader.loadResource(getTexture(ResIds::gameres::game_sapphire::art::title_sapp));
+	loader.loadResource(getTexture(ResIds::gameres::game_sapphire::art::ic_arrow_back_white));
+	loader.loadResource(getTexture(ResIds::gameres::game_sapphire::art::ic_chart_bar));
+	loader.loadResource(getTexture(ResIds::gameres::game_sapphire::art::ic_chevron_left_white));
+	loader.loadResource(getTexture(ResIds::gameres::game_sapphire::art::ic_chevron_right_white));
+	loader.loadResource(getTexture(ResIds::gameres::game_sapphire::art::ic_menu_white));
+	loader.loadResource(getTexture(ResIds::gameres::game_sapphire::art::ic_keyboard_arrow_left));
+	loader.loadResource(getTexture(ResIds::gameres::game_sapphire::art::ic_circle));
+	loader.loadResource(getTexture(ResIds::gameres::game_sapphire::art::ic_pickaxe));
+	loader.loadResource(getTexture(ResIds::gameres::game_sapphire::art::ic_star_filled));
+	loader.loadResource(getTexture(ResIds::gameres::game_sapphire::art::ic_star_outline));
+	loader.loadResource(getTexture(ResIds::gameres::game_sapphire::art::ic_check_box_white));
+	loader.loadResource(getTexture(ResIds::gameres::game_sapphire::art::ic_check_box_outline_white));
+	loader.loadResource(getTexture(ResIds::gameres::game_sapphire::art::ic_network_connect));
+	loader.loadResource(getTexture(ResIds::gameres::game_sapphire::art::ic_network_disconnect));
+	loader.loadResource(getTexture(ResIds::gameres::game_sapphire::art::ic_settings));
+	loader.loadResource(getTexture(ResIds::gameres::game_sapphire::art::ic_information));
+	loader.loadResource(getTexture(ResIds::gameres::game_sapphire::art::ic_play));
+	loader.loadResource(getTexture(ResIds::gameres::game_sapphire::art::ic_grid));
+	loader.loadResource(getTexture(ResIds::gameres::game_sapphire::art::ic_grid_off));
+	loader.loadResource(getTexture(ResIds::gameres::game_sapphire::art::ic_arrow_expand_all));
+	loader.loadResource(getTexture(ResIds::gameres::game_sapphire::art::ic_shrink));
+	loader.loadResource(getTexture(ResIds::gameres::game_sapphire::art::ic_replay_white));
 }
 
 }  // namespace userapp
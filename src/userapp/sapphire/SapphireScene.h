@@ -46,11 +46,14 @@
 #include <sapphire/community/SapphireUser.h>
 #include <sapphire/community/CommunityConnection.h>
 #include <sapphire/level/SapphireLevelDescriptor.h>
+#include <sapphire/level/SapphireLevelCatalog.h>
 #include <sapphire/common/RegistrationToken.h>
 #include <sapphire/dialogs/items/BusyIndicatorDialogItem.h>
 #include <sapphire/util/GamePadKeyRepeater.h>
 #include <sapphire/SapphireSteamAchievement.h>
+#include <sapphire/LevelPrefetcher.h>
 #include <sapphire/steam_opt.h>
+#include <sapphire/ProfilerOverlay.h>
 
 #include <gen/assets.h>
 #include <gen/types.h>
@@ -249,6 +252,7 @@ private:
 	StorageFileDescriptor statisticsFile { dataDirectory.getPath() + "stats" };
 	StorageFileDescriptor userUUIDFile { dataDirectory.getPath() + "c" };
 	StorageFileDescriptor registrationTokenFile { dataDirectory.getPath() + "r" };
+	StorageFileDescriptor levelCatalogFile { dataDirectory.getPath() + "lc" };
 	StorageDirectoryDescriptor levelDemosDirectory { dataDirectory.getPath() + "d" };
 	StorageDirectoryDescriptor userLevelsDirectory { dataDirectory.getPath() + "levels" };
 	StorageDirectoryDescriptor downloadsDirectory { dataDirectory.getPath() + "dl" };
@@ -287,9 +291,18 @@ private:
 	bool threadCancel = false;
 	ContainerLinkedNode<FixedString> levelLoaderLoadingText = "Loading levels...";
 	AsynchronTask* levelLoaderTask = nullptr;
+	/**
+	 * Declared after the level arrays, so it is destroyed (and its thread stopped) before the descriptors are.
+	 */
+	LevelPrefetcher levelPrefetcher;
 
 	CommunityConnection communityConnection;
 
+	/**
+	 * Created when first shown.
+	 */
+	ProfilerOverlay* profilerOverlay = nullptr;
+
 	bool lastInteractionKeyboard = false;
 	bool keyboardDetected = false;
 	bool mouseDetected = false;
@@ -499,6 +512,9 @@ private:
 	}
 #endif /* defined(SAPPHIRE_STEAM_API_AVAILABLE) */
 
+	template<typename AssetEnumerable>
+	bool loadBuiltinLevels(const SapphireLevelCatalog& catalog, const char* groupname, AssetEnumerable&& assets,
+			bool communitylevel, const char* levelpack = nullptr, bool singleplayeronly = false);
 	void performAsyncLoading(unsigned int version);
 	void performLoadingFinish(unsigned int version);
 
@@ -619,6 +635,16 @@ public:
 		this->needBackground = needBackground;
 	}
 
+	LevelPrefetcher& getLevelPrefetcher() {
+		return levelPrefetcher;
+	}
+
+	void toggleProfilerOverlay();
+	/**
+	 * Writes the recorded profiler zones as a Chrome trace to the data directory.
+	 */
+	void exportProfilerTrace();
+
 	bool isLevelsLoaded() const {
 		return levelLoaderTask == nullptr;
 	}
@@ -824,7 +850,11 @@ public:
 	StorageFileDescriptor& getRegistrationTokenFile() {
 		return registrationTokenFile;
 	}
+	StorageFileDescriptor& getLevelCatalogFile() {
+		return levelCatalogFile;
+	}
 	virtual void onDraw() override;
+	virtual void loadResources(ResourceLoader& loader) override;
 
 	void setProgramArguments(int argc, char** argv) {
 		this->argc = argc;
@@ -258,6 +258,17 @@ bool SapphireUILayer::onKeyEvent() {
 	if (!shouldHaveInput) {
 		return false;
 	}
+#if RHFW_DEBUG || SAPPHIRE_PROFILER_HOTKEYS
+	if ((keycode == KeyCode::KEY_F9 || keycode == KeyCode::KEY_F10) && KeyEvent::instance.getAction() == KeyAction::DOWN
+			&& !KeyEvent::instance.isRepeat()) {
+		if (keycode == KeyCode::KEY_F9) {
+			static_cast<SapphireScene*>(getScene())->toggleProfilerOverlay();
+		} else {
+			static_cast<SapphireScene*>(getScene())->exportProfilerTrace();
+		}
+		return true;
+	}
+#endif /* RHFW_DEBUG || SAPPHIRE_PROFILER_HOTKEYS */
 	if (onKeyEventImpl()) {
 		return true;
 	}
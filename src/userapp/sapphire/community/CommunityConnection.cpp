@@ -22,11 +22,13 @@
 
 #include <framework/utils/ContainerLinkedNode.h>
 #include <framework/utils/FixedString.h>
+#include <framework/utils/MemoryInput.h>
 
 #include <sapphire/community/CommunityConnection.h>
 #include <sapphire/SapphireScene.h>
 #include <sapphire/sapphireconstants.h>
 #include <sapphire/server/SapphireLevelDetails.h>
+#include <sapphire/level/DemoMoveEncoding.h>
 #include <sapphire/common/RegistrationToken.h>
 #include <sapphire/dialogs/DialogLayer.h>
 #include <sapphire/steam_opt.h>
@@ -83,7 +85,13 @@ void CommunityConnection::connect(SapphireScene* scene) {
 		loggedHardwareUUID = SapphireUUID {};
 		userUUID = SapphireUUID {};
 		levelDetails.clear();
+		levelCatalogSyncRequested = false;
+		levelCatalogSynced = false;
+		levelDownloads.clear();
+		requestedLevelDownloads.clear();
 		onlineUsers.clear();
+		onlineUsersVersion = 0;
+		communityNotificationsRequested = false;
 		messages.clear();
 		connectionTaskRunning = false;
 		messagesRemoteStartIndex = 0;
@@ -106,7 +114,13 @@ void CommunityConnection::connect(SapphireScene* scene) {
 		loggedHardwareUUID = SapphireUUID {};
 		userUUID = SapphireUUID {};
 		levelDetails.clear();
+		levelCatalogSyncRequested = false;
+		levelCatalogSynced = false;
+		levelDownloads.clear();
+		requestedLevelDownloads.clear();
 		onlineUsers.clear();
+		onlineUsersVersion = 0;
+		communityNotificationsRequested = false;
 		messages.clear();
 		connectionTaskRunning = false;
 		messagesRemoteStartIndex = 0;
@@ -156,6 +170,36 @@ TCPIPv4Address CommunityConnection::getCommunityServerAddress() const {
 	return TCPIPv4Address { IPv4Address { 0 }, SAPPHIRE_SERVER_PORT_NUMBER };
 }
 
+void CommunityConnection::updateLevelDetails(unsigned int index, const SapphireLevelDetails& details) {
+	if (index < levelDetails.size()) {
+		levelDetails[index] = details;
+	} else if (index == levelDetails.size()) {
+		levelDetails.add(new SapphireLevelDetails(details));
+	} else {
+		return;
+	}
+	for (auto&& l : levelsQueriedEvents.foreach()) {
+		l(index, &levelDetails[index]);
+	}
+}
+void CommunityConnection::applyChangedLevelDetails(unsigned int index, const SapphireLevelDetails& details) {
+	//the index is only a hint, the server resolves it before we receive the preceding removals
+	if (index < levelDetails.size() && levelDetails[index].uuid == details.uuid) {
+		updateLevelDetails(index, details);
+		return;
+	}
+	for (unsigned int i = 0; i < levelDetails.size(); ++i) {
+		if (levelDetails[i].uuid == details.uuid) {
+			updateLevelDetails(i, details);
+			return;
+		}
+	}
+	if (index <= levelDetails.size()) {
+		//newly added levels are always at the end
+		updateLevelDetails(levelDetails.size(), details);
+	}
+}
+
 void CommunityConnection::readThreadFunction(AsynchronTask& task, const SapphireUUID& hardwareuuid) {
 	auto address = getCommunityServerAddress();
 	if (address.getNetworkAddressInt() == 0) {
@@ -377,6 +421,7 @@ void CommunityConnection::readThreadFunction(AsynchronTask& task, const Sapphire
 								goto exit_loop;
 							}
 							task.postTask([=] {
+								finishLevelDownloadRequest(level.getInfo().uuid);
 								for (auto&& l : levelDownloadEvents.pointers()) {
 									if(l != nullptr) {
 										(*l)(level.getInfo().uuid, SapphireCommError::NoError, &level);
@@ -393,6 +438,7 @@ void CommunityConnection::readThreadFunction(AsynchronTask& task, const Sapphire
 							}
 							LOGE() << "Failed to download level " << uuid.asString();
 							task.postTask([=] {
+								finishLevelDownloadRequest(uuid);
 								for (auto&& l : levelDownloadEvents.pointers()) {
 									if(l != nullptr) {
 										(*l)(uuid, err, nullptr);
@@ -404,6 +450,62 @@ void CommunityConnection::readThreadFunction(AsynchronTask& task, const Sapphire
 					}
 					break;
 				}
+				case SapphireComm::DownloadLevelChunk: {
+					SapphireUUID uuid;
+					uint32 totalsize;
+					uint32 offset;
+					uint32 chunksize;
+					if (!stream->deserialize<SapphireUUID>(uuid) || !stream->deserialize<uint32>(totalsize)
+							|| !stream->deserialize<uint32>(offset) || !stream->deserialize<uint32>(chunksize)) {
+						LOGI() << "Failed to read level chunk";
+						goto exit_loop;
+					}
+					int index = -1;
+					for (int i = 0; i < levelDownloads.size(); ++i) {
+						if (levelDownloads[i].uuid == uuid) {
+							index = i;
+							break;
+						}
+					}
+					if (index < 0 && offset == 0 && totalsize <= SAPPHIRE_DOWNLOAD_MAX_SIZE) {
+						index = levelDownloads.size();
+						levelDownloads.add(new LevelDownload(uuid, totalsize));
+					}
+					//chunks of a level are sent in order
+					if (index < 0 || levelDownloads[index].size != totalsize || levelDownloads[index].received != offset
+							|| chunksize > totalsize - offset) {
+						LOGI() << "Invalid level chunk " << uuid.asString() << " at " << offset;
+						goto exit_loop;
+					}
+					LevelDownload& download = levelDownloads[index];
+					if (stream->read(download.data + offset, chunksize) != (int) chunksize) {
+						LOGI() << "Failed to read level chunk data";
+						goto exit_loop;
+					}
+					download.received += chunksize;
+					if (download.received == totalsize) {
+						Level level;
+						bool loaded;
+						{
+							auto&& is = InputStream::wrap(MemoryInput<const char> { download.data, totalsize });
+							loaded = level.loadLevel(is);
+						}
+						delete levelDownloads.remove(index);
+						if (!loaded) {
+							LOGI() << "Failed to load downloaded level";
+							goto exit_loop;
+						}
+						task.postTask([=] {
+							finishLevelDownloadRequest(uuid);
+							for (auto&& l : levelDownloadEvents.pointers()) {
+								if(l != nullptr) {
+									(*l)(level.getInfo().uuid, SapphireCommError::NoError, &level);
+								}
+							}
+						});
+					}
+					break;
+				}
 				case SapphireComm::RateLevel: {
 					SapphireUUID uuid;
 					SapphireCommError error;
@@ -574,40 +676,96 @@ void CommunityConnection::readThreadFunction(AsynchronTask& task, const Sapphire
 							goto exit_loop;
 						}
 						LOGI() << "User became online: " << name << " with difficulty state: " << diffstate;
-						task.postTask(
-								[=] {
-									for (auto&& p : onlineUsers.pointers()) {
-										if(p->getConnectionId() == connid) {
-											p->getUserName() = util::move(name);
-											p->getDifficultyLevel() = diffstate;
-											return;
-										}
-									}
-									ContainerLinkedNode<OnlineUser>* usernode = new ContainerLinkedNode<OnlineUser>(connid, util::move(name), diffstate);
-									onlineUsers.addToEnd(*usernode);
-									for (auto&& l : userStateChangedEvents.foreach()) {
-										l(*usernode, true);
-									}
-								});
+						task.postTask([=] {
+							if (!communityNotificationsRequested) {
+								return;
+							}
+							setUserOnline(connid, util::move(name), diffstate);
+						});
 					} else {
 						//someone disconnected
 						LOGI() << "User became offline with id: " << connid.asString();
 						task.postTask([=] {
-							for (auto&& n : onlineUsers.nodes()) {
-								if(n->get()->getConnectionId() == connid) {
-									LOGI() << "User disconnected: " << n->get()->getUserName();
-									n->removeLinkFromList();
-									for (auto&& l : userStateChangedEvents.foreach()) {
-										l(*n->get(), false);
-									}
-									delete n;
-									break;
-								}
+							if (!communityNotificationsRequested) {
+								return;
 							}
+							setUserOffline(connid);
 						});
 					}
 					break;
 				}
+				case SapphireComm::OnlineUsersSnapshot: {
+					uint32 version;
+					uint32 count;
+					if (!stream->deserialize<uint32>(version) || !stream->deserialize<uint32>(count)) {
+						goto exit_loop;
+					}
+					ArrayList<OnlineUser> users;
+					for (uint32 i = 0; i < count; ++i) {
+						SapphireUUID connid;
+						SapphireDifficulty diffstate;
+						FixedString name;
+						if (!stream->deserialize<SapphireUUID>(connid) || !stream->deserialize<SapphireDifficulty>(diffstate)
+								|| !stream->deserialize<SafeFixedString<SAPPHIRE_USERNAME_MAX_LEN>>(name)) {
+							LOGI() << "Read failure";
+							goto exit_loop;
+						}
+						users.add(new OnlineUser(connid, util::move(name), diffstate));
+					}
+					LOGI() << "Online users snapshot: " << count << " version: " << version;
+					task.postTask([=] {
+						if (!communityNotificationsRequested) {
+							return;
+						}
+						applyOnlineUsersSnapshot(version, users);
+					});
+					break;
+				}
+				case SapphireComm::OnlineUsersChanged: {
+					uint32 version;
+					uint32 offlinecount;
+					if (!stream->deserialize<uint32>(version) || !stream->deserialize<uint32>(offlinecount)) {
+						goto exit_loop;
+					}
+					ArrayList<SapphireUUID> offline;
+					for (uint32 i = 0; i < offlinecount; ++i) {
+						SapphireUUID connid;
+						if (!stream->deserialize<SapphireUUID>(connid)) {
+							goto exit_loop;
+						}
+						offline.add(new SapphireUUID(connid));
+					}
+					uint32 onlinecount;
+					if (!stream->deserialize<uint32>(onlinecount)) {
+						goto exit_loop;
+					}
+					ArrayList<OnlineUser> online;
+					for (uint32 i = 0; i < onlinecount; ++i) {
+						SapphireUUID connid;
+						SapphireDifficulty diffstate;
+						FixedString name;
+						if (!stream->deserialize<SapphireUUID>(connid) || !stream->deserialize<SapphireDifficulty>(diffstate)
+								|| !stream->deserialize<SafeFixedString<SAPPHIRE_USERNAME_MAX_LEN>>(name)) {
+							LOGI() << "Read failure";
+							goto exit_loop;
+						}
+						online.add(new OnlineUser(connid, util::move(name), diffstate));
+					}
+					task.postTask([=] {
+						if (!communityNotificationsRequested || version <= onlineUsersVersion) {
+							return;
+						}
+						onlineUsersVersion = version;
+						for (int i = 0; i < offline.size(); ++i) {
+							setUserOffline(offline[i]);
+						}
+						for (int i = 0; i < online.size(); ++i) {
+							const OnlineUser& u = online[i];
+							setUserOnline(u.getConnectionId(), u.getUserName(), u.getDifficultyLevel());
+						}
+					});
+					break;
+				}
 				case SapphireComm::LevelDetailsChanged: {
 					uint32 index;
 					if (!stream->deserialize<uint32>(index)) {
@@ -628,13 +786,88 @@ void CommunityConnection::readThreadFunction(AsynchronTask& task, const Sapphire
 					});
 					break;
 				}
+				case SapphireComm::SyncLevels: {
+					SapphireCommError error;
+					if (!stream->deserialize<SapphireCommError>(error)) {
+						LOGI() << "Failed to read";
+						goto exit_loop;
+					}
+					if (error != SapphireCommError::NoError) {
+						LOGI() << "Level catalog sync error: " << error;
+						task.postTask([=] {
+							//page through the levels instead
+							levelCatalogSynced = true;
+							requestLevels();
+						});
+						break;
+					}
+					SapphireUUID epoch;
+					uint32 sequence;
+					bool reset;
+					uint32 count;
+					if (!stream->deserialize<SapphireUUID>(epoch) || !stream->deserialize<uint32>(sequence) || !stream->deserialize<bool>(reset)
+							|| !stream->deserialize<uint32>(count)) {
+						LOGI() << "Failed to read";
+						goto exit_loop;
+					}
+					ArrayList<SapphireUUID> removed;
+					for (unsigned int i = 0; i < count; ++i) {
+						SapphireUUID* uuid = new SapphireUUID();
+						removed.add(uuid);
+						if (!stream->deserialize<SapphireUUID>(*uuid)) {
+							LOGI() << "Failed to read";
+							goto exit_loop;
+						}
+					}
+					if (!stream->deserialize<uint32>(count)) {
+						LOGI() << "Failed to read";
+						goto exit_loop;
+					}
+					ArrayList<SapphireLevelDetails> changed;
+					for (unsigned int i = 0; i < count; ++i) {
+						SapphireLevelDetails* details = new SapphireLevelDetails();
+						changed.add(details);
+						if (!stream->deserialize<SapphireLevelDetails>(*details)) {
+							LOGI() << "Failed to read";
+							goto exit_loop;
+						}
+					}
+					uint32 totalcount;
+					if (!stream->deserialize<uint32>(totalcount)) {
+						LOGI() << "Failed to read";
+						goto exit_loop;
+					}
+					LOGI() << "Level catalog changes: removed: " << removed.size() << " changed: " << changed.size() << " reset: " << reset;
+					task.postTask([=] {
+						applyLevelCatalogChanges(epoch, sequence, reset, removed, changed, totalcount);
+					});
+					break;
+				}
+				case SapphireComm::LevelDetailsBatch: {
+					uint32 count;
+					if (!stream->deserialize<uint32>(count)) {
+						goto exit_loop;
+					}
+					for (unsigned int i = 0; i < count; ++i) {
+						uint32 index;
+						SapphireLevelDetails details;
+						if (!stream->deserialize<uint32>(index) || !stream->deserialize<SapphireLevelDetails>(details)) {
+							LOGI() << "Failed to read";
+							goto exit_loop;
+						}
+						task.postTask([=] {
+							applyChangedLevelDetails(index, details);
+						});
+					}
+					break;
+				}
 				case SapphireComm::LevelRemoved: {
 					uint32 index;
 					if (!stream->deserialize<uint32>(index)) {
 						goto exit_loop;
 					}
 					task.postTask([=] {
-						if(index <= levelDetails.size()) {
+						if(index < levelDetails.size()) {
 							for (auto&& l : levelRemovedEvents.foreach()) {
 								l(levelDetails.get(index));
 							}
@@ -658,17 +891,7 @@ void CommunityConnection::readThreadFunction(AsynchronTask& task, const Sapphire
 								goto exit_loop;
 							}
 							task.postTask([=] {
-								if(index < levelDetails.size()) {
-									levelDetails[index] = details;
-									for (auto&& l : levelsQueriedEvents.foreach()) {
-										l(index, &levelDetails[index]);
-									}
-								} else if(index == levelDetails.size()) {
-									levelDetails.add(new SapphireLevelDetails(util::move(details)));
-									for (auto&& l : levelsQueriedEvents.foreach()) {
-										l(index, &levelDetails[index]);
-									}
-								}
+								updateLevelDetails(index, details);
 							});
 							break;
 						}
@@ -918,7 +1141,7 @@ void CommunityConnection::readThreadFunction(AsynchronTask& task, const Sapphire
 							uint32 randomseed;
 							FixedString steps;
 							if (!stream->deserialize<uint32>(randomseed)
-									|| !stream->deserialize<SafeFixedString<SAPPHIRE_DEMO_MAX_LEN>>(steps)) {
+									|| !stream->deserialize<SafeDemoMoves>(steps)) {
 								LOGI() << "Failed to read";
 								goto exit_loop;
 							}
@@ -1039,7 +1262,7 @@ void CommunityConnection::postUploadLevel(const Level& level) {
 		if (!eostream.serialize<SapphireComm>(SapphireComm::UploadLevel)) {
 			return false;
 		}
-		level.saveLevel(eostream, true);
+		level.saveLevel(eostream, true, true);
 		return true;
 	});
 }
@@ -1049,6 +1272,14 @@ void CommunityConnection::uploadLevel(const Level& level) {
 }
 
 void CommunityConnection::requestLevels() {
+	if (!levelCatalogSyncRequested) {
+		requestLevelCatalogSync(true);
+		return;
+	}
+	if (!levelCatalogSynced) {
+		//synchronization in progress
+		return;
+	}
 	uint32 detailscount = levelDetails.size();
 	writeWorker.post([=] {
 		auto&& eostream = *outputStream;
@@ -1061,8 +1292,23 @@ void CommunityConnection::requestLevels() {
 		return true;
 	});
 }
+static int compareRequestedLevelUUID(const SapphireUUID* l, const SapphireUUID& r) {
+	return l->compare(r);
+}
+void CommunityConnection::finishLevelDownloadRequest(const SapphireUUID& leveluuid) {
+	int index = requestedLevelDownloads.getIndexForSorted(leveluuid, compareRequestedLevelUUID);
+	if (index >= 0) {
+		delete requestedLevelDownloads.remove(index);
+	}
+}
 void CommunityConnection::downloadLevel(const SapphireUUID& leveluuid) {
 	ASSERT(scene->canDownloadLevels());
+	int index = requestedLevelDownloads.getIndexForSorted(leveluuid, compareRequestedLevelUUID);
+	if (index >= 0) {
+		//already requested, the listeners are notified when it arrives
+		return;
+	}
+	requestedLevelDownloads.add(-(index + 1), new SapphireUUID(leveluuid));
 	writeWorker.post([=] {
 		auto&& eostream = *outputStream;
 		if (!eostream.serialize<SapphireComm>(SapphireComm::DownloadLevel)) {
@@ -1108,9 +1354,69 @@ void CommunityConnection::sendMessage(const char* message, uint32 userid) {
 	});
 }
 
+void CommunityConnection::setUserOnline(const SapphireUUID& connid, FixedString name, SapphireDifficulty diffstate) {
+	for (auto&& p : onlineUsers.pointers()) {
+		if (p->getConnectionId() == connid) {
+			p->getUserName() = util::move(name);
+			p->getDifficultyLevel() = diffstate;
+			return;
+		}
+	}
+	ContainerLinkedNode<OnlineUser>* usernode = new ContainerLinkedNode<OnlineUser>(connid, util::move(name), diffstate);
+	onlineUsers.addToEnd(*usernode);
+	for (auto&& l : userStateChangedEvents.foreach()) {
+		l(*usernode, true);
+	}
+}
+void CommunityConnection::setUserOffline(const SapphireUUID& connid) {
+	for (auto&& n : onlineUsers.nodes()) {
+		if (n->get()->getConnectionId() == connid) {
+			LOGI() << "User disconnected: " << n->get()->getUserName();
+			n->removeLinkFromList();
+			for (auto&& l : userStateChangedEvents.foreach()) {
+				l(*n->get(), false);
+			}
+			delete n;
+			break;
+		}
+	}
+}
+void CommunityConnection::applyOnlineUsersSnapshot(uint32 version, const ArrayList<OnlineUser>& users) {
+	onlineUsersVersion = version;
+	//keep the users that are still online, so no events are fired for them
+	LinkedList<OnlineUser> previous { util::move(onlineUsers) };
+	for (int i = 0; i < users.size(); ++i) {
+		const OnlineUser& u = users[i];
+		bool found = false;
+		for (auto&& n : previous.nodes()) {
+			if (n->get()->getConnectionId() == u.getConnectionId()) {
+				n->removeLinkFromList();
+				n->get()->getUserName() = u.getUserName();
+				n->get()->getDifficultyLevel() = u.getDifficultyLevel();
+				onlineUsers.addToEnd(*n);
+				found = true;
+				break;
+			}
+		}
+		if (!found) {
+			setUserOnline(u.getConnectionId(), u.getUserName(), u.getDifficultyLevel());
+		}
+	}
+	while (!previous.isEmpty()) {
+		auto* n = previous.first();
+		n->removeLinkFromList();
+		for (auto&& l : userStateChangedEvents.foreach()) {
+			l(*n->get(), false);
+		}
+		delete n;
+	}
+}
+
 void CommunityConnection::requestCommunityNotifications(bool needs) {
+	communityNotificationsRequested = needs;
 	if (!needs) {
 		onlineUsers.clear();
+		onlineUsersVersion = 0;
 		messages.clear();
 		messagesLocalStartIndex = 0;
 		messagesRemoteCount = 0;
@@ -1184,6 +1490,168 @@ void CommunityConnection::requestMessages(unsigned int start, unsigned int count
 	});
 }
 
+void CommunityConnection::requestLevelCatalogSync(bool usecache) {
+	levelCatalogSyncRequested = true;
+	SapphireUUID epoch;
+	uint32 sequence = 0;
+	if (!usecache || !readLevelCatalogCache(&epoch, &sequence, nullptr)) {
+		//null epoch, the server sends the whole catalog
+		epoch = SapphireUUID { };
+		sequence = 0;
+	}
+	writeWorker.post([=] {
+		auto&& eostream = *outputStream;
+		if (!eostream.serialize<SapphireComm>(SapphireComm::SyncLevels)
+				|| !eostream.serialize<SapphireUUID>(epoch)
+				|| !eostream.serialize<uint32>(sequence)) {
+			return false;
+		}
+		return true;
+	});
+}
+
+static int compareCatalogUUIDPtrs(const SapphireUUID* l, const SapphireUUID* r) {
+	return l->compare(*r);
+}
+static int compareCatalogUUID(const SapphireUUID* l, const SapphireUUID& r) {
+	return l->compare(r);
+}
+
+class LevelCatalogLink {
+public:
+	SapphireUUID uuid;
+	unsigned int index;
+
+	LevelCatalogLink(const SapphireUUID& uuid, unsigned int index)
+			: uuid(uuid), index(index) {
+	}
+
+	static int compareUUID(const LevelCatalogLink* l, const SapphireUUID& uuid) {
+		return l->uuid.compare(uuid);
+	}
+};
+
+void CommunityConnection::applyLevelCatalogChanges(const SapphireUUID& epoch, uint32 sequence, bool reset,
+		const ArrayList<SapphireUUID>& removed, const ArrayList<SapphireLevelDetails>& changed, unsigned int totalcount) {
+	ArrayList<SapphireLevelDetails> catalog;
+	if (!reset) {
+		SapphireUUID cacheepoch;
+		uint32 cachesequence;
+		if (!readLevelCatalogCache(&cacheepoch, &cachesequence, &catalog)) {
+			LOGW() << "Failed to read level catalog cache, requesting all levels";
+			requestLevelCatalogSync(false);
+			return;
+		}
+		if (!removed.isEmpty()) {
+			ArrayList<SapphireUUID> removedsorted;
+			for (int i = 0; i < removed.size(); ++i) {
+				removedsorted.setSorted(new SapphireUUID(removed[i]), compareCatalogUUIDPtrs);
+			}
+			//compact in a single pass
+			ArrayList<SapphireLevelDetails> kept;
+			for (auto* details : catalog) {
+				if (removedsorted.getIndexForSorted(details->uuid, compareCatalogUUID) >= 0) {
+					delete details;
+				} else {
+					kept.add(details);
+				}
+			}
+			catalog.clearWithoutDelete();
+			catalog = util::move(kept);
+		}
+	}
+	ArrayList<LevelCatalogLink> lookup;
+	for (int i = 0; i < catalog.size(); ++i) {
+		lookup.add(new LevelCatalogLink(catalog[i].uuid, i));
+	}
+	lookup.sort([](const LevelCatalogLink& l, const LevelCatalogLink& r) {
+		return l.uuid < r.uuid;
+	});
+	for (int i = 0; i < changed.size(); ++i) {
+		auto&& details = changed[i];
+		int idx = lookup.getIndexForSorted(details.uuid, LevelCatalogLink::compareUUID);
+		if (idx >= 0) {
+			catalog[lookup[idx].index] = details;
+		} else {
+			//newly added levels are always at the end
+			lookup.add(-(idx + 1), new LevelCatalogLink(details.uuid, catalog.size()));
+			catalog.add(new SapphireLevelDetails(details));
+		}
+	}
+	if (catalog.size() != totalcount) {
+		LOGW() << "Level catalog size mismatch: " << catalog.size() << " expected: " << totalcount << ", requesting all levels";
+		requestLevelCatalogSync(false);
+		return;
+	}
+	levelCatalogEpoch = epoch;
+	levelCatalogSequence = sequence;
+	levelCatalogSynced = true;
+
+	//assign in place, as listeners may hold pointers to the already present details
+	for (int i = 0; i < catalog.size(); ++i) {
+		updateLevelDetails(i, catalog[i]);
+	}
+	while (levelDetails.size() > catalog.size()) {
+		for (auto&& l : levelRemovedEvents.foreach()) {
+			l(&levelDetails.last());
+		}
+		delete levelDetails.remove(levelDetails.size() - 1);
+	}
+	writeLevelCatalogCache();
+	for (auto&& l : levelsQueriedEvents.foreach()) {
+		l(levelDetails.size(), nullptr);
+	}
+}
+
+bool CommunityConnection::readLevelCatalogCache(SapphireUUID* outepoch, uint32* outsequence, ArrayList<SapphireLevelDetails>* outdetails) {
+	auto&& file = scene->getLevelCatalogFile();
+	if (!file.exists()) {
+		return false;
+	}
+	auto&& istream = EndianInputStream<Endianness::Big>::wrap(file.openInputStream());
+	uint32 version;
+	SapphireUUID user;
+	if (!istream.deserialize<uint32>(version) || version != 1) {
+		return false;
+	}
+	if (!istream.deserialize<SapphireUUID>(user) || user != userUUID) {
+		//the user ratings in the cache belong to a different user
+		return false;
+	}
+	if (!istream.deserialize<SapphireUUID>(*outepoch) || !istream.deserialize<uint32>(*outsequence)) {
+		return false;
+	}
+	if (outdetails == nullptr) {
+		return true;
+	}
+	uint32 count;
+	if (!istream.deserialize<uint32>(count)) {
+		return false;
+	}
+	for (unsigned int i = 0; i < count; ++i) {
+		SapphireLevelDetails* details = new SapphireLevelDetails();
+		if (!istream.deserialize<SapphireLevelDetails>(*details)) {
+			delete details;
+			return false;
+		}
+		outdetails->add(details);
+	}
+	return true;
+}
+
+void CommunityConnection::writeLevelCatalogCache() {
+	auto&& ostream = EndianOutputStream<Endianness::Big>::wrap(scene->getLevelCatalogFile().openOutputStream());
+	//version
+	ostream.serialize<uint32>(1);
+	ostream.serialize<SapphireUUID>(userUUID);
+	ostream.serialize<SapphireUUID>(levelCatalogEpoch);
+	ostream.serialize<uint32>(levelCatalogSequence);
+	ostream.serialize<uint32>(levelDetails.size());
+	for (auto* details : levelDetails) {
+		ostream.serialize<SapphireLevelDetails>(*details);
+	}
+}
+
 bool CommunityConnection::saveRegistrationToken(const RegistrationToken& regtoken) {
 	auto&& ostream = EndianOutputStream<Endianness::Big>::wrap(scene->getRegistrationTokenFile().openOutputStream());
 	return ostream.serialize<RegistrationToken>(regtoken);
@@ -1284,7 +1752,7 @@ void CommunityConnection::postLevelProgress(ProgressSynchId progressid, const Sa
 				|| !eostream.serialize<SapphireLevelCommProgress>(progress)
 				|| !eostream.serialize<ProgressSynchId>(progressid)
 				|| !eostream.serialize<SapphireUUID>(leveluuid)
-				|| !eostream.serialize<FixedString>(steps)
+				|| !eostream.serialize<CompactDemoMoves>(steps)
 				|| !eostream.serialize<uint32>(randomseed)) {
 			return false;
 		}
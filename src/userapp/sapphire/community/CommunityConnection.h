@@ -168,11 +168,52 @@ private:
 	Randomer* randomer = nullptr;
 
 	ArrayList<SapphireLevelDetails> levelDetails;
+	/**
+	 * Cursor of the level catalog, the server only sends the changes since this point.
+	 * The catalog is cached locally between sessions.
+	 */
+	SapphireUUID levelCatalogEpoch;
+	uint32 levelCatalogSequence = 0;
+	bool levelCatalogSyncRequested = false;
+	bool levelCatalogSynced = false;
+
+	class LevelDownload {
+	public:
+		SapphireUUID uuid;
+		char* data;
+		uint32 size;
+		uint32 received = 0;
+
+		LevelDownload(const SapphireUUID& uuid, uint32 size)
+				: uuid(uuid), data(new char[size]), size(size) {
+		}
+		~LevelDownload() {
+			delete[] data;
+		}
+	};
+	/**
+	 * Levels being received in DownloadLevelChunk messages, only accessed by the reader thread.
+	 */
+	ArrayList<LevelDownload> levelDownloads;
+	/**
+	 * Levels requested with DownloadLevel but not received yet, only accessed on the main thread.
+	 * A level is not requested again meanwhile, so the chunks of the same level are never interleaved.
+	 */
+	ArrayList<SapphireUUID> requestedLevelDownloads;
+	void finishLevelDownloadRequest(const SapphireUUID& leveluuid);
 	unsigned int messagesRemoteStartIndex = 0;
 	unsigned int messagesRemoteCount = 0;
 	unsigned int messagesLocalStartIndex = 0;
 	ArrayList<SapphireDiscussionMessage> messages;
 	LinkedList<OnlineUser> onlineUsers;
+	/**
+	 * Version of the online users received from the server, older changes are ignored.
+	 */
+	uint32 onlineUsersVersion = 0;
+	/**
+	 * Presence messages still in flight after the notifications are no longer requested are ignored.
+	 */
+	bool communityNotificationsRequested = false;
 
 	StateListener::Events stateEvents;
 
@@ -186,6 +227,19 @@ private:
 
 	void readThreadFunction(AsynchronTask& task, const SapphireUUID& userid);
 
+	void updateLevelDetails(unsigned int index, const SapphireLevelDetails& details);
+	void applyChangedLevelDetails(unsigned int index, const SapphireLevelDetails& details);
+
+	void requestLevelCatalogSync(bool usecache);
+	void applyLevelCatalogChanges(const SapphireUUID& epoch, uint32 sequence, bool reset, const ArrayList<SapphireUUID>& removed,
+			const ArrayList<SapphireLevelDetails>& changed, unsigned int totalcount);
+	bool readLevelCatalogCache(SapphireUUID* outepoch, uint32* outsequence, ArrayList<SapphireLevelDetails>* outdetails);
+	void writeLevelCatalogCache();
+
+	void setUserOnline(const SapphireUUID& connid, FixedString name, SapphireDifficulty diffstate);
+	void setUserOffline(const SapphireUUID& connid);
+	void applyOnlineUsersSnapshot(uint32 version, const ArrayList<OnlineUser>& users);
+
 	void postUpgradeStream();
 	void postLogin();
 	void postUpdatePlayerData(const FixedString& name, SapphireDifficulty diffcolor);
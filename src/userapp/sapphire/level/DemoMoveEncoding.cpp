@@ -0,0 +1,44 @@
+/*
+ * Copyright (C) 2020 Bence Sipka
+ *
+ * This program is free software: you can redistribute it and/or modify 
+ * it under the terms of the GNU General Public License as published by 
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/*
+ * DemoMoveEncoding.cpp
+ *
+ *  Created on: 2026. okt. 19.
+ *      Author: sipka
+ */
+
+#include <sapphire/level/DemoMoveEncoding.h>
+
+namespace userapp {
+
+static const char NIBBLE_MOVES[] = { '.', 'l', 't', 'r', 'b', 'L', 'T', 'R', 'B', 'm', 'u', 's', 'c' };
+
+int DemoMoveEncoding::getMoveNibble(char move) {
+	for (unsigned int i = 0; i < sizeof(NIBBLE_MOVES); ++i) {
+		if (NIBBLE_MOVES[i] == move) {
+			return i;
+		}
+	}
+	return -1;
+}
+char DemoMoveEncoding::getNibbleMove(unsigned int nibble) {
+	if (nibble >= sizeof(NIBBLE_MOVES)) {
+		return 0;
+	}
+	return NIBBLE_MOVES[nibble];
+}
+
+}  // namespace userapp
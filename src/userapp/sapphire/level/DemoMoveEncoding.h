@@ -0,0 +1,346 @@
+/*
+ * Copyright (C) 2020 Bence Sipka
+ *
+ * This program is free software: you can redistribute it and/or modify 
+ * it under the terms of the GNU General Public License as published by 
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/*
+ * DemoMoveEncoding.h
+ *
+ *  Created on: 2026. okt. 19.
+ *      Author: sipka
+ */
+
+#ifndef TEST_SAPPHIRE_LEVEL_DEMOMOVEENCODING_H_
+#define TEST_SAPPHIRE_LEVEL_DEMOMOVEENCODING_H_
+
+#include <framework/utils/FixedString.h>
+#include <sapphire/sapphireconstants.h>
+
+#include <gen/types.h>
+#include <gen/serialize.h>
+#include <gen/log.h>
+
+#include <string.h>
+
+namespace userapp {
+using namespace rhfw;
+
+/**
+ * Compact encoding of demo moves for storage and transfer.
+ *
+ * Demo moves are serialized with a tagged length. If the highest bit of the leading uint32 is not set,
+ * it is the length of a plain move string, which follows the same way as a serialized FixedString.
+ * Else bits 24-30 hold the encoding version, and the low 24 bits the move count. It is followed by the
+ * uint32 byte count of the encoded data.
+ *
+ * Version 1 packs every move in a nibble, high nibble first. A run of at least MIN_REPEAT_LENGTH same moves is
+ * written as the move, REPEAT_NIBBLE, and the run length - MIN_REPEAT_LENGTH in 3 bit groups,
+ * least significant first, the fourth bit of a group signaling that more groups follow.
+ */
+class DemoMoveEncoding {
+public:
+	static const uint32 VERSION = 1;
+	static const uint32 COMPACT_FLAG = 0x80000000;
+	static const uint32 VERSION_SHIFT = 24;
+	static const uint32 COUNT_MASK = 0x00FFFFFF;
+
+	static const unsigned int REPEAT_NIBBLE = 0xF;
+	static const unsigned int MIN_REPEAT_LENGTH = 3;
+private:
+	template<typename NibbleHandler>
+	static bool forEachNibble(const char* moves, unsigned int count, NibbleHandler&& handler) {
+		for (unsigned int i = 0; i < count;) {
+			int nibble = getMoveNibble(moves[i]);
+			if (nibble < 0) {
+				return false;
+			}
+			unsigned int run = 1;
+			while (i + run < count && moves[i + run] == moves[i]) {
+				++run;
+			}
+			if (run >= MIN_REPEAT_LENGTH) {
+				handler(nibble);
+				handler(REPEAT_NIBBLE);
+				uint32 remaining = run - MIN_REPEAT_LENGTH;
+				while (remaining > 0x7) {
+					handler((remaining & 0x7) | 0x8);
+					remaining >>= 3;
+				}
+				handler(remaining);
+			} else {
+				for (unsigned int r = 0; r < run; ++r) {
+					handler(nibble);
+				}
+			}
+			i += run;
+		}
+		return true;
+	}
+
+	template<typename InStream>
+	class NibbleReader {
+		InStream& is;
+		uint32 remaining;
+		unsigned char buffer[256];
+		unsigned int bufferCount = 0;
+		unsigned int nibbleIndex = 0;
+	public:
+		NibbleReader(InStream& is, uint32 bytecount)
+				: is(is), remaining(bytecount) {
+		}
+
+		int next() {
+			if (nibbleIndex == bufferCount * 2) {
+				if (remaining == 0) {
+					return -1;
+				}
+				unsigned int toread = remaining > sizeof(buffer) ? sizeof(buffer) : remaining;
+				if (is.read(buffer, toread) != (int) toread) {
+					return -1;
+				}
+				remaining -= toread;
+				bufferCount = toread;
+				nibbleIndex = 0;
+			}
+			unsigned char b = buffer[nibbleIndex / 2];
+			return (nibbleIndex++ % 2) == 0 ? (b >> 4) : (b & 0xF);
+		}
+		/**
+		 * Returns true if only the padding nibble of the last byte is unread.
+		 */
+		bool isFullyRead() const {
+			return remaining == 0 && bufferCount * 2 - nibbleIndex <= 1;
+		}
+	};
+public:
+	/**
+	 * Returns -1 for unknown moves.
+	 */
+	static int getMoveNibble(char move);
+	/**
+	 * Returns 0 for unknown nibbles.
+	 */
+	static char getNibbleMove(unsigned int nibble);
+
+	/**
+	 * Returns false if the moves cannot be encoded.
+	 */
+	static bool getEncodedSize(const char* moves, unsigned int count, uint32* outsize) {
+		uint32 nibbles = 0;
+		if (!forEachNibble(moves, count, [&](unsigned int nibble) {
+			++nibbles;
+		})) {
+			return false;
+		}
+		*outsize = (nibbles + 1) / 2;
+		return true;
+	}
+
+	template<typename OutStream>
+	static bool encode(OutStream& os, const char* moves, unsigned int count) {
+		unsigned char buffer[256];
+		unsigned int nibbleIndex = 0;
+		bool success = true;
+		bool encodable = forEachNibble(moves, count, [&](unsigned int nibble) {
+			if (nibbleIndex % 2 == 0) {
+				buffer[nibbleIndex / 2] = nibble << 4;
+			} else {
+				buffer[nibbleIndex / 2] |= nibble;
+			}
+			if (++nibbleIndex == sizeof(buffer) * 2) {
+				success = success && os.write(buffer, sizeof(buffer));
+				nibbleIndex = 0;
+			}
+		});
+		return encodable && success && (nibbleIndex == 0 || os.write(buffer, (nibbleIndex + 1) / 2));
+	}
+
+	/**
+	 * Decodes the moves directly from the stream to the output buffer of count moves, reading exactly bytecount bytes.
+	 */
+	template<typename InStream>
+	static bool decode(InStream& is, uint32 bytecount, char* outmoves, unsigned int count) {
+		NibbleReader<InStream> reader { is, bytecount };
+		for (unsigned int i = 0; i < count;) {
+			int nibble = reader.next();
+			if (nibble < 0) {
+				return false;
+			}
+			if (nibble == REPEAT_NIBBLE) {
+				if (i == 0) {
+					return false;
+				}
+				uint32 repeat = 0;
+				for (unsigned int shift = 0;; shift += 3) {
+					int group = reader.next();
+					//run lengths fit in the 24 bit move count
+					if (group < 0 || shift >= 24) {
+						return false;
+					}
+					repeat |= (uint32) (group & 0x7) << shift;
+					if ((group & 0x8) == 0) {
+						break;
+					}
+				}
+				//the first move of the run is already written
+				repeat += MIN_REPEAT_LENGTH - 1;
+				if (repeat > count - i) {
+					return false;
+				}
+				memset(outmoves + i, outmoves[i - 1], repeat);
+				i += repeat;
+			} else {
+				char move = getNibbleMove(nibble);
+				if (move == 0) {
+					return false;
+				}
+				outmoves[i++] = move;
+			}
+		}
+		return reader.isFullyRead();
+	}
+};
+
+/**
+ * Serializes the moves with the compact encoding if that is smaller.
+ */
+class CompactDemoMoves {
+public:
+	const FixedString& moves;
+	CompactDemoMoves(const FixedString& moves)
+			: moves(moves) {
+	}
+};
+/**
+ * Deserializes moves in any encoding, up to SAPPHIRE_DEMO_MAX_LEN moves.
+ */
+class SafeDemoMoves {
+public:
+	FixedString& moves;
+	SafeDemoMoves(FixedString& moves)
+			: moves(moves) {
+	}
+};
+class IgnoreDemoMoves {
+public:
+	IgnoreDemoMoves(NULLPTR_TYPE) {
+	}
+	IgnoreDemoMoves() {
+	}
+};
+
+}  // namespace userapp
+
+namespace rhfw {
+using namespace userapp;
+
+template<Endianness ENDIAN>
+class SerializeExecutor<CompactDemoMoves, ENDIAN> {
+public:
+	template<typename OutStream>
+	static bool serialize(OutStream& os, const CompactDemoMoves& data) {
+		unsigned int count = data.moves.length();
+		uint32 size;
+		if (count > DemoMoveEncoding::COUNT_MASK || !DemoMoveEncoding::getEncodedSize(data.moves, count, &size)
+				|| sizeof(uint32) + size >= count) {
+			return SerializeHandler<FixedString>::serialize<ENDIAN>(os, data.moves);
+		}
+		return SerializeHandler<uint32>::serialize<ENDIAN>(os,
+				DemoMoveEncoding::COMPACT_FLAG | (DemoMoveEncoding::VERSION << DemoMoveEncoding::VERSION_SHIFT) | count)
+				&& SerializeHandler<uint32>::serialize<ENDIAN>(os, size) && DemoMoveEncoding::encode(os, data.moves, count);
+	}
+};
+
+template<Endianness ENDIAN>
+class SerializeExecutor<SafeDemoMoves, ENDIAN> {
+public:
+	template<typename InStream>
+	static bool deserialize(InStream& is, SafeDemoMoves& outdata) {
+		uint32 tag;
+		if (!SerializeHandler<uint32>::deserialize<ENDIAN>(is, tag)) {
+			LOGW()<< "Deserialize error";
+			return false;
+		}
+		uint32 count = tag & ~DemoMoveEncoding::COMPACT_FLAG;
+		uint32 size = count;
+		if ((tag & DemoMoveEncoding::COMPACT_FLAG) != 0) {
+			uint32 version = count >> DemoMoveEncoding::VERSION_SHIFT;
+			count &= DemoMoveEncoding::COUNT_MASK;
+			if (version != DemoMoveEncoding::VERSION) {
+				LOGW()<< "Unknown demo move encoding version: " << version;
+				return false;
+			}
+			if (!SerializeHandler<uint32>::deserialize<ENDIAN>(is, size)) {
+				LOGW()<< "Deserialize error";
+				return false;
+			}
+		}
+		if (count > SAPPHIRE_DEMO_MAX_LEN) {
+			LOGW()<< "Demo exceeded max size: " << SAPPHIRE_DEMO_MAX_LEN << " with: " << count;
+			return false;
+		}
+		char* array = new char[count + 1];
+		bool success;
+		if ((tag & DemoMoveEncoding::COMPACT_FLAG) != 0) {
+			success = DemoMoveEncoding::decode(is, size, array, count);
+		} else {
+			success = is.read(array, count) == (int) count;
+		}
+		if (!success) {
+			LOGW()<< "Failed to read demo moves: " << count;
+			delete[] array;
+			return false;
+		}
+		array[count] = 0;
+		outdata.moves = FixedString::make(array, count);
+		return true;
+	}
+	template<typename InStream>
+	static bool deserialize(InStream& is, SafeDemoMoves&& outdata) {
+		return deserialize(is, outdata);
+	}
+};
+
+template<Endianness ENDIAN>
+class SerializeExecutor<IgnoreDemoMoves, ENDIAN> {
+public:
+	template<typename InStream>
+	static bool deserialize(InStream& is, const IgnoreDemoMoves& outdata) {
+		uint32 len;
+		if (!SerializeHandler<uint32>::deserialize<ENDIAN>(is, len)) {
+			LOGW()<< "Deserialize error";
+			return false;
+		}
+		if ((len & DemoMoveEncoding::COMPACT_FLAG) != 0 && !SerializeHandler<uint32>::deserialize<ENDIAN>(is, len)) {
+			LOGW()<< "Deserialize error";
+			return false;
+		}
+		while (len > 0) {
+			char buffer[4096];
+			uint32 toskip = len > sizeof(buffer) ? sizeof(buffer) : len;
+			if (is.read(buffer, toskip) != (int) toskip) {
+				return false;
+			}
+			len -= toskip;
+		}
+		return true;
+	}
+	template<typename InStream>
+	static bool deserialize(InStream& is, IgnoreDemoMoves&& outdata) {
+		return deserialize(is, outdata);
+	}
+};
+
+}  // namespace rhfw
+
+#endif /* TEST_SAPPHIRE_LEVEL_DEMOMOVEENCODING_H_ */
@@ -25,6 +25,7 @@
 
 #include <sapphire/level/Level.h>
 #include <sapphire/level/SapphireUUID.h>
+#include <sapphire/level/DemoMoveEncoding.h>
 #include <sapphire/sapphireconstants.h>
 #include <sapphire/common/commonmain.h>
 
@@ -786,12 +787,14 @@ Level::Level(const Level& o)
 		this->wheel = &MAP(o.wheel->x, o.wheel->y);
 	}
 
+	rebuildTrackedObjects();
 }
 Level& Level::operator=(Level&& o) {
 	delete[] map;
 	delete[] controls;
 	delete[] yamyamRemainders;
 	delete[] demoSteps;
+	delete[] trackedObjects;
 
 	info = util::move(o.info);
 	width = util::move(o.width);
@@ -815,6 +818,9 @@ Level& Level::operator=(Level&& o) {
 	demos = util::move(o.demos);
 	controls = util::move(o.controls);
 	map = util::move(o.map);
+	trackedObjects = util::move(o.trackedObjects);
+	trackedObjectCount = util::move(o.trackedObjectCount);
+	trackedObjectCapacity = util::move(o.trackedObjectCapacity);
 	demoSteps = util::move(o.demoSteps);
 	demoStepsLength = util::move(o.demoStepsLength);
 	originalRandomSeed = util::move(o.originalRandomSeed);
@@ -838,6 +844,10 @@ Level& Level::operator=(const Level& o) {
 	delete[] controls;
 	delete[] yamyamRemainders;
 	delete[] demoSteps;
+	delete[] trackedObjects;
+	trackedObjects = nullptr;
+	trackedObjectCount = 0;
+	trackedObjectCapacity = 0;
 
 	info = o.info;
 	width = o.width;
@@ -888,13 +898,123 @@ Level& Level::operator=(const Level& o) {
 		this->wheel = nullptr;
 	}
 
+	rebuildTrackedObjects();
+
 	return *this;
 }
+void Level::copySimulationState(const Level& o) {
+	if (width * height != o.width * o.height) {
+		delete[] map;
+		map = new GameObject[o.width * o.height];
+	}
+	if (playerCount != o.playerCount) {
+		delete[] controls;
+		controls = new PlayerControl[o.playerCount];
+	}
+	if (yamyamRemainderCount != o.yamyamRemainderCount) {
+		delete[] yamyamRemainders;
+		yamyamRemainders = o.yamyamRemainderCount > 0 ? new ObjectIdentifier[o.yamyamRemainderCount * 9] : nullptr;
+	}
+	if (demoStepsLength != o.demoStepsLength) {
+		delete[] demoSteps;
+		demoSteps = new char[o.demoStepsLength];
+	}
+	if (trackedObjectCapacity < o.trackedObjectCount) {
+		delete[] trackedObjects;
+		trackedObjects = new unsigned int[o.trackedObjectCapacity];
+		trackedObjectCapacity = o.trackedObjectCapacity;
+	}
+
+	width = o.width;
+	height = o.height;
+	playerCount = o.playerCount;
+	properties = o.properties;
+	currentDispenserValue = o.currentDispenserValue;
+	currentElevatorValue = o.currentElevatorValue;
+	closeExitOnEnter = o.closeExitOnEnter;
+	wheelRemainingTurns = o.wheelRemainingTurns;
+	openedExists = o.openedExists;
+	targetLoot = o.targetLoot;
+	pickedLoot = o.pickedLoot;
+	minersFinished = o.minersFinished;
+	minersTotal = o.minersTotal;
+	minersPlaying = o.minersPlaying;
+	yamyamRemainderCount = o.yamyamRemainderCount;
+	currentYamyamRemainder = o.currentYamyamRemainder;
+	demoStepsLength = o.demoStepsLength;
+	trackedObjectCount = o.trackedObjectCount;
+	originalRandomSeed = o.originalRandomSeed;
+	random = o.random;
+	keysCollected = o.keysCollected;
+	bombsCollected = o.bombsCollected;
+	lootLost = o.lootLost;
+	levelVersion = o.levelVersion;
+	lastLorrySoundTurn = o.lastLorrySoundTurn;
+	lastBugSoundTurn = o.lastBugSoundTurn;
+	statistics = o.statistics;
+
+	if (o.yamyamRemainderCount > 0) {
+		memcpy(yamyamRemainders, o.yamyamRemainders, o.yamyamRemainderCount * 9 * sizeof(ObjectIdentifier));
+	}
+	memcpy(controls, o.controls, o.playerCount * sizeof(PlayerControl));
+	memcpy(demoSteps, o.demoSteps, o.demoStepsLength * sizeof(char));
+	memcpy(map, o.map, o.width * o.height * sizeof(GameObject));
+	if (o.trackedObjectCount > 0) {
+		memcpy(trackedObjects, o.trackedObjects, o.trackedObjectCount * sizeof(unsigned int));
+	}
+
+	if (o.wheel != nullptr) {
+		this->wheel = &MAP(o.wheel->x, o.wheel->y);
+	} else {
+		this->wheel = nullptr;
+	}
+}
+void Level::swapSimulationState(Level& o) {
+	util::swap(width, o.width);
+	util::swap(height, o.height);
+	util::swap(playerCount, o.playerCount);
+	util::swap(properties, o.properties);
+	util::swap(currentDispenserValue, o.currentDispenserValue);
+	util::swap(currentElevatorValue, o.currentElevatorValue);
+	util::swap(closeExitOnEnter, o.closeExitOnEnter);
+	util::swap(wheel, o.wheel);
+	util::swap(wheelRemainingTurns, o.wheelRemainingTurns);
+	util::swap(openedExists, o.openedExists);
+	util::swap(targetLoot, o.targetLoot);
+	util::swap(pickedLoot, o.pickedLoot);
+	util::swap(minersFinished, o.minersFinished);
+	util::swap(minersTotal, o.minersTotal);
+	util::swap(minersPlaying, o.minersPlaying);
+	util::swap(yamyamRemainders, o.yamyamRemainders);
+	util::swap(yamyamRemainderCount, o.yamyamRemainderCount);
+	util::swap(currentYamyamRemainder, o.currentYamyamRemainder);
+	util::swap(controls, o.controls);
+	util::swap(map, o.map);
+	util::swap(trackedObjects, o.trackedObjects);
+	util::swap(trackedObjectCount, o.trackedObjectCount);
+	util::swap(trackedObjectCapacity, o.trackedObjectCapacity);
+	util::swap(demoSteps, o.demoSteps);
+	util::swap(demoStepsLength, o.demoStepsLength);
+	util::swap(originalRandomSeed, o.originalRandomSeed);
+	util::swap(random, o.random);
+	util::swap(keysCollected, o.keysCollected);
+	util::swap(bombsCollected, o.bombsCollected);
+	util::swap(lootLost, o.lootLost);
+	util::swap(levelVersion, o.levelVersion);
+	util::swap(lastLorrySoundTurn, o.lastLorrySoundTurn);
+	util::swap(lastBugSoundTurn, o.lastBugSoundTurn);
+	util::swap(statistics, o.statistics);
+	util::swap(laserId, o.laserId);
+	util::swap(soundCount, o.soundCount);
+	util::swap(soundsIndex, o.soundsIndex);
+	util::swap(sounds, o.sounds);
+}
 Level::~Level() {
 	delete[] map;
 	delete[] controls;
 	delete[] yamyamRemainders;
 	delete[] demoSteps;
+	delete[] trackedObjects;
 }
 inline bool Level::canFallDown(GameObject& obj) {
 	if (!HAS_FLAG(obj.props, SapphireProps::Fallable))
@@ -1704,6 +1824,7 @@ Level::GameObject* Level::tryMovePlayerTo(Level::GameObject& player, Level::Game
 		player.state = SapphireState::Moving;
 		player.setMoving();
 		nextto.set(player);
+		moveTrackedObject(player, nextto);
 		setObjectTurn(nextto);
 		bool putbombsuccess = putbomb && nextto.decreaseBombCount();
 		player.set(SampleMap[putbombsuccess ? SapphireObject::TickBomb : SapphireObject::Air]);
@@ -1803,6 +1924,7 @@ Level::GameObject* Level::tryMovePlayerTo(Level::GameObject& player, Level::Game
 					}
 
 					nextto.set(player);
+					moveTrackedObject(player, nextto);
 					bool putbombsuccess = putbomb && nextto.decreaseBombCount();
 					player.set(SampleMap[putbombsuccess ? SapphireObject::TickBomb : SapphireObject::Air]);
 					if (putbombsuccess) {
@@ -1846,6 +1968,7 @@ Level::GameObject* Level::tryMovePlayerTo(Level::GameObject& player, Level::Game
 				nextto.setUsingDoor();
 				setObjectTurn(nextto);
 				nextnext->set(player);
+				moveTrackedObject(player, *nextnext);
 
 				bool putbombsuccess = putbomb && nextnext->decreaseBombCount();
 				player.set(SampleMap[putbombsuccess ? SapphireObject::TickBomb : SapphireObject::Air]);
@@ -2323,6 +2446,9 @@ bool Level::turnExplosion(GameObject& o) {
 			o.set(getGameObjectForIdentifier(expres));
 			setObjectTurn(o);
 			o.setExplosionSpawning();
+			if (isTrackedObject(o.object)) {
+				addTrackedObject(o);
+			}
 
 			if (o.object == SapphireObject::Player) {
 				++minersTotal;
@@ -2750,6 +2876,8 @@ void Level::applyTurn() {
 
 	robotTargets.clear();
 
+	compactTrackedObjects();
+
 	for (unsigned int j = 0; j < height; ++j) {
 		for (unsigned int i = 0; i < width; ++i) {
 			GameObject& o = MAP(i, j);
@@ -2992,7 +3120,7 @@ void Level::applyTurn() {
 
 	checkLoot();
 }
-void Level::saveLevel(OutputStream& os, bool includeuserdemos) const {
+void Level::saveLevel(OutputStream& os, bool includeuserdemos, bool compactdemos) const {
 	auto stream = EndianOutputStream<Endianness::Big>::wrap(os);
 
 	unsigned int version = getLevelVersion();
@@ -3110,14 +3238,18 @@ void Level::saveLevel(OutputStream& os, bool includeuserdemos) const {
 		stream.serialize<char>('R');
 		stream.serialize<uint32>(d->randomseed);
 		stream.serialize<FixedString>(d->info.title);
-		stream.serialize<FixedString>(d->moves);
+		if (compactdemos) {
+			stream.serialize<CompactDemoMoves>(d->moves);
+		} else {
+			stream.serialize<FixedString>(d->moves);
+		}
 	}
 
 	stream.serialize<char>(SAPPHIRE_CMD_END_OF_FILE);
 }
-void Level::saveLevel(FileDescriptor& fd, bool includeuserdemos) const {
+void Level::saveLevel(FileDescriptor& fd, bool includeuserdemos, bool compactdemos) const {
 	auto out = fd.openOutputStream();
-	saveLevel(out, includeuserdemos);
+	saveLevel(out, includeuserdemos, compactdemos);
 }
 bool Level::loadLevel(InputStream& is) {
 	for (unsigned int i = 0; i < (unsigned int) SapphireSound::_count_of_entries; ++i) {
@@ -3415,7 +3547,7 @@ bool Level::loadLevel(InputStream& is) {
 				if (!stream.deserialize<SafeFixedString<SAPPHIRE_LEVEL_TITLE_MAX_LEN>>(d->info.title)) {
 					return false;
 				}
-				if (!stream.deserialize<SafeFixedString<SAPPHIRE_DEMO_MAX_LEN>>(d->moves)) {
+				if (!stream.deserialize<SafeDemoMoves>(d->moves)) {
 					return false;
 				}
 
@@ -3474,6 +3606,8 @@ bool Level::loadLevel(InputStream& is) {
 
 	lastLorrySoundTurn = -1000;
 	lastBugSoundTurn = -1000;
+
+	rebuildTrackedObjects();
 	return true;
 }
 bool Level::loadLevel(FileDescriptor& fd) {
@@ -3540,7 +3674,7 @@ void Level::resize(unsigned int width, unsigned int height) {
 			obj.y = j;
 		}
 	}
-
+	rebuildTrackedObjects();
 }
 void Level::expand(unsigned int left, unsigned int top, unsigned int right, unsigned int bottom) {
 	unsigned int nwidth = width + left + right;
@@ -3565,6 +3699,7 @@ void Level::expand(unsigned int left, unsigned int top, unsigned int right, unsi
 			obj.y = j;
 		}
 	}
+	rebuildTrackedObjects();
 }
 void Level::shrink(unsigned int left, unsigned int top, unsigned int right, unsigned int bottom) {
 	ASSERT(left + right < this->width) << left << " " << right << " - " << width;
@@ -3592,6 +3727,7 @@ void Level::shrink(unsigned int left, unsigned int top, unsigned int right, unsi
 			obj.y = j;
 		}
 	}
+	rebuildTrackedObjects();
 }
 
 void Level::resetState() {
@@ -3683,6 +3819,8 @@ void Level::resetState() {
 
 	lastLorrySoundTurn = -1000;
 	lastBugSoundTurn = -1000;
+
+	rebuildTrackedObjects();
 }
 
 Level::GameObject& Level::setObject(unsigned int x, unsigned int y, SapphireObject obj, SapphireDirection dir) {
@@ -3694,6 +3832,9 @@ Level::GameObject& Level::setObject(unsigned int x, unsigned int y, SapphireObje
 		ASSERT(dir != SapphireDirection::Undefined);
 		go.direction = dir;
 	}
+	if (isTrackedObject(go.object)) {
+		addTrackedObject(go);
+	}
 	return go;
 }
 Level::GameObject& Level::setObject(unsigned int x, unsigned int y, const GameObject& proto) {
@@ -3701,6 +3842,9 @@ Level::GameObject& Level::setObject(unsigned int x, unsigned int y, const GameOb
 	ASSERT(y < height);
 	auto& go = MAP(x, y);
 	go.set(proto);
+	if (isTrackedObject(go.object)) {
+		addTrackedObject(go);
+	}
 	return go;
 }
 
@@ -3709,6 +3853,9 @@ Level::GameObject& Level::setObject(unsigned int x, unsigned int y, const Object
 	ASSERT(y < height);
 	auto& go = MAP(x, y);
 	go.set(getGameObjectForIdentifier(objectchar));
+	if (isTrackedObject(go.object)) {
+		addTrackedObject(go);
+	}
 	return go;
 }
 
@@ -3738,15 +3885,74 @@ void Level::setYamYamRemainderCount(unsigned int count) {
 }
 
 unsigned int Level::getMapPlayerCount() const {
-	for (int i = 0; i < getWidth(); ++i) {
-		for (int j = 0; j < getHeight(); ++j) {
-			auto& o = get(i, j);
-			if (o.object == SapphireObject::Player && o.getPlayerId() == 1) {
-				return 2;
-			}
+	unsigned int result = 1;
+	forEachPlayer([&](const GameObject& o) {
+		if (o.getPlayerId() == 1) {
+			result = 2;
+		}
+	});
+	return result;
+}
+
+void Level::addTrackedObject(const GameObject& o) {
+	unsigned int idx = IDX(o.x, o.y);
+	for (unsigned int i = 0; i < trackedObjectCount; ++i) {
+		if (trackedObjects[i] == idx) {
+			return;
+		}
+	}
+	if (trackedObjectCount == trackedObjectCapacity) {
+		compactTrackedObjects();
+	}
+	if (trackedObjectCount == trackedObjectCapacity) {
+		unsigned int ncapacity = trackedObjectCapacity == 0 ? 8 : trackedObjectCapacity * 2;
+		unsigned int* narray = new unsigned int[ncapacity];
+		if (trackedObjectCount > 0) {
+			memcpy(narray, trackedObjects, trackedObjectCount * sizeof(unsigned int));
+		}
+		delete[] trackedObjects;
+		trackedObjects = narray;
+		trackedObjectCapacity = ncapacity;
+	}
+	trackedObjects[trackedObjectCount++] = idx;
+}
+
+void Level::moveTrackedObject(const GameObject& from, const GameObject& to) {
+	unsigned int fromidx = IDX(from.x, from.y);
+	unsigned int toidx = IDX(to.x, to.y);
+	//the target may have a stale entry of a destroyed object, remove it to avoid duplicates
+	for (unsigned int i = 0; i < trackedObjectCount; ++i) {
+		if (trackedObjects[i] == toidx) {
+			trackedObjects[i] = trackedObjects[--trackedObjectCount];
+			break;
+		}
+	}
+	for (unsigned int i = 0; i < trackedObjectCount; ++i) {
+		if (trackedObjects[i] == fromidx) {
+			trackedObjects[i] = toidx;
+			return;
+		}
+	}
+	addTrackedObject(to);
+}
+
+void Level::compactTrackedObjects() {
+	unsigned int count = 0;
+	for (unsigned int i = 0; i < trackedObjectCount; ++i) {
+		if (isTrackedObject(map[trackedObjects[i]].object)) {
+			trackedObjects[count++] = trackedObjects[i];
+		}
+	}
+	trackedObjectCount = count;
+}
+
+void Level::rebuildTrackedObjects() {
+	trackedObjectCount = 0;
+	for (unsigned int i = 0; i < this->width * this->height; ++i) {
+		if (isTrackedObject(map[i].object)) {
+			addTrackedObject(map[i]);
 		}
 	}
-	return 1;
 }
 
 void Level::loseLoot(unsigned int count) {
@@ -702,6 +702,15 @@ private:
 
 	MoveablePointer<GameObject> map = nullptr;
 
+	/**
+	 * Map indexes of the players, so they can be found without scanning the whole map.
+	 * Updated as the players move or spawn.
+	 * Entries may reference objects which were destroyed since, they are skipped when queried.
+	 */
+	MoveablePointer<unsigned int> trackedObjects = nullptr;
+	unsigned int trackedObjectCount = 0;
+	unsigned int trackedObjectCapacity = 0;
+
 	MoveablePointer<char> demoSteps = nullptr;
 	unsigned int demoStepsLength = 0;
 
@@ -789,6 +798,14 @@ private:
 		o.turn = this->getTurn();
 	}
 
+	static bool isTrackedObject(SapphireObject obj) {
+		return obj == SapphireObject::Player;
+	}
+	void addTrackedObject(const GameObject& o);
+	void moveTrackedObject(const GameObject& from, const GameObject& to);
+	void compactTrackedObjects();
+	void rebuildTrackedObjects();
+
 	GameObject* getObjectInDirection(SapphireDirection dir, unsigned int x, unsigned int y);
 	GameObject* getObjectInDirection(SapphireDirection dir, const GameObject& src);
 
@@ -831,11 +848,24 @@ public:
 	Level& operator=(Level&&);
 	~Level();
 
+	/**
+	 * Copies the state which is modified by applyTurn() from the argument. The level info, demos and music are not copied,
+	 * the levels are expected to be loaded from the same source. Reuses the allocated buffers when possible.
+	 */
+	void copySimulationState(const Level& o);
+	/**
+	 * Swaps the state which is modified by applyTurn() with the argument, without copying the map.
+	 */
+	void swapSimulationState(Level& o);
+
 	bool loadLevel(RAssetFile asset);
 	bool loadLevel(FileDescriptor& fd);
 	bool loadLevel(InputStream& is);
-	void saveLevel(FileDescriptor& fd, bool includeuserdemos = false) const;
-	void saveLevel(OutputStream& os, bool includeuserdemos = false) const;
+	/**
+	 * Compact demos can only be loaded by release version 8 or later.
+	 */
+	void saveLevel(FileDescriptor& fd, bool includeuserdemos = false, bool compactdemos = false) const;
+	void saveLevel(OutputStream& os, bool includeuserdemos = false, bool compactdemos = false) const;
 
 	unsigned int getHeight() const {
 		return height;
@@ -1029,6 +1059,20 @@ public:
 
 	unsigned int getMapPlayerCount() const;
 
+	/**
+	 * Calls the handler with every player on the map, in unspecified order.
+	 * Runs in time proportional to the number of players, not the map size.
+	 */
+	template<typename Handler>
+	void forEachPlayer(Handler&& handler) const {
+		for (unsigned int i = 0; i < trackedObjectCount; ++i) {
+			const GameObject& o = map[trackedObjects[i]];
+			if (o.object == SapphireObject::Player) {
+				handler(o);
+			}
+		}
+	}
+
 	unsigned int getLevelVersion() const {
 		return levelVersion;
 	}
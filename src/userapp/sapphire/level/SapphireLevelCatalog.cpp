@@ -0,0 +1,174 @@
+/*
+ * Copyright (C) 2020 Bence Sipka
+ *
+ * This program is free software: you can redistribute it and/or modify 
+ * it under the terms of the GNU General Public License as published by 
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/*
+ * SapphireLevelCatalog.cpp
+ *
+ *  Created on: 2026. okt. 19.
+ *      Author: sipka
+ */
+
+#include <framework/io/stream/InputStream.h>
+#include <framework/utils/MemoryInput.h>
+
+#include <sapphire/level/SapphireLevelCatalog.h>
+#include <sapphire/level/SapphireLevelDescriptor.h>
+#include <sapphire/sapphireconstants.h>
+
+#include <gen/log.h>
+#include <gen/serialize.h>
+
+#include <string.h>
+
+#define CATALOG_VERSION 2
+//asset name offset + length, levelversion, title offset + length, author offset + length, difficulty, category, democount, playercount, leaderboards
+//uuid, flags
+#define CATALOG_ENTRY_SIZE (12 * 4 + 16 + 1)
+
+#define CATALOG_FLAG_NON_MODIFYABLE 0x01
+#define CATALOG_FLAG_HAS_AUTHOR 0x02
+
+namespace userapp {
+
+bool SapphireLevelCatalog::load(FileDescriptor& fd) {
+	groups.clear();
+	delete[] data;
+	data = fd.readFully(&length);
+	if (data == nullptr) {
+		length = 0;
+		return false;
+	}
+
+	MemoryInput<const char> in { data, length };
+	auto&& is = EndianInputStream<Endianness::Big>::wrap(in);
+
+	char magic[4];
+	uint32 version;
+	if (is.read(magic, 4) != 4 || memcmp(magic, "RHLC", sizeof(magic)) != 0
+			|| !is.deserialize<uint32>(version)) {
+		LOGW()<< "Invalid level catalog header";
+		return false;
+	}
+	if (version != CATALOG_VERSION) {
+		LOGW()<< "Unsupported level catalog version: " << version;
+		return false;
+	}
+	uint32 stringslen;
+	if (!is.deserialize<uint32>(stringslen) || stringslen > in.getLength()) {
+		return false;
+	}
+	unsigned int available;
+	strings = in.read(stringslen, &available);
+	stringsLength = stringslen;
+
+	uint32 groupcount;
+	if (!is.deserialize<uint32>(groupcount)) {
+		return false;
+	}
+	for (unsigned int i = 0; i < groupcount; ++i) {
+		uint32 nameoffset;
+		uint32 namelen;
+		uint32 count;
+		const char* name;
+		if (!is.deserialize<uint32>(nameoffset) || !is.deserialize<uint32>(namelen) || !is.deserialize<uint32>(count)
+				|| !getString(nameoffset, namelen, &name)) {
+			groups.clear();
+			return false;
+		}
+		if (count > in.getLength() / CATALOG_ENTRY_SIZE) {
+			LOGW()<< "Level catalog is truncated";
+			groups.clear();
+			return false;
+		}
+		const char* entries = in.read(count * CATALOG_ENTRY_SIZE, &available);
+		groups.add(new Group(name, namelen, entries, count));
+	}
+	return true;
+}
+
+bool SapphireLevelCatalog::getString(unsigned int offset, unsigned int length, const char** outstr) const {
+	if (offset > stringsLength || length > stringsLength - offset) {
+		return false;
+	}
+	*outstr = strings + offset;
+	return true;
+}
+
+const SapphireLevelCatalog::Group* SapphireLevelCatalog::getGroup(const char* name) const {
+	unsigned int len = (unsigned int) strlen(name);
+	for (auto&& g : groups) {
+		if (g->nameLength == len && memcmp(g->name, name, len) == 0) {
+			return g;
+		}
+	}
+	return nullptr;
+}
+
+bool SapphireLevelCatalog::makeDescriptor(const Group& group, unsigned int index, SapphireLevelDescriptor* desc) const {
+	ASSERT(index < group.count) << "Index out of bounds: " << index << " - " << group.count;
+
+	auto&& is = EndianInputStream<Endianness::Big>::wrap(
+			MemoryInput<const char> { group.entries + index * CATALOG_ENTRY_SIZE, CATALOG_ENTRY_SIZE });
+
+	uint32 assetnameoffset;
+	uint32 assetnamelen;
+	uint32 version;
+	uint32 titleoffset;
+	uint32 titlelen;
+	uint32 authoroffset;
+	uint32 authorlen;
+	uint32 diff;
+	uint32 cat;
+	uint8 flags;
+	const char* title;
+	const char* author = nullptr;
+	//the asset name is only used for verification by the converter
+	if (!is.deserialize<uint32>(assetnameoffset) || !is.deserialize<uint32>(assetnamelen) || !is.deserialize<uint32>(version)
+			|| !is.deserialize<uint32>(titleoffset) || !is.deserialize<uint32>(titlelen)
+			|| !is.deserialize<uint32>(authoroffset) || !is.deserialize<uint32>(authorlen) || !is.deserialize<uint32>(diff)
+			|| !is.deserialize<uint32>(cat) || !is.deserialize<uint32>(desc->demoCount)
+			|| !is.deserialize<uint32>(desc->playerCount) || !is.deserialize<SapphireLeaderboards>(desc->leaderboards)
+			|| !is.deserialize<SapphireUUID>(desc->uuid) || !is.deserialize<uint8>(flags)) {
+		return false;
+	}
+	if (version > SAPPHIRE_RELEASE_VERSION_NUMBER || version > SAPPHIRE_LEVEL_VERSION_NUMBER) {
+		return false;
+	}
+	if (diff >= (uint32) SapphireDifficulty::_count_of_entries) {
+		return false;
+	}
+	if (titlelen == 0 || titlelen > SAPPHIRE_LEVEL_TITLE_MAX_LEN || !getString(titleoffset, titlelen, &title)) {
+		return false;
+	}
+	if ((flags & CATALOG_FLAG_HAS_AUTHOR) != 0
+			&& (authorlen > SAPPHIRE_LEVEL_AUTHOR_MAX_LEN || !getString(authoroffset, authorlen, &author))) {
+		return false;
+	}
+
+	desc->levelVersion = version;
+	desc->difficulty = (SapphireDifficulty) diff;
+	if (cat < (uint32) SapphireLevelCategory::_count_of_entries) {
+		desc->category = (SapphireLevelCategory) cat;
+	}
+	desc->title = FixedString { title, titlelen };
+	if (author != nullptr) {
+		desc->author = FixedString { author, authorlen };
+	}
+	desc->nonModifyAbleFlag = (flags & CATALOG_FLAG_NON_MODIFYABLE) != 0;
+	return true;
+}
+
+}  // namespace userapp
+
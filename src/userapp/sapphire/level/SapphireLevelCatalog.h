@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2020 Bence Sipka
+ *
+ * This program is free software: you can redistribute it and/or modify 
+ * it under the terms of the GNU General Public License as published by 
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/*
+ * SapphireLevelCatalog.h
+ *
+ *  Created on: 2026. okt. 19.
+ *      Author: sipka
+ */
+
+#ifndef TEST_SAPPHIRE_LEVEL_SAPPHIRELEVELCATALOG_H_
+#define TEST_SAPPHIRE_LEVEL_SAPPHIRELEVELCATALOG_H_
+
+#include <framework/io/files/FileDescriptor.h>
+#include <framework/utils/ArrayList.h>
+
+#include <gen/types.h>
+
+namespace userapp {
+using namespace rhfw;
+
+class SapphireLevelDescriptor;
+
+/**
+ * Prebuilt index of the descriptors of the builtin levels.
+ * <p>
+ * Generated by the level converter build step. The levels are grouped by their asset directory, and the entries in a
+ * group are in the same order as the assets of the directory are enumerated. The converter verifies this order against
+ * the asset names of the entries, so the level files are only read if a group is missing or inconsistent.
+ */
+class SapphireLevelCatalog {
+public:
+	class Group {
+		friend class SapphireLevelCatalog;
+
+		const char* name;
+		unsigned int nameLength;
+		const char* entries;
+		unsigned int count;
+
+		Group(const char* name, unsigned int namelength, const char* entries, unsigned int count)
+				: name(name), nameLength(namelength), entries(entries), count(count) {
+		}
+	public:
+		unsigned int getCount() const {
+			return count;
+		}
+	};
+private:
+	char* data = nullptr;
+	unsigned int length = 0;
+
+	const char* strings = nullptr;
+	unsigned int stringsLength = 0;
+
+	ArrayList<Group> groups;
+
+	bool getString(unsigned int offset, unsigned int length, const char** outstr) const;
+public:
+	SapphireLevelCatalog() {
+	}
+	SapphireLevelCatalog(const SapphireLevelCatalog&) = delete;
+	SapphireLevelCatalog& operator=(const SapphireLevelCatalog&) = delete;
+	~SapphireLevelCatalog() {
+		delete[] data;
+	}
+
+	/**
+	 * Reads the catalog file in one go. Returns false if the file is not present or malformed.
+	 */
+	bool load(FileDescriptor& fd);
+
+	/**
+	 * Returns the group for the given asset directory, or nullptr if not found.
+	 */
+	const Group* getGroup(const char* name) const;
+
+	/**
+	 * Initializes the descriptor the same way as SapphireLevelDescriptor::make would from the level file.
+	 * The file descriptor is not set.
+	 */
+	bool makeDescriptor(const Group& group, unsigned int index, SapphireLevelDescriptor* desc) const;
+};
+
+}  // namespace userapp
+
+#endif /* TEST_SAPPHIRE_LEVEL_SAPPHIRELEVELCATALOG_H_ */
@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2020 Bence Sipka
+ *
+ * This program is free software: you can redistribute it and/or modify 
+ * it under the terms of the GNU General Public License as published by 
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/*
+ * BandWorkers.cpp
+ *
+ *  Created on: 2026. okt. 19.
+ *      Author: sipka
+ */
+
+#include <framework/threading/Thread.h>
+#include <gen/log.h>
+
+#include <sapphire/levelrender/BandWorkers.h>
+
+namespace userapp {
+
+BandWorkers::BandWorkers() {
+	unsigned int processors = Thread::getProcessorCount();
+	workerCount = processors <= 1 ? 0 : processors - 1;
+	if (workerCount > MAX_WORKER_COUNT) {
+		workerCount = MAX_WORKER_COUNT;
+	}
+}
+
+BandWorkers::~BandWorkers() {
+	exiting = true;
+	for (unsigned int i = 0; i < startedWorkers; ++i) {
+		workSemaphore.post();
+	}
+	for (unsigned int i = 0; i < startedWorkers; ++i) {
+		exitSemaphore.wait();
+	}
+}
+
+void BandWorkers::executeBands() {
+	while (true) {
+		unsigned int band = nextBand.fetch_add(1, std::memory_order_relaxed);
+		if (band >= bandCount) {
+			break;
+		}
+		function(context, band);
+	}
+}
+
+void BandWorkers::runWorker() {
+	while (true) {
+		workSemaphore.wait();
+		if (exiting) {
+			break;
+		}
+		executeBands();
+		doneSemaphore.post();
+	}
+	exitSemaphore.post();
+}
+
+void BandWorkers::execute(unsigned int bandcount, BandFunction function, void* context) {
+	ASSERT(function != nullptr);
+
+	unsigned int notified = bandcount <= 1 ? 0 : bandcount - 1;
+	if (notified > workerCount) {
+		notified = workerCount;
+	}
+	this->function = function;
+	this->context = context;
+	this->bandCount = bandcount;
+	nextBand.store(0, std::memory_order_relaxed);
+
+	while (startedWorkers < notified) {
+		++startedWorkers;
+		Thread t;
+		t.start([this]() {
+			this->runWorker();
+			return 0;
+		});
+	}
+	for (unsigned int i = 0; i < notified; ++i) {
+		workSemaphore.post();
+	}
+	executeBands();
+	//every notified worker posts exactly once, even if all the bands were taken before it woke up
+	for (unsigned int i = 0; i < notified; ++i) {
+		doneSemaphore.wait();
+	}
+}
+
+}  // namespace userapp
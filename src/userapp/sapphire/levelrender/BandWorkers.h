@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2020 Bence Sipka
+ *
+ * This program is free software: you can redistribute it and/or modify 
+ * it under the terms of the GNU General Public License as published by 
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/*
+ * BandWorkers.h
+ *
+ *  Created on: 2026. okt. 19.
+ *      Author: sipka
+ */
+
+#ifndef TEST_SAPPHIRE_LEVELRENDER_BANDWORKERS_H_
+#define TEST_SAPPHIRE_LEVELRENDER_BANDWORKERS_H_
+
+#include <framework/threading/Semaphore.h>
+
+#include <atomic>
+
+namespace userapp {
+using namespace rhfw;
+
+/**
+ * Executes a function for a number of bands in parallel, using the calling thread and a set of worker threads.
+ * <p>
+ * The bands are taken in order by whichever thread is free, so every band should take about the same time. The
+ * worker threads are started when they are first needed.
+ */
+class BandWorkers {
+public:
+	static const unsigned int MAX_WORKER_COUNT = 7;
+
+	typedef void (*BandFunction)(void* context, unsigned int band);
+private:
+	unsigned int workerCount;
+	unsigned int startedWorkers = 0;
+
+	Semaphore workSemaphore { Semaphore::auto_init { } };
+	Semaphore doneSemaphore { Semaphore::auto_init { } };
+	Semaphore exitSemaphore { Semaphore::auto_init { } };
+
+	bool exiting = false;
+
+	/**
+	 * Parameters of the current execution, written before the workers are notified.
+	 */
+	BandFunction function = nullptr;
+	void* context = nullptr;
+	unsigned int bandCount = 0;
+	std::atomic<unsigned int> nextBand { 0 };
+
+	void runWorker();
+	void executeBands();
+public:
+	BandWorkers();
+	BandWorkers(const BandWorkers&) = delete;
+	BandWorkers& operator=(const BandWorkers&) = delete;
+	~BandWorkers();
+
+	/**
+	 * The number of threads that can execute bands at the same time, including the calling thread.
+	 */
+	unsigned int getThreadCount() const {
+		return workerCount + 1;
+	}
+
+	/**
+	 * Calls the function for every band in [0, bandcount), and returns when all of them are done.
+	 */
+	void execute(unsigned int bandcount, BandFunction function, void* context);
+};
+
+}  // namespace userapp
+
+#endif /* TEST_SAPPHIRE_LEVELRENDER_BANDWORKERS_H_ */
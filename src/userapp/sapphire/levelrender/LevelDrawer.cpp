@@ -52,36 +52,31 @@ void LevelDrawer::draw(float turnpercent, float alpha) {
 	Vector2F mid[3] { { 0.0f, 0.0f }, { 0.0f, 0.0f }, { 0.0f, 0.0f } };
 	unsigned int midcount[2] { 0, 0 };
 
-	for (int i = 0; i < levelsize.width(); ++i) {
-		for (int j = 0; j < levelsize.height(); ++j) {
-			const Level::GameObject& o = level->get(i, j);
-			if (o.object == SapphireObject::Player) {
-				unsigned int playerid = o.getPlayerId();
-				++midcount[playerid];
-				mid[playerid].x() += i;
-				mid[playerid].y() += j;
-				if (o.isMoving()) {
-					float percent = o.isPlayerUsingDoor() ? turnpercent * 2 - 2 : turnpercent - 1;
-					switch (o.direction) {
-						case SapphireDirection::Down:
-							mid[playerid].y() -= percent;
-							break;
-						case SapphireDirection::Up:
-							mid[playerid].y() += percent;
-							break;
-						case SapphireDirection::Left:
-							mid[playerid].x() -= percent;
-							break;
-						case SapphireDirection::Right:
-							mid[playerid].x() += percent;
-							break;
-						default:
-							break;
-					}
-				}
+	level->forEachPlayer([&](const Level::GameObject& o) {
+		unsigned int playerid = o.getPlayerId();
+		++midcount[playerid];
+		mid[playerid].x() += o.x;
+		mid[playerid].y() += o.y;
+		if (o.isMoving()) {
+			float percent = o.isPlayerUsingDoor() ? turnpercent * 2 - 2 : turnpercent - 1;
+			switch (o.direction) {
+				case SapphireDirection::Down:
+					mid[playerid].y() -= percent;
+					break;
+				case SapphireDirection::Up:
+					mid[playerid].y() += percent;
+					break;
+				case SapphireDirection::Left:
+					mid[playerid].x() -= percent;
+					break;
+				case SapphireDirection::Right:
+					mid[playerid].x() += percent;
+					break;
+				default:
+					break;
 			}
 		}
-	}
+	});
 
 	for (unsigned int playerid = 0; playerid < 2; ++playerid) {
 		if (midcount[playerid] != 0) {
@@ -20,6 +20,7 @@
  *      Author: sipka
  */
 
+#include <framework/core/Profiler.h>
 #include <framework/geometry/Rectangle.h>
 #include <framework/geometry/Vector.h>
 #include <framework/render/Renderer.h>
@@ -55,6 +56,15 @@ inline static float directionToRadian(SapphireDirection dir) {
 LevelDrawer2D::LevelDrawer2D(LevelDrawer& parent, const Level* level)
 		: level(level) {
 }
+LevelDrawer2D::~LevelDrawer2D() {
+	freeStaticChunks();
+}
+
+void LevelDrawer2D::levelReloaded() {
+	for (unsigned int i = 0; i < staticChunkColumns * staticChunkRows; ++i) {
+		staticChunks[i].valid = false;
+	}
+}
 
 FrameAnimation::Element LevelDrawer2D::getPlayerElement(MinerAnimations& mineranims, bool pushing, bool digging, bool moving,
 		SapphireDirection dir, float turnpercent) {
@@ -257,11 +267,8 @@ void LevelDrawer2D::drawDoor(const FrameAnimation& anim, const Level::GameObject
 	drawSapphireTexturePrepared(mvp, elem, alpha, TILE_RECT, elem.getPosition());
 }
 
-void LevelDrawer2D::drawEarth(const Level::GameObject& o, const Matrix2D& mvp, float alpha) {
+unsigned int LevelDrawer2D::getEarthIndex(int i, int j) {
 	unsigned int index = 0;
-	int i = (int) o.x;
-	int j = (int) o.y;
-
 	if (i - 1 < 0
 			|| (level->get(i - 1, j).object != SapphireObject::Earth && level->get(i - 1, j).getPastObject() != SapphireObject::Earth)) {
 		index |= 0x1;
@@ -278,13 +285,272 @@ void LevelDrawer2D::drawEarth(const Level::GameObject& o, const Matrix2D& mvp, f
 			|| (level->get(i, j + 1).object != SapphireObject::Earth && level->get(i, j + 1).getPastObject() != SapphireObject::Earth)) {
 		index |= 0x2;
 	}
+	return index;
+}
 
-	auto& elem = earthanim->getAtIndex(index);
+void LevelDrawer2D::drawEarth(const Level::GameObject& o, const Matrix2D& mvp, float alpha) {
+	auto& elem = earthanim->getAtIndex(getEarthIndex((int) o.x, (int) o.y));
 	drawSapphireTexturePrepared(mvp, elem, alpha, TILE_RECT, elem.getPosition());
 }
 
+void LevelDrawer2D::drawStaticObject(const Level::GameObject& o, const Matrix2D& mvp, float alpha) {
+	switch (o.object) {
+		case SapphireObject::Glass: {
+			auto& elem = glassanim->getAtIndex(0);
+			drawSapphireTexturePrepared(mvp, elem, alpha, TILE_RECT, elem.getPosition());
+			break;
+		}
+		case SapphireObject::TNT: {
+			auto& elem = tntanim->getAtIndex(0);
+			drawSapphireTexturePrepared(mvp, elem, alpha, TILE_RECT, elem.getPosition());
+			break;
+		}
+		case SapphireObject::RoundStoneWall: {
+			auto& elem = roundstonewallanim->getAtIndex(0);
+			drawSapphireTexturePrepared(mvp, elem, alpha, TILE_RECT, elem.getPosition());
+			break;
+		}
+		case SapphireObject::StoneWall: {
+			auto& elem = stonewallanim->getAtIndex(0);
+			drawSapphireTexturePrepared(mvp, elem, alpha, TILE_RECT, elem.getPosition());
+			if (o.isStoneWallWithObject()) {
+				switch (o.getStoneWallObject()) {
+					case SapphireObject::Emerald: {
+						auto& elem = stonewallgemmask->getAtIndex(0);
+						drawSapphireTexturePrepared(mvp, elem, Color { 0, 1, 0, alpha }, TILE_RECT, elem.getPosition());
+						break;
+					}
+					case SapphireObject::Ruby: {
+						auto& elem = stonewallgemmask->getAtIndex(0);
+						drawSapphireTexturePrepared(mvp, elem, Color { 1, 0, 0, alpha }, TILE_RECT, elem.getPosition());
+						break;
+					}
+					case SapphireObject::Sapphire: {
+						auto& elem = stonewallgemmask->getAtIndex(0);
+						drawSapphireTexturePrepared(mvp, elem, Color { 0, 0.375, 1, alpha }, TILE_RECT, elem.getPosition());
+						break;
+					}
+					case SapphireObject::Citrine: {
+						auto& elem = stonewallgemmask->getAtIndex(0);
+						drawSapphireTexturePrepared(mvp, elem, Color { 1, 1, 0, alpha }, TILE_RECT, elem.getPosition());
+						break;
+					}
+					default: {
+						break;
+					}
+				}
+			}
+			break;
+		}
+		case SapphireObject::Wall: {
+			auto& elem = wallanim->getAtIndex(0);
+			drawSapphireTexturePrepared(mvp, elem, alpha, TILE_RECT, elem.getPosition());
+			break;
+		}
+		case SapphireObject::Safe: {
+			auto& elem = safeanim->getAtIndex(0);
+			drawSapphireTexturePrepared(mvp, elem, alpha, TILE_RECT, elem.getPosition());
+			break;
+		}
+		case SapphireObject::TimeBomb: {
+			auto& elem = timebombanim->getAtIndex(0);
+			drawSapphireTexturePrepared(mvp, elem, alpha, TILE_RECT, elem.getPosition());
+			break;
+		}
+		case SapphireObject::Sand: {
+			auto& elem = sandanim->getAtIndex(0);
+			drawSapphireTexturePrepared(mvp, elem, alpha, TILE_RECT, elem.getPosition());
+			break;
+		}
+		case SapphireObject::Wheel: {
+			auto& elem = wheelanim->getAtIndex(0);
+			drawSapphireTexturePrepared(mvp, elem, alpha, TILE_RECT, elem.getPosition());
+			break;
+		}
+		case SapphireObject::PusherLeft: {
+			auto& elem = pusherleftanim->getAtIndex(0);
+			drawSapphireTexturePrepared(mvp, elem, alpha, TILE_RECT, elem.getPosition());
+			break;
+		}
+		case SapphireObject::PusherRight: {
+			auto& elem = pusherrightanim->getAtIndex(0);
+			drawSapphireTexturePrepared(mvp, elem, alpha, TILE_RECT, elem.getPosition());
+			break;
+		}
+			//case SapphireObject::InvisibleWall: //TODO create object as invisible unblowable wall
+		case SapphireObject::InvisibleStoneWall: {
+			auto& elem = darkwallanim->getAtIndex(0);
+			drawSapphireTexturePrepared(mvp, elem, alpha, TILE_RECT, elem.getPosition());
+			break;
+		}
+		default: {
+			THROW()<< "Not a static object: " << o.object;
+			break;
+		}
+	}
+}
+
+uint32 LevelDrawer2D::getStaticTileKey(const Level::GameObject& o) {
+	if (o.isMoving() || o.isPastObjectPicked() || o.isCitrineBreaking() || o.isCitrineShattered() || o.isAnyExplosion()
+			|| o.isPropagateExplosion() || o.isLaser()) {
+		return 0;
+	}
+	uint32 extra = 0;
+	switch (o.object) {
+		case SapphireObject::Glass:
+		case SapphireObject::TNT:
+		case SapphireObject::RoundStoneWall:
+		case SapphireObject::Wall:
+		case SapphireObject::Safe:
+		case SapphireObject::TimeBomb:
+		case SapphireObject::Sand:
+		case SapphireObject::PusherLeft:
+		case SapphireObject::PusherRight:
+		case SapphireObject::InvisibleStoneWall: {
+			break;
+		}
+		case SapphireObject::Wheel: {
+			if (o.isWheelActive()) {
+				return 0;
+			}
+			break;
+		}
+		case SapphireObject::StoneWall: {
+			if (o.isStoneWallWithObject()) {
+				extra = (uint32) o.getStoneWallObject() + 1;
+			}
+			break;
+		}
+		case SapphireObject::Earth: {
+			extra = getEarthIndex((int) o.x, (int) o.y) + 1;
+			break;
+		}
+		default: {
+			return 0;
+		}
+	}
+	return ((uint32) o.object + 1) | (extra << 8);
+}
+
+void LevelDrawer2D::freeStaticChunks() {
+	delete[] staticChunks;
+	staticChunks = nullptr;
+	staticChunkColumns = 0;
+	staticChunkRows = 0;
+}
+
+bool LevelDrawer2D::ensureStaticChunks(const Size2F& objectSize) {
+	if (STATIC_CHUNK_SIZE * objectSize.width() > STATIC_CHUNK_MAX_TEXTURE_SIZE
+			|| STATIC_CHUNK_SIZE * objectSize.height() > STATIC_CHUNK_MAX_TEXTURE_SIZE) {
+		freeStaticChunks();
+		return false;
+	}
+	unsigned int columns = (level->getWidth() + STATIC_CHUNK_SIZE - 1) / STATIC_CHUNK_SIZE;
+	unsigned int rows = (level->getHeight() + STATIC_CHUNK_SIZE - 1) / STATIC_CHUNK_SIZE;
+	if (columns != staticChunkColumns || rows != staticChunkRows) {
+		freeStaticChunks();
+		staticChunks = new StaticChunk[columns * rows];
+		staticChunkColumns = columns;
+		staticChunkRows = rows;
+	}
+	if (staticChunkObjectSize.width() != objectSize.width() || staticChunkObjectSize.height() != objectSize.height()) {
+		staticChunkObjectSize = objectSize;
+		levelReloaded();
+	}
+	return true;
+}
+
+void LevelDrawer2D::updateStaticChunk(StaticChunk& chunk, unsigned int cx, unsigned int cy, const Size2F& objectSize) {
+	const unsigned int startx = cx * STATIC_CHUNK_SIZE;
+	const unsigned int starty = cy * STATIC_CHUNK_SIZE;
+	const unsigned int endx = min(startx + STATIC_CHUNK_SIZE, level->getWidth());
+	const unsigned int endy = min(starty + STATIC_CHUNK_SIZE, level->getHeight());
+
+	bool changed = !chunk.valid;
+	for (unsigned int i = startx; i < endx; ++i) {
+		for (unsigned int j = starty; j < endy; ++j) {
+			uint32 key = getStaticTileKey(level->get(i, j));
+			uint32& stored = chunk.tileKeys[(i - startx) + (j - starty) * STATIC_CHUNK_SIZE];
+			if (stored != key) {
+				stored = key;
+				changed = true;
+			}
+		}
+	}
+	if (!changed) {
+		return;
+	}
+
+	Size2UI texsize { (unsigned int) ceilf(STATIC_CHUNK_SIZE * objectSize.width()), (unsigned int) ceilf(
+			STATIC_CHUNK_SIZE * objectSize.height()) };
+	if (chunk.texture == nullptr) {
+		chunk.texture = renderer->createTexture();
+		chunk.target = renderer->createRenderTarget();
+		render::RenderTargetDescriptor desc;
+		desc.setColorTarget(chunk.texture);
+		chunk.target->setDescriptor(desc);
+	}
+	if (!chunk.valid || chunk.texture->getWidth() != texsize.width() || chunk.texture->getHeight() != texsize.height()) {
+		chunk.texture->setInputSource(new StaticChunkInputSource { &chunk, texsize });
+		chunk.texture.loadOrReload();
+		chunk.target.loadOrReload();
+	}
+
+	PROFILE_ZONE("LevelDrawer2D::updateStaticChunk");
+	renderer->pushRenderTarget(chunk.target);
+	{
+		auto vp = renderer->getViewPort();
+		renderer->resetViewPort();
+		renderer->setDepthTest(false);
+		renderer->initDraw();
+		renderer->clearColor(Color { 0, 0, 0, 0 });
+		prepareSapphireTextureDraw();
+
+		//same coordinate system as the level is drawn in, with the chunk covering the texture
+		const float height = (float) level->getHeight();
+		Matrix2D cmvp = Matrix2D { }.setScreenDimension((float) startx, height - starty - STATIC_CHUNK_SIZE,
+				(float) startx + STATIC_CHUNK_SIZE, height - starty).multRenderToTexture(renderer);
+		for (unsigned int i = startx; i < endx; ++i) {
+			for (unsigned int j = starty; j < endy; ++j) {
+				if (chunk.tileKeys[(i - startx) + (j - starty) * STATIC_CHUNK_SIZE] == 0) {
+					continue;
+				}
+				const Level::GameObject& o = level->get(i, j);
+				Matrix2D mvp;
+				mvp.setTranslate(0.5f + i, -0.5f + (height - j)) *= cmvp;
+				if (o.object == SapphireObject::Earth) {
+					drawEarth(o, mvp, 1.0f);
+				} else {
+					drawStaticObject(o, mvp, 1.0f);
+				}
+			}
+		}
+		renderer->setViewPort(vp);
+	}
+	renderer->popRenderTarget();
+	chunk.valid = true;
+}
+
 void LevelDrawer2D::draw(LevelDrawer& parent, float turnpercent, float alpha, const Size2UI& begin, const Size2UI& end, const Vector2F& mid,
 		const Size2F& objectSize) {
+	PROFILE_ZONE("LevelDrawer2D::draw");
+	const bool staticlayer = ensureStaticChunks(objectSize);
+	const unsigned int chunkbeginx = begin.x() / STATIC_CHUNK_SIZE;
+	const unsigned int chunkbeginy = begin.y() / STATIC_CHUNK_SIZE;
+	const unsigned int chunkendx = (end.x() + STATIC_CHUNK_SIZE - 1) / STATIC_CHUNK_SIZE;
+	const unsigned int chunkendy = (end.y() + STATIC_CHUNK_SIZE - 1) / STATIC_CHUNK_SIZE;
+	const core::time_micros now = core::MonotonicTime::getCurrent();
+	if (staticlayer) {
+		//update before the drawing begins, as the chunks are drawn using other render targets
+		for (unsigned int cx = chunkbeginx; cx < chunkendx; ++cx) {
+			for (unsigned int cy = chunkbeginy; cy < chunkendy; ++cy) {
+				StaticChunk& chunk = staticChunks[cx + cy * staticChunkColumns];
+				updateStaticChunk(chunk, cx, cy, objectSize);
+				chunk.lastUsed = now;
+			}
+		}
+	}
+
 	prepareSapphireTextureDraw();
 
 	renderer->setDepthTest(false);
@@ -300,8 +566,32 @@ void LevelDrawer2D::draw(LevelDrawer& parent, float turnpercent, float alpha, co
 			* (parent.isDispenserFullOpacity() ?
 					1.0f : (dispenserspeed == 0 ? 1.0f : ((level->getDispenserValue() % dispenserspeed) + turnpercent) / dispenserspeed));
 
+	if (staticlayer) {
+		//the colors in the chunks are already multiplied by the alpha of the tiles
+		renderer->setPremultipliedAlphaBlend(true);
+		renderer->initDraw();
+		const Color chunkcolor { alpha, alpha, alpha, alpha };
+		const float height = (float) level->getHeight();
+		for (unsigned int cx = chunkbeginx; cx < chunkendx; ++cx) {
+			for (unsigned int cy = chunkbeginy; cy < chunkendy; ++cy) {
+				StaticChunk& chunk = staticChunks[cx + cy * staticChunkColumns];
+				const float left = (float) (cx * STATIC_CHUNK_SIZE);
+				const float bottom = height - cy * STATIC_CHUNK_SIZE;
+				drawSapphireTexturePrepared(omvp, chunk.texture, chunkcolor,
+						Rectangle { left, bottom - STATIC_CHUNK_SIZE, left + STATIC_CHUNK_SIZE, bottom }, Rectangle { 0, 0, 1, 1 });
+			}
+		}
+		renderer->setPremultipliedAlphaBlend(false);
+		renderer->initDraw();
+	}
+
 	for (int i = begin.x(); i < end.x(); ++i) {
 		for (int j = begin.y(); j < end.y(); ++j) {
+			if (staticlayer
+					&& staticChunks[i / STATIC_CHUNK_SIZE + j / STATIC_CHUNK_SIZE * staticChunkColumns].tileKeys[(i % STATIC_CHUNK_SIZE)
+							+ (j % STATIC_CHUNK_SIZE) * STATIC_CHUNK_SIZE] != 0) {
+				continue;
+			}
 			const Level::GameObject& o = level->get(i, j);
 			Matrix2D mvp;
 			mvp.setIdentity();
@@ -380,11 +670,6 @@ void LevelDrawer2D::draw(LevelDrawer& parent, float turnpercent, float alpha, co
 					}
 					break;
 				}
-				case SapphireObject::Glass: {
-					auto& elem = glassanim->getAtIndex(0);
-					drawSapphireTexturePrepared(mvp, elem, alpha, TILE_RECT, elem.getPosition());
-					break;
-				}
 				case SapphireObject::Bag: {
 					if (o.state == SapphireState::Dispensing) {
 						break;
@@ -577,11 +862,6 @@ void LevelDrawer2D::draw(LevelDrawer& parent, float turnpercent, float alpha, co
 
 					break;
 				}
-				case SapphireObject::TNT: {
-					auto& elem = tntanim->getAtIndex(0);
-					drawSapphireTexturePrepared(mvp, elem, alpha, TILE_RECT, elem.getPosition());
-					break;
-				}
 				case SapphireObject::Exit: {
 					if (o.isExitSinkPlayer()) {
 						//TODO draw player based on playerid
@@ -648,60 +928,23 @@ void LevelDrawer2D::draw(LevelDrawer& parent, float turnpercent, float alpha, co
 					}
 					break;
 				}
-				case SapphireObject::RoundStoneWall: {
-					auto& elem = roundstonewallanim->getAtIndex(0);
-					drawSapphireTexturePrepared(mvp, elem, alpha, TILE_RECT, elem.getPosition());
-					break;
-				}
 				case SapphireObject::Earth: {
 					drawEarth(o, expmvp, alpha);
 					break;
 				}
-				case SapphireObject::StoneWall: {
-					auto& elem = stonewallanim->getAtIndex(0);
-					drawSapphireTexturePrepared(mvp, elem, alpha, TILE_RECT, elem.getPosition());
-					if (o.isStoneWallWithObject()) {
-						switch (o.getStoneWallObject()) {
-							case SapphireObject::Emerald: {
-								auto& elem = stonewallgemmask->getAtIndex(0);
-								drawSapphireTexturePrepared(mvp, elem, Color { 0, 1, 0, alpha }, TILE_RECT, elem.getPosition());
-								break;
-							}
-							case SapphireObject::Ruby: {
-								auto& elem = stonewallgemmask->getAtIndex(0);
-								drawSapphireTexturePrepared(mvp, elem, Color { 1, 0, 0, alpha }, TILE_RECT, elem.getPosition());
-								break;
-							}
-							case SapphireObject::Sapphire: {
-								auto& elem = stonewallgemmask->getAtIndex(0);
-								drawSapphireTexturePrepared(mvp, elem, Color { 0, 0.375, 1, alpha }, TILE_RECT, elem.getPosition());
-								break;
-							}
-							case SapphireObject::Citrine: {
-								auto& elem = stonewallgemmask->getAtIndex(0);
-								drawSapphireTexturePrepared(mvp, elem, Color { 1, 1, 0, alpha }, TILE_RECT, elem.getPosition());
-								break;
-							}
-							default: {
-								break;
-							}
-						}
-					}
-					break;
-				}
-				case SapphireObject::Wall: {
-					auto& elem = wallanim->getAtIndex(0);
-					drawSapphireTexturePrepared(mvp, elem, alpha, TILE_RECT, elem.getPosition());
-					break;
-				}
-				case SapphireObject::Safe: {
-					auto& elem = safeanim->getAtIndex(0);
-					drawSapphireTexturePrepared(mvp, elem, alpha, TILE_RECT, elem.getPosition());
-					break;
-				}
-				case SapphireObject::TimeBomb: {
-					auto& elem = timebombanim->getAtIndex(0);
-					drawSapphireTexturePrepared(mvp, elem, alpha, TILE_RECT, elem.getPosition());
+				case SapphireObject::Glass:
+				case SapphireObject::TNT:
+				case SapphireObject::RoundStoneWall:
+				case SapphireObject::StoneWall:
+				case SapphireObject::Wall:
+				case SapphireObject::Safe:
+				case SapphireObject::TimeBomb:
+				case SapphireObject::Sand:
+				case SapphireObject::Wheel:
+				case SapphireObject::PusherLeft:
+				case SapphireObject::PusherRight:
+				case SapphireObject::InvisibleStoneWall: {
+					drawStaticObject(o, mvp, alpha);
 					break;
 				}
 				case SapphireObject::TickBomb: {
@@ -709,11 +952,6 @@ void LevelDrawer2D::draw(LevelDrawer& parent, float turnpercent, float alpha, co
 					drawSapphireTexturePrepared(mvp, elem, alpha, TILE_RECT, elem.getPosition());
 					break;
 				}
-				case SapphireObject::Sand: {
-					auto& elem = sandanim->getAtIndex(0);
-					drawSapphireTexturePrepared(mvp, elem, alpha, TILE_RECT, elem.getPosition());
-					break;
-				}
 				case SapphireObject::SandRock: {
 					DRAW_PAST_OBJECT_FALL_INTO() else {
 						auto& rockelem = rockanim->getAtIndex(0);
@@ -796,37 +1034,16 @@ void LevelDrawer2D::draw(LevelDrawer& parent, float turnpercent, float alpha, co
 					DRAW_PAST_OBJECT_FALL_INTO();
 					break;
 				}
-				case SapphireObject::Wheel: {
-					auto& elem = wheelanim->getAtIndex(0);
-					drawSapphireTexturePrepared(mvp, elem, alpha, TILE_RECT, elem.getPosition());
-					break;
-				}
 				case SapphireObject::Robot: {
 					auto& elem = robotanim->getAtPercent((level->getTurn() % 2) == 0 ? turnpercent : 1.0f - turnpercent);
 					drawSapphireTexturePrepared(mvp, elem, alpha, TILE_RECT, elem.getPosition());
 					DRAW_PAST_OBJECT_FALL_INTO();
 					break;
 				}
-				case SapphireObject::PusherLeft: {
-					auto& elem = pusherleftanim->getAtIndex(0);
-					drawSapphireTexturePrepared(mvp, elem, alpha, TILE_RECT, elem.getPosition());
-					break;
-				}
-				case SapphireObject::PusherRight: {
-					auto& elem = pusherrightanim->getAtIndex(0);
-					drawSapphireTexturePrepared(mvp, elem, alpha, TILE_RECT, elem.getPosition());
-					break;
-				}
 				case SapphireObject::Elevator: {
 					auto& elem = o.state == SapphireState::Still ? elevatoranim->getAtIndex(0) : elevatoranim->getAtPercent(turnpercent);
 					drawSapphireTexturePrepared(mvp, elem, alpha, TILE_RECT, elem.getPosition());
 					break;
-				}
-					//case SapphireObject::InvisibleWall: //TODO create object as invisible unblowable wall
-				case SapphireObject::InvisibleStoneWall: {
-					auto& elem = darkwallanim->getAtIndex(0);
-					drawSapphireTexturePrepared(mvp, elem, alpha, TILE_RECT, elem.getPosition());
-					break;
 				}
 				default: {
 					THROW()<<"Unknown object to draw: " << o.object;
@@ -867,6 +1084,17 @@ void LevelDrawer2D::draw(LevelDrawer& parent, float turnpercent, float alpha, co
 		}
 	}
 
+	if (staticlayer) {
+		//free the textures of the chunks that were not visible for a while
+		for (unsigned int i = 0; i < staticChunkColumns * staticChunkRows; ++i) {
+			StaticChunk& chunk = staticChunks[i];
+			if (chunk.valid && chunk.texture != nullptr && now - chunk.lastUsed > core::time_millis { STATIC_CHUNK_EVICT_MILLIS }) {
+				chunk.target.freeIfLoaded();
+				chunk.texture.freeIfLoaded();
+				chunk.valid = false;
+			}
+		}
+	}
 }
 
 }  // namespace userapp
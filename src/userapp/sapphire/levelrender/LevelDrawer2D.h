@@ -27,6 +27,7 @@
 #include <framework/core/Window.h>
 #include <framework/geometry/Matrix.h>
 #include <framework/render/Texture.h>
+#include <framework/render/RenderTarget.h>
 #include <framework/resource/font/Font.h>
 #include <framework/resource/Resource.h>
 #include <sapphire/levelrender/LevelDrawer.h>
@@ -41,7 +42,62 @@ class Level;
 namespace userapp {
 
 class LevelDrawer2D: public LevelDrawer::DrawerImpl {
+public:
+	/**
+	 * Width and height of a cached static block in tiles.
+	 */
+	static const unsigned int STATIC_CHUNK_SIZE = 16;
+	/**
+	 * If a block would need a larger texture than this, the static tiles are drawn directly.
+	 */
+	static const unsigned int STATIC_CHUNK_MAX_TEXTURE_SIZE = 2048;
+	/**
+	 * The textures of the chunks which were not drawn for this long are freed.
+	 */
+	static const long long STATIC_CHUNK_EVICT_MILLIS = 1000;
 private:
+	/**
+	 * A block of the level with its non-animated tiles (walls, earth, sand, ...) rendered into a texture.
+	 * The texture is only redrawn when the state of these tiles change.
+	 */
+	class StaticChunk {
+	public:
+		Resource<render::Texture> texture;
+		Resource<render::RenderTarget> target;
+		core::time_micros lastUsed { 0 };
+		bool valid = false;
+		/**
+		 * The result of getStaticTileKey() for the tiles when the texture was drawn.
+		 */
+		uint32 tileKeys[STATIC_CHUNK_SIZE * STATIC_CHUNK_SIZE];
+
+		StaticChunk() = default;
+		StaticChunk(const StaticChunk&) = delete;
+		StaticChunk& operator=(const StaticChunk&) = delete;
+		~StaticChunk() {
+			if (texture != nullptr) {
+				target.freeIfLoaded();
+				texture.freeIfLoaded();
+			}
+		}
+	};
+	/**
+	 * The content of a render target texture is lost if it is reloaded after the rendering context is lost,
+	 * so the chunk is redrawn whenever its texture is initialized.
+	 */
+	class StaticChunkInputSource: public render::EmptyInputSource {
+	private:
+		StaticChunk* chunk;
+	protected:
+		virtual void apply(render::Texture* texture) override {
+			chunk->valid = false;
+			EmptyInputSource::apply(texture);
+		}
+	public:
+		StaticChunkInputSource(StaticChunk* chunk, const Size2UI& size)
+				: EmptyInputSource(size, ColorFormat::RGBA_8888), chunk(chunk) {
+		}
+	};
 	class MinerAnimations {
 	public:
 		AutoResource<FrameAnimation> walkleftanim;
@@ -165,16 +221,36 @@ private:
 			float turnpercent);
 
 	void drawEarth(const Level::GameObject& o, const Matrix2D& mvp, float alpha);
+	unsigned int getEarthIndex(int i, int j);
+
+	void drawStaticObject(const Level::GameObject& o, const Matrix2D& mvp, float alpha);
+
+	/**
+	 * Returns 0 if the tile needs to be drawn every frame, or a value that identifies its appearance otherwise.
+	 */
+	uint32 getStaticTileKey(const Level::GameObject& o);
+
+	bool ensureStaticChunks(const Size2F& objectSize);
+	void updateStaticChunk(StaticChunk& chunk, unsigned int cx, unsigned int cy, const Size2F& objectSize);
+	void freeStaticChunks();
 
 	const Level* level;
+
+	StaticChunk* staticChunks = nullptr;
+	unsigned int staticChunkColumns = 0;
+	unsigned int staticChunkRows = 0;
+	Size2F staticChunkObjectSize { 0.0f, 0.0f };
 public:
 	LevelDrawer2D(LevelDrawer& parent, const Level* level);
-	LevelDrawer2D(const LevelDrawer2D&) = default;
-	LevelDrawer2D(LevelDrawer2D&&) = default;
+	LevelDrawer2D(const LevelDrawer2D&) = delete;
+	LevelDrawer2D(LevelDrawer2D&&) = delete;
+	~LevelDrawer2D();
 
 	virtual void draw(LevelDrawer& parent, float turnpercent, float alpha, const Size2UI& begin, const Size2UI& end, const Vector2F& mid,
 			const Size2F& objectSize) override;
 
+	virtual void levelReloaded() override;
+
 };
 
 }  // namespace userapp
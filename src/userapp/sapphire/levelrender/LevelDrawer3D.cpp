@@ -21,6 +21,7 @@
  */
 
 #include <appmain.h>
+#include <framework/core/Profiler.h>
 #include <framework/geometry/Matrix.h>
 #include <framework/xml/XmlParser.h>
 #include <framework/resource/ResourceManager.h>
@@ -56,39 +57,35 @@ inline static float directionToRadian(SapphireDirection dir) {
 		}
 	}
 }
-LevelDrawer3D::LevelDrawer3D()
-		: level(nullptr), needBackground(false), background(needBackground, 0) {
-	drawCommands.addToEnd(defaultCommands);
-	drawCommands.addToEnd(dirtCommands);
-	drawCommands.addToEnd(dispenserCommands);
-	drawCommands.addToEnd(laserCommands);
-	drawCommands.addToEnd(minerSinkCommands);
+thread_local LevelDrawer3D::CommandSet* LevelDrawer3D::recordingCommands = nullptr;
+
+LevelDrawer3D::CommandSet::CommandSet(SapphireObjectBuffer* buf)
+		: defaultCommands { buf }, dirtCommands { buf }, laserCommands { buf }, minerSinkCommands { buf }, dispenserCommands { buf },
+				turnAppearingCommands { buf } {
+	drawOrder[0] = &defaultCommands;
+	drawOrder[1] = &dirtCommands;
+	drawOrder[2] = &dispenserCommands;
+	drawOrder[3] = &laserCommands;
+	drawOrder[4] = &minerSinkCommands;
 	for (int i = 0; i < 4; ++i) {
-		explosioncommands[i].init(objectsBuffer);
-		drawCommands.addToEnd(explosioncommands[i]);
+		explosioncommands[i].init(buf);
+		drawOrder[5 + i] = &explosioncommands[i];
 	}
-	drawCommands.addToEnd(turnAppearingCommands);
+	drawOrder[9] = &turnAppearingCommands;
 
 	defaultCommands.color = Color { 1, 1, 1, 1 };
 }
+
+LevelDrawer3D::LevelDrawer3D()
+		: level(nullptr), needBackground(false), background(needBackground, 0) {
+}
 LevelDrawer3D::LevelDrawer3D(LevelDrawer& parent, const Level* level)
 		: level(level), needBackground(parent.isNeedBackground()), background(needBackground, level->getOriginalRandomSeed()) {
-
-	drawCommands.addToEnd(defaultCommands);
-	drawCommands.addToEnd(dirtCommands);
-	drawCommands.addToEnd(dispenserCommands);
-	drawCommands.addToEnd(laserCommands);
-	drawCommands.addToEnd(minerSinkCommands);
-	for (int i = 0; i < 4; ++i) {
-		explosioncommands[i].init(objectsBuffer);
-		drawCommands.addToEnd(explosioncommands[i]);
-	}
-	drawCommands.addToEnd(turnAppearingCommands);
-
-	defaultCommands.color = Color { 1, 1, 1, 1 };
-
 }
 LevelDrawer3D::~LevelDrawer3D() {
+	for (unsigned int i = 0; i < bandCommandsCount; ++i) {
+		delete bandCommands[i];
+	}
 }
 
 #define MULT_ROLLING(radians) \
@@ -761,7 +758,7 @@ void LevelDrawer3D::drawDoor(float turnpercent, Sapphire3DObject* cover, Sapphir
 	if (o.object == SapphireObject::DoorOneTime) {
 		if (o.isUsingDoor()) {
 			drawObject(door_onetime_lockmesh, Matrix3D { u_m }.multTranslate(0, 0, -0.05 * (1 - turnpercent)),
-					Matrix3D().setTranslate(0, 0, 0.05 * (1 - turnpercent)) *= u_minv, turnAppearingCommands);
+					Matrix3D().setTranslate(0, 0, 0.05 * (1 - turnpercent)) *= u_minv, recording().turnAppearingCommands);
 		} else {
 			if (o.isOneTimeDoorClosed()) {
 				drawObject(door_onetime_lockmesh, u_m, u_minv);
@@ -951,38 +948,26 @@ static void iterateRangeOrdered(int start, int end, int mid, Handler&& h) {
 	}
 }
 
-void LevelDrawer3D::draw(LevelDrawer& parent, float turnpercent, float alpha, const Size2UI& begin, const Size2UI& end, const Vector2F& mid,
-		const Size2F& objectSize) {
-	draw(turnpercent, alpha, begin, end, mid, objectSize, parent.isDispenserFullOpacity(), parent.getSize().pixelSize,
-			parent.getPaddings());
-}
-void LevelDrawer3D::draw(float turnpercent, float alpha, const Size2UI& begin, const Size2UI& end, const Vector2F& mid,
-		const Size2F& objectSize, bool fulldispenser, const Size2UI& pixelsize, const Rectangle& paddings) {
-	ASSERT(end.x() > begin.x());
-	ASSERT(end.y() > begin.y());
-
-	unsigned int midx;
-	if (mid.x() <= begin.x()) {
-		midx = begin.x();
-	} else {
-		midx = (unsigned int) (mid.x());
-		if (midx >= end.x()) {
-			midx = end.x() - 1;
-		}
-	}
-	unsigned int midy;
-	if (mid.y() <= begin.y()) {
-		midy = begin.y();
-	} else {
-		midy = (unsigned int) (mid.y());
-		if (midy >= end.y()) {
-			midy = end.y() - 1;
-		}
+void LevelDrawer3D::recordBand(void* context, unsigned int band) {
+	PROFILE_ZONE("LevelDrawer3D::recordBand");
+	BandRecordContext& ctx = *reinterpret_cast<BandRecordContext*>(context);
+	const unsigned int ystart = ctx.begin.y() + band * ctx.bandHeight;
+	const unsigned int yend = min(ystart + ctx.bandHeight, ctx.end.y());
+	unsigned int midy = ctx.midy;
+	if (midy < ystart) {
+		midy = ystart;
+	} else if (midy >= yend) {
+		midy = yend - 1;
 	}
+	recordingCommands = band == 0 ? nullptr : ctx.drawer->bandCommands[band - 1];
+	ctx.drawer->recordRegion(ctx.turnpercent, Size2UI { ctx.begin.x(), ystart }, Size2UI { ctx.end.x(), yend }, ctx.midx, midy);
+	recordingCommands = nullptr;
+}
 
+void LevelDrawer3D::recordRegion(float turnpercent, const Size2UI& begin, const Size2UI& end, unsigned int midx, unsigned int midy) {
+	//the objects are drawn from the middle outwards, so the closer ones are drawn first
 	drawSingle(level->get(midx, midy), turnpercent);
 
-	auto levelsize = level->getSize();
 	for (int r = 1; true; ++r) {
 		const int ib = ((int) midx) - r;
 		const int ie = ((int) midx) + r;
@@ -1000,8 +985,8 @@ void LevelDrawer3D::draw(float turnpercent, float alpha, const Size2UI& begin, c
 		int ystart = max(jb + 1, (int) begin.y());
 		int yend = min(je, (int) end.y());
 
-		if (jb < levelsize.height()) {
-			if (je < levelsize.height()) {
+		if (jb >= (int) begin.y()) {
+			if (je < (int) end.y()) {
 				iterateRangeOrdered(xstart, xend, midx, [&](int i) {
 					drawSingle(level->get(i, jb), turnpercent);
 					drawSingle(level->get(i, je), turnpercent);
@@ -1012,14 +997,14 @@ void LevelDrawer3D::draw(float turnpercent, float alpha, const Size2UI& begin, c
 				});
 			}
 		} else {
-			if (je < levelsize.height()) {
+			if (je < (int) end.y()) {
 				iterateRangeOrdered(xstart, xend, midx, [&](int i) {
 					drawSingle(level->get(i, je), turnpercent);
 				});
 			}
 		}
-		if (ib < levelsize.width()) {
-			if (ie < levelsize.width()) {
+		if (ib >= (int) begin.x()) {
+			if (ie < (int) end.x()) {
 				iterateRangeOrdered(ystart, yend, midy, [&](int j) {
 					drawSingle(level->get(ib, j), turnpercent);
 					drawSingle(level->get(ie, j), turnpercent);
@@ -1030,27 +1015,87 @@ void LevelDrawer3D::draw(float turnpercent, float alpha, const Size2UI& begin, c
 				});
 			}
 		} else {
-			if (ie < levelsize.width()) {
+			if (ie < (int) end.x()) {
 				iterateRangeOrdered(ystart, yend, midy, [&](int j) {
 					drawSingle(level->get(ie, j), turnpercent);
 				});
 			}
 		}
 
-		if (auto* obj = level->getOptional(ib, jb)) {
-			drawSingle(*obj, turnpercent);
+		if (jb >= (int) begin.y()) {
+			if (ib >= (int) begin.x()) {
+				drawSingle(level->get(ib, jb), turnpercent);
+			}
+			if (ie < (int) end.x()) {
+				drawSingle(level->get(ie, jb), turnpercent);
+			}
 		}
-		if (auto* obj = level->getOptional(ie, jb)) {
-			drawSingle(*obj, turnpercent);
+		if (je < (int) end.y()) {
+			if (ib >= (int) begin.x()) {
+				drawSingle(level->get(ib, je), turnpercent);
+			}
+			if (ie < (int) end.x()) {
+				drawSingle(level->get(ie, je), turnpercent);
+			}
 		}
-		if (auto* obj = level->getOptional(ib, je)) {
-			drawSingle(*obj, turnpercent);
+	}
+}
+
+void LevelDrawer3D::draw(LevelDrawer& parent, float turnpercent, float alpha, const Size2UI& begin, const Size2UI& end, const Vector2F& mid,
+		const Size2F& objectSize) {
+	draw(turnpercent, alpha, begin, end, mid, objectSize, parent.isDispenserFullOpacity(), parent.getSize().pixelSize,
+			parent.getPaddings());
+}
+void LevelDrawer3D::draw(float turnpercent, float alpha, const Size2UI& begin, const Size2UI& end, const Vector2F& mid,
+		const Size2F& objectSize, bool fulldispenser, const Size2UI& pixelsize, const Rectangle& paddings) {
+	PROFILE_ZONE("LevelDrawer3D::draw");
+	ASSERT(end.x() > begin.x());
+	ASSERT(end.y() > begin.y());
+
+	unsigned int midx;
+	if (mid.x() <= begin.x()) {
+		midx = begin.x();
+	} else {
+		midx = (unsigned int) (mid.x());
+		if (midx >= end.x()) {
+			midx = end.x() - 1;
 		}
-		if (auto* obj = level->getOptional(ie, je)) {
-			drawSingle(*obj, turnpercent);
+	}
+	unsigned int midy;
+	if (mid.y() <= begin.y()) {
+		midy = begin.y();
+	} else {
+		midy = (unsigned int) (mid.y());
+		if (midy >= end.y()) {
+			midy = end.y() - 1;
 		}
 	}
 
+	const unsigned int cellcount = (end.x() - begin.x()) * (end.y() - begin.y());
+	const unsigned int rowcount = end.y() - begin.y();
+	unsigned int bandcount = 1;
+	if (cellcount >= SAPPHIRE_THREADED_3D_RECORDING_MIN_CELLS && bandWorkers.getThreadCount() > 1) {
+		//more bands than threads, so a thread that finished early can take another one
+		bandcount = min(min(bandWorkers.getThreadCount() * 2, (unsigned int) MAX_RECORD_BAND_COUNT), rowcount);
+	}
+	if (bandcount <= 1) {
+		recordRegion(turnpercent, begin, end, midx, midy);
+	} else {
+		BandRecordContext context;
+		context.drawer = this;
+		context.turnpercent = turnpercent;
+		context.begin = begin;
+		context.end = end;
+		context.midx = midx;
+		context.midy = midy;
+		context.bandHeight = (rowcount + bandcount - 1) / bandcount;
+		bandcount = (rowcount + context.bandHeight - 1) / context.bandHeight;
+		while (bandCommandsCount < bandcount - 1) {
+			bandCommands[bandCommandsCount++] = new CommandSet(objectsBuffer);
+		}
+		bandWorkers.execute(bandcount, &LevelDrawer3D::recordBand, &context);
+	}
+
 	Size2F fieldsize = pixelsize / objectSize;
 	const float depth = 5.0f + min(fieldsize.length(), ((Size2F) end - (Size2F) begin).length()) / 2.0f;
 
@@ -1062,7 +1107,7 @@ void LevelDrawer3D::draw(float turnpercent, float alpha, const Size2UI& begin, c
 		unsigned int dispenserspeed = level->getDispenserRechargeSpeed();
 		dispenseralpha = dispenserspeed == 0 ? 1.0f : ((level->getDispenserValue() % dispenserspeed) + turnpercent) / dispenserspeed;
 	}
-	dispenserCommands.color = Color { 1, 1, 1, dispenseralpha };
+	mainCommands.dispenserCommands.color = Color { 1, 1, 1, dispenseralpha };
 
 	finishDrawing(alpha, turnpercent, objectSize, pixelsize, paddings, depth, mid);
 
@@ -1070,9 +1115,9 @@ void LevelDrawer3D::draw(float turnpercent, float alpha, const Size2UI& begin, c
 void LevelDrawer3D::finishDrawing(float alpha, float turnpercent, const Size2F& objectSize, const Size2UI& pixelsize,
 		const Rectangle& paddings, float depth, const Vector2F& mid) {
 
-	turnAppearingCommands.color = Color { 1, 1, 1, turnpercent };
+	mainCommands.turnAppearingCommands.color = Color { 1, 1, 1, turnpercent };
 
-	minerSinkCommands.color = Color { 1, 1, 1, (1 - turnpercent) };
+	mainCommands.minerSinkCommands.color = Color { 1, 1, 1, (1 - turnpercent) };
 
 	float laseralphaval;
 	if (turnpercent <= 0.25f) {
@@ -1081,22 +1126,22 @@ void LevelDrawer3D::finishDrawing(float alpha, float turnpercent, const Size2F&
 	} else {
 		laseralphaval = 1.0f - (turnpercent - 0.25f) / 0.75f;
 	}
-	laserCommands.color = Color { 1, 1, 1, laseralphaval };
+	mainCommands.laserCommands.color = Color { 1, 1, 1, laseralphaval };
 
-	dirtCommands.color = Color { 1, 1, 1, 1 - turnpercent * turnpercent };
+	mainCommands.dirtCommands.color = Color { 1, 1, 1, 1 - turnpercent * turnpercent };
 
 	for (int i = 0; i < 4; ++i) {
 		float exppercent = i / 4.0f + turnpercent / 4.0f;
 		if (exppercent <= 0.25f) {
 			float scale = 1.0f - exppercent / 0.25f;
 			scale = 1.0f - scale * scale;
-			explosioncommands[i].color = Color { scale, scale, 0, scale };
+			mainCommands.explosioncommands[i].color = Color { scale, scale, 0, scale };
 		} else if (exppercent <= 0.75f) {
 			exppercent -= 0.25f;
-			explosioncommands[i].color = Color { 1.0f - exppercent, 1.0f - exppercent / 0.5f * 0.75f, 0, 1.0f };
+			mainCommands.explosioncommands[i].color = Color { 1.0f - exppercent, 1.0f - exppercent / 0.5f * 0.75f, 0, 1.0f };
 		} else {
 			float scale = 1 - ((exppercent - 0.75f) / 0.25f);
-			explosioncommands[i].color = Color { scale * 0.5f, scale * 0.25f, 0, scale };
+			mainCommands.explosioncommands[i].color = Color { scale * 0.5f, scale * 0.25f, 0, scale };
 		}
 	}
 
@@ -1223,27 +1268,39 @@ void LevelDrawer3D::finishDrawing(float alpha, float turnpercent, const Size2F&
 	colorAmbientLighting->update( { ambientlighting });
 	sapphirePhongShader->set(colorStateUniform);
 	sapphirePhongShader->set(colorAmbientLighting);
-	for (auto&& cmdnode : drawCommands.nodes()) {
-		auto& cmds = *static_cast<ColoredCommands*>(cmdnode);
+	//the commands of the bands are merged by material, so the material uniform is only updated once
+	CommandSet* sets[MAX_RECORD_BAND_COUNT];
+	sets[0] = &mainCommands;
+	for (unsigned int i = 0; i < bandCommandsCount; ++i) {
+		sets[i + 1] = bandCommands[i];
+	}
+	const unsigned int setcount = bandCommandsCount + 1;
+	for (unsigned int k = 0; k < CommandSet::DRAW_ORDER_COUNT; ++k) {
+		const Color& cmdcolor = mainCommands.drawOrder[k]->color;
 		unsigned int colormatcount = objectsBuffer->getColoredMaterialCount();
 		for (unsigned int i = 0; i < colormatcount; ++i) {
-			auto& list = cmds.commands.coloreds[i];
-			if (list.isEmpty()) {
-				continue;
-			}
-			auto& material = objectsBuffer->getColoredMaterial(i);
-			colorMaterialUniform->update(
-					{ material.diffuseColor * cmds.color * alphamult, material.ambient * cmds.color * alphamult, material.specular
-							* cmds.color.a() * alphamult.a(), material.specularExponent });
-			sapphirePhongShader->set(colorMaterialUniform);
-			for (auto&& cmdnode : list.nodes()) {
-				auto* cmd = static_cast<DrawCommand*>(cmdnode);
-				colorShaderUniform->update( { cmd->mvp, cmd->mvpInverseTranspose });
-				sapphirePhongShader->set(colorShaderUniform);
-				sapphirePhongShader->draw(cmd->vertexIndex, cmd->vertexCount);
-				vertexcount += cmd->vertexCount;
+			bool materialset = false;
+			for (unsigned int s = 0; s < setcount; ++s) {
+				auto& list = sets[s]->drawOrder[k]->commands.coloreds[i];
+				if (list.isEmpty()) {
+					continue;
+				}
+				if (!materialset) {
+					materialset = true;
+					auto& material = objectsBuffer->getColoredMaterial(i);
+					colorMaterialUniform->update(
+							{ material.diffuseColor * cmdcolor * alphamult, material.ambient * cmdcolor * alphamult, material.specular
+									* cmdcolor.a() * alphamult.a(), material.specularExponent });
+					sapphirePhongShader->set(colorMaterialUniform);
+				}
+				for (auto&& cmd : list) {
+					colorShaderUniform->update( { cmd.mvp, cmd.mvpInverseTranspose });
+					sapphirePhongShader->set(colorShaderUniform);
+					sapphirePhongShader->draw(cmd.vertexIndex, cmd.vertexCount);
+					vertexcount += cmd.vertexCount;
+				}
+				list.clear();
 			}
-			drawCommandCache.takeAllEnd(list);
 		}
 	}
 	objectsBuffer->getTexturedInputLayout()->activate();
@@ -1252,26 +1309,31 @@ void LevelDrawer3D::finishDrawing(float alpha, float turnpercent, const Size2F&
 	textureAmbientLighting->update( { ambientlighting });
 	sapphireTexturedPhongShader->set(textureStateUniform);
 	sapphireTexturedPhongShader->set(textureAmbientLighting);
-	for (auto&& cmdnode : drawCommands.nodes()) {
-		auto& cmds = *static_cast<ColoredCommands*>(cmdnode);
+	for (unsigned int k = 0; k < CommandSet::DRAW_ORDER_COUNT; ++k) {
+		const Color& cmdcolor = mainCommands.drawOrder[k]->color;
 		unsigned int texturedmatcount = objectsBuffer->getTexturedMaterialCount();
 		for (unsigned int i = 0; i < texturedmatcount; ++i) {
-			auto& list = cmds.commands.textureds[i];
-			if (list.isEmpty()) {
-				continue;
-			}
-			auto& material = objectsBuffer->getTexturedMaterial(i);
-			textureMaterialUniform->update( { cmds.color * alphamult, material.ambient, material.specular, material.specularExponent,
-					(render::Texture*) material.diffuseColorMap });
-			sapphireTexturedPhongShader->set(textureMaterialUniform);
-			for (auto&& cmdnode : list.nodes()) {
-				auto* cmd = static_cast<DrawCommand*>(cmdnode);
-				textureShaderUniform->update( { cmd->mvp, cmd->mvpInverseTranspose });
-				sapphireTexturedPhongShader->set(textureShaderUniform);
-				sapphireTexturedPhongShader->draw(cmd->vertexIndex, cmd->vertexCount);
-				vertexcount += cmd->vertexCount;
+			bool materialset = false;
+			for (unsigned int s = 0; s < setcount; ++s) {
+				auto& list = sets[s]->drawOrder[k]->commands.textureds[i];
+				if (list.isEmpty()) {
+					continue;
+				}
+				if (!materialset) {
+					materialset = true;
+					auto& material = objectsBuffer->getTexturedMaterial(i);
+					textureMaterialUniform->update( { cmdcolor * alphamult, material.ambient, material.specular, material.specularExponent,
+							(render::Texture*) material.diffuseColorMap });
+					sapphireTexturedPhongShader->set(textureMaterialUniform);
+				}
+				for (auto&& cmd : list) {
+					textureShaderUniform->update( { cmd.mvp, cmd.mvpInverseTranspose });
+					sapphireTexturedPhongShader->set(textureShaderUniform);
+					sapphireTexturedPhongShader->draw(cmd.vertexIndex, cmd.vertexCount);
+					vertexcount += cmd.vertexCount;
+				}
+				list.clear();
 			}
-			drawCommandCache.takeAllEnd(list);
 		}
 	}
 
@@ -1487,96 +1549,62 @@ void SapphireObjectBuffer::free() {
 	delete[] textureMaterials;
 }
 
-void LevelDrawer3D::ColoredCommands::add(Sapphire3DObject* mesh, const Matrix<4>& u_m, Matrix<4> u_minv, LinkedList<DrawCommand>& cache) {
-	u_minv.transpose();
-	if (mesh->getColoredCount() > 0) {
-		for (unsigned int i = 0; i < mesh->getColoredCount(); ++i) {
-			auto& part = mesh->getColored(i);
-
-			DrawCommand* dcmd;
-			if (cache.isEmpty()) {
-				dcmd = new DrawCommand();
-			} else {
-				dcmd = static_cast<DrawCommand*>(cache.first());
-				dcmd->removeLinkFromList();
-			}
-
-			dcmd->mvp = u_m;
-			dcmd->mvpInverseTranspose = u_minv;
-			dcmd->vertexIndex = part.vertexIndex;
-			dcmd->vertexCount = part.vertexCount;
-
-			commands.coloreds[part.materialIndex].addToEnd(*dcmd);
-		}
+void LevelDrawer3D::CommandArray::grow() {
+	unsigned int ncapacity = capacity == 0 ? 64 : capacity * 2;
+	DrawCommand* ncommands = new DrawCommand[ncapacity];
+	for (unsigned int i = 0; i < count; ++i) {
+		ncommands[i] = commands[i];
 	}
-	if (mesh->getTexturedCount() > 0) {
-		for (unsigned int i = 0; i < mesh->getTexturedCount(); ++i) {
-			auto& part = mesh->getTextured(i);
-
-			DrawCommand* dcmd;
-			if (cache.isEmpty()) {
-				dcmd = new DrawCommand();
-			} else {
-				dcmd = static_cast<DrawCommand*>(cache.first());
-				dcmd->removeLinkFromList();
-			}
-
-			dcmd->mvp = u_m;
-			dcmd->mvpInverseTranspose = u_minv;
-			dcmd->vertexIndex = part.vertexIndex;
-			dcmd->vertexCount = part.vertexCount;
+	delete[] commands;
+	commands = ncommands;
+	capacity = ncapacity;
+}
 
-			commands.textureds[part.materialIndex].addToEnd(*dcmd);
-		}
+void LevelDrawer3D::ColoredCommands::add(Sapphire3DObject* mesh, const Matrix<4>& u_m, Matrix<4> u_minv) {
+	u_minv.transpose();
+	for (unsigned int i = 0; i < mesh->getColoredCount(); ++i) {
+		auto& part = mesh->getColored(i);
+
+		DrawCommand& dcmd = commands.coloreds[part.materialIndex].add();
+		dcmd.mvp = u_m;
+		dcmd.mvpInverseTranspose = u_minv;
+		dcmd.vertexIndex = part.vertexIndex;
+		dcmd.vertexCount = part.vertexCount;
+	}
+	for (unsigned int i = 0; i < mesh->getTexturedCount(); ++i) {
+		auto& part = mesh->getTextured(i);
+
+		DrawCommand& dcmd = commands.textureds[part.materialIndex].add();
+		dcmd.mvp = u_m;
+		dcmd.mvpInverseTranspose = u_minv;
+		dcmd.vertexIndex = part.vertexIndex;
+		dcmd.vertexCount = part.vertexCount;
 	}
 }
 
-void LevelDrawer3D::ColoredCommands::addBuilding(Sapphire3DObject* mesh, const Matrix<4>& u_m, Matrix<4> u_minv, float percent,
-		LinkedList<DrawCommand>& cache) {
+void LevelDrawer3D::ColoredCommands::addBuilding(Sapphire3DObject* mesh, const Matrix<4>& u_m, Matrix<4> u_minv, float percent) {
 	ASSERT(percent >= 0.0f && percent <= 1.0f) << percent;
 
 	u_minv.transpose();
-	if (mesh->getColoredCount() > 0) {
-		for (unsigned int i = 0; i < mesh->getColoredCount(); ++i) {
-			auto& part = mesh->getColored(i);
-
-			DrawCommand* dcmd;
-			if (cache.isEmpty()) {
-				dcmd = new DrawCommand();
-			} else {
-				dcmd = static_cast<DrawCommand*>(cache.first());
-				dcmd->removeLinkFromList();
-			}
-
-			dcmd->mvp = u_m;
-			dcmd->mvpInverseTranspose = u_minv;
-			dcmd->vertexIndex = part.vertexIndex;
-			dcmd->vertexCount = part.vertexCount * percent;
-			dcmd->vertexCount -= dcmd->vertexCount % 3;
-
-			commands.coloreds[part.materialIndex].addToEnd(*dcmd);
-		}
+	for (unsigned int i = 0; i < mesh->getColoredCount(); ++i) {
+		auto& part = mesh->getColored(i);
+
+		DrawCommand& dcmd = commands.coloreds[part.materialIndex].add();
+		dcmd.mvp = u_m;
+		dcmd.mvpInverseTranspose = u_minv;
+		dcmd.vertexIndex = part.vertexIndex;
+		dcmd.vertexCount = part.vertexCount * percent;
+		dcmd.vertexCount -= dcmd.vertexCount % 3;
 	}
-	if (mesh->getTexturedCount() > 0) {
-		for (unsigned int i = 0; i < mesh->getTexturedCount(); ++i) {
-			auto& part = mesh->getTextured(i);
-
-			DrawCommand* dcmd;
-			if (cache.isEmpty()) {
-				dcmd = new DrawCommand();
-			} else {
-				dcmd = static_cast<DrawCommand*>(cache.first());
-				dcmd->removeLinkFromList();
-			}
-
-			dcmd->mvp = u_m;
-			dcmd->mvpInverseTranspose = u_minv;
-			dcmd->vertexIndex = part.vertexIndex;
-			dcmd->vertexCount = part.vertexCount * percent;
-			dcmd->vertexCount -= dcmd->vertexCount % 3;
-
-			commands.textureds[part.materialIndex].addToEnd(*dcmd);
-		}
+	for (unsigned int i = 0; i < mesh->getTexturedCount(); ++i) {
+		auto& part = mesh->getTextured(i);
+
+		DrawCommand& dcmd = commands.textureds[part.materialIndex].add();
+		dcmd.mvp = u_m;
+		dcmd.mvpInverseTranspose = u_minv;
+		dcmd.vertexIndex = part.vertexIndex;
+		dcmd.vertexCount = part.vertexCount * percent;
+		dcmd.vertexCount -= dcmd.vertexCount % 3;
 	}
 }
 static Vector3F directionToVector(SapphireDirection dir) {
@@ -1748,7 +1776,7 @@ void LevelDrawer3D::drawSingle(const Level::GameObject& o, float turnpercent) {
 		exprotinverse.multRotate(angles.x() * -M_PI, rotaxes.x(), rotaxes.y(), 0);
 		exprotinverse.multScale(1 / scale, 1 / scale, 1 / scale);
 
-		drawObject(explosionmesh, exprot *= exptrans, exprotinverse, explosioncommands[o.getExplosionState()]);
+		drawObject(explosionmesh, exprot *= exptrans, exprotinverse, recording().explosioncommands[o.getExplosionState()]);
 
 		modeltrans = Matrix3D().setScale(1.0f - turnpercent, 1.0f - turnpercent, 1.0f - turnpercent) *= modeltrans;
 		modelinverse.multScale(1 / (1.0f - turnpercent), 1 / (1.0f - turnpercent), 1 / (1.0f - turnpercent));
@@ -1780,7 +1808,7 @@ void LevelDrawer3D::drawSingle(const Level::GameObject& o, float turnpercent) {
 						Matrix3D().setScale(dirtscale, dirtscale, dirtscale).multTranslate(offset) *= Matrix3D().setTranslate(x, y, 0) *=
 								exptrans,
 						Matrix3D(Matrix3D(expinverse).multTranslate(-x, -y, 0)).multTranslate(offset).multScale(1 / dirtscale,
-								1 / dirtscale, 1 / dirtscale), dirtCommands);
+								1 / dirtscale, 1 / dirtscale), recording().dirtCommands);
 
 			}
 		} else {
@@ -1819,11 +1847,11 @@ void LevelDrawer3D::drawSingle(const Level::GameObject& o, float turnpercent) {
 
 			float rand[] { random.nextFloat(), random.nextFloat(), random.nextFloat() };
 
-			minerSinkCommands.add(obj,
+			recording().minerSinkCommands.add(obj,
 					(Matrix3D().setRotate(angles[i] * turnpercent, rand[0] - 0.5f, rand[1] - 0.5f, 0.3f + 0.2f * rand[2]) *= citrinetrans).multTranslate(
 							o),
 					Matrix3D(citrinetransinv).multTranslate(-o).multRotate(-angles[i] * turnpercent, rand[0] - 0.5f, rand[1] - 0.5f,
-							0.3f + 0.2f * rand[2]), drawCommandCache);
+							0.3f + 0.2f * rand[2]));
 		}
 	} else if (o.isCitrineBreaking()) {
 		drawBuildingObject(citrine_breakingmesh, exptrans, expinverse, 1.0f - turnpercent);
@@ -1971,7 +1999,7 @@ void LevelDrawer3D::drawSingle(const Level::GameObject& o, float turnpercent) {
 						break;
 					}
 
-				drawRobot(turnpercent, robottrans, robotinverse *= expinverse, level->getTurn(), defaultCommands);
+				drawRobot(turnpercent, robottrans, robotinverse *= expinverse, level->getTurn(), recording().defaultCommands);
 			}
 			drawMiner(o.getPlayerId() == 0 ? miner1mesh : miner2mesh, turnpercent, level->getTurn(), modeltrans, modelinverse, o.direction,
 					o.getPlayerFacing(), o.isPlayerDigging(), o.isMoving(), o.isPlayerTryPush());
@@ -1979,7 +2007,7 @@ void LevelDrawer3D::drawSingle(const Level::GameObject& o, float turnpercent) {
 		}
 		case SapphireObject::Robot: {
 			DRAW_PAST_OBJECT_FALL_INTO();
-			drawRobot(turnpercent, modeltrans, modelinverse, level->getTurn(), defaultCommands);
+			drawRobot(turnpercent, modeltrans, modelinverse, level->getTurn(), recording().defaultCommands);
 			break;
 		}
 		case SapphireObject::Rock: {
@@ -2014,7 +2042,7 @@ void LevelDrawer3D::drawSingle(const Level::GameObject& o, float turnpercent) {
 			if (o.isSwampSpawnUp()) {
 				drawBuildingObject(swampmesh, modeltrans, modelinverse, turnpercent);
 			} else if (o.isSwampDropHit()) {
-				drawDropHit(turnpercent, modeltrans, modelinverse, defaultCommands);
+				drawDropHit(turnpercent, modeltrans, modelinverse, recording().defaultCommands);
 				drawBuildingObject(swampmesh, modeltrans, modelinverse, turnpercent);
 			} else {
 				if (o.isSwampHighlight()) {
@@ -2091,11 +2119,11 @@ void LevelDrawer3D::drawSingle(const Level::GameObject& o, float turnpercent) {
 				modeltrans = Matrix3D().setScale(scale, scale, scale).multRotate((1 - scale) * M_PI_4, 0, 0, 1) *= modeltrans;
 				modelinverse.multRotate(-(1 - scale) * M_PI_4, 0, 0, 1).multScale(1 / (scale), 1 / (scale), 1 / (scale));
 			}
-			drawTickBomb(true, turnpercent < 0.5f, modeltrans, modelinverse, defaultCommands);
+			drawTickBomb(true, turnpercent < 0.5f, modeltrans, modelinverse, recording().defaultCommands);
 			break;
 		}
 		case SapphireObject::TimeBomb: {
-			drawTickBomb(false, false, modeltrans, modelinverse, defaultCommands);
+			drawTickBomb(false, false, modeltrans, modelinverse, recording().defaultCommands);
 			break;
 		}
 		case SapphireObject::Bomb: {
@@ -2185,7 +2213,7 @@ void LevelDrawer3D::drawSingle(const Level::GameObject& o, float turnpercent) {
 		case SapphireObject::Exit: {
 			if (o.isExitSinkPlayer()) {
 				drawMiner(o.getPlayerId() == 0 ? miner1mesh : miner2mesh, turnpercent, level->getTurn(), modeltrans, modelinverse,
-						SapphireDirection::Up, o.direction, false, true, false, minerSinkCommands);
+						SapphireDirection::Up, o.direction, false, true, false, recording().minerSinkCommands);
 			}
 			if (o.isExitWalkPlayer()) {
 				Matrix3D plrmodel;
@@ -2250,9 +2278,9 @@ void LevelDrawer3D::drawSingle(const Level::GameObject& o, float turnpercent) {
 			DRAW_PAST_OBJECT_FALL_INTO();
 			if (o.state == SapphireState::Still || o.state == SapphireState::Taking) {
 				drawYamYam(sinf(turnpercent * M_PI), turnpercent, modeltrans, modelinverse, o.getYamYamOldDirection(), o.direction,
-						defaultCommands);
+						recording().defaultCommands);
 			} else {
-				drawYamYam(0.0f, turnpercent, modeltrans, modelinverse, o.getYamYamOldDirection(), o.direction, defaultCommands);
+				drawYamYam(0.0f, turnpercent, modeltrans, modelinverse, o.getYamYamOldDirection(), o.direction, recording().defaultCommands);
 			}
 			break;
 		}
@@ -2333,7 +2361,7 @@ void LevelDrawer3D::drawSingle(const Level::GameObject& o, float turnpercent) {
 				//draw falling rock
 				drawObject(obj, Matrix3D(modeltrans).multTranslate(0, -turnpercent, 0), modelinverse);
 			}
-			drawObject(obj, modeltrans, modelinverse, dispenserCommands);
+			drawObject(obj, modeltrans, modelinverse, recording().dispenserCommands);
 			break;
 		}
 		default: {
@@ -2345,25 +2373,25 @@ void LevelDrawer3D::drawSingle(const Level::GameObject& o, float turnpercent) {
 	if (o.isLaser()) {
 		if (HAS_FLAG(o.visual, SapphireVisual::LaserHorizontal)) {
 			drawObject(laser_verticalmesh, Matrix3D().setRotate(M_PI_2, 0, 0, 1) *= exptrans,
-					Matrix3D(expinverse).multRotate(-M_PI_2, 0, 0, 1), laserCommands);
+					Matrix3D(expinverse).multRotate(-M_PI_2, 0, 0, 1), recording().laserCommands);
 		}
 		if (HAS_FLAG(o.visual, SapphireVisual::LaserVertical)) {
-			drawObject(laser_verticalmesh, exptrans, expinverse, laserCommands);
+			drawObject(laser_verticalmesh, exptrans, expinverse, recording().laserCommands);
 		}
 		if (HAS_FLAG(o.visual, SapphireVisual::LaserLeftBottom)) {
-			drawObject(laser_leftmesh, exptrans, expinverse, laserCommands);
+			drawObject(laser_leftmesh, exptrans, expinverse, recording().laserCommands);
 		}
 		if (HAS_FLAG(o.visual, SapphireVisual::LaserLeftTop)) {
 			drawObject(laser_leftmesh, Matrix3D().setRotate(M_PI_2, 0, 0, 1) *= exptrans, Matrix3D(expinverse).multRotate(-M_PI_2, 0, 0, 1),
-					laserCommands);
+					recording().laserCommands);
 		}
 		if (HAS_FLAG(o.visual, SapphireVisual::LaserRightTop)) {
 			drawObject(laser_leftmesh, Matrix3D().setRotate(M_PI, 0, 0, 1) *= exptrans, Matrix3D(expinverse).multRotate(M_PI, 0, 0, -1),
-					laserCommands);
+					recording().laserCommands);
 		}
 		if (HAS_FLAG(o.visual, SapphireVisual::LaserRightBottom)) {
 			drawObject(laser_leftmesh, Matrix3D().setRotate(M_PI, 0, 1, 0) *= exptrans, Matrix3D(expinverse).multRotate(M_PI, 0, -1, 0),
-					laserCommands);
+					recording().laserCommands);
 		}
 	}
 }
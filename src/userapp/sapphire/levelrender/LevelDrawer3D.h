@@ -32,6 +32,7 @@
 #include <sapphire/level/SapphireRandom.h>
 #include <sapphire/levelrender/LevelDrawer.h>
 #include <sapphire/levelrender/Level3DBackground.h>
+#include <sapphire/levelrender/BandWorkers.h>
 
 namespace userapp {
 using namespace rhfw;
@@ -154,21 +155,57 @@ class LevelDrawer3D: public LevelDrawer::DrawerImpl {
 	AutoResource<SapphireTexturedPhongShader::UFragmentLighting> textureAmbientLighting =
 			sapphireTexturedPhongShader->createUniform_UFragmentLighting();
 
-	class DrawCommand: public LinkedNode<DrawCommand> {
+	class DrawCommand {
 	public:
 		Matrix3D mvp;
 		Matrix3D mvpInverseTranspose;
 		unsigned int vertexIndex;
 		unsigned int vertexCount;
+	};
+	/**
+	 * Contiguous storage of the commands for a material.
+	 * Cleared after every frame, but keeps its capacity, so recording does not allocate once the arrays have grown
+	 * large enough.
+	 */
+	class CommandArray {
+	private:
+		DrawCommand* commands = nullptr;
+		unsigned int count = 0;
+		unsigned int capacity = 0;
+
+		void grow();
+	public:
+		CommandArray() {
+		}
+		CommandArray(const CommandArray&) = delete;
+		CommandArray& operator=(const CommandArray&) = delete;
+		~CommandArray() {
+			delete[] commands;
+		}
 
-		DrawCommand* get() override {
-			return this;
+		DrawCommand& add() {
+			if (count == capacity) {
+				grow();
+			}
+			return commands[count++];
+		}
+		bool isEmpty() const {
+			return count == 0;
+		}
+		void clear() {
+			count = 0;
+		}
+		const DrawCommand* begin() const {
+			return commands;
+		}
+		const DrawCommand* end() const {
+			return commands + count;
 		}
 	};
 	class CommandsHolder {
 	public:
-		MoveablePointer<LinkedList<DrawCommand, false>> coloreds;
-		MoveablePointer<LinkedList<DrawCommand, false>> textureds;
+		MoveablePointer<CommandArray> coloreds;
+		MoveablePointer<CommandArray> textureds;
 
 		CommandsHolder() {
 		}
@@ -182,12 +219,12 @@ class LevelDrawer3D: public LevelDrawer::DrawerImpl {
 		}
 
 		void init(SapphireObjectBuffer* buf) {
-			coloreds = new LinkedList<DrawCommand, false> [buf->getColoredMaterialCount()];
-			textureds = new LinkedList<DrawCommand, false> [buf->getTexturedMaterialCount()];
+			coloreds = new CommandArray[buf->getColoredMaterialCount()];
+			textureds = new CommandArray[buf->getTexturedMaterialCount()];
 		}
 
 	};
-	class ColoredCommands: public LinkedNode<ColoredCommands> {
+	class ColoredCommands {
 	public:
 		Color color;
 		CommandsHolder commands;
@@ -198,30 +235,70 @@ class LevelDrawer3D: public LevelDrawer::DrawerImpl {
 				: commands(buf) {
 		}
 
-		ColoredCommands* get() override {
-			return this;
-		}
 		void init(SapphireObjectBuffer* buf) {
 			commands.init(buf);
 		}
 
-		void add(Sapphire3DObject* mesh, const Matrix<4>& u_m, Matrix<4> u_minv, LinkedList<DrawCommand>& cache);
-		void addBuilding(Sapphire3DObject* mesh, const Matrix<4>& u_m, Matrix<4> u_minv, float percent, LinkedList<DrawCommand>& cache);
+		void add(Sapphire3DObject* mesh, const Matrix<4>& u_m, Matrix<4> u_minv);
+		void addBuilding(Sapphire3DObject* mesh, const Matrix<4>& u_m, Matrix<4> u_minv, float percent);
 	};
 
 	AutoResource<SapphireObjectBuffer> objectsBuffer = getApplicationResource<SapphireObjectBuffer>(
 			ResIds::sapphire_yours::objects_3d_collection);
 
-	ColoredCommands defaultCommands { objectsBuffer };
-	ColoredCommands dirtCommands { objectsBuffer };
-	ColoredCommands laserCommands { objectsBuffer };
-	ColoredCommands minerSinkCommands { objectsBuffer };
-	ColoredCommands dispenserCommands { objectsBuffer };
-	ColoredCommands turnAppearingCommands { objectsBuffer };
-	ColoredCommands explosioncommands[4];
-	LinkedList<ColoredCommands, false> drawCommands;
+	/**
+	 * The commands recorded by a single thread.
+	 * The colors of the main set are used for the commands of every set when drawing.
+	 */
+	class CommandSet {
+	public:
+		static const unsigned int DRAW_ORDER_COUNT = 10;
+
+		ColoredCommands defaultCommands;
+		ColoredCommands dirtCommands;
+		ColoredCommands laserCommands;
+		ColoredCommands minerSinkCommands;
+		ColoredCommands dispenserCommands;
+		ColoredCommands turnAppearingCommands;
+		ColoredCommands explosioncommands[4];
+		ColoredCommands* drawOrder[DRAW_ORDER_COUNT];
+
+		CommandSet(SapphireObjectBuffer* buf);
+		CommandSet(const CommandSet&) = delete;
+		CommandSet& operator=(const CommandSet&) = delete;
+	};
+
+	static const unsigned int MAX_RECORD_BAND_COUNT = 16;
+
+	CommandSet mainCommands { objectsBuffer };
+	/**
+	 * Command sets of the bands recorded by the worker threads, the first band is recorded into the main set.
+	 */
+	CommandSet* bandCommands[MAX_RECORD_BAND_COUNT - 1] { };
+	unsigned int bandCommandsCount = 0;
+	BandWorkers bandWorkers;
+
+	/**
+	 * The set the calling thread records into, or nullptr for the main set.
+	 */
+	static thread_local CommandSet* recordingCommands;
 
-	LinkedList<DrawCommand> drawCommandCache;
+	CommandSet& recording() {
+		return recordingCommands == nullptr ? mainCommands : *recordingCommands;
+	}
+
+	class BandRecordContext {
+	public:
+		LevelDrawer3D* drawer;
+		float turnpercent;
+		Size2UI begin;
+		Size2UI end;
+		unsigned int midx;
+		unsigned int midy;
+		unsigned int bandHeight;
+	};
+	static void recordBand(void* context, unsigned int band);
+	void recordRegion(float turnpercent, const Size2UI& begin, const Size2UI& end, unsigned int midx, unsigned int midy);
 
 	bool lightingFixed = false;
 	Vector2F lightingPosition { 0, 0 };
@@ -410,10 +487,10 @@ class LevelDrawer3D: public LevelDrawer::DrawerImpl {
 	void drawSidedObject(const Level::GameObject& o, Sided3DObject& obj, const Matrix<4>& u_m, const Matrix<4>& u_minv, Tester&& test);
 
 	void drawObject(Sapphire3DObject* mesh, const Matrix<4>& u_m, const Matrix<4>& u_minv, ColoredCommands& commands) {
-		commands.add(mesh, u_m, u_minv, drawCommandCache);
+		commands.add(mesh, u_m, u_minv);
 	}
 	void drawObject(Sapphire3DObject* mesh, const Matrix<4>& u_m, const Matrix<4>& u_minv) {
-		drawObject(mesh, u_m, u_minv, defaultCommands);
+		drawObject(mesh, u_m, u_minv, recording().defaultCommands);
 	}
 	void drawObjectAtOrigin(Sapphire3DObject* mesh, const Matrix<4>& u_m, const Matrix<4>& u_minv,
 			ColoredCommands& commands) {
@@ -421,16 +498,16 @@ class LevelDrawer3D: public LevelDrawer::DrawerImpl {
 				Matrix3D(u_minv).multTranslate(Vector3F {-mesh->getOrigin()}), commands);
 	}
 	void drawObjectAtOrigin(Sapphire3DObject* mesh, const Matrix<4>& u_m, const Matrix<4>& u_minv) {
-		drawObjectAtOrigin(mesh, u_m, u_minv, defaultCommands);
+		drawObjectAtOrigin(mesh, u_m, u_minv, recording().defaultCommands);
 	}
 
 	void drawBuildingObject(Sapphire3DObject* mesh, const Matrix<4>& u_m, const Matrix<4>& u_minv,
 			float percent, ColoredCommands& commands) {
-		commands.addBuilding(mesh, u_m, u_minv, percent, drawCommandCache);
+		commands.addBuilding(mesh, u_m, u_minv, percent);
 	}
 	void drawBuildingObject(Sapphire3DObject* mesh, const Matrix<4>& u_m, const Matrix<4>& u_minv,
 			float percent) {
-		drawBuildingObject(mesh, u_m, u_minv, percent, defaultCommands);
+		drawBuildingObject(mesh, u_m, u_minv, percent, recording().defaultCommands);
 	}
 
 	void drawSand(const Level::GameObject& o, const Matrix<4>& u_m, const Matrix<4>& u_minv);
@@ -474,7 +551,7 @@ public:
 	LevelDrawer3D();
 	LevelDrawer3D(LevelDrawer& parent, const Level* level);
 	LevelDrawer3D(const LevelDrawer3D&) = delete;
-	LevelDrawer3D(LevelDrawer3D&&) = default;
+	LevelDrawer3D(LevelDrawer3D&&) = delete;
 	~LevelDrawer3D();
 
 	virtual void draw(LevelDrawer& parent, float turnpercent, float alpha, const Size2UI& begin, const Size2UI& end,
@@ -556,10 +633,10 @@ public:
 	void disableBackground();
 
 	ColoredCommands& getManualColoredCommand() {
-		return dispenserCommands;
+		return mainCommands.dispenserCommands;
 	}
 	ColoredCommands& getDefaultColoredCommand() {
-		return defaultCommands;
+		return mainCommands.defaultCommands;
 	}
 };
 
@@ -21,6 +21,7 @@
  */
 
 #include <framework/audio/descriptor/WavAudioDescriptor.h>
+#include <framework/core/Profiler.h>
 #include <framework/core/timing.h>
 #include <framework/io/files/AssetFileDescriptor.h>
 #include <framework/utils/BasicListener.h>
@@ -48,6 +49,7 @@ LevelSounder::~LevelSounder() {
 }
 
 void LevelSounder::playSoundsForTurn() {
+	PROFILE_ZONE("LevelSounder::playSoundsForTurn");
 	if (soundVolume == 0 || !audioManager.isLoaded()) {
 		return;
 	}
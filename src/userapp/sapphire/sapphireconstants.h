@@ -36,6 +36,25 @@
 #define SAPPHIRE_TURN_INCREASE_STEP_MILLIS 50
 #define SAPPHIRE_TURN_MILLIS 250
 #define SAPPHIRE_TURN_SLOW_MILLIS 500
+/* levels with at least this many cells are simulated on a separate thread while playing */
+#define SAPPHIRE_THREADED_SIMULATION_MIN_CELLS (64 * 64)
+/* 3D views showing at least this many cells record their draw commands on multiple threads */
+#define SAPPHIRE_THREADED_3D_RECORDING_MIN_CELLS (24 * 24)
+/* the server collects level changes for this long before notifying the clients in a single batch */
+#define SAPPHIRE_LEVEL_CHANGES_BATCH_MILLIS 250
+/* same for the online user changes */
+#define SAPPHIRE_PRESENCE_BATCH_MILLIS 1000
+/* downloaded levels are sent in chunks of this size, so other responses can be sent in between */
+#define SAPPHIRE_DOWNLOAD_CHUNK_SIZE (16 * 1024)
+#define SAPPHIRE_DOWNLOAD_MAX_SIZE (64 * 1024 * 1024)
+/* estimated size of the messages in the server write queues, if not specified otherwise */
+#define SAPPHIRE_SERVER_WRITE_SIZE_ESTIMATE 64
+/* superseded notifications are coalesced if the write queue of a connection grows larger */
+#define SAPPHIRE_SERVER_WRITE_QUEUE_COALESCE_LIMIT (256 * 1024)
+/* the connection is dropped if its write queue grows larger */
+#define SAPPHIRE_SERVER_WRITE_QUEUE_LIMIT (4 * 1024 * 1024)
+/* expensive requests (level uploads, demo downloads) are refused if this many are in progress */
+#define SAPPHIRE_SERVER_EXPENSIVE_REQUEST_LIMIT 8
 
 #define SAPPHIRE_CMD_END_OF_FILE ((char)0)
 #define SAPPHIRE_CMD_DEMOCOUNT ((char)128)
@@ -91,7 +110,12 @@
 //4: fix for enum dialog item listener
 //5: steam release, ruby hunter
 //6: speed increase/decrease keys aded
-#define SAPPHIRE_RELEASE_VERSION_NUMBER 6
+//7: batched level details notifications
+//8: compact demo move encoding
+//9: concurrent request handling, chunked level downloads
+//10: online user snapshot and batched presence changes
+//11: incremental level catalog synchronization
+#define SAPPHIRE_RELEASE_VERSION_NUMBER 11
 #define SAPPHIRE_LEVEL_VERSION_NUMBER 5
 /*
  * !!!update server when increasing release number!!!
@@ -118,6 +142,11 @@
  #define SAPPHIRE_SCREENSHOT_INCLUDE_HUD 1
  //*/
 
+//put // at the start of the next line to enable the profiler hotkeys (F9, F10) in release builds
+/*
+ #define SAPPHIRE_PROFILER_HOTKEYS 1
+ //*/
+
 typedef rhfw::uint16 SY_COMM_CMD;
 namespace rhfw {
 
@@ -100,6 +100,14 @@ public:
 		exitState = EXIT_STATE_SIGNALED;
 		jobsSemaphore.post();
 	}
+	/**
+	 * Signals the thread to stop without running the jobs that haven't started yet.
+	 */
+	void signalStopDiscardJobs() {
+		signalStop();
+		MutexLocker lock { jobsMutex };
+		jobs.clear();
+	}
 	void stop() {
 		signalStop();
 		if (exitState < EXIT_STATE_WAITED) {
@@ -133,6 +141,11 @@ public:
 		auto job = new ConcreteJob(util::forward<Functor>(j));
 		{
 			MutexLocker m { jobsMutex };
+			if (exitState != EXIT_STATE_RUNNING) {
+				//stopped meanwhile
+				delete job;
+				return false;
+			}
 			jobs.addToEnd(*job);
 		}
 		jobsSemaphore.post();